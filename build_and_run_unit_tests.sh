@@ -18,4 +18,7 @@ cmake ..
 make
 
 # run unit tests
-./ppm_tests
\ No newline at end of file
+./ppm_tests
+
+# run the soak tests, which are left out of the default run
+./ppm_tests "[soak]"
\ No newline at end of file
@@ -0,0 +1,139 @@
+/**
+ * @file
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems, UT Battelle.
+ */
+
+
+#ifndef CVDP_DI_CORRIDORKERNEL_HPP
+#define CVDP_DI_CORRIDORKERNEL_HPP
+
+#include <cstdint>
+
+#include "frozenquad.hpp"
+
+/**
+ * @brief Scans over a range of FrozenQuad corridors that return as soon as one corridor contains the point.
+ *
+ * There is a portable scalar scan plus SSE2 (two corridors per step) and AVX2 (four corridors per step) scans on x86.
+ * Each one evaluates the bounding box and the four edge expressions with the same products and sums, in the same order
+ * and without fused multiply-add, as geo::Corridor::contains. All of them therefore give exactly the same answer. The
+ * widest scan the processor supports is picked at runtime; see best().
+ *
+ * The fixed-point scans over geo::FixedCorridor arrays are integer only, so they agree exactly by construction: the
+ * scalar scan and an AVX2 scan that tests eight bounding boxes per step and computes the edge cross products four at a
+ * time in 64 bit lanes. SSE2 has no signed 32 x 32 bit multiply, so it uses the scalar fixed-point scan.
+ */
+class CorridorKernel {
+    public:
+        /**
+         * @brief The instruction sets a scan can be written for.
+         */
+        enum class ISA : uint8_t {
+            SCALAR = 0,
+            SSE2 = 1,
+            AVX2 = 2
+        };
+
+        using Scan = FrozenQuad::CorridorScan;
+        using FixedScan = FrozenQuad::FixedCorridorScan;
+
+        /**
+         * @brief Predicate indicating whether this build includes a scan for the instruction set and the processor can
+         * run it.
+         *
+         * @param isa the instruction set.
+         * @return true if get( isa ) returns a usable scan; false otherwise.
+         */
+        static bool supported( ISA isa );
+
+        /**
+         * @brief Return the widest supported instruction set; the result is computed once.
+         *
+         * @return the instruction set used by FrozenQuad.
+         */
+        static ISA best();
+
+        /**
+         * @brief Return the scan written for an instruction set.
+         *
+         * @param isa the instruction set.
+         * @return the scan function; nullptr when the instruction set is not supported.
+         */
+        static Scan get( ISA isa );
+
+        /**
+         * @brief Return the fixed-point scan written for an instruction set.
+         *
+         * @param isa the instruction set.
+         * @return the scan function; the scalar scan for SSE2 and nullptr when the instruction set is not supported.
+         */
+        static FixedScan get_fixed( ISA isa );
+
+        /**
+         * @brief Return a printable name for an instruction set.
+         *
+         * @param isa the instruction set.
+         * @return "scalar", "sse2" or "avx2".
+         */
+        static const char* name( ISA isa );
+
+        /**
+         * @brief The portable scan; every other scan must agree with it.
+         *
+         * @param corridors the corridor arrays.
+         * @param begin the first corridor to check.
+         * @param end one past the last corridor to check.
+         * @param lat the latitude of the point.
+         * @param lon the longitude of the point.
+         * @return true if one of the corridors contains the point; false otherwise.
+         */
+        static bool scan_scalar( const FrozenQuad::CorridorArrays& corridors, uint32_t begin, uint32_t end, double lat, double lon );
+
+        /**
+         * @brief The SSE2 scan; see scan_scalar for the parameters. Only defined on x86.
+         */
+        static bool scan_sse2( const FrozenQuad::CorridorArrays& corridors, uint32_t begin, uint32_t end, double lat, double lon );
+
+        /**
+         * @brief The AVX2 scan; see scan_scalar for the parameters. Only defined on x86 when the compiler can target AVX2,
+         * and only safe to call when supported( ISA::AVX2 ).
+         */
+        static bool scan_avx2( const FrozenQuad::CorridorArrays& corridors, uint32_t begin, uint32_t end, double lat, double lon );
+
+        /**
+         * @brief The portable fixed-point scan; the same tests as geo::FixedCorridor::contains.
+         *
+         * @param corridors the fixed-point corridor arrays.
+         * @param begin the first corridor to check.
+         * @param end one past the last corridor to check.
+         * @param lat the latitude of the position in 1e-7 degree.
+         * @param lon the longitude of the position in 1e-7 degree.
+         * @return true if one of the corridors contains the position; false otherwise.
+         */
+        static bool scan_fixed_scalar( const FrozenQuad::FixedCorridorArrays& corridors, uint32_t begin, uint32_t end, int32_t lat, int32_t lon );
+
+        /**
+         * @brief The AVX2 fixed-point scan; see scan_fixed_scalar for the parameters. Only defined on x86 when the
+         * compiler can target AVX2, and only safe to call when supported( ISA::AVX2 ).
+         */
+        static bool scan_fixed_avx2( const FrozenQuad::FixedCorridorArrays& corridors, uint32_t begin, uint32_t end, int32_t lat, int32_t lon );
+};
+
+#endif
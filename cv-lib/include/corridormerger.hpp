@@ -0,0 +1,120 @@
+/**
+ * @file
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems, UT Battelle.
+ */
+
+#ifndef CVDP_DI_CORRIDORMERGER_HPP
+#define CVDP_DI_CORRIDORMERGER_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "entity.hpp"
+
+/**
+ * @brief A CorridorMerger replaces runs of consecutive map edges of the same way with one longer edge and corridor.
+ * Maps such as I_80.edges describe a road as thousands of short two-vertex edges; each becomes its own corridor, so
+ * the leaves of a geofence index are crowded with nearly collinear neighbours that a query checks one by one.
+ *
+ * Two edges are consecutive when the second starts at the vertex the first ends at, both have the same way id and
+ * way type, and no other edge of that way starts or ends at the shared vertex. Each chain of consecutive edges is
+ * merged greedily from its first edge: a run grows while the merged corridor stays within the tolerance.
+ *
+ * The merged corridor is the rectangle, aligned with the chord from the first vertex of the run to its last, that
+ * holds every corner of the corridors of the run's edges, plus kPadMeters. The rectangle is computed in degrees scaled
+ * by the cosine of the run's first latitude, an affine image of the degree space that Corridor tests in, so it holds
+ * each original corridor exactly (up to rounding, which the pad covers): no position that was within the geofence
+ * falls outside of it. A run is only accepted when
+ *
+ * - every vertex of the run is within the tolerance of the chord,
+ * - each side of the rectangle is within the tolerance of half the way width from the chord,
+ * - each end of the rectangle is within the tolerance of the edge extension past the chord's end, and
+ * - the chord is no longer than the maximum length.
+ *
+ * So a position newly within the geofence is at most about twice the tolerance from an original corridor. The
+ * maximum length keeps the bounding boxes of diagonal runs from growing without bound.
+ *
+ * Edges without a way id are never merged. A merged edge keeps the identifier of the first edge of its run; edges
+ * that are not merged are returned as they were, with the same corridor Edge::to_area gives them.
+ */
+class CorridorMerger {
+    public:
+        constexpr static double kDefaultMaxLength = 1000.0;     ///< Meters; the longest merged chord when privacy.filter.geofence.merge.length is not set.
+        constexpr static double kPadMeters = 0.001;             ///< Meters added around a merged rectangle.
+
+        /**
+         * @brief The counts of one merge.
+         */
+        struct Stats {
+            std::size_t edges;                      ///< Edges given to merge.
+            std::size_t chains;                     ///< Chains of consecutive edges, including single edges.
+            std::size_t corridors;                  ///< Edges, and so corridors, returned.
+        };
+
+        /**
+         * @brief Construct a merger.
+         *
+         * @param extension the meters each edge corridor is extended beyond its vertices (see Edge::to_area).
+         * @param tolerance the meters a merged corridor may reach beyond the corridors it replaces; see above.
+         * @param max_length the longest merged chord in meters.
+         * @throws std::invalid_argument when extension or tolerance is negative or max_length is not positive.
+         */
+        CorridorMerger( double extension, double tolerance, double max_length = kDefaultMaxLength );
+
+        /**
+         * @brief Merge the consecutive edges of each way.
+         *
+         * @param edges the map edges.
+         * @param ways the way id of each edge, in the same order; empty for an edge without one.
+         * @param merged set to the edges after merging, merged or not; in the order of the first edge of each run.
+         * @param corridors set to the corridor of each edge in merged.
+         * @param stats when not null, set to the counts of this merge.
+         * @throws std::invalid_argument when edges and ways differ in size.
+         * @throws geo::ZeroAreaException when an edge has no width (see Edge::to_area).
+         */
+        void merge( const std::vector<geo::EdgeCPtr>& edges, const std::vector<std::string>& ways,
+                    std::vector<geo::EdgeCPtr>& merged, std::vector<geo::Corridor>& corridors, Stats* stats = nullptr ) const;
+
+        double get_extension() const;               ///< @return the edge corridor extension in meters.
+        double get_tolerance() const;               ///< @return the merge tolerance in meters.
+        double get_max_length() const;              ///< @return the longest merged chord in meters.
+
+    private:
+        double extension_;                          ///< Meters edge corridors are extended.
+        double tolerance_;                          ///< Meters a merged corridor may reach beyond the originals.
+        double max_length_;                         ///< Meters; the longest merged chord.
+
+        /**
+         * @brief Compute the merged edge and corridor of chain[begin, end) if it is within the tolerance.
+         *
+         * @param chain the edges of one chain, in order.
+         * @param areas the area of each edge of the chain (see Edge::to_area).
+         * @param begin the first edge of the run.
+         * @param end one past the last edge of the run; at least begin + 2.
+         * @param edge set to the merged edge when the run fits.
+         * @param corridor set to the merged corridor when the run fits.
+         * @return true if the run fits; false otherwise.
+         */
+        bool fit( const std::vector<geo::EdgeCPtr>& chain, const std::vector<geo::AreaPtr>& areas, std::size_t begin,
+                  std::size_t end, geo::EdgeCPtr& edge, geo::Corridor& corridor ) const;
+};
+
+#endif
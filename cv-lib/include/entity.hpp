@@ -26,6 +26,7 @@
 #ifndef CVDP_DI_ENTITY_HPP
 #define CVDP_DI_ENTITY_HPP
 
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <limits>
@@ -148,6 +149,12 @@ struct Point {
     friend std::ostream& operator<<(std::ostream& os, const Point& pt);
 };
 
+/**
+ * @brief The concrete type of an Entity. This is the numeric form of Entity::get_type for dispatching (switch) in
+ * loops that cannot afford string construction and comparison.
+ */
+enum class EntityType : uint8_t { LOCATION = 0, EDGE = 1, AREA = 2, CIRCLE = 3, GRID = 4 };
+
 /**
  * @brief Interface for entities which can be partially contained within other
  * entities. Entity is the base class for all shapes, points, lines, etc.
@@ -166,6 +173,13 @@ class Entity {
          */ 
         virtual const std::string get_type(void) const = 0;
 
+        /**
+         * @brief Get the numeric type of this entity; it always agrees with get_type.
+         * 
+         * @return EntityType The type of this entity.
+         */ 
+        virtual EntityType get_entity_type(void) const = 0;
+
         /**
          * @brief Determine is this entity is within the bounds object.
          * 
@@ -356,6 +370,13 @@ class Location : public Point, public Entity {
          */ 
         const std::string get_type(void) const;
 
+        /**
+         * @brief Get the numeric type of this entity.
+         * 
+         * @return EntityType The type of this entity.
+         */ 
+        EntityType get_entity_type(void) const;
+
         /**
          * @brief Determine is this location is within the bounds object.
          * 
@@ -663,6 +684,13 @@ class Edge : public Entity {
          */ 
         const std::string get_type(void) const;
 
+        /**
+         * @brief Get the numeric type of this entity.
+         * 
+         * @return EntityType The type of this entity.
+         */ 
+        EntityType get_entity_type(void) const;
+
         /**
          * Determine if this edge is within the bounds object.
          * 
@@ -914,6 +942,13 @@ class Area : public Entity {
          */ 
         const std::string get_type(void) const;
 
+        /**
+         * @brief Get the numeric type of this entity.
+         * 
+         * @return EntityType The type of this entity.
+         */ 
+        EntityType get_entity_type(void) const;
+
         /**
          * @brief Predicate that indicates whether this area is contained within the 
          * provided bounds or intersects spatially the bounds.
@@ -984,6 +1019,166 @@ class Area : public Entity {
         friend std::ostream& operator<< ( std::ostream& os, const Area& area );
 };
 
+/**
+ * @brief A Corridor is the precomputed form of an Area used for repeated containment checks. The four edge lines of the
+ * area are reduced to line coefficients and the area is wrapped in an axis aligned bounding box, so a containment
+ * check is a few compares and at most four multiply-adds with no allocation.
+ *
+ * The edge tests evaluate exactly the same expressions as Area::outside_edge so a Corridor and the Area it was built
+ * from agree on every point. The bounding box is padded by #kPad so it never rejects a point the edge tests would accept.
+ *
+ * A default constructed Corridor is empty and contains no points.
+ */
+struct Corridor {
+    constexpr static double kPad = 1.0e-9;      ///< Degrees added around the bounding box (roughly a tenth of a millimeter).
+
+    double min_lat;                             ///< Southern edge of the bounding box.
+    double min_lon;                             ///< Western edge of the bounding box.
+    double max_lat;                             ///< Northern edge of the bounding box.
+    double max_lon;                             ///< Eastern edge of the bounding box.
+
+    double a[4];                                ///< Latitude coefficient of each area edge; the negated longitude span.
+    double b[4];                                ///< Longitude coefficient of each area edge; the latitude span.
+    double c[4];                                ///< Constant term of each area edge.
+
+    /**
+     * @brief Construct an empty corridor.
+     */
+    Corridor();
+
+    /**
+     * @brief Construct a corridor from an area.
+     *
+     * @param area The area to precompute.
+     */
+    explicit Corridor( const Area& area );
+
+    /**
+     * @brief Predicate indicating this corridor was default constructed and contains nothing.
+     *
+     * @return true if the corridor is empty; false otherwise.
+     */
+    bool empty() const;
+
+    /**
+     * @brief Predicate that indicates whether this Corridor contains the provided point.
+     *
+     * @param pt the point whose containment is checked.
+     * @return true if the area this corridor was built from contains the point; false otherwise.
+     */
+    bool contains( const Point& pt ) const;
+};
+
+/**
+ * @brief A FixedPoint is a position in integer units of 1e-7 degree, the resolution J2735 uses for latitude and
+ * longitude. Every valid position fits in 32 bits and converting a decoded BSM position back to these units is exact.
+ */
+struct FixedPoint {
+    constexpr static double kUnitsPerDegree = 1.0e7;    ///< J2735 positions are tenths of a microdegree.
+
+    int32_t lat;                                ///< Latitude in 1e-7 degree.
+    int32_t lon;                                ///< Longitude in 1e-7 degree.
+
+    /**
+     * @brief Construct the point (0, 0).
+     */
+    FixedPoint();
+
+    /**
+     * @brief Construct a point from fixed-point coordinates.
+     *
+     * @param latitude the latitude in 1e-7 degree.
+     * @param longitude the longitude in 1e-7 degree.
+     */
+    FixedPoint( int32_t latitude, int32_t longitude );
+
+    /**
+     * @brief Convert a point in decimal degrees, rounding each coordinate to the nearest unit.
+     *
+     * @param pt the point; its coordinates must be valid latitude and longitude values.
+     * @return The fixed-point position.
+     */
+    static FixedPoint from_degrees( const Point& pt );
+
+    /**
+     * @brief Convert one coordinate in decimal degrees, rounding to the nearest unit.
+     *
+     * @param degrees the coordinate; within [-180, 180].
+     * @return The coordinate in 1e-7 degree.
+     */
+    static int32_t to_units( double degrees );
+
+    /**
+     * @brief Convert this position back to decimal degrees.
+     *
+     * @return The point.
+     */
+    Point to_degrees() const;
+};
+
+/**
+ * @brief A FixedCorridor is a Corridor with its four corners rounded to FixedPoint units. Containment uses 64 bit
+ * integer cross products, so the answer for a position is exact and the same on every build and processor.
+ *
+ * Rounding moves each corner by at most half a unit (about 6 mm) per coordinate, so a FixedCorridor agrees with the
+ * Corridor it was built from except for points within about a unit of its boundary. Every coordinate difference in a
+ * containment check is between two values inside the bounding box; the constructor rejects corridors whose box spans
+ * 2^31 units (about 214 degrees) or more so those differences fit in 32 bits and their products in 64.
+ *
+ * A default constructed FixedCorridor is empty and contains no points.
+ */
+struct FixedCorridor {
+    int32_t min_lat;                            ///< Southern edge of the bounding box.
+    int32_t min_lon;                            ///< Western edge of the bounding box.
+    int32_t max_lat;                            ///< Northern edge of the bounding box.
+    int32_t max_lon;                            ///< Eastern edge of the bounding box.
+
+    int32_t lat[4];                             ///< Latitude of each corner, in Area order.
+    int32_t lon[4];                             ///< Longitude of each corner, in Area order.
+
+    /**
+     * @brief Construct an empty corridor.
+     */
+    FixedCorridor();
+
+    /**
+     * @brief Construct a fixed-point corridor from a corridor. The corners are recovered by intersecting adjacent edge
+     * lines; a corridor that has collapsed onto a line has no corners and gives an empty FixedCorridor.
+     *
+     * @param corridor The corridor to convert.
+     * @throws std::out_of_range when the corridor's bounding box is too wide for 32 bit differences.
+     */
+    explicit FixedCorridor( const Corridor& corridor );
+
+    /**
+     * @brief Predicate indicating this corridor contains nothing.
+     *
+     * @return true if the corridor is empty; false otherwise.
+     */
+    bool empty() const;
+
+    /**
+     * @brief Predicate that indicates whether this corridor contains the provided position; points on an edge are
+     * inside, as with Area::contains.
+     *
+     * @param pt the position whose containment is checked.
+     * @return true if the position is within the corridor; false otherwise.
+     */
+    bool contains( const FixedPoint& pt ) const;
+
+    /**
+     * @brief The edge test shared by contains and the FrozenQuad fixed-point scans: the cross product of the edge from
+     * corner (lat1, lon1) to (lat2, lon2) with the vector from that corner to the position.
+     *
+     * @return a negative value when the position is outside the edge (to its left, see Area::outside_edge).
+     */
+    static int64_t edge_side( int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2, int32_t lat, int32_t lon )
+    {
+        return (static_cast<int64_t>( lat2 ) - lat1) * (static_cast<int64_t>( lon ) - lon1) -
+               (static_cast<int64_t>( lon2 ) - lon1) * (static_cast<int64_t>( lat ) - lat1);
+    }
+};
+
 /**
  * @brief A circle is a 2D GPS coordinate and a radius measured in meters. The
  * circle is also described by its northernmost, southernmost, easternmost,
@@ -1041,6 +1236,13 @@ class Circle : public Location {
          */ 
         const std::string get_type(void) const;
 
+        /**
+         * @brief Get the numeric type of this entity.
+         * 
+         * @return EntityType The type of this entity.
+         */ 
+        EntityType get_entity_type(void) const;
+
         /**
          * Predicate indicating whether this circle is within the provided
          * bounds.
@@ -1065,6 +1267,17 @@ class Circle : public Location {
          */ 
         bool contains(const Point& point) const;
 
+        /**
+         * Return a box that contains every point this circle contains.
+         *
+         * Unlike the cardinal points, the box is derived from the
+         * distance used by contains, and is padded for rounding, so no
+         * contained point falls outside it.
+         *
+         * @return Bounds The containing box.
+         */
+        Bounds containment_bounds() const;
+
         /**
          * Compare this circle with another circle. Two circles are 
          * equal if they contain they have the same point and radius.
@@ -1297,6 +1510,13 @@ class Grid : public Bounds, public Entity {
          */ 
         const std::string get_type(void) const;
 
+        /**
+         * @brief Get the numeric type of this entity.
+         * 
+         * @return EntityType The type of this entity.
+         */ 
+        EntityType get_entity_type(void) const;
+
         /**
          * @brief Predicate indicating whether any of the corners of this grid are within
          * the provided bounds, the grid is contained in the bounds, or the bounds is contained in the grid.
@@ -0,0 +1,509 @@
+/**
+ * @file
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems, UT Battelle.
+ */
+
+#ifndef CVDP_DI_FROZENQUAD_HPP
+#define CVDP_DI_FROZENQUAD_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "entity.hpp"
+#include "quad.hpp"
+#include "geofenceindex.hpp"
+
+/**
+ * @brief A FrozenQuad is a compiled, read-only copy of a Quad tree used to answer geofence queries.
+ *
+ * Everything lives in one allocation. The nodes are stored in a single array. Each node's children are contiguous and
+ * the subtrees are laid out depth first in child order (NW, NE, SW, SE), so the leaves appear in Z-order. Children
+ * and leaf contents are referenced by integer offsets rather than pointers. The geometry the leaves need (edge
+ * corridors, circles and grids) is copied out of the entities and packed as structure-of-arrays, one range per type and
+ * leaf, so a query never touches an Entity.
+ *
+ * A query descends the tree exactly as Quad::retrieve_elements does (first child whose bounds contain the point) and
+ * checks the same geometry, so the answers match the Quad it was built from. A leaf's corridors are checked with the
+ * widest CorridorKernel scan the processor supports. Edges are checked with the corridors
+ * stored in the Quad; an edge without a corridor (see Quad::make_corridors) contains nothing. Entity types other than
+ * edges, circles and grids are not part of the geofence and are not copied.
+ *
+ * The leaf geometry can also be projected onto a local plane in meters when the tree is compiled (Geometry::PLANAR),
+ * or rounded to the 1e-7 degree integers J2735 positions use (Geometry::FIXED); the tree itself stays in degrees and
+ * each query converts its point once, after the descent.
+ *
+ * Because the allocation holds no pointers, a FrozenQuad can be saved to a file as is (see save) and mapped back into
+ * memory read-only (see load) without any parsing. This lets a geofence be compiled once, offline, and loaded in
+ * milliseconds.
+ */
+class FrozenQuad : public GeofenceIndex {
+    public:
+        using Ptr = std::shared_ptr<FrozenQuad>;
+        using CPtr = std::shared_ptr<const FrozenQuad>;
+
+        /**
+         * @brief A tree node: its retrieval bounds, its children and, for leaves, its geometry ranges. One cache line.
+         */
+        struct Node {
+            double sw_lat;                          ///< Southern edge of the node.
+            double sw_lon;                          ///< Western edge of the node.
+            double ne_lat;                          ///< Northern edge of the node.
+            double ne_lon;                          ///< Eastern edge of the node.
+            uint32_t first_child;                   ///< Index of the first child node; children are contiguous.
+            uint32_t child_count;                   ///< Number of children; 0 for a leaf.
+            uint32_t corridor_begin;                ///< First corridor of this leaf.
+            uint32_t corridor_end;                  ///< One past the last corridor of this leaf.
+            uint32_t circle_begin;                  ///< First circle of this leaf.
+            uint32_t circle_end;                    ///< One past the last circle of this leaf.
+            uint32_t grid_begin;                    ///< First grid of this leaf.
+            uint32_t grid_end;                      ///< One past the last grid of this leaf.
+
+            /**
+             * @brief Predicate indicating whether the (inclusive) bounds of this node contain the point.
+             *
+             * @param pt the point to check.
+             * @return true if the point is within the node's bounds; false otherwise.
+             */
+            bool contains( const geo::Point& pt ) const
+            {
+                return sw_lat <= pt.lat && pt.lat <= ne_lat && sw_lon <= pt.lon && pt.lon <= ne_lon;
+            }
+        };
+
+        /**
+         * @brief The corridor fields (see geo::Corridor) stored as one array per field.
+         */
+        struct CorridorArrays {
+            const double* min_lat;
+            const double* min_lon;
+            const double* max_lat;
+            const double* max_lon;
+            const double* a[4];
+            const double* b[4];
+            const double* c[4];
+        };
+
+        /**
+         * @brief A function that checks the corridors [begin, end) and returns true when one of them contains the point
+         * (lat, lon); see CorridorKernel.
+         */
+        using CorridorScan = bool (*)( const CorridorArrays& corridors, uint32_t begin, uint32_t end, double lat, double lon );
+
+        /**
+         * @brief The fixed-point corridor fields (see geo::FixedCorridor) stored as one array per field.
+         */
+        struct FixedCorridorArrays {
+            const int32_t* min_lat;
+            const int32_t* min_lon;
+            const int32_t* max_lat;
+            const int32_t* max_lon;
+            const int32_t* lat[4];
+            const int32_t* lon[4];
+        };
+
+        /**
+         * @brief A function that checks the fixed-point corridors [begin, end) and returns true when one of them
+         * contains the position (lat, lon), in 1e-7 degree; see CorridorKernel.
+         */
+        using FixedCorridorScan = bool (*)( const FixedCorridorArrays& corridors, uint32_t begin, uint32_t end, int32_t lat, int32_t lon );
+
+        /**
+         * @brief The circle fields stored as one array per field.
+         */
+        struct CircleArrays {
+            const double* lat;
+            const double* lon;
+            const double* radius;
+            const double* scale;                    ///< Planar geometry only: the east scale at the circle over the anchor's.
+        };
+
+        /**
+         * @brief The grid fields stored as one array per field.
+         */
+        struct GridArrays {
+            const double* sw_lat;
+            const double* sw_lon;
+            const double* ne_lat;
+            const double* ne_lon;
+        };
+
+        constexpr static std::size_t kAlignment = 64;           ///< Every array starts on a cache line boundary.
+        constexpr static uint32_t kFormatVersion = 6;           ///< Version of the compiled file format; bump on any layout change.
+        constexpr static uint32_t kPlanarFlag = 0x1;            ///< FileHeader::flags bit set when the geometry is planar.
+        constexpr static uint32_t kFixedFlag = 0x2;             ///< FileHeader::flags bit set when the geometry is fixed-point.
+
+        /**
+         * @brief How the leaf geometry is stored and checked.
+         */
+        enum class Geometry {
+            SPHERICAL,                              ///< Degrees, as in the Quad; circles use Location::distance.
+            PLANAR,                                 ///< Meters in a local east-north plane; see Projection.
+            FIXED                                   ///< Integer 1e-7 degrees; corridors are geo::FixedCorridor, circles stay in degrees.
+        };
+
+        /**
+         * @brief A local east-north (ENU without the up) plane anchored at the center of the tree. A point is projected
+         * with one multiply-add per coordinate: north = (lat - anchor_lat) * north_scale and east = (lon - anchor_lon) *
+         * east_scale, in meters.
+         *
+         * The projection scales each axis by a constant, so corridors and grids, which are straight-edged in degrees,
+         * keep their shape and answer the same; only rounding (well under a micrometer) can differ. A circle is checked
+         * with the east scale of its own center, so the planar distance differs from Location::distance by at most
+         * d * d * tan|lat| / (2 * kEarthRadiusM) for a point d meters away, e.g., 0.7 mm for a 100 m circle at 42
+         * degrees.
+         */
+        struct Projection {
+            double anchor_lat;                      ///< Latitude of the origin.
+            double anchor_lon;                      ///< Longitude of the origin.
+            double north_scale;                     ///< Meters per degree of latitude.
+            double east_scale;                      ///< Meters per degree of longitude at the anchor.
+
+            /**
+             * @brief Construct the projection anchored at the center of a node.
+             *
+             * @param root the node, normally the root of the tree.
+             * @return The projection.
+             */
+            static Projection centered( const Node& root );
+
+            /**
+             * @brief Project a point onto the plane.
+             *
+             * @param pt the point in degrees.
+             * @return The point in meters; lat holds north and lon holds east.
+             */
+            geo::Point project( const geo::Point& pt ) const
+            {
+                return geo::Point{ (pt.lat - anchor_lat) * north_scale, (pt.lon - anchor_lon) * east_scale };
+            }
+        };
+
+        /**
+         * @brief The identity of the map file a tree was compiled from.
+         */
+        struct Source {
+            uint64_t bytes;                         ///< The size of the file.
+            int64_t mtime_ns;                       ///< The modification time of the file, in nanoseconds since the epoch.
+            uint64_t hash;                          ///< FrozenQuad::checksum of the contents, zero padded to whole words.
+
+            /**
+             * @brief Predicate indicating whether two files have the same contents; the modification time is not
+             * compared, so a copy of a map is the same map and an edit within the same second is not.
+             */
+            bool same_contents( const Source& other ) const
+            {
+                return bytes == other.bytes && hash == other.hash;
+            }
+
+            /**
+             * @brief Read the identity of a file.
+             *
+             * @throws std::runtime_error when the file cannot be read.
+             */
+            static Source of( const std::string& path );
+        };
+
+        /**
+         * @brief The header of a compiled geofence file; it is followed by the allocation, byte for byte.
+         */
+        struct FileHeader {
+            char magic[8];                          ///< Always "CVDPGEOF".
+            uint32_t byte_order;                    ///< 0x01020304 written in the byte order of the compiling host.
+            uint32_t version;                       ///< kFormatVersion of the compiler.
+            uint32_t node_size;                     ///< sizeof(Node) of the compiler.
+            uint32_t node_count;                    ///< Number of nodes.
+            uint32_t corridor_count;                ///< Number of corridors.
+            uint32_t circle_count;                  ///< Number of circles.
+            uint32_t grid_count;                    ///< Number of grids.
+            uint32_t flags;                         ///< kPlanarFlag or kFixedFlag for those geometries.
+            double extension;                       ///< The edge box extension (meters) the corridors were computed with.
+            uint64_t payload_bytes;                 ///< The size of the allocation that follows the header.
+            uint64_t checksum;                      ///< Checksum of the allocation; see FrozenQuad::checksum.
+            uint32_t max_elements;                  ///< The Quad::Parameters the tree was built with.
+            uint32_t reserved;                      ///< Zero.
+            double min_degrees;                     ///< The Quad::Parameters the tree was built with.
+            double reduction_factor;                ///< The Quad::Parameters the tree was built with.
+            double merge_tolerance;                 ///< The CorridorMerger tolerance (meters) of the edges; 0 when not merged.
+            double merge_length;                    ///< The CorridorMerger maximum length (meters); 0 when not merged.
+            uint64_t source_bytes;                  ///< The Source of the map file; all zero when not recorded.
+            int64_t source_mtime_ns;                ///< The Source of the map file.
+            uint64_t source_hash;                   ///< The Source of the map file.
+
+            /**
+             * @brief Return the tree parameters recorded in the header.
+             */
+            Quad::Parameters parameters() const
+            {
+                return Quad::Parameters{ max_elements, min_degrees, reduction_factor };
+            }
+
+            /**
+             * @brief Return the identity of the map file recorded in the header.
+             */
+            Source source() const
+            {
+                return Source{ source_bytes, source_mtime_ns, source_hash };
+            }
+
+            /**
+             * @brief Return the geometry recorded in the flags.
+             */
+            Geometry geometry() const
+            {
+                return (flags & kFixedFlag) ? Geometry::FIXED : ((flags & kPlanarFlag) ? Geometry::PLANAR : Geometry::SPHERICAL);
+            }
+        };
+
+        /**
+         * @brief Compile a Quad tree.
+         *
+         * @param quad the root of the tree to compile; the tree is not modified and can be discarded afterwards.
+         * @param geometry whether the leaf geometry is kept in degrees, projected onto a local plane or rounded to
+         * fixed point.
+         * @throws std::out_of_range for fixed-point geometry when a corridor is too wide; see geo::FixedCorridor.
+         */
+        explicit FrozenQuad( const Quad& quad, Geometry geometry = Geometry::SPHERICAL );
+
+        /**
+         * @brief Write this tree to a compiled geofence file. The file is written next to its final name and renamed
+         * into place, so a reader never sees a partial file. On a hugetlbfs mount the file is sized in whole huge
+         * pages and filled through a mapping, so processes that load it share huge pages.
+         *
+         * @param path the file to write.
+         * @param extension the edge box extension (meters) the corridors were computed with; recorded in the header.
+         * @param merge_tolerance the CorridorMerger tolerance (meters) the edges were merged with; 0 when not merged.
+         * @param merge_length the CorridorMerger maximum length (meters) the edges were merged with; 0 when not merged.
+         * @param source the identity of the map file the tree was compiled from; all zero when not known.
+         * @throws std::runtime_error when the file cannot be written.
+         */
+        void save( const std::string& path, double extension, double merge_tolerance = 0.0, double merge_length = 0.0,
+                   const Source& source = Source{} ) const;
+
+        /**
+         * @brief Map a compiled geofence file into memory read-only. Nothing is parsed or copied; the tree uses the
+         * mapped pages directly and unmaps them when the last reference goes away. The mapping is shared, so every
+         * process that loads the same file uses one physical copy of it.
+         *
+         * @param path the file to load.
+         * @param verify when true, the checksum of the whole file is checked.
+         * @return The tree.
+         * @throws std::runtime_error when the file cannot be mapped or is not a compatible, intact compiled geofence.
+         */
+        static CPtr load( const std::string& path, bool verify = true );
+
+        /**
+         * @brief Read and check the header of a compiled geofence file.
+         *
+         * @param path the file to read.
+         * @return The header.
+         * @throws std::runtime_error when the file cannot be read or its header is not compatible with this build.
+         */
+        static FileHeader read_header( const std::string& path );
+
+        /**
+         * @brief Predicate indicating whether a file starts like a compiled geofence file.
+         *
+         * @param path the file to check.
+         * @return true if the file exists and starts with the compiled geofence magic; false otherwise.
+         */
+        static bool is_compiled( const std::string& path );
+
+        /**
+         * @brief Compute the checksum stored in a compiled geofence file: FNV-1a over 64 bit words.
+         *
+         * @param data the start of the data; 8 byte aligned.
+         * @param bytes the size of the data; a multiple of 8.
+         * @return The checksum.
+         */
+        static uint64_t checksum( const char* data, std::size_t bytes );
+
+        /**
+         * @brief Predicate indicating whether the point is within any of the geofence entities in its leaf.
+         *
+         * @param pt the point to check.
+         * @return true if the point is within the geofence; false otherwise.
+         */
+        bool is_within_entity( const geo::Point& pt ) const override;
+
+        /**
+         * @brief Predicate indicating whether the point is within any of the geofence entities in its leaf, starting
+         * with the hinted leaf and corridor.
+         *
+         * A point strictly inside the hinted leaf's bounds is in no other leaf, so the descent is skipped. The hint
+         * remembers the leaf and the corridor that contained the point.
+         *
+         * @param pt the point to check.
+         * @param hint the hint left by the previous query for the same moving point; updated.
+         * @return true if the point is within the geofence; false otherwise.
+         */
+        bool is_within_entity( const geo::Point& pt, Hint& hint ) const override;
+
+        /**
+         * @brief Check a batch of points, walking the tree once (see GeofenceIndex::walk_batch).
+         *
+         * @param points the points to check.
+         * @param count the number of points.
+         * @param within set to count answers, in the order of the points.
+         */
+        void within_entities( const geo::Point* points, std::size_t count, Bitmap& within ) const override;
+
+        /**
+         * @brief Return the leaf node that contains the provided point.
+         *
+         * @param pt The point whose containing leaf we are interested in.
+         * @return A pointer to the leaf; nullptr when pt is outside the tree.
+         */
+        const Node* retrieve_leaf( const geo::Point& pt ) const;
+
+        /**
+         * @brief Predicate indicating whether the point is within any of the entities of the provided leaf.
+         *
+         * @param leaf a leaf of this tree.
+         * @param pt the point to check.
+         * @return true if the point is within one of the leaf's entities; false otherwise.
+         */
+        bool leaf_contains( const Node& leaf, const geo::Point& pt ) const;
+
+        /**
+         * @brief Return the node array; the root is the first node.
+         *
+         * @return A pointer to the first of node_count() nodes.
+         */
+        const Node* get_nodes() const;
+
+        /**
+         * @brief Return the corridor arrays; each leaf's corridors are the range [corridor_begin, corridor_end).
+         *
+         * @return A constant reference to the corridor arrays.
+         */
+        const CorridorArrays& get_corridors() const;
+
+        /**
+         * @brief Return the fixed-point corridor arrays used instead of the corridor arrays by fixed-point geometry.
+         *
+         * @return A constant reference to the fixed-point corridor arrays; all null for other geometries.
+         */
+        const FixedCorridorArrays& get_fixed_corridors() const;
+
+        /**
+         * @brief Return the circle arrays; each leaf's circles are the range [circle_begin, circle_end).
+         *
+         * @return A constant reference to the circle arrays.
+         */
+        const CircleArrays& get_circles() const;
+
+        /**
+         * @brief Return the grid arrays; each leaf's grids are the range [grid_begin, grid_end).
+         *
+         * @return A constant reference to the grid arrays.
+         */
+        const GridArrays& get_grids() const;
+
+        Geometry get_geometry() const;                  ///< @return how the leaf geometry is stored.
+        const Quad::Parameters& get_parameters() const; ///< @return the parameters of the Quad the tree was compiled from.
+        const Projection& get_projection() const;       ///< @return the plane used by planar geometry.
+        uint32_t node_count() const;                    ///< @return the number of nodes.
+        uint32_t corridor_count() const;                ///< @return the number of corridors over all leaves.
+        uint32_t circle_count() const;                  ///< @return the number of circles over all leaves.
+        uint32_t grid_count() const;                    ///< @return the number of grids over all leaves.
+
+        /**
+         * @brief Return the size of the single allocation holding the nodes and geometry.
+         *
+         * @return The number of bytes used.
+         */
+        std::size_t bytes() const;
+
+    private:
+        constexpr static char kMagic[8] = { 'C', 'V', 'D', 'P', 'G', 'E', 'O', 'F' };     ///< The first bytes of a compiled file.
+        constexpr static uint32_t kByteOrder = 0x01020304;                              ///< Detects files from other byte orders.
+
+        /**
+         * @brief Return the huge page size of the file system holding an open file: non-zero only on hugetlbfs.
+         */
+        static std::size_t huge_page_bytes( int fd );
+
+        /**
+         * @brief Throw std::runtime_error unless a header was written by a compatible build.
+         */
+        static void check_header( const FileHeader& header, const std::string& path );
+
+        /**
+         * @brief Return the point in the coordinates of the leaf geometry: projected when planar, rounded to 1e-7 degree
+         * units when fixed, as is otherwise.
+         */
+        geo::Point to_geometry( const geo::Point& pt ) const;
+
+        /**
+         * @brief Predicate indicating whether the point, in leaf geometry coordinates, is within any of the corridors
+         * [begin, end), using the scan for this geometry and processor.
+         */
+        bool corridors_contain( uint32_t begin, uint32_t end, const geo::Point& q ) const;
+
+        /**
+         * @brief Predicate indicating whether the point, in leaf geometry coordinates, is within any of the circles or
+         * grids of the provided leaf.
+         */
+        bool shapes_contain( const Node& leaf, const geo::Point& q ) const;
+
+        /**
+         * @brief Point the arrays at the allocation and set up the projection for the geometry.
+         */
+        void attach( Geometry geometry );
+
+        /**
+         * @brief Construct a tree over an existing allocation laid out by a FrozenQuad with the same counts.
+         */
+        FrozenQuad( std::shared_ptr<char> storage, const FileHeader& header );
+
+        /**
+         * @brief Return the size of the allocation needed for the counts of this tree.
+         */
+        std::size_t layout_bytes() const;
+
+        /**
+         * @brief Predicate indicating whether every node's children follow it within the node array and every leaf's
+         * ranges lie within the entity arrays, so a query stays in bounds and ends.
+         */
+        bool nodes_consistent() const;
+
+
+        std::shared_ptr<char> storage_;                 ///< The allocation holding all the arrays.
+        std::size_t bytes_;                             ///< The usable size of the allocation.
+
+        uint32_t node_count_;                           ///< Number of nodes.
+        uint32_t corridor_count_;                       ///< Number of corridors; an edge in several leaves is counted in each.
+        uint32_t circle_count_;                         ///< Number of circles; counted per leaf like corridors.
+        uint32_t grid_count_;                           ///< Number of grids; counted per leaf like corridors.
+
+        const Node* nodes_;                             ///< The node array.
+        CorridorArrays corridors_;                      ///< The corridor arrays.
+        FixedCorridorArrays fixed_corridors_;           ///< The fixed-point corridor arrays.
+        CircleArrays circles_;                          ///< The circle arrays.
+        GridArrays grids_;                              ///< The grid arrays.
+        CorridorScan scan_corridors_;                   ///< The corridor scan chosen for this processor.
+        FixedCorridorScan scan_fixed_corridors_;        ///< The fixed-point corridor scan chosen for this processor.
+        Geometry geometry_;                             ///< How the leaf geometry is stored.
+        Quad::Parameters parameters_;                   ///< The parameters of the Quad the tree was compiled from.
+        Projection projection_;                         ///< The plane of planar geometry; anchored at the root's center.
+};
+
+#endif
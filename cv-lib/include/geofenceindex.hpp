@@ -0,0 +1,205 @@
+/**
+ * @file
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems, UT Battelle.
+ */
+
+
+#ifndef CVDP_DI_GEOFENCEINDEX_HPP
+#define CVDP_DI_GEOFENCEINDEX_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "entity.hpp"
+
+/**
+ * @brief A GeofenceIndex answers the one question the geofence filter asks: is a point inside any of the map's
+ * geofence entities (edge corridors, circles and grids)?
+ *
+ * Implementations differ only in how they find the candidate entities for a point (Quad, FrozenQuad, GridIndex, HilbertRTree). One
+ * is chosen per deployment with the privacy.filter.geofence.index property. Once built, an index is not modified and
+ * queries may run concurrently.
+ *
+ * Successive queries for one moving point, e.g., the BSMs of one vehicle, usually land in the same leaf and often in
+ * the same entity. An index may use a Hint, owned by the caller, to check those first. A batch of points, e.g., one
+ * Kafka consumer batch, is checked in Morton (Z) order so neighboring points are checked together.
+ */
+class GeofenceIndex {
+    public:
+        using Ptr = std::shared_ptr<GeofenceIndex>;
+        using CPtr = std::shared_ptr<const GeofenceIndex>;
+        using Bitmap = std::vector<bool>;                           ///< One answer per point of a batch.
+
+        /**
+         * @brief What an index remembers about the previous query for one moving point. A hint is only a shortcut: a
+         * query with a stale hint, or one filled in by another index, gives the same answer as a query without one.
+         */
+        struct Hint {
+            static constexpr uint32_t kNoEntity = UINT32_MAX;      ///< No entity contained the previous point.
+
+            const GeofenceIndex* index;             ///< The index that filled in the hint; nullptr when empty.
+            const void* leaf;                       ///< The index's leaf (or cell) that held the previous point.
+            uint32_t entity;                        ///< The index's position of the entity that contained the previous point.
+            bool leaf_hit;                          ///< Set by each query: the point was answered from the hinted leaf.
+            bool entity_hit;                        ///< Set by each query: the hinted entity contained the point.
+
+            Hint() : index{ nullptr }, leaf{ nullptr }, entity{ kNoEntity }, leaf_hit{ false }, entity_hit{ false } {}
+        };
+
+        virtual ~GeofenceIndex() {}
+
+        /**
+         * @brief Predicate indicating whether the point is within the geofence.
+         *
+         * @param pt the point to check.
+         * @return true if the point is within one of the geofence entities; false otherwise.
+         */
+        virtual bool is_within_entity( const geo::Point& pt ) const = 0;
+
+        /**
+         * @brief Predicate indicating whether the point is within the geofence, checking the hinted leaf and entity
+         * first and updating the hint for the next query. Indexes that do not use hints ignore it.
+         *
+         * @param pt the point to check.
+         * @param hint the hint left by the previous query for the same moving point.
+         * @return true if the point is within one of the geofence entities; false otherwise.
+         */
+        virtual bool is_within_entity( const geo::Point& pt, Hint& hint ) const
+        {
+            hint.leaf_hit = false;
+            hint.entity_hit = false;
+            return is_within_entity( pt );
+        }
+
+        /**
+         * @brief Check a batch of points. The points are visited in Morton order; indexes that can, walk their tree
+         * once for the whole batch. The answers are the same as checking each point on its own.
+         *
+         * The default visits the points in Morton order with one Hint, so consecutive points reuse their leaf.
+         *
+         * @param points the points to check.
+         * @param count the number of points.
+         * @param within set to count answers, in the order of the points.
+         */
+        virtual void within_entities( const geo::Point* points, std::size_t count, Bitmap& within ) const;
+
+        /**
+         * @brief Return the positions of a batch of points sorted by the Morton (Z-order) code of each point within
+         * the bounding box of the batch. Points with the same code keep their order.
+         *
+         * @param points the points to sort.
+         * @param count the number of points.
+         * @return The positions of the points in Morton order.
+         */
+        static std::vector<uint32_t> morton_order( const geo::Point* points, std::size_t count );
+
+        /**
+         * @brief Interleave the bits of two 32 bit cell coordinates into a 64 bit Morton code; y takes the odd bits.
+         *
+         * @param x the column of the cell.
+         * @param y the row of the cell.
+         * @return The Morton code.
+         */
+        static uint64_t morton_code( uint32_t x, uint32_t y );
+
+    protected:
+        /**
+         * @brief Check a batch of points against a tree by walking it once: the points, in Morton order, are handed
+         * down level by level, each to the first child whose bounds contain it (as a single query descends), and
+         * checked against their leaf together.
+         *
+         * The tree is accessed through an adaptor that provides Handle, root(), contains( Handle, pt ),
+         * child_count( Handle ), child( Handle, i ) and leaf_contains( Handle, pt ).
+         *
+         * @param tree the adaptor of the tree to walk.
+         * @param points the points to check.
+         * @param count the number of points.
+         * @param within set to count answers, in the order of the points.
+         */
+        template <typename Tree>
+        static void walk_batch( const Tree& tree, const geo::Point* points, std::size_t count, Bitmap& within )
+        {
+            using Handle = typename Tree::Handle;
+
+            struct Range {
+                Handle node;
+                std::size_t begin;
+                std::size_t end;
+            };
+
+            within.assign( count, false );
+
+            // keep the points in the root; everything else is outside the tree.
+            std::vector<uint32_t> order = morton_order( points, count );
+            std::size_t inside = 0;
+            for (uint32_t i : order) {
+                if (tree.contains( tree.root(), points[i] )) order[inside++] = i;
+            }
+
+            std::vector<uint32_t> buffer( inside );
+            std::vector<uint8_t> bucket( inside );
+            std::vector<Range> stack{ Range{ tree.root(), 0, inside } };
+
+            while (!stack.empty()) {
+                Range range = stack.back();
+                stack.pop_back();
+
+                std::size_t children = tree.child_count( range.node );
+                if (children == 0) {
+                    for (std::size_t k = range.begin; k < range.end; ++k) {
+                        within[order[k]] = tree.leaf_contains( range.node, points[order[k]] );
+                    }
+                    continue;
+                }
+
+                // a stable counting sort of the range by child; bucket children holds the points no child contains.
+                std::vector<std::size_t> offsets( children + 2, 0 );
+                for (std::size_t k = range.begin; k < range.end; ++k) {
+                    std::size_t c = 0;
+                    while (c < children && !tree.contains( tree.child( range.node, c ), points[order[k]] )) ++c;
+                    bucket[k] = static_cast<uint8_t>( c );
+                    ++offsets[c + 1];
+                }
+
+                offsets[0] = range.begin;
+                for (std::size_t c = 1; c < offsets.size(); ++c) {
+                    offsets[c] += offsets[c - 1];
+                }
+
+                std::vector<std::size_t> next( offsets.begin(), offsets.end() - 1 );
+                for (std::size_t k = range.begin; k < range.end; ++k) {
+                    buffer[next[bucket[k]]++] = order[k];
+                }
+                std::copy( buffer.begin() + range.begin, buffer.begin() + range.end, order.begin() + range.begin );
+
+                // push in reverse so the first child's points are checked first.
+                for (std::size_t c = children; c-- > 0;) {
+                    if (offsets[c] != offsets[c + 1]) {
+                        stack.push_back( Range{ tree.child( range.node, c ), offsets[c], offsets[c + 1] } );
+                    }
+                }
+            }
+        }
+};
+
+#endif
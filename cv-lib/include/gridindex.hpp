@@ -0,0 +1,153 @@
+/**
+ * @file
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems, UT Battelle.
+ */
+
+
+#ifndef CVDP_DI_GRIDINDEX_HPP
+#define CVDP_DI_GRIDINDEX_HPP
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "entity.hpp"
+#include "quad.hpp"
+#include "frozenquad.hpp"
+#include "geofenceindex.hpp"
+
+/**
+ * @brief A GridIndex divides the geofence region into uniform square cells and hashes each cell that some geofence
+ * entity overlaps to the geometry of those entities. A query quantizes the point to its cell, does one hash lookup
+ * and checks that cell's geometry; there is no tree to descend. This suits long, thin maps such as highway corridors,
+ * where most of the region is empty and a tree spends most of its depth isolating the road.
+ *
+ * The index is built from a Quad tree: it takes the tree's region and every edge corridor, circle and grid entity in
+ * it (an entity held by several leaves is taken once). Edges without a corridor are skipped, as in FrozenQuad. Each
+ * entity is registered in every cell its bounding box overlaps, so a point is checked against every entity that could
+ * contain it. Points outside the tree's region are never within the geofence.
+ */
+class GridIndex : public GeofenceIndex {
+    public:
+        using Ptr = std::shared_ptr<GridIndex>;
+        using CPtr = std::shared_ptr<const GridIndex>;
+
+        constexpr static double kDefaultCellDegrees = 0.01;        ///< Cell side used when privacy.filter.geofence.index.cell is not set.
+
+        /**
+         * @brief The geometry ranges of one cell; each range indexes the corresponding arrays of the index.
+         */
+        struct Cell {
+            uint32_t corridor_begin;                ///< First corridor of this cell.
+            uint32_t corridor_end;                  ///< One past the last corridor of this cell.
+            uint32_t circle_begin;                  ///< First circle of this cell.
+            uint32_t circle_end;                    ///< One past the last circle of this cell.
+            uint32_t grid_begin;                    ///< First grid of this cell.
+            uint32_t grid_end;                      ///< One past the last grid of this cell.
+        };
+
+        /**
+         * @brief Build a grid index.
+         *
+         * @param quad the root of the tree holding the geofence entities; the tree is not modified.
+         * @param cell_degrees the side of a cell in decimal degrees; must be positive.
+         * @throws std::invalid_argument when cell_degrees is not positive.
+         */
+        GridIndex( const Quad& quad, double cell_degrees = kDefaultCellDegrees );
+
+        GridIndex( const GridIndex& ) = delete;                 ///< The corridor arrays point into this instance.
+        GridIndex& operator=( const GridIndex& ) = delete;
+
+        /**
+         * @brief Predicate indicating whether the point is within any of the geofence entities of its cell.
+         *
+         * @param pt the point to check.
+         * @return true if the point is within the geofence; false otherwise.
+         */
+        bool is_within_entity( const geo::Point& pt ) const override;
+        using GeofenceIndex::is_within_entity;                 ///< The hinted query; a grid cell lookup is a hash probe, so hints are ignored.
+
+        /**
+         * @brief Return the cell that contains the provided point.
+         *
+         * @param pt the point whose cell we are interested in.
+         * @return A pointer to the cell; nullptr when pt is outside the region or no entity overlaps its cell.
+         */
+        const Cell* retrieve_cell( const geo::Point& pt ) const;
+
+        double get_cell_degrees() const;                        ///< @return the side of a cell in decimal degrees.
+        std::size_t cell_count() const;                         ///< @return the number of cells holding at least one entity.
+        uint32_t corridor_count() const;                        ///< @return the number of corridors over all cells.
+        uint32_t circle_count() const;                          ///< @return the number of circles over all cells.
+        uint32_t grid_count() const;                            ///< @return the number of grids over all cells.
+
+    private:
+        /**
+         * @brief A circle's center and radius.
+         */
+        struct CircleRecord {
+            double lat;
+            double lon;
+            double radius;
+        };
+
+        /**
+         * @brief A grid's inclusive bounds.
+         */
+        struct GridRecord {
+            double sw_lat;
+            double sw_lon;
+            double ne_lat;
+            double ne_lon;
+        };
+
+        geo::Point sw_;                                         ///< The southwest corner of the region.
+        geo::Point ne_;                                         ///< The northeast corner of the region.
+        double cell_degrees_;                                   ///< The side of a cell in decimal degrees.
+        uint32_t last_row_;                                     ///< The row of the northern edge of the region.
+        uint32_t last_col_;                                     ///< The column of the eastern edge of the region.
+
+        std::unordered_map<uint64_t, Cell> cells_;              ///< Cell key (row, column) to the cell's ranges; only cells with entities.
+
+        std::vector<double> corridor_data_;                     ///< The 16 corridor fields, each stored as one contiguous array.
+        FrozenQuad::CorridorArrays corridors_;                  ///< The corridor arrays in corridor_data_.
+        uint32_t corridor_count_;                               ///< Number of corridors; an edge in several cells is counted in each.
+        std::vector<CircleRecord> circles_;                     ///< The circles of every cell.
+        std::vector<GridRecord> grids_;                         ///< The grids of every cell.
+        FrozenQuad::CorridorScan scan_corridors_;               ///< The corridor scan chosen for this processor.
+
+        /**
+         * @brief Return the row of a latitude; not clamped to the region.
+         */
+        int64_t row( double lat ) const;
+
+        /**
+         * @brief Return the column of a longitude; not clamped to the region.
+         */
+        int64_t col( double lon ) const;
+
+        /**
+         * @brief Return the hash key of a cell.
+         */
+        static uint64_t key( uint32_t row, uint32_t col );
+};
+
+#endif
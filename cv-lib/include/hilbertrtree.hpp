@@ -0,0 +1,210 @@
+/**
+ * @file
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems, UT Battelle.
+ */
+
+#ifndef CVDP_DI_HILBERTRTREE_HPP
+#define CVDP_DI_HILBERTRTREE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "entity.hpp"
+#include "quad.hpp"
+#include "frozenquad.hpp"
+#include "geofenceindex.hpp"
+
+/**
+ * @brief A HilbertRTree is a static, packed R-tree over the bounding boxes of the geofence entities, bulk loaded in
+ * Hilbert order.
+ *
+ * A Quad splits space without regard to the data, so a long edge is copied into every leaf it crosses. Here each
+ * entity is stored exactly once. The entities are sorted by the Hilbert index of their box centers and cut into leaves
+ * of fanout entities; each level above groups fanout consecutive nodes of the level below, up to a single root. Every
+ * node is full except the last of its level. The nodes live in one array, root first and level by level, with each
+ * node's children contiguous, so the tree needs no pointers.
+ *
+ * The index is built from a Quad tree: it takes every edge corridor, circle and grid entity in it once, as GridIndex
+ * does. Node boxes may overlap, so a query visits every child whose box holds the point and stops at the first entity
+ * that contains it. Entities are checked exactly as in FrozenQuad, and points outside the tree's region are never
+ * within the geofence, so the answers do not depend on the index.
+ */
+class HilbertRTree : public GeofenceIndex {
+    public:
+        using Ptr = std::shared_ptr<HilbertRTree>;
+        using CPtr = std::shared_ptr<const HilbertRTree>;
+
+        constexpr static uint32_t kDefaultFanout = 16;          ///< Children per node when privacy.filter.geofence.index.fanout is not set.
+        constexpr static uint32_t kMaxFanout = 1024;            ///< The largest fanout accepted.
+
+        /**
+         * @brief A tree node: the bounding box of everything below it, its children and, for leaves, its geometry
+         * ranges. One cache line.
+         */
+        struct Node {
+            double min_lat;                         ///< Southern edge of the box.
+            double min_lon;                         ///< Western edge of the box.
+            double max_lat;                         ///< Northern edge of the box.
+            double max_lon;                         ///< Eastern edge of the box.
+            uint32_t first_child;                   ///< Index of the first child node; children are contiguous.
+            uint32_t child_count;                   ///< Number of children; 0 for a leaf.
+            uint32_t corridor_begin;                ///< First corridor of this leaf.
+            uint32_t corridor_end;                  ///< One past the last corridor of this leaf.
+            uint32_t circle_begin;                  ///< First circle of this leaf.
+            uint32_t circle_end;                    ///< One past the last circle of this leaf.
+            uint32_t grid_begin;                    ///< First grid of this leaf.
+            uint32_t grid_end;                      ///< One past the last grid of this leaf.
+
+            /**
+             * @brief Predicate indicating whether the (inclusive) box of this node contains the point.
+             *
+             * @param pt the point to check.
+             * @return true if the point is within the node's box; false otherwise.
+             */
+            bool contains( const geo::Point& pt ) const
+            {
+                return min_lat <= pt.lat && pt.lat <= max_lat && min_lon <= pt.lon && pt.lon <= max_lon;
+            }
+        };
+
+        /**
+         * @brief The work done by one query, for comparing indexes.
+         */
+        struct SearchCost {
+            uint64_t nodes;                         ///< Node boxes checked against the point.
+            uint64_t candidates;                    ///< Entities in the leaves entered; each one's box or geometry is checked.
+
+            SearchCost() : nodes{ 0 }, candidates{ 0 } {}
+        };
+
+        /**
+         * @brief Bulk load an R-tree.
+         *
+         * @param quad the root of the tree holding the geofence entities; the tree is not modified.
+         * @param fanout the number of children (or entities) per node; at least 2 and at most kMaxFanout.
+         * @throws std::invalid_argument when fanout is out of range.
+         */
+        HilbertRTree( const Quad& quad, uint32_t fanout = kDefaultFanout );
+
+        HilbertRTree( const HilbertRTree& ) = delete;           ///< The corridor arrays point into this instance.
+        HilbertRTree& operator=( const HilbertRTree& ) = delete;
+
+        /**
+         * @brief Predicate indicating whether the point is within any of the geofence entities.
+         *
+         * @param pt the point to check.
+         * @return true if the point is within the geofence; false otherwise.
+         */
+        bool is_within_entity( const geo::Point& pt ) const override;
+        using GeofenceIndex::is_within_entity;                 ///< The hinted query; a point may be in several leaves, so hints are ignored.
+
+        /**
+         * @brief The same query as is_within_entity, adding up the work it does.
+         *
+         * @param pt the point to check.
+         * @param cost incremented by the nodes and candidates this query checks.
+         * @return true if the point is within the geofence; false otherwise.
+         */
+        bool search( const geo::Point& pt, SearchCost& cost ) const;
+
+        /**
+         * @brief Return the Hilbert index of a cell of a 65536 x 65536 grid.
+         *
+         * @param x the column of the cell; only the low 16 bits are used.
+         * @param y the row of the cell; only the low 16 bits are used.
+         * @return The position of the cell along the Hilbert curve.
+         */
+        static uint32_t hilbert_index( uint32_t x, uint32_t y );
+
+        /**
+         * @brief Return the node array; the root is the first node.
+         *
+         * @return A pointer to the first of node_count() nodes.
+         */
+        const Node* get_nodes() const;
+
+        uint32_t get_fanout() const;                            ///< @return the children per node.
+        uint32_t node_count() const;                            ///< @return the number of nodes.
+        uint32_t leaf_count() const;                            ///< @return the number of leaves.
+        uint32_t height() const;                                ///< @return the number of levels; 1 when the root is a leaf.
+        uint32_t corridor_count() const;                        ///< @return the number of corridors; each edge once.
+        uint32_t circle_count() const;                          ///< @return the number of circles.
+        uint32_t grid_count() const;                            ///< @return the number of grids.
+
+        /**
+         * @brief Return the memory used by the nodes and the geometry.
+         *
+         * @return The number of bytes used.
+         */
+        std::size_t bytes() const;
+
+    private:
+        /**
+         * @brief A circle's center and radius.
+         */
+        struct CircleRecord {
+            double lat;
+            double lon;
+            double radius;
+        };
+
+        /**
+         * @brief A grid's inclusive bounds.
+         */
+        struct GridRecord {
+            double sw_lat;
+            double sw_lon;
+            double ne_lat;
+            double ne_lon;
+        };
+
+        geo::Point sw_;                                         ///< The southwest corner of the region.
+        geo::Point ne_;                                         ///< The northeast corner of the region.
+        uint32_t fanout_;                                       ///< Children per node.
+        uint32_t leaf_count_;                                   ///< Number of leaves; they are the last nodes of the array.
+        uint32_t height_;                                       ///< Number of levels.
+
+        std::vector<Node> nodes_;                               ///< The nodes, root first, level by level.
+        std::vector<double> corridor_data_;                     ///< The 16 corridor fields, each stored as one contiguous array.
+        FrozenQuad::CorridorArrays corridors_;                  ///< The corridor arrays in corridor_data_.
+        uint32_t corridor_count_;                               ///< Number of corridors.
+        std::vector<CircleRecord> circles_;                     ///< The circles, leaf by leaf.
+        std::vector<GridRecord> grids_;                         ///< The grids, leaf by leaf.
+        FrozenQuad::CorridorScan scan_corridors_;               ///< The corridor scan chosen for this processor.
+
+        /**
+         * @brief Predicate indicating whether the point is within any entity below a node whose box holds it; the work
+         * is added to cost unless it is null.
+         */
+        bool descend( const Node& node, const geo::Point& pt, SearchCost* cost ) const;
+
+        /**
+         * @brief Predicate indicating whether the point is within the (inclusive) region of the tree.
+         */
+        bool in_region( const geo::Point& pt ) const;
+
+        /**
+         * @brief Predicate indicating whether the point is within any of the entities of a leaf.
+         */
+        bool leaf_contains( const Node& leaf, const geo::Point& pt ) const;
+};
+
+#endif
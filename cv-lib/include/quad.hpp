@@ -31,10 +31,14 @@
 #include <sstream>
 #include <stack>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "names.hpp"
 #include "entity.hpp"
 #include "osm.hpp"
+#include "geofenceindex.hpp"
 
 /**
  * @brief A Quad instance is a special tree. Instances are geographically defined and divided into four children. Each
@@ -43,8 +47,10 @@
  * quad. The actual boundary is used to retrieve entities. A Quad tree is a more efficient data structure to use for
  * searching through a geographical space since search is logarithmic in the number of levels.  The entities within a
  * leaf Quad must still be searched linearly.
+ *
+ * A Quad can serve as a GeofenceIndex directly, although a FrozenQuad compiled from it answers the same queries faster.
  */
-class Quad : public geo::Bounds {
+class Quad : public geo::Bounds, public GeofenceIndex {
     public:
         using Point  = geo::Point;
         using Edge   = geo::Edge;
@@ -58,6 +64,53 @@ class Quad : public geo::Bounds {
         using EntityPtrStack = std::stack<Entity::CPtr>;
         using PtrSet = std::unordered_set<Ptr>;
 
+        /**
+         * @brief A non-owning view of the contents of one leaf: its entities and their corridors as parallel arrays.
+         * Walking a view copies no shared pointers. A view stays valid until the tree is modified.
+         */
+        struct LeafView {
+            const Entity::CPtr* elements;                           ///< The entities of the leaf.
+            const geo::Corridor* corridors;                         ///< The corridors of the entities.
+            std::size_t size;                                       ///< The number of entities (and corridors).
+
+            /**
+             * @brief Predicate indicating the view has no entities.
+             *
+             * @return true if the view is empty; false otherwise.
+             */
+            bool empty() const { return size == 0; }
+        };
+
+        /**
+         * @brief A set of changes to a tree, e.g., the work zones of the day: entities to remove, by identifier, and
+         * entities to insert. Removals are applied first, so an entity can be replaced by removing and adding its id.
+         */
+        struct Delta {
+            std::unordered_set<uint64_t> removed_edges;             ///< The uids of the edges to remove.
+            std::unordered_set<uint64_t> removed_circles;           ///< The uids of the circles to remove.
+            Entity::PtrList added;                                  ///< The entities to insert, in insertion order.
+            std::vector<geo::Corridor> corridors;                   ///< The corridors of the added entities (parallel to added) or empty for none.
+
+            /**
+             * @brief Predicate indicating the delta changes nothing.
+             *
+             * @return true if there is nothing to remove or add; false otherwise.
+             */
+            bool empty() const { return removed_edges.empty() && removed_circles.empty() && added.empty(); }
+        };
+
+        /**
+         * @brief What an edit changed.
+         */
+        struct EditStats {
+            std::size_t removed;                                    ///< Entities removed, each counted once however many leaves held it.
+            std::size_t added;                                      ///< Entities inserted, i.e., those that touch the root.
+            std::size_t copied;                                     ///< Quads copied; the others are shared with the original tree.
+            std::size_t merged;                                     ///< Quads whose children were merged back into one leaf.
+
+            EditStats() : removed{ 0 }, added{ 0 }, copied{ 0 }, merged{ 0 } {}
+        };
+
         constexpr static double REDUCTION_FACTOR = 10.0;            ///< When the fuzzy dimensions are not set (i.e., 0), they will be set to the width of the quad divided by this factor.
 
         //! Maximum number of elements allowed in a quad node. If more elements
@@ -67,14 +120,101 @@ class Quad : public geo::Bounds {
         constexpr static double MIN_DEGREES = 0.003;
 
         constexpr static int BUFFER_SIZE = 8 * 1024;                ///< The input stream buffer size when generating a Quad tree from a file.
+
+        /**
+         * @brief The shape parameters of a tree; every quad of a tree has those of its root. The defaults suit the
+         * interstate maps the PPM was first deployed with; dense city grids and long corridors may want others (see
+         * ppm_geofence_stats).
+         */
+        struct Parameters {
+            uint32_t max_elements;                                  ///< A leaf holding more entities than this is split.
+            double min_degrees;                                     ///< A quad is not split into halves smaller than this many degrees.
+            double reduction_factor;                                ///< The fuzzy margin of a quad is its width (height) divided by this.
+
+            Parameters() : max_elements{ MAX_ELEMENTS }, min_degrees{ MIN_DEGREES }, reduction_factor{ REDUCTION_FACTOR } {}
+
+            Parameters( uint32_t elements, double degrees, double reduction ) :
+                max_elements{ elements }, min_degrees{ degrees }, reduction_factor{ reduction }
+            {}
+
+            bool operator==( const Parameters& other ) const
+            {
+                return max_elements == other.max_elements && min_degrees == other.min_degrees &&
+                       reduction_factor == other.reduction_factor;
+            }
+
+            bool operator!=( const Parameters& other ) const { return !(*this == other); }
+        };
+
         /**
          * @brief Attempt to insert an Entity into the Quad tree.
          *
+         * The optional corridor is stored alongside the entity in every leaf that holds it so containment checks do
+         * not have to rebuild the entity's area; see Quad::make_corridors.
+         *
          * @param quadptr A pointer to the quad in which to insert the Entity
          * @param entity_ptr A pointer to the entity to insert into the given Quad or its children.
+         * @param corridor The precomputed containment area of the entity; empty when there is none.
          * @ return True if the entity is inserted into the quad, False otherwise.
          */
-        static bool insert( Ptr& quadptr, Entity::CPtr entity_ptr );
+        static bool insert( Ptr& quadptr, Entity::CPtr entity_ptr, const geo::Corridor& corridor = geo::Corridor{} );
+
+        /**
+         * @brief Insert a list of entities into an empty Quad tree, building independent subtrees in parallel.
+         *
+         * The tree is split breadth first until there are a few subtrees per thread; the subtrees are then built by a
+         * pool of threads. Each node is split exactly when inserting the entities one at a time, in list order, would
+         * split it, so the result is the same as that serial build leaf by leaf, including the order of each leaf's
+         * elements and corridors.
+         *
+         * @param quadptr A pointer to the root of an empty tree (a leaf with no elements).
+         * @param entities The entities to insert, in insertion order.
+         * @param corridors The precomputed corridors of the entities (parallel to entities) or empty for none.
+         * @param threads The number of threads to use; 0 uses one per hardware thread.
+         * @return The number of entities inserted, i.e., those that touch the root.
+         * @throws std::invalid_argument when the tree is not empty or corridors is not parallel to entities.
+         */
+        static std::size_t bulk_insert( Ptr& quadptr, const Entity::PtrList& entities,
+                                        const std::vector<geo::Corridor>& corridors, unsigned threads = 0 );
+
+        /**
+         * @brief Compute the corridor of every Edge in the tree that was inserted without one. Each Edge's area is
+         * computed once no matter how many leaves hold it. Edges that already have a corridor are left alone.
+         *
+         * @param quadptr A pointer to the root of the tree.
+         * @param extension The number of meters to extend each edge area beyond its vertices (see Edge::to_area).
+         */
+        static void make_corridors( Ptr& quadptr, double extension );
+
+        /**
+         * @brief Apply a delta to a tree without modifying it (copy on write). Only the quads on the paths to the
+         * changed leaves are copied; every other subtree is shared with the original, which stays valid for the
+         * queries still using it.
+         *
+         * Removed entities are dropped from every leaf that holds them; added ones are inserted as Quad::insert would,
+         * splitting full leaves. A copied quad whose subtree holds no more than max_elements distinct entities is merged
+         * back into one leaf, so removals do not leave a tree of near-empty leaves.
+         *
+         * @param quadptr A pointer to the root of the tree to edit; not modified.
+         * @param delta The entities to remove and add.
+         * @param stats When not null, filled with what the edit changed.
+         * @return The root of the edited tree; quadptr itself when the delta changes nothing.
+         * @throws std::invalid_argument when the delta corridors are not parallel to the added entities.
+         */
+        static Ptr edit( const Ptr& quadptr, const Delta& delta, EditStats* stats = nullptr );
+
+        /**
+         * @brief Remove the edges or circles with the given identifiers; see Quad::edit.
+         *
+         * @param quadptr A pointer to the root of the tree to edit; not modified.
+         * @param type The type of the entities to remove: EDGE or CIRCLE.
+         * @param ids The uids of the entities to remove.
+         * @param stats When not null, filled with what the edit changed.
+         * @return The root of the edited tree; quadptr itself when nothing was removed.
+         * @throws std::invalid_argument when type is neither EDGE nor CIRCLE.
+         */
+        static Ptr remove( const Ptr& quadptr, geo::EntityType type, const std::unordered_set<uint64_t>& ids,
+                           EditStats* stats = nullptr );
 
         /**
          * @brief Return the all the Bounds that contains the provided point.
@@ -97,6 +237,19 @@ class Quad : public geo::Bounds {
          */
         Quad( const Point& swpoint, const Point& nepoint, int level = 0, const std::string& position = "" );
 
+        /**
+         * @brief Construct a Quad with its own tree parameters; its children inherit them.
+         *
+         * @param swpoint The Southwest corner of the Quad.
+         * @param nepoint The Northeast corner of the Quad.
+         * @param parameters The leaf capacity, minimum size and fuzzy margin of the tree.
+         * @param level The numeric level of the quad (root is 0).
+         * @param position A string describing the orientation of this Quad (debugging primarily).
+         * @throws std::invalid_argument when max_elements is 0 or min_degrees or reduction_factor is not positive.
+         */
+        Quad( const Point& swpoint, const Point& nepoint, const Parameters& parameters, int level = 0,
+              const std::string& position = "" );
+
         /**
          * @brief Predicate indicating whether this Quad is split into children.
          *
@@ -107,7 +260,7 @@ class Quad : public geo::Bounds {
         /**
          * @brief Predicate indicating whether this Quad has exceeded the maximum allowable number of elements.
          *
-         * @return true if this Quad contains more than maxelements; false otherwise.
+         * @return true if this Quad contains more than the max_elements parameter; false otherwise.
          */
         bool full() const;
 
@@ -119,6 +272,87 @@ class Quad : public geo::Bounds {
          */
         const Entity::PtrList& retrieve_elements( const Point& pt ) const;
 
+        /** 
+         * @brief Return the leaf Quad that contains the provided geopoint.
+         *
+         * @param pt The point whose containing Quad we are interested in.
+         * @return A pointer to the leaf that contains pt; nullptr when pt is outside this Quad.
+         */
+        const Quad* retrieve_leaf( const Point& pt ) const;
+
+        /** 
+         * @brief Return a view of the contents of the leaf that contains the provided geopoint.
+         *
+         * @param pt The point whose containing Quad we are interested in.
+         * @return The view of the leaf; an empty view when pt is outside this Quad.
+         */
+        LeafView retrieve_leaf_view( const Point& pt ) const;
+
+        /**
+         * @brief Predicate indicating whether the point is within any of the edges, circles or grids of its leaf. Edges
+         * are checked with their corridors, so an edge inserted without one (see Quad::make_corridors) contains nothing.
+         *
+         * @param pt the point to check.
+         * @return true if the point is within an entity of its leaf; false otherwise.
+         */
+        bool is_within_entity( const Point& pt ) const override;
+
+        /**
+         * @brief Predicate indicating whether the point is within any of the edges, circles or grids of its leaf,
+         * starting with the hinted leaf and entity. A point strictly inside the hinted leaf's bounds is in no other
+         * leaf, so the descent is skipped.
+         *
+         * @param pt the point to check.
+         * @param hint the hint left by the previous query for the same moving point; updated.
+         * @return true if the point is within an entity of its leaf; false otherwise.
+         */
+        bool is_within_entity( const Point& pt, Hint& hint ) const override;
+
+        /**
+         * @brief Check a batch of points, walking the tree once (see GeofenceIndex::walk_batch).
+         *
+         * @param points the points to check.
+         * @param count the number of points.
+         * @param within set to count answers, in the order of the points.
+         */
+        void within_entities( const Point* points, std::size_t count, Bitmap& within ) const override;
+
+        /**
+         * @brief Return the tree parameters of this Quad.
+         *
+         * @return A constant reference to the parameters.
+         */
+        const Parameters& get_parameters() const;
+
+        /**
+         * @brief Return the tree depth of this Quad; the root is at level 0.
+         *
+         * @return The level.
+         */
+        int get_level() const;
+
+        /**
+         * @brief Return the children of this Quad in split order; empty when this Quad is a leaf.
+         *
+         * @return A constant reference to the child list.
+         */
+        const PtrList& get_children() const;
+
+        /**
+         * @brief Return the entities held by this Quad; empty unless this Quad is a leaf.
+         *
+         * @return A constant reference to the entity list.
+         */
+        const Entity::PtrList& get_elements() const;
+
+        /**
+         * @brief Return the corridors held by this Quad. The list is parallel to the element list; entities without a
+         * precomputed corridor have an empty one.
+         *
+         * @return A constant reference to the corridor list.
+         */
+        const std::vector<geo::Corridor>& get_corridors() const;
+
         /**
          * @brief Return the Bounds that contains the provided point.
          *
@@ -142,9 +376,9 @@ class Quad : public geo::Bounds {
         friend std::ostream& operator<< (std::ostream& os, const Quad& quad);
 
     private:
-        static geo::Vertex::IdToPtrMap elementmap;              ///< Lookup table from vertex unique identifer to pointers to Vertex instance; prevents duplicating Vertex creation.
         static geo::Entity::PtrList empty_element_list;                ///< Fixed empty set of Edges; returned when a point is contained in a Quad with no Entities.
 
+        Parameters parameters_;                                 ///< The shape parameters of the tree.
         int level_;                                             ///< The tree depth, or level, of this Quad.
         std::string position_;                                  ///< The relative position of this Quad amoung siblings.
 
@@ -155,6 +389,12 @@ class Quad : public geo::Bounds {
 
         PtrList children_;                                      ///< The list of this Quad's children Quads.
         Entity::PtrList element_list_;                             ///< The elements contained in this Quad.
+        std::vector<geo::Corridor> corridor_list_;              ///< The precomputed corridors of the elements; parallel to element_list_.
+
+        /**
+         * @brief Predicate indicating whether the point is within the element at a position of this leaf's list.
+         */
+        bool element_contains( std::size_t i, const Point& pt ) const;
 
         /**
          * @brief Split this Quad into four children. The child list will be cleared, the children created and inserted. The order in
@@ -180,6 +420,64 @@ class Quad : public geo::Bounds {
          */
         void verticalsplit();
 
+        /**
+         * @brief Build the subtree rooted at this leaf from a list of entities, splitting like Quad::insert would.
+         *
+         * @param entities The entities being inserted.
+         * @param corridors The corridors of the entities; empty for none.
+         * @param indices The indices of the entities, in insertion order, that reach this Quad.
+         */
+        void build( const Entity::PtrList& entities, const std::vector<geo::Corridor>& corridors,
+                    const std::vector<uint32_t>& indices );
+
+        /**
+         * @brief Split this leaf if the entities that reach it would overflow it, and distribute them to the children.
+         *
+         * @param entities The entities being inserted.
+         * @param indices The indices of the entities, in insertion order, that reach this Quad.
+         * @param child_indices Filled with the indices that reach each child, parallel to the child list.
+         * @return True if the quad is split, False otherwise.
+         */
+        bool bulk_split( const Entity::PtrList& entities, const std::vector<uint32_t>& indices,
+                         std::vector<std::vector<uint32_t>>& child_indices );
+
+        /**
+         * @brief Store the entities that reach this leaf.
+         *
+         * @param entities The entities being inserted.
+         * @param corridors The corridors of the entities; empty for none.
+         * @param indices The indices of the entities, in insertion order, that reach this Quad.
+         */
+        void fill( const Entity::PtrList& entities, const std::vector<geo::Corridor>& corridors,
+                   const std::vector<uint32_t>& indices );
+
+        /**
+         * @brief Predicate indicating whether a delta removes an entity.
+         */
+        static bool is_removed( const Entity& entity, const Delta& delta );
+
+        /**
+         * @brief Return the subtree rooted at a quad with a delta applied, sharing it when nothing in it changes.
+         *
+         * @param quadptr The root of the subtree; not modified.
+         * @param delta The delta being applied.
+         * @param indices The indices of the added entities that reach this Quad, in insertion order.
+         * @param removed Collects the removed entities.
+         * @param stats Counts the copied and merged quads.
+         * @return The edited subtree; quadptr itself when unchanged.
+         */
+        static Ptr edit_subtree( const Ptr& quadptr, const Delta& delta, const std::vector<uint32_t>& indices,
+                                 std::unordered_set<const Entity*>& removed, EditStats& stats );
+
+        /**
+         * @brief Turn this Quad back into a leaf holding the distinct entities of its subtree if there are no more than
+         * max_elements of them. Subtrees an edit did not copy may hold only empty leaves, so the whole subtree is
+         * checked, not just the children.
+         *
+         * @return True if the children were merged, False otherwise.
+         */
+        bool merge();
+
         /**
          * @brief Attempt to split this Quad into children and insert those into this Quad's children list.
          *
@@ -0,0 +1,155 @@
+/**
+ * @file
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems, UT Battelle.
+ */
+
+
+#ifndef CVDP_DI_RASTERINDEX_HPP
+#define CVDP_DI_RASTERINDEX_HPP
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "entity.hpp"
+#include "quad.hpp"
+#include "geofenceindex.hpp"
+
+/**
+ * @brief A RasterIndex puts a precomputed occupancy raster in front of another (exact) GeofenceIndex.
+ *
+ * The geofence region is divided into uniform square cells with 2 bits each. A cell is inside when every point of it is
+ * within one edge corridor or grid held by the quad leaf covering the whole cell. It is outside when no geofence entity
+ * comes near it. Otherwise it is a boundary cell. A query in an inside or outside cell is answered with one load from
+ * the raster. Only queries in boundary cells, and points outside the region, are passed to the exact index. Circles
+ * only ever make cells boundary.
+ *
+ * The classification is conservative: cells are padded and the corridor tests carry a margin that covers rounding, so
+ * the answers are the same as the exact index built from the same quad tree (Quad, FrozenQuad or GridIndex).
+ */
+class RasterIndex : public GeofenceIndex {
+    public:
+        using Ptr = std::shared_ptr<RasterIndex>;
+        using CPtr = std::shared_ptr<const RasterIndex>;
+
+        constexpr static double kDefaultCellDegrees = 0.0005;      ///< Cell side used when privacy.filter.geofence.raster.cell is not set.
+        constexpr static uint64_t kMaxCells = uint64_t{ 1 } << 32;   ///< Largest raster allowed (1 GiB).
+
+        /**
+         * @brief The classification of a raster cell; the values are the 2 bit codes stored in the raster.
+         */
+        enum class CellState : uint8_t {
+            OUTSIDE = 0,                        ///< No point of the cell is within the geofence.
+            BOUNDARY = 1,                       ///< The exact index must be asked.
+            INSIDE = 2                          ///< Every point of the cell is within the geofence.
+        };
+
+        /**
+         * @brief Rasterize the geofence held by a quad tree.
+         *
+         * @param quad the root of the tree holding the geofence entities; the tree is not modified.
+         * @param exact the index that answers queries in boundary cells; it should be built from the same tree.
+         * @param cell_degrees the side of a cell in decimal degrees; must be positive.
+         * @throws std::invalid_argument when cell_degrees is not positive or the raster would have more than kMaxCells cells.
+         */
+        RasterIndex( const Quad& quad, GeofenceIndex::CPtr exact, double cell_degrees = kDefaultCellDegrees );
+
+        /**
+         * @brief Predicate indicating whether the point is within the geofence; asks the exact index only for boundary
+         * cells and points outside the raster.
+         *
+         * @param pt the point to check.
+         * @return true if the point is within the geofence; false otherwise.
+         */
+        bool is_within_entity( const geo::Point& pt ) const override;
+
+        /**
+         * @brief Predicate indicating whether the point is within the geofence; the hint is passed to the exact index
+         * and left alone when the raster answers.
+         *
+         * @param pt the point to check.
+         * @param hint the hint left by the previous query for the same moving point.
+         * @return true if the point is within the geofence; false otherwise.
+         */
+        bool is_within_entity( const geo::Point& pt, Hint& hint ) const override;
+
+        /**
+         * @brief Return the state of the cell holding the provided point.
+         *
+         * @param pt the point whose cell we are interested in.
+         * @return The state of the cell; BOUNDARY when pt is outside the raster.
+         */
+        CellState retrieve_state( const geo::Point& pt ) const;
+
+        /**
+         * @brief Return the number of cells in a state.
+         *
+         * @param state the cell state to count.
+         * @return The number of cells in that state.
+         */
+        uint64_t count( CellState state ) const;
+
+        double get_cell_degrees() const;                        ///< @return the side of a cell in decimal degrees.
+        uint32_t get_rows() const;                              ///< @return the number of rows (south to north).
+        uint32_t get_cols() const;                              ///< @return the number of columns (west to east).
+        std::size_t bytes() const;                              ///< @return the size of the raster in bytes.
+        const GeofenceIndex::CPtr& get_exact_index() const;     ///< @return the index used for boundary cells.
+
+    private:
+        constexpr static double kCellPad = 1e-9;                ///< Cells are padded by this many degrees when classified.
+        constexpr static double kMargin = 1e-12;                ///< Relative margin of the corridor edge tests.
+
+        geo::Point sw_;                                         ///< The southwest corner of the raster.
+        geo::Point ne_;                                         ///< The northeast corner of the raster.
+        double cell_degrees_;                                   ///< The side of a cell in decimal degrees.
+        uint32_t rows_;                                         ///< Number of rows.
+        uint32_t cols_;                                         ///< Number of columns.
+        std::vector<uint64_t> cells_;                           ///< The cell states, 32 per word, row major.
+        uint64_t inside_count_;                                 ///< Number of inside cells.
+        uint64_t boundary_count_;                               ///< Number of boundary cells.
+        GeofenceIndex::CPtr exact_;                             ///< The index used for boundary cells.
+
+        /**
+         * @brief Classify the cells overlapping the entities of one leaf.
+         */
+        void rasterize_leaf( const Quad& root, const Quad& leaf );
+
+        /**
+         * @brief Raise the state of a cell; inside beats boundary beats outside.
+         */
+        void raise( uint32_t row, uint32_t col, CellState state );
+
+        /**
+         * @brief Return the state of a cell.
+         */
+        CellState state( uint32_t row, uint32_t col ) const;
+
+        /**
+         * @brief Return the row of a latitude; not clamped to the raster.
+         */
+        int64_t row( double lat ) const;
+
+        /**
+         * @brief Return the column of a longitude; not clamped to the raster.
+         */
+        int64_t col( double lon ) const;
+};
+
+#endif
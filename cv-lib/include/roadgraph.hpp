@@ -0,0 +1,138 @@
+/**
+ * @file
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems, UT Battelle.
+ */
+
+#ifndef CVDP_DI_ROADGRAPH_HPP
+#define CVDP_DI_ROADGRAPH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "entity.hpp"
+
+/**
+ * @brief A RoadGraph is the road network of a map file in compressed sparse row form: arrays of vertices and edges
+ * addressed by integer index, and for each vertex a slice of one adjacency array listing its incident edges.
+ *
+ * A geo::Vertex keeps a hash set of shared pointers to its incident edges and each geo::Edge shared pointers to its
+ * vertices, so a map built from them is a web of small allocations whose reference cycles are never freed. A RoadGraph
+ * holds the same network in a few flat arrays, 32 bytes per vertex and per edge, and frees it as a whole.
+ * CSVInputFactory::load_graph produces one directly from a shape file.
+ *
+ * The incident edges of a vertex are listed in edge order. Edges are undirected, from source to target as written.
+ */
+class RoadGraph {
+    public:
+        constexpr static uint32_t kNoVertex = std::numeric_limits<uint32_t>::max();    ///< find when no vertex has the identifier.
+
+        /**
+         * @brief A vertex of the graph.
+         */
+        struct Node {
+            uint64_t uid;                           ///< The unique identifier of the vertex.
+            double lat;                             ///< The latitude of the vertex in degrees.
+            double lon;                             ///< The longitude of the vertex in degrees.
+        };
+
+        /**
+         * @brief An edge of the graph.
+         */
+        struct Link {
+            uint64_t uid;                           ///< The unique identifier of the edge.
+            uint32_t source;                        ///< The index of the first vertex.
+            uint32_t target;                        ///< The index of the second vertex.
+            osm::Highway way_type;                  ///< The way type of the edge.
+            uint32_t way;                           ///< The index of the way id of the edge; 0 for none.
+        };
+
+        using Range = std::pair<const uint32_t*, const uint32_t*>;     ///< A [begin, end) range of edge indices.
+
+        /**
+         * @brief Construct an empty graph.
+         */
+        RoadGraph();
+
+        /**
+         * @brief Construct a graph and index its adjacency.
+         *
+         * @param nodes the vertices.
+         * @param links the edges; their source and target are indices into nodes.
+         * @param ways the way ids the edges refer to; ways[0] must be empty, for the edges without one.
+         * @throws std::invalid_argument when an edge refers to a missing vertex or way, an edge starts and ends at the
+         * same vertex, two vertices share an identifier, or ways[0] is not empty.
+         */
+        RoadGraph( std::vector<Node> nodes, std::vector<Link> links, std::vector<std::string> ways );
+
+        std::size_t vertex_count() const;                       ///< @return the number of vertices.
+        std::size_t edge_count() const;                         ///< @return the number of edges.
+
+        const Node& vertex( uint32_t v ) const;                 ///< @return vertex v.
+        const Link& edge( uint32_t e ) const;                   ///< @return edge e.
+        const std::string& way( uint32_t e ) const;             ///< @return the way id of edge e; empty for none.
+
+        uint32_t degree( uint32_t v ) const;                    ///< @return the number of edges incident to vertex v.
+        Range incident( uint32_t v ) const;                     ///< @return the indices of the edges incident to vertex v.
+
+        /**
+         * @brief Return the vertex at the other end of an edge.
+         *
+         * @param e the edge.
+         * @param v the vertex at one end of e.
+         * @return the vertex at the other end of e.
+         */
+        uint32_t opposite( uint32_t e, uint32_t v ) const;
+
+        /**
+         * @brief Find a vertex by identifier.
+         *
+         * @param uid the identifier of the vertex.
+         * @return the index of the vertex or kNoVertex.
+         */
+        uint32_t find( uint64_t uid ) const;
+
+        /**
+         * @brief Make the geo::Edge of each edge, in edge order, for the geofence. Edges sharing a vertex share one
+         * geo::Vertex, which is not given incident edges, so the result has no reference cycles.
+         *
+         * @param edges set to the edges.
+         * @param ways set to the way id of each edge; empty for none.
+         */
+        void make_edges( std::vector<geo::EdgeCPtr>& edges, std::vector<std::string>& ways ) const;
+
+        /**
+         * @return the bytes the graph holds, excluding the characters of long way ids.
+         */
+        std::size_t memory_bytes() const;
+
+    private:
+        std::vector<Node> nodes_;                   ///< The vertices.
+        std::vector<Link> links_;                   ///< The edges.
+        std::vector<std::string> ways_;             ///< The way ids; ways_[0] is empty.
+        std::vector<uint32_t> offsets_;             ///< The incident edges of vertex v are adjacency_[offsets_[v], offsets_[v + 1]).
+        std::vector<uint32_t> adjacency_;           ///< The incident edges of every vertex, two entries per edge.
+        std::vector<uint32_t> by_uid_;              ///< The vertex indices ordered by identifier, for find.
+};
+
+#endif
@@ -27,7 +27,9 @@
 #define CVDP_SHAPES_HPP
 
 #include <memory>
+#include <unordered_set>
 #include "entity.hpp"
+#include "roadgraph.hpp"
 
 namespace shapes {
 
@@ -54,6 +56,9 @@ static const int POINT_LON = 2;
  *
  * Geographies are specified in their respective make_<shape> methods.
  *
+ * A delta file, which edits a map already loaded (see Quad::edit), has the same format and may also remove edges and
+ * circles by identifier; see make_removal.
+ *
  * The order of the shapes in the file does not matter.
  */
 class CSVInputFactory
@@ -80,6 +85,31 @@ class CSVInputFactory
          */
         void make_shapes(void);
 
+        /**
+         * @brief Create the same shapes as make_shapes, in the same order and with the same messages, but faster.
+         *
+         * The file is mapped into memory and split into chunks of whole lines that are tokenized in place, without
+         * copying fields into strings, on a pool of threads. Each chunk yields a list of parsed specifications; the
+         * lists are then merged in file order on the calling thread, which deduplicates the vertices of the edges
+         * exactly as make_shapes does. A file that cannot be mapped, e.g., a pipe, is read into memory first.
+         *
+         * @param threads the number of threads to use; 0 uses one per hardware thread.
+         * @throws invalid_argument when the file could not be opened or the file is malformed, e.g., no header.
+         */
+        void load_shapes(unsigned threads = 0);
+
+        /**
+         * @brief Load the file as load_shapes does, but return its edges as a RoadGraph instead of Edge instances.
+         *
+         * The circles, grids and removals are stored as usual; get_edges stays empty. The graph has the vertices and
+         * edges load_shapes would make, in the same order, and the same messages are displayed.
+         *
+         * @param threads the number of threads to use; 0 uses one per hardware thread.
+         * @return the road graph of the edges.
+         * @throws invalid_argument when the file could not be opened or the file is malformed, e.g., no header.
+         */
+        RoadGraph load_graph(unsigned threads = 0);
+
         /**
          * @brief Return an immutable vector of the Circle shapes specified in the file.
          *
@@ -98,6 +128,13 @@ class CSVInputFactory
          */
         const std::vector<geo::EdgeCPtr>& get_edges(void) const;
 
+        /**
+         * @brief Return the way id attribute of each Edge, in the order of get_edges; empty for an edge without one.
+         *
+         * @return an immutable vector of way ids.
+         */
+        const std::vector<std::string>& get_edge_ways(void) const;
+
         /**
          * @brief Return an immutable vector of the Grid shapes specified in the file.
          *
@@ -107,6 +144,20 @@ class CSVInputFactory
          */
         const std::vector<geo::Grid::CPtr>& get_grids(void) const;
 
+        /**
+         * @brief Return the identifiers of the edges the file removes.
+         *
+         * @return an immutable set of edge uids.
+         */
+        const std::unordered_set<uint64_t>& get_removed_edges(void) const;
+
+        /**
+         * @brief Return the identifiers of the circles the file removes.
+         *
+         * @return an immutable set of circle uids.
+         */
+        const std::unordered_set<uint64_t>& get_removed_circles(void) const;
+
 
         /**
          * @brief Attempt to construct a Circle instance from the parts provided
@@ -158,13 +209,50 @@ class CSVInputFactory
          */
         void make_grid(const StrVector& line_parts);
 
+        /**
+         * @brief Attempt to record the removal of a previously loaded shape.
+         *
+         * Removal Specification:
+         * - line_parts[0] : "remove"
+         * - line_parts[1] : the type of the shape to remove: "edge" or "circle".
+         * - line_parts[2] : the unique 64-bit integer identifier of the shape.
+         *
+         * @param line_parts A vector of strings where each string is a part of a removal specification.
+         * @throws invalid_argument exception for an unknown shape type or identifier.
+         */
+        void make_removal(const StrVector& line_parts);
+
     private:
 
+        /**
+         * @brief Implement load_shapes, or load_graph when graph is not null.
+         */
+        void load(unsigned threads, RoadGraph* graph);
+
+        /**
+         * @brief Return the vertex with the given identifier, creating it the first time the identifier is seen.
+         *
+         * A vertex already created keeps its coordinates; a warning is displayed when they differ from lat and lon.
+         *
+         * @throws out_of_range exception for incorrect lat/lon of a new vertex.
+         */
+        geo::Vertex::Ptr make_vertex(uint64_t vertex_id, double lat, double lon);
+
+        /**
+         * @brief Construct the Edge between two vertices, add it to their incident edge lists and to the container.
+         *
+         * @throws invalid_argument exception when both vertices are the same.
+         */
+        void add_edge(const geo::Vertex::Ptr (&vp)[2], osm::Highway way_type, uint64_t edge_id, const std::string& way_id);
+
         std::string file_path_;                                 ///< The file containing the shape specifications.
         geo::Vertex::IdToPtrMap vertex_map_;                      ///< Map from identifiers to pointers to previously constructed vertices; prevents duplicates seen in OSM.
         std::vector<geo::Circle::CPtr> circles_;                ///< Vector of constant pointers to Circle instances.
         std::vector<geo::EdgeCPtr> edges_;                      ///< Vector of constant pointers to Edge instances.
+        std::vector<std::string> edge_ways_;                    ///< The way id of each edge in edges_; empty when not given.
         std::vector<geo::Grid::CPtr> grids_;                    ///< Vector of constant pointers to Grid instances.
+        std::unordered_set<uint64_t> removed_edges_;            ///< Identifiers of the edges to remove.
+        std::unordered_set<uint64_t> removed_circles_;          ///< Identifiers of the circles to remove.
 };
 
 /**
@@ -0,0 +1,176 @@
+/**
+ * @file
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors: Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems,
+ * UT Battelle.
+ */
+
+
+#include "corridorkernel.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+bool CorridorKernel::supported( ISA isa )
+{
+    switch (isa) {
+        case ISA::SCALAR:
+            return true;
+
+        case ISA::SSE2:
+#if defined(__SSE2__)
+            return true;
+#else
+            return false;
+#endif
+
+        case ISA::AVX2:
+#if defined(CVLIB_CORRIDOR_AVX2)
+            __builtin_cpu_init();
+            return __builtin_cpu_supports( "avx2" );
+#else
+            return false;
+#endif
+    }
+
+    return false;
+}
+
+CorridorKernel::ISA CorridorKernel::best()
+{
+    static const ISA isa = supported( ISA::AVX2 ) ? ISA::AVX2 : (supported( ISA::SSE2 ) ? ISA::SSE2 : ISA::SCALAR);
+    return isa;
+}
+
+CorridorKernel::Scan CorridorKernel::get( ISA isa )
+{
+    if (!supported( isa )) return nullptr;
+
+    switch (isa) {
+#if defined(__SSE2__)
+        case ISA::SSE2:
+            return &CorridorKernel::scan_sse2;
+#endif
+
+#if defined(CVLIB_CORRIDOR_AVX2)
+        case ISA::AVX2:
+            return &CorridorKernel::scan_avx2;
+#endif
+
+        default:
+            return &CorridorKernel::scan_scalar;
+    }
+}
+
+CorridorKernel::FixedScan CorridorKernel::get_fixed( ISA isa )
+{
+    if (!supported( isa )) return nullptr;
+
+#if defined(CVLIB_CORRIDOR_AVX2)
+    if (isa == ISA::AVX2) return &CorridorKernel::scan_fixed_avx2;
+#endif
+
+    return &CorridorKernel::scan_fixed_scalar;
+}
+
+const char* CorridorKernel::name( ISA isa )
+{
+    switch (isa) {
+        case ISA::SSE2:
+            return "sse2";
+
+        case ISA::AVX2:
+            return "avx2";
+
+        default:
+            return "scalar";
+    }
+}
+
+bool CorridorKernel::scan_scalar( const FrozenQuad::CorridorArrays& corridors, uint32_t begin, uint32_t end, double lat, double lon )
+{
+    for (uint32_t i = begin; i < end; ++i) {
+        if (lat < corridors.min_lat[i] || lat > corridors.max_lat[i] ||
+            lon < corridors.min_lon[i] || lon > corridors.max_lon[i]) continue;
+
+        // same tests as geo::Corridor::contains.
+        if (corridors.a[0][i] * lat + corridors.b[0][i] * lon + corridors.c[0][i] < 0.0) continue;
+        if (corridors.a[1][i] * lat + corridors.b[1][i] * lon + corridors.c[1][i] < 0.0) continue;
+        if (corridors.a[2][i] * lat + corridors.b[2][i] * lon + corridors.c[2][i] < 0.0) continue;
+        if (corridors.a[3][i] * lat + corridors.b[3][i] * lon + corridors.c[3][i] < 0.0) continue;
+
+        return true;
+    }
+
+    return false;
+}
+
+bool CorridorKernel::scan_fixed_scalar( const FrozenQuad::FixedCorridorArrays& corridors, uint32_t begin, uint32_t end, int32_t lat, int32_t lon )
+{
+    for (uint32_t i = begin; i < end; ++i) {
+        if (lat < corridors.min_lat[i] || lat > corridors.max_lat[i] ||
+            lon < corridors.min_lon[i] || lon > corridors.max_lon[i]) continue;
+
+        // same tests as geo::FixedCorridor::contains.
+        bool inside = true;
+        for (int p1 = 0; inside && p1 < 4; ++p1) {
+            int p2 = (p1 + 1) % 4;
+            inside = geo::FixedCorridor::edge_side( corridors.lat[p1][i], corridors.lon[p1][i],
+                                                    corridors.lat[p2][i], corridors.lon[p2][i], lat, lon ) >= 0;
+        }
+
+        if (inside) return true;
+    }
+
+    return false;
+}
+
+#if defined(__SSE2__)
+bool CorridorKernel::scan_sse2( const FrozenQuad::CorridorArrays& corridors, uint32_t begin, uint32_t end, double lat, double lon )
+{
+    const __m128d vlat = _mm_set1_pd( lat );
+    const __m128d vlon = _mm_set1_pd( lon );
+    const __m128d zero = _mm_setzero_pd();
+
+    uint32_t i = begin;
+
+    for (; i + 2 <= end; i += 2) {
+        // a lane is set when its corridor cannot contain the point; the comparisons are the negations used by the
+        // scalar scan so a NaN coordinate is treated the same way.
+        __m128d out = _mm_or_pd( _mm_cmplt_pd( vlat, _mm_loadu_pd( corridors.min_lat + i ) ),
+                                 _mm_cmpgt_pd( vlat, _mm_loadu_pd( corridors.max_lat + i ) ) );
+        out = _mm_or_pd( out, _mm_cmplt_pd( vlon, _mm_loadu_pd( corridors.min_lon + i ) ) );
+        out = _mm_or_pd( out, _mm_cmpgt_pd( vlon, _mm_loadu_pd( corridors.max_lon + i ) ) );
+
+        // most corridors of a leaf are rejected by their bounding box.
+        if (_mm_movemask_pd( out ) == 0x3) continue;
+
+        for (int e = 0; e < 4; ++e) {
+            __m128d d = _mm_add_pd( _mm_add_pd( _mm_mul_pd( _mm_loadu_pd( corridors.a[e] + i ), vlat ),
+                                                _mm_mul_pd( _mm_loadu_pd( corridors.b[e] + i ), vlon ) ),
+                                    _mm_loadu_pd( corridors.c[e] + i ) );
+            out = _mm_or_pd( out, _mm_cmplt_pd( d, zero ) );
+        }
+
+        if (_mm_movemask_pd( out ) != 0x3) return true;
+    }
+
+    return scan_scalar( corridors, i, end, lat, lon );
+}
+#endif
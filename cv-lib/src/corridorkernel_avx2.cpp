@@ -0,0 +1,116 @@
+/**
+ * @file
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors: Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems,
+ * UT Battelle.
+ */
+
+
+// This file is compiled with -mavx2 and its code only runs after CorridorKernel::supported( ISA::AVX2 ) has said it
+// may. Do not call inline functions from shared headers here: the AVX2 copy the compiler emits for them could be the
+// one the linker keeps for the whole program.
+
+#include <immintrin.h>
+
+#include "corridorkernel.hpp"
+
+bool CorridorKernel::scan_avx2( const FrozenQuad::CorridorArrays& corridors, uint32_t begin, uint32_t end, double lat, double lon )
+{
+    const __m256d vlat = _mm256_set1_pd( lat );
+    const __m256d vlon = _mm256_set1_pd( lon );
+    const __m256d zero = _mm256_setzero_pd();
+
+    uint32_t i = begin;
+
+    for (; i + 4 <= end; i += 4) {
+        // a lane is set when its corridor cannot contain the point; see scan_sse2.
+        __m256d out = _mm256_or_pd( _mm256_cmp_pd( vlat, _mm256_loadu_pd( corridors.min_lat + i ), _CMP_LT_OS ),
+                                    _mm256_cmp_pd( vlat, _mm256_loadu_pd( corridors.max_lat + i ), _CMP_GT_OS ) );
+        out = _mm256_or_pd( out, _mm256_cmp_pd( vlon, _mm256_loadu_pd( corridors.min_lon + i ), _CMP_LT_OS ) );
+        out = _mm256_or_pd( out, _mm256_cmp_pd( vlon, _mm256_loadu_pd( corridors.max_lon + i ), _CMP_GT_OS ) );
+
+        if (_mm256_movemask_pd( out ) == 0xF) continue;
+
+        for (int e = 0; e < 4; ++e) {
+            __m256d d = _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( _mm256_loadu_pd( corridors.a[e] + i ), vlat ),
+                                                      _mm256_mul_pd( _mm256_loadu_pd( corridors.b[e] + i ), vlon ) ),
+                                       _mm256_loadu_pd( corridors.c[e] + i ) );
+            out = _mm256_or_pd( out, _mm256_cmp_pd( d, zero, _CMP_LT_OS ) );
+        }
+
+        if (_mm256_movemask_pd( out ) != 0xF) return true;
+    }
+
+    // the last few corridors use the SSE2 or scalar scan.
+    return scan_sse2( corridors, i, end, lat, lon );
+}
+
+bool CorridorKernel::scan_fixed_avx2( const FrozenQuad::FixedCorridorArrays& corridors, uint32_t begin, uint32_t end, int32_t lat, int32_t lon )
+{
+    const __m256i vlat = _mm256_set1_epi32( lat );
+    const __m256i vlon = _mm256_set1_epi32( lon );
+    const __m256i wlat = _mm256_set1_epi64x( lat );
+    const __m256i wlon = _mm256_set1_epi64x( lon );
+    const __m256i zero = _mm256_setzero_si256();
+
+    // widen four int32 values to int64 lanes.
+    auto widen = [] ( const int32_t* values ) {
+        return _mm256_cvtepi32_epi64( _mm_loadu_si128( reinterpret_cast<const __m128i*>( values ) ) );
+    };
+
+    uint32_t i = begin;
+
+    for (; i + 8 <= end; i += 8) {
+        // a lane is set when its corridor's bounding box does not hold the position.
+        auto load = [i] ( const int32_t* values ) { return _mm256_loadu_si256( reinterpret_cast<const __m256i*>( values + i ) ); };
+        __m256i out = _mm256_or_si256( _mm256_cmpgt_epi32( load( corridors.min_lat ), vlat ),
+                                       _mm256_cmpgt_epi32( vlat, load( corridors.max_lat ) ) );
+        out = _mm256_or_si256( out, _mm256_cmpgt_epi32( load( corridors.min_lon ), vlon ) );
+        out = _mm256_or_si256( out, _mm256_cmpgt_epi32( vlon, load( corridors.max_lon ) ) );
+
+        int boxes = _mm256_movemask_ps( _mm256_castsi256_ps( out ) );
+        if (boxes == 0xFF) continue;
+
+        for (uint32_t half = 0; half < 2; ++half) {
+            int outside = (boxes >> (4 * half)) & 0xF;
+            if (outside == 0xF) continue;
+
+            uint32_t j = i + 4 * half;
+            __m256i edges_out = zero;
+
+            for (int p1 = 0; p1 < 4; ++p1) {
+                int p2 = (p1 + 1) % 4;
+                __m256i lat1 = widen( corridors.lat[p1] + j );
+                __m256i lon1 = widen( corridors.lon[p1] + j );
+
+                // every difference of a lane inside its box fits in 32 bits (see geo::FixedCorridor), which is what
+                // the signed 32 x 32 bit multiply reads from each 64 bit lane.
+                __m256i d = _mm256_sub_epi64( _mm256_mul_epi32( _mm256_sub_epi64( widen( corridors.lat[p2] + j ), lat1 ),
+                                                                _mm256_sub_epi64( wlon, lon1 ) ),
+                                              _mm256_mul_epi32( _mm256_sub_epi64( widen( corridors.lon[p2] + j ), lon1 ),
+                                                                _mm256_sub_epi64( wlat, lat1 ) ) );
+                edges_out = _mm256_or_si256( edges_out, _mm256_cmpgt_epi64( zero, d ) );
+            }
+
+            outside |= _mm256_movemask_pd( _mm256_castsi256_pd( edges_out ) );
+            if (outside != 0xF) return true;
+        }
+    }
+
+    return scan_fixed_scalar( corridors, i, end, lat, lon );
+}
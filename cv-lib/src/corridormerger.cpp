@@ -0,0 +1,226 @@
+/**
+ * @file
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems, UT Battelle.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#include "corridormerger.hpp"
+
+constexpr double CorridorMerger::kDefaultMaxLength;
+constexpr double CorridorMerger::kPadMeters;
+
+CorridorMerger::CorridorMerger( double extension, double tolerance, double max_length ) :
+    extension_{ extension },
+    tolerance_{ tolerance },
+    max_length_{ max_length }
+{
+    if (!(extension_ >= 0.0) || !(tolerance_ >= 0.0) || !(max_length_ > 0.0)) {
+        throw std::invalid_argument{ "corridor merge extension and tolerance must not be negative and length must be positive" };
+    }
+}
+
+void CorridorMerger::merge( const std::vector<geo::EdgeCPtr>& edges, const std::vector<std::string>& ways,
+                            std::vector<geo::EdgeCPtr>& merged, std::vector<geo::Corridor>& corridors, Stats* stats ) const
+{
+    if (edges.size() != ways.size()) {
+        throw std::invalid_argument{ "corridor merge needs one way id per edge" };
+    }
+
+    merged.clear();
+    corridors.clear();
+
+    constexpr std::size_t kNone = std::numeric_limits<std::size_t>::max();
+    constexpr std::size_t kMany = kNone - 1;
+
+    // number the ways so an edge end is a (way, vertex) pair; edges without a way are left alone.
+    std::unordered_map<std::string, uint64_t> way_numbers;
+    std::vector<uint64_t> way_of( edges.size(), 0 );
+    for (std::size_t i = 0; i < edges.size(); ++i) {
+        if (ways[i].empty()) continue;
+        way_of[i] = way_numbers.emplace( ways[i], way_numbers.size() + 1 ).first->second;
+    }
+
+    // the edge of each way leaving and entering each vertex; kMany when there is more than one (a fork or a join).
+    using End = std::pair<uint64_t, uint64_t>;
+    std::map<End, std::size_t> leaving;
+    std::map<End, std::size_t> entering;
+    for (std::size_t i = 0; i < edges.size(); ++i) {
+        if (way_of[i] == 0) continue;
+
+        auto out = leaving.emplace( End{ way_of[i], edges[i]->v1->uid }, i );
+        if (!out.second) out.first->second = kMany;
+
+        auto in = entering.emplace( End{ way_of[i], edges[i]->v2->uid }, i );
+        if (!in.second) in.first->second = kMany;
+    }
+
+    std::vector<std::size_t> next( edges.size(), kNone );
+    std::vector<bool> has_previous( edges.size(), false );
+    for (std::size_t i = 0; i < edges.size(); ++i) {
+        if (way_of[i] == 0) continue;
+
+        End end{ way_of[i], edges[i]->v2->uid };
+        auto out = leaving.find( end );
+        if (out == leaving.end() || out->second == kMany || entering[end] == kMany) continue;
+
+        std::size_t j = out->second;
+        if (j == i || edges[j]->get_way_type() != edges[i]->get_way_type()) continue;
+
+        next[i] = j;
+        has_previous[j] = true;
+    }
+
+    Stats counts{ edges.size(), 0, 0 };
+    std::vector<bool> visited( edges.size(), false );
+    std::vector<geo::EdgeCPtr> chain;
+    std::vector<geo::AreaPtr> areas;
+
+    // chains start at edges without a predecessor; whatever is left over is a closed loop and starts anywhere.
+    for (int pass = 0; pass < 2; ++pass) {
+        for (std::size_t first = 0; first < edges.size(); ++first) {
+            if (visited[first] || (pass == 0 && has_previous[first])) continue;
+
+            chain.clear();
+            areas.clear();
+            for (std::size_t i = first; i != kNone && !visited[i]; i = next[i]) {
+                visited[i] = true;
+                chain.push_back( edges[i] );
+                areas.push_back( edges[i]->to_area( extension_ ) );
+            }
+            ++counts.chains;
+
+            std::size_t begin = 0;
+            while (begin < chain.size()) {
+                geo::EdgeCPtr edge = chain[begin];
+                geo::Corridor corridor{ *areas[begin] };
+
+                std::size_t end = begin + 1;
+                geo::EdgeCPtr candidate_edge;
+                geo::Corridor candidate_corridor;
+                while (end < chain.size() && fit( chain, areas, begin, end + 1, candidate_edge, candidate_corridor )) {
+                    edge = candidate_edge;
+                    corridor = candidate_corridor;
+                    ++end;
+                }
+
+                merged.push_back( edge );
+                corridors.push_back( corridor );
+                begin = end;
+            }
+        }
+    }
+
+    counts.corridors = merged.size();
+    if (stats) *stats = counts;
+}
+
+bool CorridorMerger::fit( const std::vector<geo::EdgeCPtr>& chain, const std::vector<geo::AreaPtr>& areas,
+                          std::size_t begin, std::size_t end, geo::EdgeCPtr& edge, geo::Corridor& corridor ) const
+{
+    const geo::Vertex& start = *chain[begin]->v1;
+    const geo::Vertex& finish = *chain[end - 1]->v2;
+
+    // degrees to local meters; an affine map, so containment in the plane is containment in degrees.
+    const double north_scale = geo::to_radians( 1.0 ) * geo::kEarthRadiusM;
+    const double east_scale = north_scale * std::cos( geo::to_radians( start.lat ) );
+
+    auto east = [&]( const geo::Point& pt ) { return (pt.lon - start.lon) * east_scale; };
+    auto north = [&]( const geo::Point& pt ) { return (pt.lat - start.lat) * north_scale; };
+
+    double chord_east = east( finish );
+    double chord_north = north( finish );
+    double length = std::sqrt( chord_east * chord_east + chord_north * chord_north );
+
+    // a run that closes on itself has no direction.
+    if (length > max_length_ || length < 1.0) return false;
+
+    // the chord direction and its left normal.
+    double ue = chord_east / length;
+    double un = chord_north / length;
+    double ne = -un;
+    double nn = ue;
+
+    for (std::size_t i = begin; i < end; ++i) {
+        const geo::Vertex& v = *chain[i]->v2;
+        if (std::abs( east( v ) * ne + north( v ) * nn ) > tolerance_) return false;
+    }
+
+    double min_along = std::numeric_limits<double>::max();
+    double max_along = std::numeric_limits<double>::lowest();
+    double min_across = std::numeric_limits<double>::max();
+    double max_across = std::numeric_limits<double>::lowest();
+
+    for (std::size_t i = begin; i < end; ++i) {
+        for (auto& corner : areas[i]->get_corners()) {
+            double along = east( corner ) * ue + north( corner ) * un;
+            double across = east( corner ) * ne + north( corner ) * nn;
+            min_along = std::min( min_along, along );
+            max_along = std::max( max_along, along );
+            min_across = std::min( min_across, across );
+            max_across = std::max( max_across, across );
+        }
+    }
+
+    double half_width = chain[begin]->get_way_width() / 2.0;
+    if (max_across > half_width + tolerance_ || -min_across > half_width + tolerance_) return false;
+    if (-min_along > extension_ + tolerance_ || max_along - length > extension_ + tolerance_) return false;
+
+    min_along -= kPadMeters;
+    max_along += kPadMeters;
+    min_across -= kPadMeters;
+    max_across += kPadMeters;
+
+    auto point = [&]( double along, double across ) {
+        double e = along * ue + across * ne;
+        double n = along * un + across * nn;
+        return geo::Point{ start.lat + n / north_scale, start.lon + e / east_scale };
+    };
+
+    // the corner order of Edge::to_area: first left, last left, last right, first right.
+    geo::Area area{ point( min_along, max_across ), point( max_along, max_across ),
+                    point( max_along, min_across ), point( min_along, min_across ) };
+
+    edge = std::make_shared<const geo::Edge>( chain[begin]->v1, chain[end - 1]->v2, chain[begin]->get_way_type(),
+                                              chain[begin]->get_uid() );
+    corridor = geo::Corridor{ area };
+    return true;
+}
+
+double CorridorMerger::get_extension() const
+{
+    return extension_;
+}
+
+double CorridorMerger::get_tolerance() const
+{
+    return tolerance_;
+}
+
+double CorridorMerger::get_max_length() const
+{
+    return max_length_;
+}
@@ -22,9 +22,11 @@
  * Contributors:
  *    Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems, UT Battelle.
  */
+#include <algorithm>
 #include <cmath>
 #include <iomanip>
 #include <sstream>
+#include <stdexcept>
 
 #include "entity.hpp"
 #include "utilities.hpp"
@@ -166,6 +168,10 @@ const std::string Location::get_type() const {
     return "location";
 }
 
+EntityType Location::get_entity_type(void) const {
+    return EntityType::LOCATION;
+}
+
 bool Location::touches(const Bounds& bounds) const {
     return bounds.contains(*this); 
 }
@@ -290,6 +296,10 @@ const std::string Edge::get_type(void) const {
     return "edge";
 }
 
+EntityType Edge::get_entity_type(void) const {
+    return EntityType::EDGE;
+}
+
 bool Edge::touches(const Bounds& bounds) const {
     return bounds.contains_or_intersects(*this);
 }
@@ -483,6 +493,10 @@ const std::string Area::get_type() const {
     return "area";
 }
 
+EntityType Area::get_entity_type(void) const {
+    return EntityType::AREA;
+}
+
 bool Area::touches(const Bounds& bounds) const {
     if (bounds.contains(corners_[0]) || bounds.contains(corners_[1]) || bounds.contains(corners_[2]) || bounds.contains(corners_[3])) {
         return true;
@@ -550,6 +564,158 @@ const std::string Area::get_poly_string() const
     return ss.str();
 }
 
+constexpr double Corridor::kPad;
+
+Corridor::Corridor() :
+    min_lat{ std::numeric_limits<double>::max() },
+    min_lon{ std::numeric_limits<double>::max() },
+    max_lat{ std::numeric_limits<double>::lowest() },
+    max_lon{ std::numeric_limits<double>::lowest() },
+    a{ 0.0, 0.0, 0.0, 0.0 },
+    b{ 0.0, 0.0, 0.0, 0.0 },
+    c{ 0.0, 0.0, 0.0, 0.0 }
+{}
+
+Corridor::Corridor( const Area& area ) :
+    Corridor{}
+{
+    const std::vector<Point>& corners = area.get_corners();
+
+    for (int p1 = 0; p1 < 4; ++p1) {
+        int p2 = (p1 + 1) % 4;
+
+        // same terms, in the same order, as Area::outside_edge.
+        double dlon = corners[p2].lon - corners[p1].lon;
+        double dlat = corners[p2].lat - corners[p1].lat;
+
+        a[p1] = -dlon;
+        b[p1] = dlat;
+        c[p1] = corners[p1].lat * dlon - corners[p1].lon * dlat;
+
+        min_lat = std::min( min_lat, corners[p1].lat );
+        min_lon = std::min( min_lon, corners[p1].lon );
+        max_lat = std::max( max_lat, corners[p1].lat );
+        max_lon = std::max( max_lon, corners[p1].lon );
+    }
+
+    min_lat -= kPad;
+    min_lon -= kPad;
+    max_lat += kPad;
+    max_lon += kPad;
+}
+
+bool Corridor::empty() const
+{
+    return min_lat > max_lat;
+}
+
+bool Corridor::contains( const Point& pt ) const
+{
+    if (pt.lat < min_lat || pt.lat > max_lat || pt.lon < min_lon || pt.lon > max_lon) return false;
+
+    for (int i = 0; i < 4; ++i) {
+        // negative indicates pt is to the left of the edge; see Area::outside_edge.
+        if (a[i] * pt.lat + b[i] * pt.lon + c[i] < 0.0) return false;
+    }
+
+    return true;
+}
+
+constexpr double FixedPoint::kUnitsPerDegree;
+
+FixedPoint::FixedPoint() :
+    lat{ 0 },
+    lon{ 0 }
+{}
+
+FixedPoint::FixedPoint( int32_t latitude, int32_t longitude ) :
+    lat{ latitude },
+    lon{ longitude }
+{}
+
+FixedPoint FixedPoint::from_degrees( const Point& pt )
+{
+    return FixedPoint{ to_units( pt.lat ), to_units( pt.lon ) };
+}
+
+int32_t FixedPoint::to_units( double degrees )
+{
+    return static_cast<int32_t>( std::llround( degrees * kUnitsPerDegree ) );
+}
+
+Point FixedPoint::to_degrees() const
+{
+    return Point{ lat / kUnitsPerDegree, lon / kUnitsPerDegree };
+}
+
+FixedCorridor::FixedCorridor() :
+    min_lat{ std::numeric_limits<int32_t>::max() },
+    min_lon{ std::numeric_limits<int32_t>::max() },
+    max_lat{ std::numeric_limits<int32_t>::min() },
+    max_lon{ std::numeric_limits<int32_t>::min() },
+    lat{ 0, 0, 0, 0 },
+    lon{ 0, 0, 0, 0 }
+{}
+
+FixedCorridor::FixedCorridor( const Corridor& corridor ) :
+    FixedCorridor{}
+{
+    if (corridor.empty()) return;
+
+    Point corners[4];
+
+    for (int p1 = 0; p1 < 4; ++p1) {
+        // corner p1 ends edge p0 and starts edge p1: solve a * lat + b * lon + c = 0 for both lines.
+        int p0 = (p1 + 3) % 4;
+        double det = corridor.a[p0] * corridor.b[p1] - corridor.a[p1] * corridor.b[p0];
+        if (det == 0.0) return;
+
+        corners[p1].lat = (corridor.b[p0] * corridor.c[p1] - corridor.b[p1] * corridor.c[p0]) / det;
+        corners[p1].lon = (corridor.a[p1] * corridor.c[p0] - corridor.a[p0] * corridor.c[p1]) / det;
+    }
+
+    int32_t south = std::numeric_limits<int32_t>::max();
+    int32_t west = std::numeric_limits<int32_t>::max();
+    int32_t north = std::numeric_limits<int32_t>::min();
+    int32_t east = std::numeric_limits<int32_t>::min();
+
+    for (int i = 0; i < 4; ++i) {
+        lat[i] = FixedPoint::to_units( corners[i].lat );
+        lon[i] = FixedPoint::to_units( corners[i].lon );
+        south = std::min( south, lat[i] );
+        west = std::min( west, lon[i] );
+        north = std::max( north, lat[i] );
+        east = std::max( east, lon[i] );
+    }
+
+    if (static_cast<int64_t>( north ) - south > std::numeric_limits<int32_t>::max() ||
+        static_cast<int64_t>( east ) - west > std::numeric_limits<int32_t>::max()) {
+        throw std::out_of_range{ "corridor is too wide for fixed-point containment" };
+    }
+
+    min_lat = south;
+    min_lon = west;
+    max_lat = north;
+    max_lon = east;
+}
+
+bool FixedCorridor::empty() const
+{
+    return min_lat > max_lat;
+}
+
+bool FixedCorridor::contains( const FixedPoint& pt ) const
+{
+    if (pt.lat < min_lat || pt.lat > max_lat || pt.lon < min_lon || pt.lon > max_lon) return false;
+
+    for (int p1 = 0; p1 < 4; ++p1) {
+        int p2 = (p1 + 1) % 4;
+        if (edge_side( lat[p1], lon[p1], lat[p2], lon[p2], pt.lat, pt.lon ) < 0) return false;
+    }
+
+    return true;
+}
+
 Circle::Circle(const Location& location, double radius) :
     Location(location.lat, location.lon, location.uid),
     radius(radius),
@@ -581,6 +747,10 @@ const std::string Circle::get_type(void) const {
     return "circle";
 }
 
+EntityType Circle::get_entity_type(void) const {
+    return EntityType::CIRCLE;
+}
+
 bool Circle::touches(const Bounds& bounds) const {
     bool cardinals_within_bounds = bounds.contains(north) || bounds.contains(south) || bounds.contains(east) || bounds.contains(west);
 
@@ -597,6 +767,15 @@ bool Circle::contains(const Point& point) const {
    return distance(lat, lon, point.lat, point.lon) <= radius;
 }
 
+Bounds Circle::containment_bounds() const {
+    // Location::distance is equirectangular: the latitude offset is at most radius / R and the longitude offset is
+    // that divided by the cosine of the mean latitude.
+    double dlat = to_degrees( radius / kEarthRadiusM ) * (1.0 + 1e-6) + Corridor::kPad;
+    double reach = std::abs( lat ) + dlat;
+    double dlon = reach < 89.0 ? dlat / std::cos( to_radians( reach ) ) : 360.0;
+    return Bounds{ Point{ lat - dlat, lon - dlon }, Point{ lat + dlat, lon + dlon } };
+}
+
 bool Circle::operator==(const Circle& other) const {
     return double_utilities::are_equal(other.lat, lat, kGPSEpsilon) && double_utilities::are_equal(other.lon, lon, kGPSEpsilon) && double_utilities::are_equal(radius, other.radius, kGPSEpsilon);
 }
@@ -714,6 +893,10 @@ Grid::Grid(const geo::Point& sw_loc, const geo::Point& ne_loc, uint32_t row, uin
 const std::string Grid::get_type() const {
     return "grid";
 }
+
+EntityType Grid::get_entity_type(void) const {
+    return EntityType::GRID;
+}
    
 bool Grid::touches(const geo::Bounds& bounds) const {
     if (bounds.contains(sw) || bounds.contains(ne) || bounds.contains(se) || bounds.contains(nw)) {
@@ -0,0 +1,800 @@
+/**
+ * @file
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors: Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems,
+ * UT Battelle.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/vfs.h>
+#endif
+#include <unistd.h>
+
+#include "frozenquad.hpp"
+#include "corridorkernel.hpp"
+
+static_assert( sizeof(FrozenQuad::Node) == 64, "FrozenQuad::Node should fill exactly one cache line." );
+
+static_assert( sizeof(FrozenQuad::FileHeader) == 128, "FrozenQuad::FileHeader should keep the arrays cache line aligned." );
+
+constexpr std::size_t FrozenQuad::kAlignment;
+constexpr uint32_t FrozenQuad::kFormatVersion;
+constexpr uint32_t FrozenQuad::kPlanarFlag;
+constexpr uint32_t FrozenQuad::kFixedFlag;
+constexpr char FrozenQuad::kMagic[8];
+constexpr uint32_t FrozenQuad::kByteOrder;
+
+namespace {
+
+std::size_t padded( std::size_t bytes )
+{
+    return (bytes + FrozenQuad::kAlignment - 1) / FrozenQuad::kAlignment * FrozenQuad::kAlignment;
+}
+
+/**
+ * @brief Gathers the nodes and leaf geometry of a Quad in frozen order before they are packed into one allocation.
+ */
+struct FrozenQuadBuilder {
+    std::vector<FrozenQuad::Node> nodes;
+    std::vector<geo::Corridor> corridors;
+    std::vector<const geo::Circle*> circles;
+    std::vector<const geo::Grid*> grids;
+
+    void add_node( const Quad& quad )
+    {
+        FrozenQuad::Node node{};
+        node.sw_lat = quad.sw.lat;
+        node.sw_lon = quad.sw.lon;
+        node.ne_lat = quad.ne.lat;
+        node.ne_lon = quad.ne.lon;
+        nodes.push_back( node );
+    }
+
+    // Place the children of quad as one contiguous block, then recurse into each child in order; the leaves end up
+    // in Z-order.
+    void freeze( const Quad& quad, uint32_t index )
+    {
+        const Quad::PtrList& children = quad.get_children();
+
+        if (!children.empty()) {
+            uint32_t first = static_cast<uint32_t>( nodes.size() );
+            nodes[index].first_child = first;
+            nodes[index].child_count = static_cast<uint32_t>( children.size() );
+
+            for (auto& child : children) {
+                add_node( *child );
+            }
+
+            for (uint32_t i = 0; i < children.size(); ++i) {
+                freeze( *children[i], first + i );
+            }
+
+            return;
+        }
+
+        const geo::Entity::PtrList& elements = quad.get_elements();
+        const std::vector<geo::Corridor>& leaf_corridors = quad.get_corridors();
+
+        // split the leaf into homogeneous per-type lists.
+        std::vector<geo::Corridor> leaf_edges;
+        std::vector<const geo::Circle*> leaf_circles;
+        std::vector<const geo::Grid*> leaf_grids;
+
+        for (std::size_t i = 0; i < elements.size(); ++i) {
+            const geo::Entity& entity = *elements[i];
+
+            switch (entity.get_entity_type()) {
+                case geo::EntityType::EDGE:
+                    if (!leaf_corridors[i].empty()) leaf_edges.push_back( leaf_corridors[i] );
+                    break;
+
+                case geo::EntityType::CIRCLE:
+                    leaf_circles.push_back( &static_cast<const geo::Circle&>( entity ) );
+                    break;
+
+                case geo::EntityType::GRID:
+                    leaf_grids.push_back( &static_cast<const geo::Grid&>( entity ) );
+                    break;
+
+                default:
+                    // other entities are not part of the geofence.
+                    break;
+            }
+        }
+
+        nodes[index].corridor_begin = static_cast<uint32_t>( corridors.size() );
+        corridors.insert( corridors.end(), leaf_edges.begin(), leaf_edges.end() );
+        nodes[index].corridor_end = static_cast<uint32_t>( corridors.size() );
+
+        nodes[index].circle_begin = static_cast<uint32_t>( circles.size() );
+        circles.insert( circles.end(), leaf_circles.begin(), leaf_circles.end() );
+        nodes[index].circle_end = static_cast<uint32_t>( circles.size() );
+
+        nodes[index].grid_begin = static_cast<uint32_t>( grids.size() );
+        grids.insert( grids.end(), leaf_grids.begin(), leaf_grids.end() );
+        nodes[index].grid_end = static_cast<uint32_t>( grids.size() );
+    }
+};
+
+}
+
+FrozenQuad::Projection FrozenQuad::Projection::centered( const Node& root )
+{
+    Projection projection;
+    projection.anchor_lat = (root.sw_lat + root.ne_lat) / 2.0;
+    projection.anchor_lon = (root.sw_lon + root.ne_lon) / 2.0;
+    projection.north_scale = geo::kEarthRadiusM * M_PI / 180.0;
+    projection.east_scale = projection.north_scale * std::cos( projection.anchor_lat * M_PI / 180.0 );
+    return projection;
+}
+
+FrozenQuad::FrozenQuad( const Quad& quad, Geometry geometry ) :
+    storage_{},
+    bytes_{ 0 },
+    node_count_{ 0 },
+    corridor_count_{ 0 },
+    circle_count_{ 0 },
+    grid_count_{ 0 },
+    nodes_{ nullptr },
+    corridors_{},
+    fixed_corridors_{},
+    circles_{},
+    grids_{},
+    scan_corridors_{ CorridorKernel::get( CorridorKernel::best() ) },
+    scan_fixed_corridors_{ CorridorKernel::get_fixed( CorridorKernel::best() ) },
+    geometry_{ geometry },
+    parameters_{ quad.get_parameters() },
+    projection_{}
+{
+    FrozenQuadBuilder builder;
+    builder.add_node( quad );
+    builder.freeze( quad, 0 );
+
+    node_count_ = static_cast<uint32_t>( builder.nodes.size() );
+    corridor_count_ = static_cast<uint32_t>( builder.corridors.size() );
+    circle_count_ = static_cast<uint32_t>( builder.circles.size() );
+    grid_count_ = static_cast<uint32_t>( builder.grids.size() );
+
+    // zeroed, so the padding is deterministic and saved files are reproducible.
+    bytes_ = layout_bytes();
+    std::shared_ptr<char> allocation{ new char[bytes_ + kAlignment](), std::default_delete<char[]>() };
+    std::size_t offset = kAlignment - reinterpret_cast<std::uintptr_t>( allocation.get() ) % kAlignment;
+    storage_ = std::shared_ptr<char>( allocation, allocation.get() + offset );
+
+    // the nodes lead the allocation and attaching derives the plane from the root, so they go in first.
+    std::copy( builder.nodes.begin(), builder.nodes.end(), reinterpret_cast<Node*>( storage_.get() ) );
+    attach( geometry );
+
+    // the arrays are only read after this point; this allocation is ours, so fill it through the attached pointers.
+    auto fill = [] ( const double* array ) { return const_cast<double*>( array ); };
+    auto fill_fixed = [] ( const int32_t* array ) { return const_cast<int32_t*>( array ); };
+
+    // planar geometry is the same geometry with each axis offset and scaled; the identity otherwise.
+    bool planar = geometry == Geometry::PLANAR;
+    bool fixed = geometry == Geometry::FIXED;
+    const Projection& p = projection_;
+    auto north = [planar, &p] ( double lat ) { return planar ? (lat - p.anchor_lat) * p.north_scale : lat; };
+    auto east = [planar, &p] ( double lon ) { return planar ? (lon - p.anchor_lon) * p.east_scale : lon; };
+
+    for (uint32_t i = 0; fixed && i < corridor_count_; ++i) {
+        geo::FixedCorridor corridor{ builder.corridors[i] };
+        fill_fixed( fixed_corridors_.min_lat )[i] = corridor.min_lat;
+        fill_fixed( fixed_corridors_.min_lon )[i] = corridor.min_lon;
+        fill_fixed( fixed_corridors_.max_lat )[i] = corridor.max_lat;
+        fill_fixed( fixed_corridors_.max_lon )[i] = corridor.max_lon;
+        for (int e = 0; e < 4; ++e) {
+            fill_fixed( fixed_corridors_.lat[e] )[i] = corridor.lat[e];
+            fill_fixed( fixed_corridors_.lon[e] )[i] = corridor.lon[e];
+        }
+    }
+
+    for (uint32_t i = 0; !fixed && i < corridor_count_; ++i) {
+        const geo::Corridor& corridor = builder.corridors[i];
+        fill( corridors_.min_lat )[i] = north( corridor.min_lat );
+        fill( corridors_.min_lon )[i] = east( corridor.min_lon );
+        fill( corridors_.max_lat )[i] = north( corridor.max_lat );
+        fill( corridors_.max_lon )[i] = east( corridor.max_lon );
+        for (int e = 0; e < 4; ++e) {
+            if (planar) {
+                // a * lat + b * lon + c with lat = anchor_lat + north / north_scale and lon = anchor_lon + east / east_scale.
+                fill( corridors_.a[e] )[i] = corridor.a[e] / p.north_scale;
+                fill( corridors_.b[e] )[i] = corridor.b[e] / p.east_scale;
+                fill( corridors_.c[e] )[i] = corridor.c[e] + corridor.a[e] * p.anchor_lat + corridor.b[e] * p.anchor_lon;
+            } else {
+                fill( corridors_.a[e] )[i] = corridor.a[e];
+                fill( corridors_.b[e] )[i] = corridor.b[e];
+                fill( corridors_.c[e] )[i] = corridor.c[e];
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < circle_count_; ++i) {
+        const geo::Circle& circle = *builder.circles[i];
+        fill( circles_.lat )[i] = north( circle.lat );
+        fill( circles_.lon )[i] = east( circle.lon );
+        fill( circles_.radius )[i] = circle.radius;
+        fill( circles_.scale )[i] = planar ? std::cos( circle.lat * M_PI / 180.0 ) / std::cos( p.anchor_lat * M_PI / 180.0 ) : 1.0;
+    }
+
+    for (uint32_t i = 0; i < grid_count_; ++i) {
+        const geo::Grid& grid = *builder.grids[i];
+        if (fixed) {
+            // whole units, so the comparisons with a rounded position are exact.
+            fill( grids_.sw_lat )[i] = geo::FixedPoint::to_units( grid.sw.lat );
+            fill( grids_.sw_lon )[i] = geo::FixedPoint::to_units( grid.sw.lon );
+            fill( grids_.ne_lat )[i] = geo::FixedPoint::to_units( grid.ne.lat );
+            fill( grids_.ne_lon )[i] = geo::FixedPoint::to_units( grid.ne.lon );
+        } else {
+            fill( grids_.sw_lat )[i] = north( grid.sw.lat );
+            fill( grids_.sw_lon )[i] = east( grid.sw.lon );
+            fill( grids_.ne_lat )[i] = north( grid.ne.lat );
+            fill( grids_.ne_lon )[i] = east( grid.ne.lon );
+        }
+    }
+}
+
+FrozenQuad::FrozenQuad( std::shared_ptr<char> storage, const FileHeader& header ) :
+    storage_{ storage },
+    bytes_{ header.payload_bytes },
+    node_count_{ header.node_count },
+    corridor_count_{ header.corridor_count },
+    circle_count_{ header.circle_count },
+    grid_count_{ header.grid_count },
+    nodes_{ nullptr },
+    corridors_{},
+    fixed_corridors_{},
+    circles_{},
+    grids_{},
+    scan_corridors_{ CorridorKernel::get( CorridorKernel::best() ) },
+    scan_fixed_corridors_{ CorridorKernel::get_fixed( CorridorKernel::best() ) },
+    geometry_{ header.geometry() },
+    parameters_{ header.parameters() },
+    projection_{}
+{
+    attach( geometry_ );
+}
+
+std::size_t FrozenQuad::layout_bytes() const
+{
+    std::size_t corridor_bytes = geometry_ == Geometry::FIXED ? 12 * padded( corridor_count_ * sizeof(int32_t) ) :
+                                                                16 * padded( corridor_count_ * sizeof(double) );
+
+    return padded( node_count_ * sizeof(Node) ) + corridor_bytes + 4 * padded( circle_count_ * sizeof(double) ) +
+           4 * padded( grid_count_ * sizeof(double) );
+}
+
+bool FrozenQuad::nodes_consistent() const
+{
+    auto within = [] ( uint32_t begin, uint32_t end, uint32_t count ) { return begin <= end && end <= count; };
+
+    for (uint32_t i = 0; i < node_count_; ++i) {
+        const Node& node = nodes_[i];
+
+        // children after their parent: a descent only moves forward, so it ends.
+        if (node.child_count > 0 &&
+            (node.first_child <= i || uint64_t{ node.first_child } + node.child_count > node_count_)) {
+            return false;
+        }
+
+        if (!within( node.corridor_begin, node.corridor_end, corridor_count_ ) ||
+            !within( node.circle_begin, node.circle_end, circle_count_ ) ||
+            !within( node.grid_begin, node.grid_end, grid_count_ )) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void FrozenQuad::attach( Geometry geometry )
+{
+    // hand out the cache line aligned arrays from the allocation in order.
+    const char* next = storage_.get();
+    auto take = [&next] ( std::size_t n ) { const double* array = reinterpret_cast<const double*>( next ); next += n; return array; };
+    auto take_fixed = [&next] ( std::size_t n ) { const int32_t* array = reinterpret_cast<const int32_t*>( next ); next += n; return array; };
+
+    nodes_ = reinterpret_cast<const Node*>( next );
+    next += padded( node_count_ * sizeof(Node) );
+
+    // the corridors are either doubles or fixed point; the arrays of the other kind stay null.
+    corridors_ = CorridorArrays{};
+    fixed_corridors_ = FixedCorridorArrays{};
+
+    if (geometry == Geometry::FIXED) {
+        std::size_t corridor_bytes = padded( corridor_count_ * sizeof(int32_t) );
+        fixed_corridors_.min_lat = take_fixed( corridor_bytes );
+        fixed_corridors_.min_lon = take_fixed( corridor_bytes );
+        fixed_corridors_.max_lat = take_fixed( corridor_bytes );
+        fixed_corridors_.max_lon = take_fixed( corridor_bytes );
+        for (int e = 0; e < 4; ++e) {
+            fixed_corridors_.lat[e] = take_fixed( corridor_bytes );
+            fixed_corridors_.lon[e] = take_fixed( corridor_bytes );
+        }
+    } else {
+        std::size_t corridor_bytes = padded( corridor_count_ * sizeof(double) );
+        corridors_.min_lat = take( corridor_bytes );
+        corridors_.min_lon = take( corridor_bytes );
+        corridors_.max_lat = take( corridor_bytes );
+        corridors_.max_lon = take( corridor_bytes );
+        for (int e = 0; e < 4; ++e) {
+            corridors_.a[e] = take( corridor_bytes );
+            corridors_.b[e] = take( corridor_bytes );
+            corridors_.c[e] = take( corridor_bytes );
+        }
+    }
+
+    std::size_t circle_bytes = padded( circle_count_ * sizeof(double) );
+    circles_.lat = take( circle_bytes );
+    circles_.lon = take( circle_bytes );
+    circles_.radius = take( circle_bytes );
+    circles_.scale = take( circle_bytes );
+
+    std::size_t grid_bytes = padded( grid_count_ * sizeof(double) );
+    grids_.sw_lat = take( grid_bytes );
+    grids_.sw_lon = take( grid_bytes );
+    grids_.ne_lat = take( grid_bytes );
+    grids_.ne_lon = take( grid_bytes );
+
+    // the plane is derived from the root, so a saved tree only records that it is planar.
+    geometry_ = geometry;
+    projection_ = Projection::centered( *nodes_ );
+}
+
+uint64_t FrozenQuad::checksum( const char* data, std::size_t bytes )
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (std::size_t i = 0; i + sizeof(uint64_t) <= bytes; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy( &word, data + i, sizeof(word) );
+        hash ^= word;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+FrozenQuad::Source FrozenQuad::Source::of( const std::string& path )
+{
+    struct stat status;
+    std::ifstream ifs{ path, std::ios::binary };
+
+    if (!ifs || ::stat( path.c_str(), &status ) != 0) {
+        throw std::runtime_error{ "cannot read map file: " + path };
+    }
+
+    std::string contents{ std::istreambuf_iterator<char>{ ifs }, std::istreambuf_iterator<char>{} };
+    uint64_t bytes = contents.size();
+    contents.resize( (contents.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t), '\0' );
+
+    int64_t mtime_ns = static_cast<int64_t>( status.st_mtim.tv_sec ) * 1000000000 + status.st_mtim.tv_nsec;
+    return Source{ bytes, mtime_ns, checksum( contents.data(), contents.size() ) };
+}
+
+void FrozenQuad::save( const std::string& path, double extension, double merge_tolerance, double merge_length,
+                       const Source& source ) const
+{
+    FileHeader header{};
+    std::memcpy( header.magic, kMagic, sizeof(header.magic) );
+    header.byte_order = kByteOrder;
+    header.version = kFormatVersion;
+    header.node_size = sizeof(Node);
+    header.node_count = node_count_;
+    header.corridor_count = corridor_count_;
+    header.circle_count = circle_count_;
+    header.grid_count = grid_count_;
+    header.flags = geometry_ == Geometry::PLANAR ? kPlanarFlag : (geometry_ == Geometry::FIXED ? kFixedFlag : 0);
+    header.extension = extension;
+    header.payload_bytes = bytes_;
+    header.checksum = checksum( storage_.get(), bytes_ );
+    header.max_elements = parameters_.max_elements;
+    header.min_degrees = parameters_.min_degrees;
+    header.reduction_factor = parameters_.reduction_factor;
+    header.merge_tolerance = merge_tolerance;
+    header.merge_length = merge_length;
+    header.source_bytes = source.bytes;
+    header.source_mtime_ns = source.mtime_ns;
+    header.source_hash = source.hash;
+
+    // one temporary per process, so replicas publishing the same shared geofence do not write over each other.
+    std::string temporary = path + "." + std::to_string( ::getpid() ) + ".tmp";
+
+    int fd = ::open( temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 );
+    if (fd < 0) {
+        throw std::runtime_error{ "cannot write compiled geofence: " + temporary };
+    }
+
+    std::size_t size = sizeof(header) + bytes_;
+    std::size_t page = huge_page_bytes( fd );
+    bool written = false;
+
+    if (page > 0) {
+        // hugetlbfs files cannot be written, only sized in whole huge pages and filled through a mapping.
+        std::size_t mapped = (size + page - 1) / page * page;
+
+        if (::ftruncate( fd, static_cast<off_t>( mapped ) ) == 0) {
+            void* map = ::mmap( nullptr, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+            if (map != MAP_FAILED) {
+                std::memcpy( map, &header, sizeof(header) );
+                std::memcpy( static_cast<char*>( map ) + sizeof(header), storage_.get(), bytes_ );
+                written = ::munmap( map, mapped ) == 0;
+            }
+        }
+    } else {
+        const char* parts[2] = { reinterpret_cast<const char*>( &header ), storage_.get() };
+        std::size_t lengths[2] = { sizeof(header), bytes_ };
+        written = true;
+
+        for (int part = 0; part < 2 && written; ++part) {
+            std::size_t done = 0;
+            while (done < lengths[part]) {
+                ssize_t n = ::write( fd, parts[part] + done, lengths[part] - done );
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) {
+                    written = false;
+                    break;
+                }
+                done += static_cast<std::size_t>( n );
+            }
+        }
+    }
+
+    if (::close( fd ) != 0) written = false;
+
+    if (!written) {
+        std::remove( temporary.c_str() );
+        throw std::runtime_error{ "cannot write compiled geofence: " + temporary };
+    }
+
+    if (std::rename( temporary.c_str(), path.c_str() ) != 0) {
+        std::remove( temporary.c_str() );
+        throw std::runtime_error{ "cannot rename compiled geofence to: " + path };
+    }
+}
+
+std::size_t FrozenQuad::huge_page_bytes( int fd )
+{
+#ifdef __linux__
+    constexpr long kHugetlbfsMagic = 0x958458f6;
+
+    struct statfs fs;
+    if (::fstatfs( fd, &fs ) == 0 && static_cast<long>( fs.f_type ) == kHugetlbfsMagic) {
+        return static_cast<std::size_t>( fs.f_bsize );
+    }
+#else
+    (void) fd;
+#endif
+    return 0;
+}
+
+FrozenQuad::FileHeader FrozenQuad::read_header( const std::string& path )
+{
+    FileHeader header{};
+
+    std::ifstream ifs{ path, std::ios::binary };
+    if (!ifs.read( reinterpret_cast<char*>( &header ), sizeof(header) )) {
+        throw std::runtime_error{ "cannot read compiled geofence header: " + path };
+    }
+
+    check_header( header, path );
+    return header;
+}
+
+bool FrozenQuad::is_compiled( const std::string& path )
+{
+    char magic[sizeof(kMagic)] = {};
+
+    std::ifstream ifs{ path, std::ios::binary };
+    return ifs.read( magic, sizeof(magic) ) && std::memcmp( magic, kMagic, sizeof(magic) ) == 0;
+}
+
+FrozenQuad::CPtr FrozenQuad::load( const std::string& path, bool verify )
+{
+    int fd = ::open( path.c_str(), O_RDONLY );
+    if (fd < 0) {
+        throw std::runtime_error{ "cannot open compiled geofence: " + path };
+    }
+
+    struct stat status;
+    if (::fstat( fd, &status ) != 0 || status.st_size < static_cast<off_t>( sizeof(FileHeader) )) {
+        ::close( fd );
+        throw std::runtime_error{ "not a compiled geofence: " + path };
+    }
+
+    std::size_t size = static_cast<std::size_t>( status.st_size );
+    // shared, so every process mapping the file uses the same physical pages; a private hugetlbfs mapping would
+    // reserve its own huge pages.
+    void* map = ::mmap( nullptr, size, PROT_READ, MAP_SHARED, fd, 0 );
+    ::close( fd );
+
+    if (map == MAP_FAILED) {
+        throw std::runtime_error{ "cannot map compiled geofence: " + path };
+    }
+
+    std::shared_ptr<char> mapping{ static_cast<char*>( map ), [size] ( char* base ) { ::munmap( base, size ); } };
+
+    FileHeader header;
+    std::memcpy( &header, mapping.get(), sizeof(header) );
+    check_header( header, path );
+
+    if (size - sizeof(FileHeader) < header.payload_bytes) {
+        throw std::runtime_error{ "truncated compiled geofence: " + path };
+    }
+
+    // the mapping is page aligned and the header is one cache line, so the arrays keep their alignment.
+    std::shared_ptr<char> payload{ mapping, mapping.get() + sizeof(FileHeader) };
+
+    if (verify && checksum( payload.get(), header.payload_bytes ) != header.checksum) {
+        throw std::runtime_error{ "compiled geofence checksum mismatch: " + path };
+    }
+
+    std::shared_ptr<FrozenQuad> frozen{ new FrozenQuad{ payload, header } };
+
+    if (frozen->layout_bytes() != header.payload_bytes || frozen->node_count_ == 0 || !frozen->nodes_consistent()) {
+        throw std::runtime_error{ "inconsistent compiled geofence: " + path };
+    }
+
+    return frozen;
+}
+
+void FrozenQuad::check_header( const FileHeader& header, const std::string& path )
+{
+    if (std::memcmp( header.magic, kMagic, sizeof(header.magic) ) != 0) {
+        throw std::runtime_error{ "not a compiled geofence: " + path };
+    }
+
+    if (header.byte_order != kByteOrder || header.node_size != sizeof(Node)) {
+        throw std::runtime_error{ "compiled geofence was built for a different platform: " + path };
+    }
+
+    if (header.version != kFormatVersion) {
+        throw std::runtime_error{ "compiled geofence version " + std::to_string( header.version ) + " is not supported (expected " +
+                                  std::to_string( kFormatVersion ) + "): " + path };
+    }
+}
+
+const FrozenQuad::Node* FrozenQuad::retrieve_leaf( const geo::Point& pt ) const
+{
+    const Node* node = nodes_;
+
+    if (!node->contains( pt )) return nullptr;
+
+    while (node->child_count > 0) {
+        const Node* child = nodes_ + node->first_child;
+        const Node* end = child + node->child_count;
+
+        // stop at the first child; retrieval quads are disjoint except for their shared edges.
+        while (child != end && !child->contains( pt )) ++child;
+
+        if (child == end) return nullptr;
+
+        node = child;
+    }
+
+    return node;
+}
+
+geo::Point FrozenQuad::to_geometry( const geo::Point& pt ) const
+{
+    switch (geometry_) {
+        case Geometry::PLANAR:
+            return projection_.project( pt );
+
+        case Geometry::FIXED:
+            // whole units held exactly in doubles; the corridor scan narrows them back to int32.
+            return geo::Point{ static_cast<double>( geo::FixedPoint::to_units( pt.lat ) ),
+                               static_cast<double>( geo::FixedPoint::to_units( pt.lon ) ) };
+
+        default:
+            return pt;
+    }
+}
+
+bool FrozenQuad::corridors_contain( uint32_t begin, uint32_t end, const geo::Point& q ) const
+{
+    if (geometry_ == Geometry::FIXED) {
+        return scan_fixed_corridors_( fixed_corridors_, begin, end, static_cast<int32_t>( q.lat ), static_cast<int32_t>( q.lon ) );
+    }
+
+    return scan_corridors_( corridors_, begin, end, q.lat, q.lon );
+}
+
+bool FrozenQuad::shapes_contain( const Node& leaf, const geo::Point& q ) const
+{
+    if (geometry_ == Geometry::PLANAR) {
+        for (uint32_t i = leaf.circle_begin; i < leaf.circle_end; ++i) {
+            // squared distance in the plane, with the east axis at the circle's own scale.
+            double east = (q.lon - circles_.lon[i]) * circles_.scale[i];
+            double north = q.lat - circles_.lat[i];
+            if (east * east + north * north <= circles_.radius[i] * circles_.radius[i]) return true;
+        }
+    } else {
+        // circles stay in degrees; a fixed-point position is decoded first.
+        geo::Point pt = geometry_ == Geometry::FIXED
+            ? geo::FixedPoint{ static_cast<int32_t>( q.lat ), static_cast<int32_t>( q.lon ) }.to_degrees()
+            : geo::Point{ q };
+        for (uint32_t i = leaf.circle_begin; i < leaf.circle_end; ++i) {
+            // same test as geo::Circle::contains.
+            if (geo::Location::distance( circles_.lat[i], circles_.lon[i], pt.lat, pt.lon ) <= circles_.radius[i]) return true;
+        }
+    }
+
+    for (uint32_t i = leaf.grid_begin; i < leaf.grid_end; ++i) {
+        if (grids_.sw_lat[i] <= q.lat && q.lat <= grids_.ne_lat[i] &&
+            grids_.sw_lon[i] <= q.lon && q.lon <= grids_.ne_lon[i]) return true;
+    }
+
+    return false;
+}
+
+bool FrozenQuad::leaf_contains( const Node& leaf, const geo::Point& pt ) const
+{
+    geo::Point q = to_geometry( pt );
+
+    if (leaf.corridor_begin != leaf.corridor_end && corridors_contain( leaf.corridor_begin, leaf.corridor_end, q )) return true;
+
+    return shapes_contain( leaf, q );
+}
+
+bool FrozenQuad::is_within_entity( const geo::Point& pt ) const
+{
+    const Node* leaf = retrieve_leaf( pt );
+
+    return leaf && leaf_contains( *leaf, pt );
+}
+
+bool FrozenQuad::is_within_entity( const geo::Point& pt, Hint& hint ) const
+{
+    hint.leaf_hit = false;
+    hint.entity_hit = false;
+
+    const Node* leaf = nullptr;
+    if (hint.index == this) {
+        const Node* last = static_cast<const Node*>( hint.leaf );
+        // the descent ends in the first leaf whose inclusive bounds hold the point; only the hinted leaf holds a point
+        // strictly inside it.
+        if (last->sw_lat < pt.lat && pt.lat < last->ne_lat && last->sw_lon < pt.lon && pt.lon < last->ne_lon) {
+            leaf = last;
+            hint.leaf_hit = true;
+        }
+    }
+
+    if (!hint.leaf_hit) {
+        leaf = retrieve_leaf( pt );
+        hint.index = leaf ? this : nullptr;
+        hint.leaf = leaf;
+        hint.entity = Hint::kNoEntity;
+        if (!leaf) return false;
+    }
+
+    // converted only once the point is known to be inside the tree.
+    geo::Point q = to_geometry( pt );
+
+    if (hint.leaf_hit && hint.entity != Hint::kNoEntity && corridors_contain( hint.entity, hint.entity + 1, q )) {
+        hint.entity_hit = true;
+        return true;
+    }
+
+    if (leaf->corridor_begin != leaf->corridor_end && corridors_contain( leaf->corridor_begin, leaf->corridor_end, q )) {
+        // find the corridor for the next query; every scan gives the same answers, so one of these is it.
+        for (uint32_t i = leaf->corridor_begin; i < leaf->corridor_end; ++i) {
+            if (corridors_contain( i, i + 1, q )) {
+                hint.entity = i;
+                break;
+            }
+        }
+        return true;
+    }
+
+    return shapes_contain( *leaf, q );
+}
+
+void FrozenQuad::within_entities( const geo::Point* points, std::size_t count, Bitmap& within ) const
+{
+    struct Tree {
+        using Handle = const Node*;
+
+        const FrozenQuad& fq;
+
+        Handle root() const { return fq.nodes_; }
+        bool contains( Handle node, const geo::Point& pt ) const { return node->contains( pt ); }
+        std::size_t child_count( Handle node ) const { return node->child_count; }
+        Handle child( Handle node, std::size_t i ) const { return fq.nodes_ + node->first_child + i; }
+        bool leaf_contains( Handle node, const geo::Point& pt ) const { return fq.leaf_contains( *node, pt ); }
+    };
+
+    walk_batch( Tree{ *this }, points, count, within );
+}
+
+const FrozenQuad::Node* FrozenQuad::get_nodes() const
+{
+    return nodes_;
+}
+
+const FrozenQuad::CorridorArrays& FrozenQuad::get_corridors() const
+{
+    return corridors_;
+}
+
+const FrozenQuad::FixedCorridorArrays& FrozenQuad::get_fixed_corridors() const
+{
+    return fixed_corridors_;
+}
+
+const FrozenQuad::CircleArrays& FrozenQuad::get_circles() const
+{
+    return circles_;
+}
+
+const FrozenQuad::GridArrays& FrozenQuad::get_grids() const
+{
+    return grids_;
+}
+
+FrozenQuad::Geometry FrozenQuad::get_geometry() const
+{
+    return geometry_;
+}
+
+const Quad::Parameters& FrozenQuad::get_parameters() const
+{
+    return parameters_;
+}
+
+const FrozenQuad::Projection& FrozenQuad::get_projection() const
+{
+    return projection_;
+}
+
+uint32_t FrozenQuad::node_count() const
+{
+    return node_count_;
+}
+
+uint32_t FrozenQuad::corridor_count() const
+{
+    return corridor_count_;
+}
+
+uint32_t FrozenQuad::circle_count() const
+{
+    return circle_count_;
+}
+
+uint32_t FrozenQuad::grid_count() const
+{
+    return grid_count_;
+}
+
+std::size_t FrozenQuad::bytes() const
+{
+    return bytes_;
+}
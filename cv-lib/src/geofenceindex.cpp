@@ -0,0 +1,114 @@
+/**
+ * @file
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems, UT Battelle.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "geofenceindex.hpp"
+
+namespace {
+
+/**
+ * @brief Spread the bits of a 32 bit value into the even bits of a 64 bit value.
+ */
+uint64_t spread( uint32_t value )
+{
+    uint64_t x = value;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFULL;
+    x = (x | (x << 8))  & 0x00FF00FF00FF00FFULL;
+    x = (x | (x << 4))  & 0x0F0F0F0F0F0F0F0FULL;
+    x = (x | (x << 2))  & 0x3333333333333333ULL;
+    x = (x | (x << 1))  & 0x5555555555555555ULL;
+    return x;
+}
+
+/**
+ * @brief Map a coordinate onto [0, 2^32) across [low, low + span]; anything outside (or NaN) lands on an end.
+ */
+uint32_t quantize( double value, double low, double span )
+{
+    if (!(span > 0.0)) return 0;
+
+    double cell = (value - low) / span * 4294967295.0;
+    if (!(cell > 0.0)) return 0;
+    if (cell >= 4294967295.0) return UINT32_MAX;
+    return static_cast<uint32_t>( cell );
+}
+
+}
+
+uint64_t GeofenceIndex::morton_code( uint32_t x, uint32_t y )
+{
+    return spread( x ) | (spread( y ) << 1);
+}
+
+std::vector<uint32_t> GeofenceIndex::morton_order( const geo::Point* points, std::size_t count )
+{
+    double min_lat = 0.0, max_lat = 0.0, min_lon = 0.0, max_lon = 0.0;
+    bool first = true;
+
+    for (std::size_t i = 0; i < count; ++i) {
+        const geo::Point& pt = points[i];
+        if (!std::isfinite( pt.lat ) || !std::isfinite( pt.lon )) continue;
+
+        if (first) {
+            min_lat = max_lat = pt.lat;
+            min_lon = max_lon = pt.lon;
+            first = false;
+        } else {
+            min_lat = std::min( min_lat, pt.lat );
+            max_lat = std::max( max_lat, pt.lat );
+            min_lon = std::min( min_lon, pt.lon );
+            max_lon = std::max( max_lon, pt.lon );
+        }
+    }
+
+    std::vector<std::pair<uint64_t, uint32_t>> keyed;
+    keyed.reserve( count );
+    for (std::size_t i = 0; i < count; ++i) {
+        uint32_t x = quantize( points[i].lon, min_lon, max_lon - min_lon );
+        uint32_t y = quantize( points[i].lat, min_lat, max_lat - min_lat );
+        keyed.emplace_back( morton_code( x, y ), static_cast<uint32_t>( i ) );
+    }
+
+    // the position breaks ties, so the order is stable.
+    std::sort( keyed.begin(), keyed.end() );
+
+    std::vector<uint32_t> order;
+    order.reserve( count );
+    for (auto& key : keyed) {
+        order.push_back( key.second );
+    }
+
+    return order;
+}
+
+void GeofenceIndex::within_entities( const geo::Point* points, std::size_t count, Bitmap& within ) const
+{
+    within.assign( count, false );
+
+    Hint hint;
+    for (uint32_t i : morton_order( points, count )) {
+        within[i] = is_within_entity( points[i], hint );
+    }
+}
@@ -0,0 +1,299 @@
+/**
+ * @file
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors: Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems,
+ * UT Battelle.
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+
+#include "gridindex.hpp"
+#include "corridorkernel.hpp"
+
+constexpr double GridIndex::kDefaultCellDegrees;
+
+GridIndex::GridIndex( const Quad& quad, double cell_degrees ) :
+    sw_{ quad.sw },
+    ne_{ quad.ne },
+    cell_degrees_{ cell_degrees },
+    last_row_{ 0 },
+    last_col_{ 0 },
+    cells_{},
+    corridor_data_{},
+    corridors_{},
+    corridor_count_{ 0 },
+    circles_{},
+    grids_{},
+    scan_corridors_{ CorridorKernel::get( CorridorKernel::best() ) }
+{
+    if (!(cell_degrees_ > 0.0)) {
+        throw std::invalid_argument{ "grid index cell size must be positive: " + std::to_string( cell_degrees ) };
+    }
+
+    int64_t last_row = row( ne_.lat );
+    int64_t last_col = col( ne_.lon );
+    if (last_row > std::numeric_limits<uint32_t>::max() || last_col > std::numeric_limits<uint32_t>::max()) {
+        throw std::invalid_argument{ "grid index cell size is too small for the region: " + std::to_string( cell_degrees ) };
+    }
+
+    last_row_ = static_cast<uint32_t>( std::max<int64_t>( last_row, 0 ) );
+    last_col_ = static_cast<uint32_t>( std::max<int64_t>( last_col, 0 ) );
+
+    // collect every geofence entity once, in tree order, with its bounding box.
+    std::vector<geo::Corridor> entity_corridors;
+    std::vector<CircleRecord> entity_circles;
+    std::vector<GridRecord> entity_grids;
+    std::vector<GridRecord> circle_boxes;
+
+    std::unordered_set<const geo::Entity*> seen;
+    std::vector<const Quad*> pending{ &quad };
+
+    while (!pending.empty()) {
+        const Quad* node = pending.back();
+        pending.pop_back();
+
+        const Quad::PtrList& children = node->get_children();
+        for (auto child = children.rbegin(); child != children.rend(); ++child) {
+            pending.push_back( child->get() );
+        }
+
+        const geo::Entity::PtrList& elements = node->get_elements();
+        const std::vector<geo::Corridor>& leaf_corridors = node->get_corridors();
+
+        for (std::size_t i = 0; i < elements.size(); ++i) {
+            const geo::Entity& entity = *elements[i];
+            if (!seen.insert( &entity ).second) continue;
+
+            switch (entity.get_entity_type()) {
+                case geo::EntityType::EDGE:
+                    if (!leaf_corridors[i].empty()) entity_corridors.push_back( leaf_corridors[i] );
+                    break;
+
+                case geo::EntityType::CIRCLE:
+                {
+                    const geo::Circle& circle = static_cast<const geo::Circle&>( entity );
+                    entity_circles.push_back( CircleRecord{ circle.lat, circle.lon, circle.radius } );
+
+                    geo::Bounds box = circle.containment_bounds();
+                    circle_boxes.push_back( GridRecord{ box.sw.lat, box.sw.lon, box.ne.lat, box.ne.lon } );
+                    break;
+                }
+
+                case geo::EntityType::GRID:
+                {
+                    const geo::Grid& grid = static_cast<const geo::Grid&>( entity );
+                    entity_grids.push_back( GridRecord{ grid.sw.lat, grid.sw.lon, grid.ne.lat, grid.ne.lon } );
+                    break;
+                }
+
+                default:
+                    // other entities are not part of the geofence.
+                    break;
+            }
+        }
+    }
+
+    // register each entity in every cell its box overlaps; rows and columns are clamped to the region.
+    struct Bucket {
+        std::vector<uint32_t> corridors;
+        std::vector<uint32_t> circles;
+        std::vector<uint32_t> grids;
+    };
+
+    std::unordered_map<uint64_t, Bucket> buckets;
+
+    auto register_box = [&] ( double min_lat, double min_lon, double max_lat, double max_lon, std::vector<uint32_t> Bucket::*list, uint32_t index ) {
+        int64_t row_begin = std::max<int64_t>( row( min_lat ), 0 );
+        int64_t row_end = std::min<int64_t>( row( max_lat ), last_row_ );
+        int64_t col_begin = std::max<int64_t>( col( min_lon ), 0 );
+        int64_t col_end = std::min<int64_t>( col( max_lon ), last_col_ );
+
+        for (int64_t r = row_begin; r <= row_end; ++r) {
+            for (int64_t c = col_begin; c <= col_end; ++c) {
+                (buckets[ key( static_cast<uint32_t>( r ), static_cast<uint32_t>( c ) ) ].*list).push_back( index );
+            }
+        }
+    };
+
+    for (uint32_t i = 0; i < entity_corridors.size(); ++i) {
+        const geo::Corridor& corridor = entity_corridors[i];
+        register_box( corridor.min_lat, corridor.min_lon, corridor.max_lat, corridor.max_lon, &Bucket::corridors, i );
+    }
+
+    for (uint32_t i = 0; i < circle_boxes.size(); ++i) {
+        const GridRecord& box = circle_boxes[i];
+        register_box( box.sw_lat, box.sw_lon, box.ne_lat, box.ne_lon, &Bucket::circles, i );
+    }
+
+    for (uint32_t i = 0; i < entity_grids.size(); ++i) {
+        const GridRecord& grid = entity_grids[i];
+        register_box( grid.sw_lat, grid.sw_lon, grid.ne_lat, grid.ne_lon, &Bucket::grids, i );
+    }
+
+    // pack the cells in key order so the layout does not depend on the hash.
+    std::vector<uint64_t> keys;
+    keys.reserve( buckets.size() );
+    for (auto& bucket : buckets) {
+        keys.push_back( bucket.first );
+    }
+    std::sort( keys.begin(), keys.end() );
+
+    std::vector<const geo::Corridor*> packed_corridors;
+    cells_.reserve( keys.size() );
+
+    for (uint64_t k : keys) {
+        const Bucket& bucket = buckets[k];
+        Cell cell{};
+
+        cell.corridor_begin = static_cast<uint32_t>( packed_corridors.size() );
+        for (uint32_t i : bucket.corridors) packed_corridors.push_back( &entity_corridors[i] );
+        cell.corridor_end = static_cast<uint32_t>( packed_corridors.size() );
+
+        cell.circle_begin = static_cast<uint32_t>( circles_.size() );
+        for (uint32_t i : bucket.circles) circles_.push_back( entity_circles[i] );
+        cell.circle_end = static_cast<uint32_t>( circles_.size() );
+
+        cell.grid_begin = static_cast<uint32_t>( grids_.size() );
+        for (uint32_t i : bucket.grids) grids_.push_back( entity_grids[i] );
+        cell.grid_end = static_cast<uint32_t>( grids_.size() );
+
+        cells_.emplace( k, cell );
+    }
+
+    // the corridors are stored as structure-of-arrays so the CorridorKernel scans can be used.
+    corridor_count_ = static_cast<uint32_t>( packed_corridors.size() );
+    corridor_data_.resize( 16 * static_cast<std::size_t>( corridor_count_ ) );
+
+    double* field = corridor_data_.data();
+    auto take = [&field, this] () { double* array = field; field += corridor_count_; return array; };
+
+    double* min_lat = take();
+    double* min_lon = take();
+    double* max_lat = take();
+    double* max_lon = take();
+    double* a[4];
+    double* b[4];
+    double* c[4];
+    for (int e = 0; e < 4; ++e) {
+        a[e] = take();
+        b[e] = take();
+        c[e] = take();
+    }
+
+    for (uint32_t i = 0; i < corridor_count_; ++i) {
+        const geo::Corridor& corridor = *packed_corridors[i];
+        min_lat[i] = corridor.min_lat;
+        min_lon[i] = corridor.min_lon;
+        max_lat[i] = corridor.max_lat;
+        max_lon[i] = corridor.max_lon;
+        for (int e = 0; e < 4; ++e) {
+            a[e][i] = corridor.a[e];
+            b[e][i] = corridor.b[e];
+            c[e][i] = corridor.c[e];
+        }
+    }
+
+    corridors_.min_lat = min_lat;
+    corridors_.min_lon = min_lon;
+    corridors_.max_lat = max_lat;
+    corridors_.max_lon = max_lon;
+    for (int e = 0; e < 4; ++e) {
+        corridors_.a[e] = a[e];
+        corridors_.b[e] = b[e];
+        corridors_.c[e] = c[e];
+    }
+}
+
+int64_t GridIndex::row( double lat ) const
+{
+    // clamp before converting so points far outside the region cannot overflow.
+    double r = std::floor( (lat - sw_.lat) / cell_degrees_ );
+    return static_cast<int64_t>( std::max( -1.0, std::min( r, 4294967296.0 ) ) );
+}
+
+int64_t GridIndex::col( double lon ) const
+{
+    double c = std::floor( (lon - sw_.lon) / cell_degrees_ );
+    return static_cast<int64_t>( std::max( -1.0, std::min( c, 4294967296.0 ) ) );
+}
+
+uint64_t GridIndex::key( uint32_t row, uint32_t col )
+{
+    return (static_cast<uint64_t>( row ) << 32) | col;
+}
+
+const GridIndex::Cell* GridIndex::retrieve_cell( const geo::Point& pt ) const
+{
+    if (!(sw_.lat <= pt.lat && pt.lat <= ne_.lat && sw_.lon <= pt.lon && pt.lon <= ne_.lon)) return nullptr;
+
+    auto search = cells_.find( key( static_cast<uint32_t>( row( pt.lat ) ), static_cast<uint32_t>( col( pt.lon ) ) ) );
+    return search == cells_.end() ? nullptr : &search->second;
+}
+
+bool GridIndex::is_within_entity( const geo::Point& pt ) const
+{
+    const Cell* cell = retrieve_cell( pt );
+
+    if (!cell) return false;
+
+    if (cell->corridor_begin != cell->corridor_end &&
+        scan_corridors_( corridors_, cell->corridor_begin, cell->corridor_end, pt.lat, pt.lon )) return true;
+
+    for (uint32_t i = cell->circle_begin; i < cell->circle_end; ++i) {
+        // same test as geo::Circle::contains.
+        if (geo::Location::distance( circles_[i].lat, circles_[i].lon, pt.lat, pt.lon ) <= circles_[i].radius) return true;
+    }
+
+    for (uint32_t i = cell->grid_begin; i < cell->grid_end; ++i) {
+        if (grids_[i].sw_lat <= pt.lat && pt.lat <= grids_[i].ne_lat &&
+            grids_[i].sw_lon <= pt.lon && pt.lon <= grids_[i].ne_lon) return true;
+    }
+
+    return false;
+}
+
+double GridIndex::get_cell_degrees() const
+{
+    return cell_degrees_;
+}
+
+std::size_t GridIndex::cell_count() const
+{
+    return cells_.size();
+}
+
+uint32_t GridIndex::corridor_count() const
+{
+    return corridor_count_;
+}
+
+uint32_t GridIndex::circle_count() const
+{
+    return static_cast<uint32_t>( circles_.size() );
+}
+
+uint32_t GridIndex::grid_count() const
+{
+    return static_cast<uint32_t>( grids_.size() );
+}
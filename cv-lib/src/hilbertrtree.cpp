@@ -0,0 +1,404 @@
+/**
+ * @file
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors: Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems,
+ * UT Battelle.
+ */
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+
+#include "hilbertrtree.hpp"
+#include "corridorkernel.hpp"
+
+static_assert( sizeof(HilbertRTree::Node) == 64, "HilbertRTree::Node should fill exactly one cache line." );
+
+constexpr uint32_t HilbertRTree::kDefaultFanout;
+constexpr uint32_t HilbertRTree::kMaxFanout;
+
+HilbertRTree::HilbertRTree( const Quad& quad, uint32_t fanout ) :
+    sw_{ quad.sw },
+    ne_{ quad.ne },
+    fanout_{ fanout },
+    leaf_count_{ 0 },
+    height_{ 0 },
+    nodes_{},
+    corridor_data_{},
+    corridors_{},
+    corridor_count_{ 0 },
+    circles_{},
+    grids_{},
+    scan_corridors_{ CorridorKernel::get( CorridorKernel::best() ) }
+{
+    if (fanout_ < 2 || fanout_ > kMaxFanout) {
+        throw std::invalid_argument{ "R-tree fanout must be between 2 and " + std::to_string( kMaxFanout ) + ": " + std::to_string( fanout ) };
+    }
+
+    // collect every geofence entity once, in tree order, with its bounding box.
+    enum class Kind { CORRIDOR, CIRCLE, GRID };
+
+    struct Item {
+        Node box;                                   // only the box fields are used.
+        Kind kind;
+        uint32_t index;
+        uint32_t hilbert;
+    };
+
+    std::vector<geo::Corridor> entity_corridors;
+    std::vector<CircleRecord> entity_circles;
+    std::vector<GridRecord> entity_grids;
+    std::vector<Item> items;
+
+    auto add_item = [&items] ( double min_lat, double min_lon, double max_lat, double max_lon, Kind kind, std::size_t index ) {
+        Item item{};
+        item.box.min_lat = min_lat;
+        item.box.min_lon = min_lon;
+        item.box.max_lat = max_lat;
+        item.box.max_lon = max_lon;
+        item.kind = kind;
+        item.index = static_cast<uint32_t>( index );
+        items.push_back( item );
+    };
+
+    std::unordered_set<const geo::Entity*> seen;
+    std::vector<const Quad*> pending{ &quad };
+
+    while (!pending.empty()) {
+        const Quad* node = pending.back();
+        pending.pop_back();
+
+        const Quad::PtrList& children = node->get_children();
+        for (auto child = children.rbegin(); child != children.rend(); ++child) {
+            pending.push_back( child->get() );
+        }
+
+        const geo::Entity::PtrList& elements = node->get_elements();
+        const std::vector<geo::Corridor>& leaf_corridors = node->get_corridors();
+
+        for (std::size_t i = 0; i < elements.size(); ++i) {
+            const geo::Entity& entity = *elements[i];
+            if (!seen.insert( &entity ).second) continue;
+
+            switch (entity.get_entity_type()) {
+                case geo::EntityType::EDGE:
+                    if (!leaf_corridors[i].empty()) {
+                        const geo::Corridor& corridor = leaf_corridors[i];
+                        add_item( corridor.min_lat, corridor.min_lon, corridor.max_lat, corridor.max_lon, Kind::CORRIDOR, entity_corridors.size() );
+                        entity_corridors.push_back( corridor );
+                    }
+                    break;
+
+                case geo::EntityType::CIRCLE:
+                {
+                    const geo::Circle& circle = static_cast<const geo::Circle&>( entity );
+                    geo::Bounds box = circle.containment_bounds();
+                    add_item( box.sw.lat, box.sw.lon, box.ne.lat, box.ne.lon, Kind::CIRCLE, entity_circles.size() );
+                    entity_circles.push_back( CircleRecord{ circle.lat, circle.lon, circle.radius } );
+                    break;
+                }
+
+                case geo::EntityType::GRID:
+                {
+                    const geo::Grid& grid = static_cast<const geo::Grid&>( entity );
+                    add_item( grid.sw.lat, grid.sw.lon, grid.ne.lat, grid.ne.lon, Kind::GRID, entity_grids.size() );
+                    entity_grids.push_back( GridRecord{ grid.sw.lat, grid.sw.lon, grid.ne.lat, grid.ne.lon } );
+                    break;
+                }
+
+                default:
+                    // other entities are not part of the geofence.
+                    break;
+            }
+        }
+    }
+
+    // order the entities along the Hilbert curve through the tree's region; ties keep tree order.
+    double lat_scale = quad.ne.lat > quad.sw.lat ? 65535.0 / (quad.ne.lat - quad.sw.lat) : 0.0;
+    double lon_scale = quad.ne.lon > quad.sw.lon ? 65535.0 / (quad.ne.lon - quad.sw.lon) : 0.0;
+    auto cell = [] ( double offset, double scale ) {
+        return static_cast<uint32_t>( std::max( 0.0, std::min( offset * scale, 65535.0 ) ) );
+    };
+
+    for (auto& item : items) {
+        double lat = (item.box.min_lat + item.box.max_lat) / 2.0;
+        double lon = (item.box.min_lon + item.box.max_lon) / 2.0;
+        item.hilbert = hilbert_index( cell( lon - quad.sw.lon, lon_scale ), cell( lat - quad.sw.lat, lat_scale ) );
+    }
+
+    std::stable_sort( items.begin(), items.end(), [] ( const Item& a, const Item& b ) { return a.hilbert < b.hilbert; } );
+
+    auto grow = [] ( Node& node, const Node& box ) {
+        node.min_lat = std::min( node.min_lat, box.min_lat );
+        node.min_lon = std::min( node.min_lon, box.min_lon );
+        node.max_lat = std::max( node.max_lat, box.max_lat );
+        node.max_lon = std::max( node.max_lon, box.max_lon );
+    };
+
+    auto empty_node = [] () {
+        Node node{};
+        node.min_lat = std::numeric_limits<double>::max();
+        node.min_lon = std::numeric_limits<double>::max();
+        node.max_lat = std::numeric_limits<double>::lowest();
+        node.max_lon = std::numeric_limits<double>::lowest();
+        return node;
+    };
+
+    // the leaves: fanout consecutive entities each, with each leaf's geometry packed by type. An empty map is one
+    // empty leaf whose box holds nothing.
+    std::vector<const geo::Corridor*> packed_corridors;
+    std::vector<std::vector<Node>> levels( 1 );
+
+    for (std::size_t first = 0; first < items.size() || levels[0].empty(); first += fanout_) {
+        std::size_t last = std::min( items.size(), first + fanout_ );
+        Node leaf = empty_node();
+
+        leaf.corridor_begin = static_cast<uint32_t>( packed_corridors.size() );
+        leaf.circle_begin = static_cast<uint32_t>( circles_.size() );
+        leaf.grid_begin = static_cast<uint32_t>( grids_.size() );
+
+        for (std::size_t i = first; i < last; ++i) {
+            grow( leaf, items[i].box );
+            switch (items[i].kind) {
+                case Kind::CORRIDOR:
+                    packed_corridors.push_back( &entity_corridors[items[i].index] );
+                    break;
+
+                case Kind::CIRCLE:
+                    circles_.push_back( entity_circles[items[i].index] );
+                    break;
+
+                case Kind::GRID:
+                    grids_.push_back( entity_grids[items[i].index] );
+                    break;
+            }
+        }
+
+        leaf.corridor_end = static_cast<uint32_t>( packed_corridors.size() );
+        leaf.circle_end = static_cast<uint32_t>( circles_.size() );
+        leaf.grid_end = static_cast<uint32_t>( grids_.size() );
+        levels[0].push_back( leaf );
+    }
+
+    // each level above groups fanout consecutive nodes of the level below; first_child is relative to that level.
+    while (levels.back().size() > 1) {
+        const std::vector<Node>& below = levels.back();
+        std::vector<Node> level;
+
+        for (std::size_t first = 0; first < below.size(); first += fanout_) {
+            std::size_t last = std::min( below.size(), first + fanout_ );
+            Node node = empty_node();
+            node.first_child = static_cast<uint32_t>( first );
+            node.child_count = static_cast<uint32_t>( last - first );
+            for (std::size_t i = first; i < last; ++i) {
+                grow( node, below[i] );
+            }
+            level.push_back( node );
+        }
+
+        levels.push_back( std::move( level ) );
+    }
+
+    // root first: lay the levels out top down and make the child offsets absolute.
+    height_ = static_cast<uint32_t>( levels.size() );
+    leaf_count_ = static_cast<uint32_t>( levels[0].size() );
+
+    for (std::size_t l = levels.size(); l-- > 0;) {
+        uint32_t below_offset = static_cast<uint32_t>( nodes_.size() + levels[l].size() );
+        for (Node node : levels[l]) {
+            if (node.child_count > 0) node.first_child += below_offset;
+            nodes_.push_back( node );
+        }
+    }
+
+    // the corridors are stored as structure-of-arrays so the CorridorKernel scans can be used.
+    corridor_count_ = static_cast<uint32_t>( packed_corridors.size() );
+    corridor_data_.resize( 16 * static_cast<std::size_t>( corridor_count_ ) );
+
+    double* field = corridor_data_.data();
+    auto take = [&field, this] () { double* array = field; field += corridor_count_; return array; };
+
+    double* min_lat = take();
+    double* min_lon = take();
+    double* max_lat = take();
+    double* max_lon = take();
+    double* a[4];
+    double* b[4];
+    double* c[4];
+    for (int e = 0; e < 4; ++e) {
+        a[e] = take();
+        b[e] = take();
+        c[e] = take();
+    }
+
+    for (uint32_t i = 0; i < corridor_count_; ++i) {
+        const geo::Corridor& corridor = *packed_corridors[i];
+        min_lat[i] = corridor.min_lat;
+        min_lon[i] = corridor.min_lon;
+        max_lat[i] = corridor.max_lat;
+        max_lon[i] = corridor.max_lon;
+        for (int e = 0; e < 4; ++e) {
+            a[e][i] = corridor.a[e];
+            b[e][i] = corridor.b[e];
+            c[e][i] = corridor.c[e];
+        }
+    }
+
+    corridors_.min_lat = min_lat;
+    corridors_.min_lon = min_lon;
+    corridors_.max_lat = max_lat;
+    corridors_.max_lon = max_lon;
+    for (int e = 0; e < 4; ++e) {
+        corridors_.a[e] = a[e];
+        corridors_.b[e] = b[e];
+        corridors_.c[e] = c[e];
+    }
+}
+
+uint32_t HilbertRTree::hilbert_index( uint32_t x, uint32_t y )
+{
+    const uint32_t last = 0xFFFF;
+    uint32_t d = 0;
+
+    x &= last;
+    y &= last;
+
+    for (uint32_t s = 0x8000; s > 0; s >>= 1) {
+        uint32_t rx = (x & s) ? 1 : 0;
+        uint32_t ry = (y & s) ? 1 : 0;
+        d += s * s * ((3 * rx) ^ ry);
+
+        // rotate the quadrant so the curve inside it starts and ends where the parent curve needs.
+        if (ry == 0) {
+            if (rx == 1) {
+                x = last - x;
+                y = last - y;
+            }
+            std::swap( x, y );
+        }
+    }
+
+    return d;
+}
+
+bool HilbertRTree::leaf_contains( const Node& leaf, const geo::Point& pt ) const
+{
+    if (leaf.corridor_begin != leaf.corridor_end &&
+        scan_corridors_( corridors_, leaf.corridor_begin, leaf.corridor_end, pt.lat, pt.lon )) return true;
+
+    for (uint32_t i = leaf.circle_begin; i < leaf.circle_end; ++i) {
+        // same test as geo::Circle::contains.
+        if (geo::Location::distance( circles_[i].lat, circles_[i].lon, pt.lat, pt.lon ) <= circles_[i].radius) return true;
+    }
+
+    for (uint32_t i = leaf.grid_begin; i < leaf.grid_end; ++i) {
+        const GridRecord& grid = grids_[i];
+        if (grid.sw_lat <= pt.lat && pt.lat <= grid.ne_lat && grid.sw_lon <= pt.lon && pt.lon <= grid.ne_lon) return true;
+    }
+
+    return false;
+}
+
+bool HilbertRTree::descend( const Node& node, const geo::Point& pt, SearchCost* cost ) const
+{
+    if (node.child_count == 0) {
+        if (cost) {
+            cost->candidates += (node.corridor_end - node.corridor_begin) + (node.circle_end - node.circle_begin) +
+                                (node.grid_end - node.grid_begin);
+        }
+        return leaf_contains( node, pt );
+    }
+
+    const Node* child = nodes_.data() + node.first_child;
+    const Node* end = child + node.child_count;
+
+    if (cost) cost->nodes += node.child_count;
+
+    // the boxes may overlap, so every child holding the point is searched until one answers.
+    for (; child != end; ++child) {
+        if (child->contains( pt ) && descend( *child, pt, cost )) return true;
+    }
+
+    return false;
+}
+
+bool HilbertRTree::is_within_entity( const geo::Point& pt ) const
+{
+    return in_region( pt ) && nodes_[0].contains( pt ) && descend( nodes_[0], pt, nullptr );
+}
+
+bool HilbertRTree::search( const geo::Point& pt, SearchCost& cost ) const
+{
+    // the region and the root box are checked together as the first node.
+    ++cost.nodes;
+    return in_region( pt ) && nodes_[0].contains( pt ) && descend( nodes_[0], pt, &cost );
+}
+
+bool HilbertRTree::in_region( const geo::Point& pt ) const
+{
+    // entity boxes can reach past the region; the other indexes stop at it.
+    return sw_.lat <= pt.lat && pt.lat <= ne_.lat && sw_.lon <= pt.lon && pt.lon <= ne_.lon;
+}
+
+const HilbertRTree::Node* HilbertRTree::get_nodes() const
+{
+    return nodes_.data();
+}
+
+uint32_t HilbertRTree::get_fanout() const
+{
+    return fanout_;
+}
+
+uint32_t HilbertRTree::node_count() const
+{
+    return static_cast<uint32_t>( nodes_.size() );
+}
+
+uint32_t HilbertRTree::leaf_count() const
+{
+    return leaf_count_;
+}
+
+uint32_t HilbertRTree::height() const
+{
+    return height_;
+}
+
+uint32_t HilbertRTree::corridor_count() const
+{
+    return corridor_count_;
+}
+
+uint32_t HilbertRTree::circle_count() const
+{
+    return static_cast<uint32_t>( circles_.size() );
+}
+
+uint32_t HilbertRTree::grid_count() const
+{
+    return static_cast<uint32_t>( grids_.size() );
+}
+
+std::size_t HilbertRTree::bytes() const
+{
+    return nodes_.size() * sizeof(Node) + corridor_data_.size() * sizeof(double) + circles_.size() * sizeof(CircleRecord) +
+           grids_.size() * sizeof(GridRecord);
+}
@@ -23,19 +23,38 @@
  * UT Battelle.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+
 #include "quad.hpp"
 #include "utilities.hpp"
 
-geo::Vertex::IdToPtrMap Quad::elementmap{};
 geo::Entity::PtrList Quad::empty_element_list{};
 
 Quad::Quad( const geo::Point& swpoint, const geo::Point& nepoint, int level, const std::string& position )
+    : Quad{ swpoint, nepoint, Parameters{}, level, position }
+{}
+
+Quad::Quad( const geo::Point& swpoint, const geo::Point& nepoint, const Parameters& parameters, int level,
+            const std::string& position )
     : geo::Bounds{ swpoint, nepoint }, 
+    parameters_{parameters},
     level_{level}, 
     position_{position}
 {
-    fuzzywidth_ = width() / REDUCTION_FACTOR;
-    fuzzyheight_ = height() / REDUCTION_FACTOR;
+    if (parameters_.max_elements == 0 || !(parameters_.min_degrees > 0.0) || !(parameters_.reduction_factor > 0.0)) {
+        throw std::invalid_argument{ "Quad parameters must be positive" };
+    }
+
+    fuzzywidth_ = width() / parameters_.reduction_factor;
+    fuzzyheight_ = height() / parameters_.reduction_factor;
 
     fuzzybounds_.sw.lat = sw.lat - fuzzyheight_;
     fuzzybounds_.sw.lon = sw.lon - fuzzywidth_;
@@ -54,32 +73,32 @@ void Quad::quadsplit()
 {
     children_.clear();
     int nextlevel = level_ + 1;
-    children_.emplace_back( std::make_shared<Quad>( west_midpoint(), north_midpoint(), nextlevel ) );
-    children_.emplace_back( std::make_shared<Quad>( center(), ne, nextlevel ) );
-    children_.emplace_back( std::make_shared<Quad>( sw, center(), nextlevel ) );
-    children_.emplace_back( std::make_shared<Quad>( south_midpoint(), east_midpoint(), nextlevel ) );
+    children_.emplace_back( std::make_shared<Quad>( west_midpoint(), north_midpoint(), parameters_, nextlevel ) );
+    children_.emplace_back( std::make_shared<Quad>( center(), ne, parameters_, nextlevel ) );
+    children_.emplace_back( std::make_shared<Quad>( sw, center(), parameters_, nextlevel ) );
+    children_.emplace_back( std::make_shared<Quad>( south_midpoint(), east_midpoint(), parameters_, nextlevel ) );
 }
 
 void Quad::horizontalsplit()
 {
     children_.clear();
     int nextlevel = level_ + 1;
-    children_.emplace_back( std::make_shared<Quad>( sw, north_midpoint(), nextlevel ) );
-    children_.emplace_back( std::make_shared<Quad>( south_midpoint(), ne, nextlevel ) );
+    children_.emplace_back( std::make_shared<Quad>( sw, north_midpoint(), parameters_, nextlevel ) );
+    children_.emplace_back( std::make_shared<Quad>( south_midpoint(), ne, parameters_, nextlevel ) );
 }
 
 void Quad::verticalsplit()
 {
     children_.clear();
     int nextlevel = level_ + 1;
-    children_.emplace_back( std::make_shared<Quad>( west_midpoint(), ne, nextlevel ) );
-    children_.emplace_back( std::make_shared<Quad>( sw, east_midpoint(), nextlevel ) );
+    children_.emplace_back( std::make_shared<Quad>( west_midpoint(), ne, parameters_, nextlevel ) );
+    children_.emplace_back( std::make_shared<Quad>( sw, east_midpoint(), parameters_, nextlevel ) );
 }
 
 bool Quad::split()
 {
-    bool isverticalsplit = height() / 2.0 >= Quad::MIN_DEGREES;
-    bool ishorizontalsplit = width() / 2.0 >= Quad::MIN_DEGREES;
+    bool isverticalsplit = height() / 2.0 >= parameters_.min_degrees;
+    bool ishorizontalsplit = width() / 2.0 >= parameters_.min_degrees;
 
     if (isverticalsplit && ishorizontalsplit) {
         quadsplit();
@@ -105,10 +124,10 @@ bool Quad::haschildren() const
 
 bool Quad::full() const
 {
-    return static_cast<int>(element_list_.size()) > MAX_ELEMENTS;
+    return element_list_.size() > parameters_.max_elements;
 }
 
-bool Quad::insert( Quad::Ptr& quadptr, geo::Entity::CPtr entity_ptr )
+bool Quad::insert( Quad::Ptr& quadptr, geo::Entity::CPtr entity_ptr, const geo::Corridor& corridor )
 {
     if ( !entity_ptr->touches(quadptr->fuzzybounds_) ) return false;
 
@@ -137,25 +156,340 @@ bool Quad::insert( Quad::Ptr& quadptr, geo::Entity::CPtr entity_ptr )
         
         // This is a leaf node. Try to insert.
         currquad->element_list_.push_back(entity_ptr);
+        currquad->corridor_list_.push_back(corridor);
 
         // Try to split the quad if its full.
         if (currquad->full() && currquad->split()) {
             // quad is saturated with elements; split and redistribute.
             // add it first so we redistribute everything including this
             // element.
-            for ( auto& e : currquad->element_list_ ) {
+            for ( std::size_t i = 0; i < currquad->element_list_.size(); ++i ) {
                 for ( auto& quad : currquad->children_ ) {
-                    insert(quad, e);
+                    insert(quad, currquad->element_list_[i], currquad->corridor_list_[i]);
                 }
             }
 
             currquad->element_list_.clear();
+            currquad->corridor_list_.clear();
         } 
     }
 
     return true;
 }
 
+bool Quad::bulk_split( const geo::Entity::PtrList& entities, const std::vector<uint32_t>& indices,
+                       std::vector<std::vector<uint32_t>>& child_indices )
+{
+    // Quad::insert splits a leaf when its element count passes max_elements; the count only grows, so it splits iff
+    // all of the entities that reach it would overflow it.
+    if (indices.size() <= parameters_.max_elements || !split()) return false;
+
+    child_indices.assign( children_.size(), std::vector<uint32_t>{} );
+    for ( std::size_t c = 0; c < children_.size(); ++c ) {
+        const Bounds& fuzzy = children_[c]->fuzzybounds_;
+        for ( uint32_t index : indices ) {
+            if (entities[index]->touches( fuzzy )) {
+                child_indices[c].push_back( index );
+            }
+        }
+    }
+
+    return true;
+}
+
+void Quad::fill( const geo::Entity::PtrList& entities, const std::vector<geo::Corridor>& corridors,
+                 const std::vector<uint32_t>& indices )
+{
+    element_list_.reserve( indices.size() );
+    corridor_list_.reserve( indices.size() );
+
+    for ( uint32_t index : indices ) {
+        element_list_.push_back( entities[index] );
+        corridor_list_.push_back( corridors.empty() ? geo::Corridor{} : corridors[index] );
+    }
+}
+
+void Quad::build( const geo::Entity::PtrList& entities, const std::vector<geo::Corridor>& corridors,
+                  const std::vector<uint32_t>& indices )
+{
+    std::vector<std::vector<uint32_t>> child_indices;
+
+    if (!bulk_split( entities, indices, child_indices )) {
+        fill( entities, corridors, indices );
+        return;
+    }
+
+    for ( std::size_t c = 0; c < children_.size(); ++c ) {
+        children_[c]->build( entities, corridors, child_indices[c] );
+    }
+}
+
+std::size_t Quad::bulk_insert( Quad::Ptr& quadptr, const geo::Entity::PtrList& entities,
+                               const std::vector<geo::Corridor>& corridors, unsigned threads )
+{
+    if (quadptr->haschildren() || !quadptr->element_list_.empty()) {
+        throw std::invalid_argument{ "Quad::bulk_insert requires an empty tree" };
+    }
+
+    if (!corridors.empty() && corridors.size() != entities.size()) {
+        throw std::invalid_argument{ "Quad::bulk_insert corridors must be parallel to the entities" };
+    }
+
+    if (threads == 0) {
+        threads = std::max( 1u, std::thread::hardware_concurrency() );
+    }
+
+    std::vector<uint32_t> root_indices;
+    for ( uint32_t i = 0; i < entities.size(); ++i ) {
+        if (entities[i]->touches( quadptr->fuzzybounds_ )) {
+            root_indices.push_back( i );
+        }
+    }
+
+    if (threads == 1) {
+        quadptr->build( entities, corridors, root_indices );
+        return root_indices.size();
+    }
+
+    // Split breadth first until every thread has a few subtrees to build; leaves found on the way are filled here.
+    using Task = std::pair<Quad*, std::vector<uint32_t>>;
+    std::deque<Task> frontier;
+    frontier.emplace_back( quadptr.get(), root_indices );
+
+    const std::size_t target = 4 * static_cast<std::size_t>( threads );
+    while (!frontier.empty() && frontier.size() < target) {
+        Task task = std::move( frontier.front() );
+        frontier.pop_front();
+
+        std::vector<std::vector<uint32_t>> child_indices;
+        if (!task.first->bulk_split( entities, task.second, child_indices )) {
+            task.first->fill( entities, corridors, task.second );
+            continue;
+        }
+
+        for ( std::size_t c = 0; c < task.first->children_.size(); ++c ) {
+            frontier.emplace_back( task.first->children_[c].get(), std::move( child_indices[c] ) );
+        }
+    }
+
+    std::vector<Task> tasks{ std::make_move_iterator( frontier.begin() ), std::make_move_iterator( frontier.end() ) };
+
+    std::atomic<std::size_t> next{ 0 };
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto worker = [&]() {
+        for ( std::size_t t = next++; t < tasks.size(); t = next++ ) {
+            try {
+                tasks[t].first->build( entities, corridors, tasks[t].second );
+            } catch ( ... ) {
+                std::lock_guard<std::mutex> lock{ error_mutex };
+                if (!error) error = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for ( unsigned i = 1; i < std::min<std::size_t>( threads, tasks.size() ); ++i ) {
+        pool.emplace_back( worker );
+    }
+    worker();
+
+    for ( auto& thread : pool ) {
+        thread.join();
+    }
+
+    if (error) std::rethrow_exception( error );
+
+    return root_indices.size();
+}
+
+void Quad::make_corridors( Quad::Ptr& quadptr, double extension )
+{
+    std::unordered_map<const geo::Entity*, geo::Corridor> corridor_map;
+    PtrStack quadstack;
+    quadstack.push(quadptr);
+
+    while (!quadstack.empty()) {
+        Ptr currquad = quadstack.top();
+        quadstack.pop();
+
+        for (auto& child : currquad->children_) {
+            quadstack.push(child);
+        }
+
+        for ( std::size_t i = 0; i < currquad->element_list_.size(); ++i ) {
+            const geo::Entity* entity = currquad->element_list_[i].get();
+
+            if (!currquad->corridor_list_[i].empty() || entity->get_entity_type() != geo::EntityType::EDGE) continue;
+
+            auto search = corridor_map.find(entity);
+            if (search == corridor_map.end()) {
+                const geo::Edge* edge = static_cast<const geo::Edge*>(entity);
+                search = corridor_map.emplace(entity, geo::Corridor{ *edge->to_area(extension) }).first;
+            }
+
+            currquad->corridor_list_[i] = search->second;
+        }
+    }
+}
+
+bool Quad::is_removed( const geo::Entity& entity, const Delta& delta )
+{
+    switch (entity.get_entity_type()) {
+        case geo::EntityType::EDGE:
+            return delta.removed_edges.count( static_cast<const geo::Edge&>( entity ).get_uid() ) > 0;
+
+        case geo::EntityType::CIRCLE:
+            return delta.removed_circles.count( static_cast<const geo::Circle&>( entity ).uid ) > 0;
+
+        default:
+            // grids have no identifier.
+            return false;
+    }
+}
+
+bool Quad::merge()
+{
+    // an entity crossing leaves is held by each of them; keep one copy.
+    std::unordered_set<const geo::Entity*> seen;
+    geo::Entity::PtrList elements;
+    std::vector<geo::Corridor> corridors;
+
+    PtrStack quadstack;
+    for ( auto it = children_.rbegin(); it != children_.rend(); ++it ) {
+        quadstack.push( *it );
+    }
+
+    // leaves in split order, so the merged leaf keeps the order of its children's entities.
+    while (!quadstack.empty()) {
+        Ptr currquad = quadstack.top();
+        quadstack.pop();
+
+        for ( auto it = currquad->children_.rbegin(); it != currquad->children_.rend(); ++it ) {
+            quadstack.push( *it );
+        }
+
+        for ( std::size_t i = 0; i < currquad->element_list_.size(); ++i ) {
+            if (!seen.insert( currquad->element_list_[i].get() ).second) continue;
+
+            // Quad::insert would have split a leaf this full.
+            if (elements.size() == parameters_.max_elements) return false;
+
+            elements.push_back( currquad->element_list_[i] );
+            corridors.push_back( currquad->corridor_list_[i] );
+        }
+    }
+
+    children_.clear();
+    element_list_ = std::move( elements );
+    corridor_list_ = std::move( corridors );
+    return true;
+}
+
+Quad::Ptr Quad::edit_subtree( const Quad::Ptr& quadptr, const Delta& delta, const std::vector<uint32_t>& indices,
+                              std::unordered_set<const geo::Entity*>& removed, EditStats& stats )
+{
+    if (!quadptr->haschildren()) {
+        bool changed = !indices.empty();
+        for ( std::size_t i = 0; !changed && i < quadptr->element_list_.size(); ++i ) {
+            changed = is_removed( *quadptr->element_list_[i], delta );
+        }
+
+        if (!changed) return quadptr;
+
+        Ptr copy = std::make_shared<Quad>( *quadptr );
+        ++stats.copied;
+
+        copy->element_list_.clear();
+        copy->corridor_list_.clear();
+
+        for ( std::size_t i = 0; i < quadptr->element_list_.size(); ++i ) {
+            if (is_removed( *quadptr->element_list_[i], delta )) {
+                removed.insert( quadptr->element_list_[i].get() );
+            } else {
+                copy->element_list_.push_back( quadptr->element_list_[i] );
+                copy->corridor_list_.push_back( quadptr->corridor_list_[i] );
+            }
+        }
+
+        // the copy and the children its splits create belong to the new tree only.
+        for ( uint32_t index : indices ) {
+            insert( copy, delta.added[index], delta.corridors.empty() ? geo::Corridor{} : delta.corridors[index] );
+        }
+
+        return copy;
+    }
+
+    PtrList children;
+    bool changed = false;
+
+    for ( auto& child : quadptr->children_ ) {
+        std::vector<uint32_t> child_indices;
+        for ( uint32_t index : indices ) {
+            if (delta.added[index]->touches( child->fuzzybounds_ )) {
+                child_indices.push_back( index );
+            }
+        }
+
+        children.push_back( edit_subtree( child, delta, child_indices, removed, stats ) );
+        changed = changed || children.back() != child;
+    }
+
+    if (!changed) return quadptr;
+
+    Ptr copy = std::make_shared<Quad>( *quadptr );
+    ++stats.copied;
+
+    copy->children_ = std::move( children );
+    if (copy->merge()) ++stats.merged;
+
+    return copy;
+}
+
+Quad::Ptr Quad::edit( const Quad::Ptr& quadptr, const Delta& delta, EditStats* stats )
+{
+    if (!delta.corridors.empty() && delta.corridors.size() != delta.added.size()) {
+        throw std::invalid_argument{ "Quad::edit corridors must be parallel to the added entities" };
+    }
+
+    EditStats local;
+    EditStats& counts = stats ? *stats : local;
+    counts = EditStats{};
+
+    if (delta.empty()) return quadptr;
+
+    std::vector<uint32_t> root_indices;
+    for ( uint32_t i = 0; i < delta.added.size(); ++i ) {
+        if (delta.added[i]->touches( quadptr->fuzzybounds_ )) {
+            root_indices.push_back( i );
+        }
+    }
+
+    std::unordered_set<const geo::Entity*> removed;
+    Ptr edited = edit_subtree( quadptr, delta, root_indices, removed, counts );
+
+    counts.removed = removed.size();
+    counts.added = root_indices.size();
+    return edited;
+}
+
+Quad::Ptr Quad::remove( const Quad::Ptr& quadptr, geo::EntityType type, const std::unordered_set<uint64_t>& ids,
+                        EditStats* stats )
+{
+    Delta delta;
+
+    if (type == geo::EntityType::EDGE) {
+        delta.removed_edges = ids;
+    } else if (type == geo::EntityType::CIRCLE) {
+        delta.removed_circles = ids;
+    } else {
+        throw std::invalid_argument{ "Quad::remove only removes edges and circles" };
+    }
+
+    return edit( quadptr, delta, stats );
+}
+
 std::ostream& operator<<( std::ostream& os, const Quad& quad )
 {
     return os << "Quad: {" << quad.sw << ", " << quad.ne << "} element count: " << quad.element_list_.size() << " level: " << quad.level_ << " children: " << quad.children_.size() << " fuzzy: {" << quad.fuzzybounds_.sw << ", " << quad.fuzzybounds_.ne << ", " << quad.fuzzybounds_.height() << ", " << quad.fuzzybounds_.width() << "}";
@@ -185,6 +519,154 @@ const geo::Entity::PtrList& Quad::retrieve_elements( const geo::Point& pt ) cons
     }
 }
 
+const Quad* Quad::retrieve_leaf( const geo::Point& pt ) const
+{
+    const Quad* currquad = this;
+
+    if (!currquad->contains(pt)) return nullptr;
+
+    while (currquad->haschildren()) {
+        for (auto& child : currquad->children_) {
+            // one of these must contain the point.
+            if (child->contains( pt )) {
+                currquad = child.get();  // grab the raw pointer.
+                break;                   // stop at the first child; retrieval quads are disjoint.
+            }
+        }
+    }
+
+    return currquad;
+}
+
+Quad::LeafView Quad::retrieve_leaf_view( const geo::Point& pt ) const
+{
+    const Quad* leaf = retrieve_leaf( pt );
+
+    if (!leaf) return LeafView{ nullptr, nullptr, 0 };
+
+    return LeafView{ leaf->element_list_.data(), leaf->corridor_list_.data(), leaf->element_list_.size() };
+}
+
+bool Quad::element_contains( std::size_t i, const geo::Point& pt ) const
+{
+    const geo::Entity& entity = *element_list_[i];
+
+    switch (entity.get_entity_type()) {
+        case geo::EntityType::EDGE:
+            return corridor_list_[i].contains( pt );
+
+        case geo::EntityType::CIRCLE:
+            return static_cast<const geo::Circle&>( entity ).contains( pt );
+
+        case geo::EntityType::GRID:
+            return static_cast<const geo::Grid&>( entity ).contains( pt );
+
+        default:
+            // other entities are not part of the geofence.
+            return false;
+    }
+}
+
+bool Quad::is_within_entity( const geo::Point& pt ) const
+{
+    const Quad* leaf = retrieve_leaf( pt );
+
+    if (!leaf) return false;
+
+    for (std::size_t i = 0; i < leaf->element_list_.size(); ++i) {
+        if (leaf->element_contains( i, pt )) return true;
+    }
+
+    return false;
+}
+
+bool Quad::is_within_entity( const geo::Point& pt, Hint& hint ) const
+{
+    hint.leaf_hit = false;
+    hint.entity_hit = false;
+
+    const Quad* leaf = nullptr;
+    if (hint.index == this) {
+        const Quad* last = static_cast<const Quad*>( hint.leaf );
+        // retrieval bounds are disjoint except for their edges; only the hinted leaf holds a point strictly inside it.
+        if (last->sw.lat < pt.lat && pt.lat < last->ne.lat && last->sw.lon < pt.lon && pt.lon < last->ne.lon) {
+            leaf = last;
+            hint.leaf_hit = true;
+        }
+    }
+
+    if (hint.leaf_hit) {
+        if (hint.entity != Hint::kNoEntity && leaf->element_contains( hint.entity, pt )) {
+            hint.entity_hit = true;
+            return true;
+        }
+    } else {
+        leaf = retrieve_leaf( pt );
+        hint.index = leaf ? this : nullptr;
+        hint.leaf = leaf;
+        hint.entity = Hint::kNoEntity;
+        if (!leaf) return false;
+    }
+
+    for (std::size_t i = 0; i < leaf->element_list_.size(); ++i) {
+        if (leaf->element_contains( i, pt )) {
+            hint.entity = static_cast<uint32_t>( i );
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Quad::within_entities( const geo::Point* points, std::size_t count, Bitmap& within ) const
+{
+    struct Tree {
+        using Handle = const Quad*;
+
+        const Quad* top;
+
+        Handle root() const { return top; }
+        bool contains( Handle quad, const geo::Point& pt ) const { return quad->contains( pt ); }
+        std::size_t child_count( Handle quad ) const { return quad->children_.size(); }
+        Handle child( Handle quad, std::size_t i ) const { return quad->children_[i].get(); }
+
+        bool leaf_contains( Handle quad, const geo::Point& pt ) const
+        {
+            for (std::size_t i = 0; i < quad->element_list_.size(); ++i) {
+                if (quad->element_contains( i, pt )) return true;
+            }
+            return false;
+        }
+    };
+
+    walk_batch( Tree{ this }, points, count, within );
+}
+
+const Quad::Parameters& Quad::get_parameters() const
+{
+    return parameters_;
+}
+
+int Quad::get_level() const
+{
+    return level_;
+}
+
+const Quad::PtrList& Quad::get_children() const
+{
+    return children_;
+}
+
+const geo::Entity::PtrList& Quad::get_elements() const
+{
+    return element_list_;
+}
+
+const std::vector<geo::Corridor>& Quad::get_corridors() const
+{
+    return corridor_list_;
+}
+
 geo::Bounds::Ptr Quad::retrieve_bounds( const geo::Point& pt, bool fuzzy) const
 {
     const Quad* currquad = this;
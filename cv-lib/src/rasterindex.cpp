@@ -0,0 +1,330 @@
+/**
+ * @file
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors: Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems,
+ * UT Battelle.
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+#include "rasterindex.hpp"
+
+constexpr double RasterIndex::kDefaultCellDegrees;
+constexpr uint64_t RasterIndex::kMaxCells;
+constexpr double RasterIndex::kCellPad;
+constexpr double RasterIndex::kMargin;
+
+namespace {
+
+/**
+ * @brief A padded cell; every point that quantizes to the cell is inside it.
+ */
+struct CellBox {
+    double min_lat;
+    double min_lon;
+    double max_lat;
+    double max_lon;
+};
+
+/**
+ * @brief Return the sign of a corridor edge expression over a box: 1 when it is non-negative with margin at every
+ * corner, -1 when it is negative with margin at every corner and 0 otherwise. The expression is linear, so its extremes
+ * over the box are at the corners.
+ */
+int edge_sign( double a, double b, double c, const CellBox& box, double margin )
+{
+    const double lats[2] = { box.min_lat, box.max_lat };
+    const double lons[2] = { box.min_lon, box.max_lon };
+
+    int above = 0;
+    int below = 0;
+
+    for (double lat : lats) {
+        for (double lon : lons) {
+            double value = a * lat + b * lon + c;
+            double tolerance = margin * (std::abs( a * lat ) + std::abs( b * lon ) + std::abs( c ));
+            if (value >= tolerance) ++above;
+            else if (value < -tolerance) ++below;
+        }
+    }
+
+    return above == 4 ? 1 : (below == 4 ? -1 : 0);
+}
+
+}
+
+RasterIndex::RasterIndex( const Quad& quad, GeofenceIndex::CPtr exact, double cell_degrees ) :
+    sw_{ quad.sw },
+    ne_{ quad.ne },
+    cell_degrees_{ cell_degrees },
+    rows_{ 0 },
+    cols_{ 0 },
+    cells_{},
+    inside_count_{ 0 },
+    boundary_count_{ 0 },
+    exact_{ exact }
+{
+    if (!(cell_degrees_ > 0.0)) {
+        throw std::invalid_argument{ "raster cell size must be positive: " + std::to_string( cell_degrees ) };
+    }
+
+    int64_t rows = std::max<int64_t>( row( ne_.lat ), 0 ) + 1;
+    int64_t cols = std::max<int64_t>( col( ne_.lon ), 0 ) + 1;
+    if (static_cast<uint64_t>( rows ) * static_cast<uint64_t>( cols ) > kMaxCells) {
+        throw std::invalid_argument{ "raster cell size is too small for the region: " + std::to_string( cell_degrees ) };
+    }
+
+    rows_ = static_cast<uint32_t>( rows );
+    cols_ = static_cast<uint32_t>( cols );
+    cells_.assign( (static_cast<uint64_t>( rows_ ) * cols_ + 31) / 32, 0 );
+
+    // entities held by several leaves are rasterized once per leaf; only the leaf covering a cell can make it inside.
+    std::vector<const Quad*> pending{ &quad };
+
+    while (!pending.empty()) {
+        const Quad* node = pending.back();
+        pending.pop_back();
+
+        if (node->haschildren()) {
+            for (auto& child : node->get_children()) {
+                pending.push_back( child.get() );
+            }
+        } else {
+            rasterize_leaf( quad, *node );
+        }
+    }
+
+    for (uint32_t r = 0; r < rows_; ++r) {
+        for (uint32_t c = 0; c < cols_; ++c) {
+            CellState cell = state( r, c );
+            if (cell == CellState::INSIDE) ++inside_count_;
+            else if (cell == CellState::BOUNDARY) ++boundary_count_;
+        }
+    }
+}
+
+void RasterIndex::rasterize_leaf( const Quad& root, const Quad& leaf )
+{
+    const geo::Entity::PtrList& elements = leaf.get_elements();
+    const std::vector<geo::Corridor>& corridors = leaf.get_corridors();
+
+    auto cell_box = [this] ( int64_t r, int64_t c ) {
+        return CellBox{ sw_.lat + r * cell_degrees_ - kCellPad, sw_.lon + c * cell_degrees_ - kCellPad,
+                        sw_.lat + (r + 1) * cell_degrees_ + kCellPad, sw_.lon + (c + 1) * cell_degrees_ + kCellPad };
+    };
+
+    // a box is only inside when all of it is answered from this leaf; see Quad::retrieve_leaf.
+    auto within_leaf = [&root, &leaf] ( const CellBox& box ) {
+        return root.retrieve_leaf( geo::Point{ box.min_lat, box.min_lon } ) == &leaf &&
+               root.retrieve_leaf( geo::Point{ box.min_lat, box.max_lon } ) == &leaf &&
+               root.retrieve_leaf( geo::Point{ box.max_lat, box.min_lon } ) == &leaf &&
+               root.retrieve_leaf( geo::Point{ box.max_lat, box.max_lon } ) == &leaf;
+    };
+
+    // visit the cells overlapping a box; the whole box, not just this leaf, so outside cells are outside for any index.
+    auto for_each_cell = [this] ( double min_lat, double min_lon, double max_lat, double max_lon, std::function<void (int64_t, int64_t)> visit ) {
+        int64_t row_begin = std::max<int64_t>( row( min_lat ), 0 );
+        int64_t row_end = std::min<int64_t>( row( max_lat ), rows_ - 1 );
+        int64_t col_begin = std::max<int64_t>( col( min_lon ), 0 );
+        int64_t col_end = std::min<int64_t>( col( max_lon ), cols_ - 1 );
+
+        for (int64_t r = row_begin; r <= row_end; ++r) {
+            for (int64_t c = col_begin; c <= col_end; ++c) {
+                visit( r, c );
+            }
+        }
+    };
+
+    for (std::size_t i = 0; i < elements.size(); ++i) {
+        const geo::Entity& entity = *elements[i];
+
+        switch (entity.get_entity_type()) {
+            case geo::EntityType::EDGE:
+            {
+                const geo::Corridor& corridor = corridors[i];
+                if (corridor.empty()) break;
+
+                for_each_cell( corridor.min_lat, corridor.min_lon, corridor.max_lat, corridor.max_lon, [&] ( int64_t r, int64_t c ) {
+                    CellBox box = cell_box( r, c );
+
+                    bool inside = corridor.min_lat <= box.min_lat && box.max_lat <= corridor.max_lat &&
+                                  corridor.min_lon <= box.min_lon && box.max_lon <= corridor.max_lon;
+
+                    for (int e = 0; e < 4; ++e) {
+                        int sign = edge_sign( corridor.a[e], corridor.b[e], corridor.c[e], box, kMargin );
+                        if (sign < 0) return;                       // the whole cell is outside this corridor.
+                        if (sign == 0) inside = false;
+                    }
+
+                    if (inside && state( r, c ) != CellState::INSIDE && within_leaf( box )) {
+                        raise( r, c, CellState::INSIDE );
+                    } else {
+                        raise( r, c, CellState::BOUNDARY );
+                    }
+                });
+                break;
+            }
+
+            case geo::EntityType::CIRCLE:
+            {
+                geo::Bounds bounds = static_cast<const geo::Circle&>( entity ).containment_bounds();
+
+                for_each_cell( bounds.sw.lat, bounds.sw.lon, bounds.ne.lat, bounds.ne.lon, [&] ( int64_t r, int64_t c ) {
+                    raise( r, c, CellState::BOUNDARY );
+                });
+                break;
+            }
+
+            case geo::EntityType::GRID:
+            {
+                const geo::Grid& grid = static_cast<const geo::Grid&>( entity );
+
+                for_each_cell( grid.sw.lat, grid.sw.lon, grid.ne.lat, grid.ne.lon, [&] ( int64_t r, int64_t c ) {
+                    CellBox box = cell_box( r, c );
+
+                    bool inside = grid.sw.lat <= box.min_lat && box.max_lat <= grid.ne.lat &&
+                                  grid.sw.lon <= box.min_lon && box.max_lon <= grid.ne.lon;
+
+                    if (inside && state( r, c ) != CellState::INSIDE && within_leaf( box )) {
+                        raise( r, c, CellState::INSIDE );
+                    } else {
+                        raise( r, c, CellState::BOUNDARY );
+                    }
+                });
+                break;
+            }
+
+            default:
+                // other entities are not part of the geofence.
+                break;
+        }
+    }
+}
+
+void RasterIndex::raise( uint32_t row, uint32_t col, CellState state )
+{
+    uint64_t cell = static_cast<uint64_t>( row ) * cols_ + col;
+    uint64_t& word = cells_[cell >> 5];
+    unsigned shift = static_cast<unsigned>( cell & 31 ) * 2;
+    uint64_t code = static_cast<uint64_t>( state );
+
+    if (((word >> shift) & 0x3) < code) {
+        word = (word & ~(uint64_t{ 0x3 } << shift)) | (code << shift);
+    }
+}
+
+RasterIndex::CellState RasterIndex::state( uint32_t row, uint32_t col ) const
+{
+    uint64_t cell = static_cast<uint64_t>( row ) * cols_ + col;
+    return static_cast<CellState>( (cells_[cell >> 5] >> ((cell & 31) * 2)) & 0x3 );
+}
+
+int64_t RasterIndex::row( double lat ) const
+{
+    // clamp before converting so points far outside the raster cannot overflow.
+    double r = std::floor( (lat - sw_.lat) / cell_degrees_ );
+    return static_cast<int64_t>( std::max( -1.0, std::min( r, 4294967296.0 ) ) );
+}
+
+int64_t RasterIndex::col( double lon ) const
+{
+    double c = std::floor( (lon - sw_.lon) / cell_degrees_ );
+    return static_cast<int64_t>( std::max( -1.0, std::min( c, 4294967296.0 ) ) );
+}
+
+RasterIndex::CellState RasterIndex::retrieve_state( const geo::Point& pt ) const
+{
+    if (!(sw_.lat <= pt.lat && pt.lat <= ne_.lat && sw_.lon <= pt.lon && pt.lon <= ne_.lon)) return CellState::BOUNDARY;
+
+    return state( static_cast<uint32_t>( row( pt.lat ) ), static_cast<uint32_t>( col( pt.lon ) ) );
+}
+
+bool RasterIndex::is_within_entity( const geo::Point& pt ) const
+{
+    switch (retrieve_state( pt )) {
+        case CellState::INSIDE:
+            return true;
+
+        case CellState::OUTSIDE:
+            return false;
+
+        default:
+            return exact_ && exact_->is_within_entity( pt );
+    }
+}
+
+bool RasterIndex::is_within_entity( const geo::Point& pt, Hint& hint ) const
+{
+    hint.leaf_hit = false;
+    hint.entity_hit = false;
+
+    switch (retrieve_state( pt )) {
+        case CellState::INSIDE:
+            return true;
+
+        case CellState::OUTSIDE:
+            return false;
+
+        default:
+            return exact_ && exact_->is_within_entity( pt, hint );
+    }
+}
+
+uint64_t RasterIndex::count( CellState state ) const
+{
+    switch (state) {
+        case CellState::INSIDE:
+            return inside_count_;
+
+        case CellState::BOUNDARY:
+            return boundary_count_;
+
+        default:
+            return static_cast<uint64_t>( rows_ ) * cols_ - inside_count_ - boundary_count_;
+    }
+}
+
+double RasterIndex::get_cell_degrees() const
+{
+    return cell_degrees_;
+}
+
+uint32_t RasterIndex::get_rows() const
+{
+    return rows_;
+}
+
+uint32_t RasterIndex::get_cols() const
+{
+    return cols_;
+}
+
+std::size_t RasterIndex::bytes() const
+{
+    return cells_.size() * sizeof(uint64_t);
+}
+
+const GeofenceIndex::CPtr& RasterIndex::get_exact_index() const
+{
+    return exact_;
+}
@@ -0,0 +1,166 @@
+/**
+ * @file
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems, UT Battelle.
+ */
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "roadgraph.hpp"
+
+constexpr uint32_t RoadGraph::kNoVertex;
+
+RoadGraph::RoadGraph() :
+    nodes_{},
+    links_{},
+    ways_{ std::string{} },
+    offsets_{ 0 },
+    adjacency_{},
+    by_uid_{}
+{}
+
+RoadGraph::RoadGraph( std::vector<Node> nodes, std::vector<Link> links, std::vector<std::string> ways ) :
+    nodes_{ std::move( nodes ) },
+    links_{ std::move( links ) },
+    ways_{ std::move( ways ) },
+    offsets_( nodes_.size() + 1, 0 ),
+    adjacency_( 2 * links_.size() ),
+    by_uid_( nodes_.size() )
+{
+    if (nodes_.size() >= kNoVertex || links_.size() >= kNoVertex) {
+        throw std::invalid_argument{ "road graph too large" };
+    }
+
+    if (ways_.empty() || !ways_[0].empty()) {
+        throw std::invalid_argument{ "road graph way 0 must be the empty way id" };
+    }
+
+    // count the edges of each vertex, then place them with a running offset; the edges of a vertex stay in edge order.
+    for (auto& link : links_) {
+        if (link.source >= nodes_.size() || link.target >= nodes_.size() || link.way >= ways_.size()) {
+            throw std::invalid_argument{ "road graph edge " + std::to_string( link.uid ) + " refers to a missing vertex or way" };
+        }
+
+        if (link.source == link.target) {
+            throw std::invalid_argument{ "road graph edge " + std::to_string( link.uid ) + " starts and ends at the same vertex" };
+        }
+
+        ++offsets_[link.source + 1];
+        ++offsets_[link.target + 1];
+    }
+
+    for (std::size_t v = 0; v < nodes_.size(); ++v) {
+        offsets_[v + 1] += offsets_[v];
+    }
+
+    std::vector<uint32_t> next{ offsets_.begin(), offsets_.end() - 1 };
+    for (uint32_t e = 0; e < links_.size(); ++e) {
+        adjacency_[next[links_[e].source]++] = e;
+        adjacency_[next[links_[e].target]++] = e;
+    }
+
+    for (uint32_t v = 0; v < nodes_.size(); ++v) {
+        by_uid_[v] = v;
+    }
+
+    std::sort( by_uid_.begin(), by_uid_.end(), [this]( uint32_t a, uint32_t b ) { return nodes_[a].uid < nodes_[b].uid; } );
+
+    auto same_uid = [this]( uint32_t a, uint32_t b ) { return nodes_[a].uid == nodes_[b].uid; };
+    if (std::adjacent_find( by_uid_.begin(), by_uid_.end(), same_uid ) != by_uid_.end()) {
+        throw std::invalid_argument{ "road graph vertices must have unique identifiers" };
+    }
+}
+
+std::size_t RoadGraph::vertex_count() const
+{
+    return nodes_.size();
+}
+
+std::size_t RoadGraph::edge_count() const
+{
+    return links_.size();
+}
+
+const RoadGraph::Node& RoadGraph::vertex( uint32_t v ) const
+{
+    return nodes_[v];
+}
+
+const RoadGraph::Link& RoadGraph::edge( uint32_t e ) const
+{
+    return links_[e];
+}
+
+const std::string& RoadGraph::way( uint32_t e ) const
+{
+    return ways_[links_[e].way];
+}
+
+uint32_t RoadGraph::degree( uint32_t v ) const
+{
+    return offsets_[v + 1] - offsets_[v];
+}
+
+RoadGraph::Range RoadGraph::incident( uint32_t v ) const
+{
+    return Range{ adjacency_.data() + offsets_[v], adjacency_.data() + offsets_[v + 1] };
+}
+
+uint32_t RoadGraph::opposite( uint32_t e, uint32_t v ) const
+{
+    return links_[e].source == v ? links_[e].target : links_[e].source;
+}
+
+uint32_t RoadGraph::find( uint64_t uid ) const
+{
+    auto found = std::lower_bound( by_uid_.begin(), by_uid_.end(), uid,
+                                   [this]( uint32_t v, uint64_t key ) { return nodes_[v].uid < key; } );
+
+    return found != by_uid_.end() && nodes_[*found].uid == uid ? *found : kNoVertex;
+}
+
+void RoadGraph::make_edges( std::vector<geo::EdgeCPtr>& edges, std::vector<std::string>& ways ) const
+{
+    edges.clear();
+    ways.clear();
+    edges.reserve( links_.size() );
+    ways.reserve( links_.size() );
+
+    std::vector<geo::Vertex::Ptr> vertices( nodes_.size() );
+    auto vertex_of = [&]( uint32_t v ) -> const geo::Vertex::Ptr& {
+        if (!vertices[v]) {
+            vertices[v] = std::make_shared<geo::Vertex>( nodes_[v].lat, nodes_[v].lon, nodes_[v].uid );
+        }
+        return vertices[v];
+    };
+
+    for (auto& link : links_) {
+        edges.push_back( std::make_shared<const geo::Edge>( vertex_of( link.source ), vertex_of( link.target ),
+                                                            link.way_type, link.uid ) );
+        ways.push_back( ways_[link.way] );
+    }
+}
+
+std::size_t RoadGraph::memory_bytes() const
+{
+    return nodes_.capacity() * sizeof(Node) + links_.capacity() * sizeof(Link) +
+           ways_.capacity() * sizeof(std::string) + offsets_.capacity() * sizeof(uint32_t) +
+           adjacency_.capacity() * sizeof(uint32_t) + by_uid_.capacity() * sizeof(uint32_t);
+}
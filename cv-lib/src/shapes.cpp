@@ -24,8 +24,19 @@
  */
 
 #include <algorithm>
+#include <cstring>
+#include <exception>
 #include <fstream>
 #include <iomanip>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "shapes.hpp"
 #include "osm.hpp"
@@ -35,6 +46,353 @@ namespace shapes {
 
 using StreamPtr = std::shared_ptr<std::istream>;
 
+namespace {
+
+constexpr std::size_t kMinChunkBytes = 1 << 16;                    ///< load_shapes does not split a file into smaller chunks.
+
+/**
+ * @brief A range of characters of the mapped shape file; fields are sliced out of it without being copied.
+ */
+struct Slice {
+    const char* begin;
+    const char* end;
+
+    std::size_t size() const { return static_cast<std::size_t>( end - begin ); }
+    bool empty() const { return begin == end; }
+    std::string str() const { return std::string{ begin, end }; }
+
+    bool operator==( const char* text ) const {
+        std::size_t length = std::strlen( text );
+        return size() == length && std::memcmp( begin, text, length ) == 0;
+    }
+};
+
+using Slices = std::vector<Slice>;
+
+/**
+ * @brief Split text at every occurrence of delim the way string_utilities::split does: an empty last field is dropped.
+ */
+void split( const Slice& text, char delim, Slices& fields )
+{
+    fields.clear();
+
+    const char* begin = text.begin;
+    for (const char* p = text.begin; p != text.end; ++p) {
+        if (*p == delim) {
+            fields.push_back( Slice{ begin, p } );
+            begin = p + 1;
+        }
+    }
+
+    if (begin != text.end) {
+        fields.push_back( Slice{ begin, text.end } );
+    }
+}
+
+/**
+ * @brief Remove the string_utilities::DELIMITERS whitespace surrounding text.
+ */
+Slice strip( Slice text )
+{
+    auto space = []( char c ) { return c == ' ' || (c >= '\t' && c <= '\r'); };
+
+    while (!text.empty() && space( *text.begin )) ++text.begin;
+    while (!text.empty() && space( *(text.end - 1) )) --text.end;
+    return text;
+}
+
+/**
+ * @brief Convert a field to an unsigned integer; the same value and exceptions as std::stoull.
+ */
+uint64_t to_uint64( const Slice& field )
+{
+    // plain digits that cannot overflow; anything else (space, sign, overflow, garbage) is left to std::stoull.
+    if (!field.empty() && field.size() < 20) {
+        uint64_t value = 0;
+        const char* p = field.begin;
+        for (; p != field.end && *p >= '0' && *p <= '9'; ++p) {
+            value = value * 10 + static_cast<uint64_t>( *p - '0' );
+        }
+
+        if (p == field.end) return value;
+    }
+
+    return std::stoull( field.str() );
+}
+
+/**
+ * @brief Convert a field to a double; the same value and exceptions as std::stod.
+ *
+ * A decimal with at most 19 digits whose digits form an integer below 2^53 and which has at most 22 fraction digits
+ * is that integer divided by a power of ten; both are exact doubles, so the one correctly rounded division gives the
+ * correctly rounded value strtod does. Every coordinate of an OSM extract takes this path; anything else (exponents,
+ * long fractions, hexadecimal, garbage) is left to std::stod.
+ */
+double to_double( const Slice& field )
+{
+    static const double kPowersOfTen[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char* p = field.begin;
+    bool negative = false;
+    if (p != field.end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int fraction = 0;
+    bool point = false;
+    for (; p != field.end; ++p) {
+        if (*p >= '0' && *p <= '9') {
+            if (++digits > 19) break;
+            mantissa = mantissa * 10 + static_cast<uint64_t>( *p - '0' );
+            if (point) ++fraction;
+        } else if (*p == '.' && !point) {
+            point = true;
+        } else {
+            break;
+        }
+    }
+
+    if (p == field.end && digits > 0 && mantissa <= (uint64_t{ 1 } << 53) && fraction <= 22) {
+        double value = static_cast<double>( mantissa ) / kPowersOfTen[fraction];
+        return negative ? -value : value;
+    }
+
+    return std::stod( field.str() );
+}
+
+/**
+ * @brief Throw out_of_range for a latitude outside of the map.
+ */
+void check_latitude( double lat )
+{
+    if (lat > 80.0 || lat < -84.0) {
+        throw std::out_of_range{ "bad latitude: " + std::to_string(lat) };
+    }
+}
+
+/**
+ * @brief Throw out_of_range for a longitude outside of the map.
+ */
+void check_longitude( double lon )
+{
+    if (lon >= 180.0 || lon <= -180.0) {
+        throw std::out_of_range{"bad longitude: " + std::to_string(lon) };
+    }
+}
+
+/**
+ * @brief One line of a shape file after parsing; load_shapes turns it into a shape, in file order.
+ */
+struct ShapeSpec {
+    enum class Kind { MESSAGE, CIRCLE, EDGE, GRID, REMOVE_EDGE, REMOVE_CIRCLE };
+
+    Kind kind = Kind::MESSAGE;
+    std::string message;                                ///< Displayed on std::cerr when not empty; an edge is then not added.
+    geo::Circle::CPtr circle;                           ///< The circle of a CIRCLE.
+    geo::Grid::CPtr grid;                               ///< The grid of a GRID.
+    uint64_t uid = 0;                                   ///< The identifier of an EDGE or of the removed shape.
+    osm::Highway way_type = osm::Highway::OTHER;        ///< The way type of an EDGE.
+    std::string way_id;                                 ///< The way id of an EDGE; empty when not given.
+    int points = 0;                                     ///< The vertices of an EDGE parsed before the message, if any.
+    uint64_t vertex_ids[2];                             ///< The vertex identifiers of an EDGE.
+    double lats[2];                                     ///< The vertex latitudes of an EDGE.
+    double lons[2];                                     ///< The vertex longitudes of an EDGE.
+};
+
+/**
+ * @brief Parse the lines of a shape file with the checks of the CSVInputFactory make_<shape> methods. Vertices depend
+ * on the edges before them, so an edge is only parsed here and made by load_shapes.
+ */
+class ShapeParser {
+    public:
+        /**
+         * @brief Parse one line, without its newline, into spec; return false for a line that is ignored.
+         */
+        bool parse( const Slice& line, ShapeSpec& spec )
+        {
+            split( line, ',', parts_ );
+
+            if (parts_.size() < 3 || parts_.size() > 4) {
+                spec.message = "Too few or too many elements in shape specification: " + std::to_string( parts_.size() ) + " fields.";
+                return true;
+            }
+
+            try {
+                const Slice& type = parts_[SHAPE_TYPE];
+
+                if (type == "circle") {
+                    parse_circle( spec );
+                } else if (type == "edge") {
+                    parse_edge( spec );
+                } else if (type == "grid") {
+                    parse_grid( spec );
+                } else if (type == "remove") {
+                    parse_removal( spec );
+                } else {
+                    return false;
+                }
+
+            } catch (std::exception& e) {
+                spec.message = std::string{ "Failed to make shape: " } + e.what();
+            }
+
+            return true;
+        }
+
+    private:
+        Slices parts_;                                  ///< The fields of the line; reused so parsing does not allocate.
+        Slices fields_;                                 ///< The fields of one part.
+        Slices items_;                                  ///< The fields of one field.
+
+        void parse_circle( ShapeSpec& spec )
+        {
+            uint64_t uid = to_uint64( parts_[SHAPE_ID] );
+
+            split( parts_[SHAPE_GEOGRAPHY], ':', fields_ );
+
+            if (fields_.size() != 3) {
+                throw std::out_of_range{ "wrong number of elements for circle center: " + std::to_string( fields_.size() ) };
+            }
+
+            double lat = to_double( fields_[0] );
+            check_latitude( lat );
+
+            double lon = to_double( fields_[1] );
+            check_longitude( lon );
+
+            double radius = to_double( fields_[2] );
+
+            if (radius < 0.0) {
+                throw std::out_of_range{"bad radius: " + std::to_string(radius) };
+            }
+
+            spec.kind = ShapeSpec::Kind::CIRCLE;
+            spec.circle = std::make_shared<geo::Circle>( lat, lon, uid, radius );
+        }
+
+        void parse_edge( ShapeSpec& spec )
+        {
+            spec.kind = ShapeSpec::Kind::EDGE;
+
+            // Attributes must be processed first (if they exist) so we pickup the specified way_type.
+            if (parts_.size() > 3) {
+                split( parts_[SHAPE_ATTS], ':', fields_ );
+
+                // the last value of each attribute wins, as in the map make_edge builds.
+                Slice way_type{ nullptr, nullptr };
+                Slice way_id{ nullptr, nullptr };
+                for (auto& att : fields_) {
+                    const char* equals = static_cast<const char*>( std::memchr( att.begin, '=', att.size() ) );
+                    if (!equals) continue;
+
+                    Slice key = strip( Slice{ att.begin, equals } );
+                    Slice value = strip( Slice{ equals + 1, att.end } );
+                    if (key.empty() || value.empty()) continue;
+
+                    if (key == "way_type") {
+                        way_type = value;
+                    } else if (key == "way_id") {
+                        way_id = value;
+                    }
+                }
+
+                if (!way_type.empty()) {
+                    // map uses all lower case.
+                    std::string name = way_type.str();
+                    std::transform( name.begin(), name.end(), name.begin(), ::tolower );
+                    auto s2 = osm::highway_map.find( name );
+                    if (s2 != osm::highway_map.end()) {
+                        spec.way_type = s2->second;
+                    }
+                }
+
+                spec.way_id = way_id.str();
+
+                if (osm::highway_blacklist.find( spec.way_type ) != osm::highway_blacklist.end()) {
+                    // this edge type should be ignored since it is in the blacklist.
+                    throw osm::invalid_way_exception{ spec.way_type };
+                }
+            }
+
+            spec.uid = to_uint64( parts_[SHAPE_ID] );
+            split( parts_[SHAPE_GEOGRAPHY], ':', fields_ );
+
+            if (fields_.size() != 2) {
+                throw std::out_of_range{ "too many or too few points to define an edge: " + std::to_string(fields_.size()) };
+            }
+
+            for (int pi = 0; pi < 2; ++pi) {
+                split( fields_[pi], ';', items_ );
+
+                if (items_.size() != 3) {
+                    throw std::out_of_range{ "too many or too few elements to define a point: " + std::to_string(items_.size()) };
+                }
+
+                spec.vertex_ids[pi] = to_uint64( items_[POINT_ID] );
+                spec.lats[pi] = to_double( items_[POINT_LAT] );
+                spec.lons[pi] = to_double( items_[POINT_LON] );
+                spec.points = pi + 1;
+            }
+        }
+
+        void parse_grid( ShapeSpec& spec )
+        {
+            split( parts_[SHAPE_ID], '_', items_ );
+
+            if (items_.size() != 2) {
+                throw std::out_of_range("geo::Grid missing row/col fields.");
+            }
+
+            uint32_t row = static_cast<uint32_t>( to_uint64( items_[0] ) );
+            uint32_t col = static_cast<uint32_t>( to_uint64( items_[1] ) );
+
+            split( parts_[SHAPE_GEOGRAPHY], ':', fields_ );
+
+            if (fields_.size() != 4) {
+                throw std::out_of_range("geo::Grid missing bounds data.");
+            }
+
+            double sw_lat = to_double( fields_[0] );
+            double sw_lon = to_double( fields_[1] );
+            double ne_lat = to_double( fields_[2] );
+            double ne_lon = to_double( fields_[3] );
+
+            check_latitude( sw_lat );
+            check_longitude( sw_lon );
+            check_latitude( ne_lat );
+            check_longitude( ne_lon );
+
+            geo::Bounds bounds(geo::Point(sw_lat, sw_lon), geo::Point(ne_lat, ne_lon));
+            spec.kind = ShapeSpec::Kind::GRID;
+            spec.grid = std::make_shared<const geo::Grid>( bounds, row, col );
+        }
+
+        void parse_removal( ShapeSpec& spec )
+        {
+            if (parts_.size() != 3) {
+                throw std::invalid_argument("wrong number of components to remove a shape: " + std::to_string(parts_.size()) + "; requires 3." );
+            }
+
+            spec.uid = to_uint64( parts_[2] );
+
+            if (parts_[1] == "edge") {
+                spec.kind = ShapeSpec::Kind::REMOVE_EDGE;
+            } else if (parts_[1] == "circle") {
+                spec.kind = ShapeSpec::Kind::REMOVE_CIRCLE;
+            } else {
+                throw std::invalid_argument("only edges and circles can be removed: " + parts_[1].str());
+            }
+        }
+};
+
+}  // end namespace.
+
 CSVInputFactory::CSVInputFactory() :
     file_path_{}
 {}
@@ -58,6 +416,7 @@ void CSVInputFactory::make_edge(const StrVector& line_parts) {
     uint64_t edge_id;
     uint64_t vertex_id;
     osm::Highway way_type{osm::Highway::OTHER};                     // default value.
+    std::string way_id;                                             // empty when not given.
 
     if ( line_parts.size() < 3) {
         // lines cannot be defined without points.
@@ -93,6 +452,11 @@ void CSVInputFactory::make_edge(const StrVector& line_parts) {
             } // othewise, use the default value.
         }
 
+        auto s3 = atts.find("way_id");
+        if ( s3 != atts.end() ) {
+            way_id = s3->second;
+        }
+
         auto blacklist_item = osm::highway_blacklist.find( way_type );
         if (blacklist_item != osm::highway_blacklist.end()) {
             // this edge type should be ignored since it is in the blacklist.
@@ -124,31 +488,34 @@ void CSVInputFactory::make_edge(const StrVector& line_parts) {
         lat = std::stod( point_parts[POINT_LAT] );                  // throws.
         lon = std::stod( point_parts[POINT_LON] );                  // throws.
 
-        auto element_item = vertex_map_.find(vertex_id);
-        if (element_item != vertex_map_.end()) {
-            // point already defined; use existing instance.
-            // needed because we have an incident edge list.
-            vp[pi] = vertex_map_[vertex_id];
-            if ( !double_utilities::are_equal(vp[pi]->lat, lat, geo::kGPSEpsilon) || !double_utilities::are_equal(vp[pi]->lon, lon, geo::kGPSEpsilon)) {
-                std::cerr << "WARNING: identical vertex id with different coordinates!\n";
-            }
+        vp[pi] = make_vertex( vertex_id, lat, lon );
+    }
 
-        } else {
-            // point must be instantiated.
+    add_edge( vp, way_type, edge_id, way_id );
+}
 
-            if (lat > 80.0 || lat < -84.0) {
-                throw std::out_of_range{ "bad latitude: " + std::to_string(lat) };
-            }
+geo::Vertex::Ptr CSVInputFactory::make_vertex(uint64_t vertex_id, double lat, double lon) {
+    auto element_item = vertex_map_.find(vertex_id);
+    if (element_item != vertex_map_.end()) {
+        // point already defined; use existing instance.
+        // needed because we have an incident edge list.
+        const geo::Vertex::Ptr& vertex = element_item->second;
+        if ( !double_utilities::are_equal(vertex->lat, lat, geo::kGPSEpsilon) || !double_utilities::are_equal(vertex->lon, lon, geo::kGPSEpsilon)) {
+            std::cerr << "WARNING: identical vertex id with different coordinates!\n";
+        }
+        return vertex;
+    }
 
-            if (lon >= 180.0 || lon <= -180.0) {
-                throw std::out_of_range{"bad longitude: " + std::to_string(lon) };
-            }
+    // point must be instantiated.
+    check_latitude( lat );
+    check_longitude( lon );
 
-            vp[pi] = std::make_shared<geo::Vertex>(lat,lon,vertex_id);  
-            vertex_map_[vertex_id] = vp[pi];
-        }    
-    }
+    geo::Vertex::Ptr vertex = std::make_shared<geo::Vertex>(lat,lon,vertex_id);
+    vertex_map_[vertex_id] = vertex;
+    return vertex;
+}
 
+void CSVInputFactory::add_edge(const geo::Vertex::Ptr (&vp)[2], osm::Highway way_type, uint64_t edge_id, const std::string& way_id) {
     if ( vp[0]->uid == vp[1]->uid ) {
         throw std::invalid_argument("The identifiers for the edges points are the same.");
     }
@@ -158,6 +525,7 @@ void CSVInputFactory::make_edge(const StrVector& line_parts) {
     vp[0]->add_edge( edge_ptr );
     vp[1]->add_edge( edge_ptr );
     edges_.push_back(edge_ptr);
+    edge_ways_.push_back(way_id);
 }
 
 void CSVInputFactory::make_circle(const StrVector& line_parts) 
@@ -260,6 +628,28 @@ void CSVInputFactory::make_grid(const StrVector& line_parts) {
     grids_.push_back(grid_ptr); 
 }
 
+void CSVInputFactory::make_removal(const StrVector& line_parts) {
+
+    // Removal Specification:
+    // - line_parts[0] : "remove"
+    // - line_parts[1] : "edge" or "circle"
+    // - line_parts[2] : unique 64-bit integer identifier
+    //
+    if ( line_parts.size() != 3) {
+        throw std::invalid_argument("wrong number of components to remove a shape: " + std::to_string(line_parts.size()) + "; requires 3." );
+    }
+
+    uint64_t uid = std::stoull(line_parts[2]);
+
+    if (line_parts[1] == "edge") {
+        removed_edges_.insert(uid);
+    } else if (line_parts[1] == "circle") {
+        removed_circles_.insert(uid);
+    } else {
+        throw std::invalid_argument("only edges and circles can be removed: " + line_parts[1]);
+    }
+}
+
 void CSVInputFactory::make_shapes() {
     std::string line;
     std::ifstream file(file_path_);
@@ -292,6 +682,8 @@ void CSVInputFactory::make_shapes() {
                 make_edge(parts);
             } else if (type == "grid") {
                 make_grid(parts);
+            } else if (type == "remove") {
+                make_removal(parts);
             }
 
         } catch (std::exception& e) {
@@ -304,6 +696,201 @@ void CSVInputFactory::make_shapes() {
     file.close();
 }
 
+void CSVInputFactory::load_shapes(unsigned threads) {
+    load( threads, nullptr );
+}
+
+RoadGraph CSVInputFactory::load_graph(unsigned threads) {
+    RoadGraph graph;
+    load( threads, &graph );
+    return graph;
+}
+
+void CSVInputFactory::load(unsigned threads, RoadGraph* graph) {
+    int fd = ::open( file_path_.c_str(), O_RDONLY );
+    if (fd < 0) {
+        throw std::invalid_argument("Could not open shape file: " + file_path_);
+    }
+
+    std::shared_ptr<const char> text;
+    std::size_t size = 0;
+
+    struct stat status;
+    if (::fstat( fd, &status ) == 0 && S_ISREG( status.st_mode ) && status.st_size > 0) {
+        size = static_cast<std::size_t>( status.st_size );
+        void* map = ::mmap( nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+
+        if (map != MAP_FAILED) {
+            text.reset( static_cast<const char*>( map ), [size] ( const char* base ) { ::munmap( const_cast<char*>( base ), size ); } );
+            ::madvise( map, size, MADV_SEQUENTIAL );
+        }
+    }
+    ::close( fd );
+
+    if (!text) {
+        // a pipe, or a file that cannot be mapped: read it instead.
+        std::ifstream file(file_path_);
+        auto buffer = std::make_shared<std::string>( std::istreambuf_iterator<char>( file ), std::istreambuf_iterator<char>() );
+        text = std::shared_ptr<const char>( buffer, buffer->data() );
+        size = buffer->size();
+    }
+
+    if (size == 0) {
+        throw std::invalid_argument("Shape file missing header!");
+    }
+
+    const char* end = text.get() + size;
+
+    // Skip the header.
+    const char* body = static_cast<const char*>( std::memchr( text.get(), '\n', size ) );
+    body = body ? body + 1 : end;
+
+    if (threads == 0) {
+        threads = std::max( 1u, std::thread::hardware_concurrency() );
+    }
+
+    // Chunks of whole lines; each starts after the first newline at or past an equal share of the body.
+    std::size_t chunks = std::min<std::size_t>( threads, static_cast<std::size_t>( end - body ) / kMinChunkBytes + 1 );
+    std::vector<const char*> starts{ body };
+    for (std::size_t c = 1; c < chunks; ++c) {
+        const char* start = body + static_cast<std::size_t>( end - body ) * c / chunks;
+        if (start > starts.back()) {
+            const char* newline = static_cast<const char*>( std::memchr( start - 1, '\n', end - start + 1 ) );
+            start = newline ? newline + 1 : end;
+        }
+        starts.push_back( std::max( start, starts.back() ) );
+    }
+    starts.push_back( end );
+
+    std::vector<std::vector<ShapeSpec>> specs( chunks );
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto parse_chunk = [&]( std::size_t c ) {
+        try {
+            ShapeParser parser;
+            const char* line = starts[c];
+            while (line < starts[c + 1]) {
+                const char* newline = static_cast<const char*>( std::memchr( line, '\n', starts[c + 1] - line ) );
+                const char* line_end = newline ? newline : starts[c + 1];
+
+                specs[c].emplace_back();
+                if (!parser.parse( Slice{ line, line_end }, specs[c].back() )) {
+                    specs[c].pop_back();
+                }
+
+                line = newline ? newline + 1 : starts[c + 1];
+            }
+        } catch ( ... ) {
+            std::lock_guard<std::mutex> lock{ error_mutex };
+            if (!error) error = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (std::size_t c = 1; c < chunks; ++c) {
+        pool.emplace_back( parse_chunk, c );
+    }
+    parse_chunk( 0 );
+
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    if (error) std::rethrow_exception( error );
+
+    // The vertices and way ids of a graph; the index of a way id is its position in ways.
+    std::vector<RoadGraph::Node> nodes;
+    std::vector<RoadGraph::Link> links;
+    std::vector<std::string> ways{ std::string{} };
+    std::unordered_map<uint64_t, uint32_t> node_index;
+    std::unordered_map<std::string, uint32_t> way_index{ { std::string{}, 0 } };
+
+    // make_vertex for a graph.
+    auto make_node = [&]( uint64_t vertex_id, double lat, double lon ) {
+        auto found = node_index.find( vertex_id );
+        if (found != node_index.end()) {
+            const RoadGraph::Node& node = nodes[found->second];
+            if ( !double_utilities::are_equal(node.lat, lat, geo::kGPSEpsilon) || !double_utilities::are_equal(node.lon, lon, geo::kGPSEpsilon)) {
+                std::cerr << "WARNING: identical vertex id with different coordinates!\n";
+            }
+            return found->second;
+        }
+
+        check_latitude( lat );
+        check_longitude( lon );
+
+        uint32_t index = static_cast<uint32_t>( nodes.size() );
+        nodes.push_back( RoadGraph::Node{ vertex_id, lat, lon } );
+        node_index.emplace( vertex_id, index );
+        return index;
+    };
+
+    // Merge in file order; vertices are shared by the edges that use them, so they are made here.
+    for (auto& chunk : specs) {
+        for (auto& spec : chunk) {
+            switch (spec.kind) {
+                case ShapeSpec::Kind::MESSAGE:
+                    std::cerr << spec.message << std::endl;
+                    break;
+
+                case ShapeSpec::Kind::CIRCLE:
+                    circles_.push_back( std::move( spec.circle ) );
+                    break;
+
+                case ShapeSpec::Kind::GRID:
+                    grids_.push_back( std::move( spec.grid ) );
+                    break;
+
+                case ShapeSpec::Kind::REMOVE_EDGE:
+                    removed_edges_.insert( spec.uid );
+                    break;
+
+                case ShapeSpec::Kind::REMOVE_CIRCLE:
+                    removed_circles_.insert( spec.uid );
+                    break;
+
+                case ShapeSpec::Kind::EDGE:
+                    try {
+                        // the vertices parsed before a bad one are made, as make_edge makes them.
+                        geo::Vertex::Ptr vp[2];
+                        uint32_t np[2] = { 0, 0 };
+                        for (int pi = 0; pi < spec.points; ++pi) {
+                            if (graph) {
+                                np[pi] = make_node( spec.vertex_ids[pi], spec.lats[pi], spec.lons[pi] );
+                            } else {
+                                vp[pi] = make_vertex( spec.vertex_ids[pi], spec.lats[pi], spec.lons[pi] );
+                            }
+                        }
+
+                        if (!spec.message.empty()) {
+                            std::cerr << spec.message << std::endl;
+                            break;
+                        }
+
+                        if (!graph) {
+                            add_edge( vp, spec.way_type, spec.uid, spec.way_id );
+                        } else if (np[0] == np[1]) {
+                            throw std::invalid_argument("The identifiers for the edges points are the same.");
+                        } else {
+                            uint32_t way = way_index.emplace( spec.way_id, static_cast<uint32_t>( ways.size() ) ).first->second;
+                            if (way == ways.size()) ways.push_back( spec.way_id );
+                            links.push_back( RoadGraph::Link{ spec.uid, np[0], np[1], spec.way_type, way } );
+                        }
+
+                    } catch (std::exception& e) {
+                        std::cerr << "Failed to make shape: " << e.what() << std::endl;
+                    }
+                    break;
+            }
+        }
+    }
+
+    if (graph) {
+        *graph = RoadGraph{ std::move( nodes ), std::move( links ), std::move( ways ) };
+    }
+}
+
 const std::vector<geo::Circle::CPtr>& CSVInputFactory::get_circles() const {
     return circles_;
 } 
@@ -312,10 +899,22 @@ const std::vector<geo::EdgeCPtr>& CSVInputFactory::get_edges() const {
     return edges_;
 }
 
+const std::vector<std::string>& CSVInputFactory::get_edge_ways() const {
+    return edge_ways_;
+}
+
 const std::vector<geo::Grid::CPtr>& CSVInputFactory::get_grids() const {
     return grids_;
 }
 
+const std::unordered_set<uint64_t>& CSVInputFactory::get_removed_edges() const {
+    return removed_edges_;
+}
+
+const std::unordered_set<uint64_t>& CSVInputFactory::get_removed_circles() const {
+    return removed_circles_;
+}
+
 CSVOutputFactory::CSVOutputFactory(const std::string& file_path) :
     file_path_{file_path}
     {}
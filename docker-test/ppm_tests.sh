@@ -3,3 +3,6 @@ export LD_LIBRARY_PATH=/usr/local/lib
 
 # Start the DI tool.
 /cvdi-stream-build/ppm_tests
+
+# Run the soak tests, which are left out of the default run.
+/cvdi-stream-build/ppm_tests "[soak]"
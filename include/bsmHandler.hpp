@@ -34,10 +34,17 @@
 #include "cvlib.hpp"
 #include "general-redaction/redactionPropertiesManager.hpp"
 #include "general-redaction/rapidjsonRedactor.hpp"
+#include "general-redaction/redactionTrie.hpp"
 #include "bsm.hpp"
 #include "velocityFilter.hpp"
 #include "idRedactor.hpp"
 #include "ppmLogger.hpp"
+#include "geofenceBuilder.hpp"
+#include "geofenceHintCache.hpp"
+#include "privacySnapshot.hpp"
+#include "bsmStreamHandler.hpp"
+#include "bsmPrefilter.hpp"
+#include "jsonArena.hpp"
 
 /**
  * @mainpage
@@ -125,6 +132,8 @@ class BSMHandler {
         static constexpr uint32_t kSizeRedactFlag     = 0x1 << 4;
         static constexpr uint32_t kGeneralRedactFlag  = 0x1 << 8;
 
+        static constexpr double kDefaultBoxExtension = GeofenceBuilder::kDefaultBoxExtension;    ///< Meters edge boxes are extended when privacy.filter.geofence.extension is not set.
+
         // must be static const to compose these flags and use in template specialization.
         static const unsigned flags = rapidjson::kParseDefaultFlags | rapidjson::kParseNumbersAsStringsFlag;
 
@@ -138,32 +147,112 @@ class BSMHandler {
          */
         BSMHandler(Quad::Ptr quad_ptr, const ConfigMap& conf, std::shared_ptr<PpmLogger> logger);
 
+        /**
+         * @brief Replace the geofence index, e.g., with one shared by every handler or mapped from a compiled geofence
+         * file (see GeofenceBuilder::load). The per-vehicle hints for the old index are dropped.
+         *
+         * @param index the index to use for geofence checks; null disables the geofence checks.
+         */
+        void set_geofence_index( GeofenceIndex::CPtr index );
+
+        /**
+         * @brief Switch to the settings of a snapshot: its geofence index, velocity filter, id redactor and general
+         * redaction fields. Called between messages, e.g., when the PrivacyReloader publishes a new snapshot. The
+         * per-vehicle hints are kept unless the geofence index changes.
+         *
+         * @param snapshot the snapshot to use.
+         */
+        void apply( const PrivacySnapshot& snapshot );
+
         /**
          * @brief Predicate indicating whether the BSM's position is within the prescribed geofence.
          *
-         * @todo: entities use string type values; numeric types would be faster.
+         * The check runs against the GeofenceIndex built from the quad tree when the handler is constructed (see
+         * GeofenceBuilder::build_index) or set with set_geofence_index. The privacy.filter.geofence.index property
+         * selects the quad tree itself (quad), a FrozenQuad (frozen, the default) or a GridIndex (grid). With
+         * privacy.filter.geofence.raster ON, a RasterIndex answers most queries first and passes only boundary cells
+         * to that index. Edges are checked against the corridors stored in the quad tree; any edge
+         * inserted without one is given one first.
          *
          * @param bsm the BSM to be checked.
          * @return true if the BSM is within the geofence; false otherwise.
          */
         bool isWithinEntity(BSM &bsm) const;
 
+        /**
+         * @brief Predicate indicating whether the BSM's position is within the prescribed geofence, starting from the
+         * leaf and entity that held the same vehicle's previous position (see GeofenceHintCache). The answer is the
+         * same as isWithinEntity(BSM&).
+         *
+         * @param bsm the BSM to be checked.
+         * @param vehicle_id the identifier of the vehicle that sent the BSM.
+         * @return true if the BSM is within the geofence; false otherwise.
+         */
+        bool isWithinEntity(BSM &bsm, const std::string& vehicle_id);
+
         /** 
          * @brief Process a BSM presented as a JSON string; the string should not have any newlines in it.
          *
          * The result of the processing besides SAX fail/succeed status can be obtained using the #get_result method.
          *
+         * In streaming mode (privacy.parse.streaming, on by default) the message is parsed once by a
+         * BSMStreamHandler that writes the output as it goes; otherwise a DOM is built, changed and written. Both give
+         * the same result, BSM and output. A message the streaming pass cannot decide falls back to the DOM. The DOM
+         * is built in the handler's JsonArena, which is reset after each DOM message.
+         *
+         * With the prefilter on (privacy.parse.prefilter, on by default) and the velocity or geofence filter active, a
+         * BSMPrefilter first scans the message for its speed, position and id. A message the filters suppress is then
+         * given its result and BSM without being parsed; its redacted JSON is not produced, so #get_json still returns
+         * the previous message's. Any other message, or one the scan cannot decide, is processed as above.
+         *
          * @param bsm_json a JSON string of the BSM.  
          * @return true if the SAX parser did not encounter any errors during parsing; false otherwise.
          *
          */
         bool process( const std::string& bsm_json );
+
+        /**
+         * @brief Process a BSM held in a buffer that is not NUL terminated, e.g., a Kafka message payload.
+         *
+         * The message is copied once into a buffer the handler reuses from message to message, and processed from
+         * there as by #process; the DOM path parses that copy in place, so its strings are not copied again.
+         *
+         * @param bsm_json the first byte of the BSM's JSON.
+         * @param length the number of bytes.
+         * @return true if the BSM is retained; false otherwise, as #process.
+         */
+        bool process( const char* bsm_json, std::size_t length );
     
         /**
-         * @brief Handle general redaction of fields, the paths for which are specified in fieldsToRedact.txt
+         * @brief Select streaming mode or DOM mode for #process.
+         *
+         * @param streaming true to parse messages in one streaming pass; false to build a DOM.
+         */
+        void set_stream_parse( bool streaming );
+
+        /**
+         * @return true if #process parses messages in one streaming pass; false if it builds a DOM.
+         */
+        bool is_stream_parse() const;
+
+        /**
+         * @brief Turn the prefilter of #process on or off.
+         *
+         * @param on true to suppress messages from a scan of their bytes when possible.
+         */
+        void set_prefilter( bool on );
+
+        /**
+         * @return true if #process suppresses messages from a scan of their bytes when possible.
+         */
+        bool is_prefilter() const;
+
+        /**
+         * @brief Handle general redaction of fields, the paths for which are specified in fieldsToRedact.txt and
+         * compiled into a RedactionTrie when they are loaded; one walk of the document applies them all.
          *
          */
-        void handleGeneralRedaction(rapidjson::Document& document);
+        void handleGeneralRedaction(rapidjson::Value& document);
 
         /**
          * @brief Return the result of the most recent BSM processing.
@@ -228,6 +317,25 @@ class BSMHandler {
          */
         const double get_box_extension() const;
 
+        /**
+         * @brief for unit testing only.
+         */
+        const GeofenceIndex::CPtr& get_geofence_index() const;
+
+        /**
+         * @brief Return the per-vehicle geofence hints, e.g., to report their hit rates.
+         *
+         * @return a constant reference to the hint cache.
+         */
+        const GeofenceHintCache& get_hint_cache() const;
+
+        /**
+         * @brief Return the arena of the DOM path, e.g., to report its heap allocations.
+         *
+         * @return a constant reference to the arena.
+         */
+        const JsonArena& get_arena() const;
+
         RapidjsonRedactor& getRapidjsonRedactor();
         
     private:
@@ -235,6 +343,7 @@ class BSMHandler {
         // JMC: The leak seems to be caused by re-using the RapidJSON document instance.
         // JMC: We will use a unique instance for each message.
         // rapidjson::Document document_;              ///< JSON DOM
+        JsonArena arena_;                           ///< The memory of each DOM message's document, reset after the message.
 
         uint32_t activated_;                        ///< A flag word indicating which features of the privacy protection are activiated.
 
@@ -242,8 +351,12 @@ class BSMHandler {
         ResultStatus result_;                       ///< Indicates the current state of BSM parsing and what causes failure.
         BSM bsm_;                                   ///< The BSM instance that is being built through parsing.
         Quad::Ptr quad_ptr_;                        ///< A pointer to the quad tree containing the map elements.
+        GeofenceIndex::CPtr geofence_index_;        ///< The index built from the quad tree and used for geofence queries.
+        GeofenceHintCache hints_;                   ///< The per-vehicle hints for geofence queries.
         bool get_value_;                            ///< Indicates the next value should be saved.
         std::string json_;                          ///< The JSON string after redaction.
+        std::string input_;                         ///< The copy of the message the DOM path parses in place.
+        std::string member_;                        ///< The JSON of the coreData or partII the BSM is given.
 
         VelocityFilter vf_;                         ///< The velocity filter functor instance.
         IdRedactor idr_;                            ///< The ID Redactor to use during parsing of BSMs.
@@ -252,6 +365,48 @@ class BSMHandler {
 
         RedactionPropertiesManager rpm;
         RapidjsonRedactor rapidjsonRedactor;
+        RedactionTrie redactionTrie;                ///< The paths of rpm, compiled when they are loaded.
+
+        BSMStreamHandler stream_;                   ///< The SAX handler of streaming mode.
+        bool stream_parse_;                         ///< Process messages in streaming mode.
+
+        /**
+         * @brief The geofence answer for the message being processed, when the prefilter has already found it.
+         */
+        enum class Geofence : uint8_t { UNCHECKED, INSIDE };
+
+        BSMPrefilter prefilter_;                    ///< The byte scanner of the prefilter.
+        bool prefilter_on_;                         ///< Suppress messages from a scan when possible.
+        Geofence geofence_;                         ///< The prefilter's geofence answer for the current message.
+
+        /**
+         * @brief Suppress a message from a scan of its bytes, setting the result and BSM as processing it would.
+         *
+         * @return true if the message was suppressed; false if it must be processed.
+         */
+        bool prefilter( const std::string& bsm_json );
+
+        /**
+         * @brief The geofence check of the message being processed; the prefilter's answer when it has one.
+         *
+         * @param vehicle_id the vehicle's id for the geofence hints, or null for none.
+         */
+        bool within_geofence( const std::string* vehicle_id );
+
+        /**
+         * @brief Log the general redaction paths the last message did not have, when info messages are logged.
+         */
+        void log_unredacted_paths();
+
+        /**
+         * @brief Process a message by building, changing and writing a DOM.
+         */
+        bool process_dom( const std::string& bsm_json );
+
+        /**
+         * @brief Finish processing a message the stream handler has parsed.
+         */
+        bool process_stream();
 
         // logger pointer
         std::shared_ptr<PpmLogger> logger_;
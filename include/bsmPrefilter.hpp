@@ -0,0 +1,87 @@
+/**
+ * @file
+ * @version
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory.
+ */
+
+#ifndef CVDP_BSM_PREFILTER_H
+#define CVDP_BSM_PREFILTER_H
+
+#include <string>
+#include <vector>
+
+#include "bsmStreamHandler.hpp"
+
+/**
+ * @brief A BSMPrefilter scans the raw bytes of a message for the fields the velocity and geofence filters need, so
+ * BSMHandler can suppress a message without parsing, redacting and writing it.
+ *
+ * The scan walks the message once, checking its structure and tracking the member path, and records the same fields
+ * a BSMStreamHandler records, with the same first-member rule. It builds nothing and writes nothing. The scan only
+ * succeeds when the message is certainly one rapidjson parses the same way; a message with something it does not
+ * handle exactly fails the scan and takes the normal path:
+ *
+ * - an escape in a tracked member name, the payload type or the id, or a surrogate escape anywhere;
+ * - a number longer than kMaxNumber characters or with an exponent of three or more digits, which rapidjson may
+ *   reject as too big;
+ * - nesting deeper than kMaxDepth, a NUL byte, or a root that is not an object;
+ * - anything that is not well-formed JSON.
+ *
+ * Numbers of the tracked fields are converted by rapidjson itself, so they equal the parsed values bit for bit.
+ */
+class BSMPrefilter {
+    public:
+        using Field = BSMStreamHandler::Field;
+        using Value = BSMStreamHandler::Value;
+
+        constexpr static std::size_t kMaxNumber = 64;      ///< Characters in the longest number the scan accepts.
+        constexpr static int kMaxDepth = 128;              ///< Levels of nesting the scan accepts.
+
+        BSMPrefilter();
+
+        /**
+         * @brief Scan a message.
+         *
+         * @param json the message.
+         * @return true if the message was scanned and its fields recorded; false if it must take the normal path.
+         */
+        bool scan( const std::string& json );
+
+        /**
+         * @param field the field.
+         * @return what the last scanned message held for the field.
+         */
+        const Value& get( Field field ) const;
+
+    private:
+        std::vector<Value> values_;                 ///< The fields of the last message.
+        const char* p_;                             ///< The next byte to scan.
+        const char* end_;                           ///< One past the last byte.
+
+        void skip_whitespace();
+        bool scan_value( Field field, int depth );
+        bool scan_object( Field role, bool root, int depth );
+        bool scan_array( int depth );
+        bool scan_string( const char*& begin, const char*& end, bool& escaped );
+        bool scan_number( Field field );
+        bool scan_literal( const char* literal );
+        void note( Field field, rapidjson::Type type );
+};
+
+#endif
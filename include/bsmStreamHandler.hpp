@@ -0,0 +1,286 @@
+/**
+ * @file
+ * @version
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory.
+ */
+
+#ifndef CVDP_BSM_STREAM_HANDLER_H
+#define CVDP_BSM_STREAM_HANDLER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rapidjson/reader.h"
+#include "rapidjson/writer.h"
+#include "rapidjson/stringbuffer.h"
+#include "general-redaction/redactionTrie.hpp"
+
+/**
+ * @brief A BSMStreamHandler is the rapidjson SAX handler behind BSMHandler's streaming mode. One pass of a
+ * rapidjson::Reader over a message records the fields BSMHandler validates and writes the message to an output
+ * Writer, with the sanitized flag and the vehicle size redacted on the way; no DOM is built.
+ *
+ * The output is byte for byte what the DOM path writes, given the same decisions:
+ *
+ * - The value of coreData.id is written as a one byte placeholder, a control character the Writer would always
+ *   escape, and replaced in finish once BSMHandler has redacted (or kept) the id.
+ * - General redaction rewrites members wherever they are, and rapidjson removes a member by moving the last member
+ *   of its object into its place. So when general redaction is on, the objects and arrays a redaction path can reach
+ *   (plus the root, payload and data) are kept as an outline: each member's name, type and written text, or its
+ *   outline when the path continues into it. The RedactionTrie of the paths is then applied to the outline in one
+ *   walk, exactly as it applies to a DOM, and finish writes the outline.
+ *
+ * Only the first member of a name counts, as with rapidjson::Value::HasMember. The size redaction depends on the
+ * payload type; when a size field comes before the payload type, needs_dom() reports that the message must be
+ * processed by the DOM path instead.
+ */
+class BSMStreamHandler {
+    public:
+        /**
+         * @brief The members a BSMHandler validates or redacts, each the first of its name in its parent.
+         */
+        enum Field : uint8_t {
+            METADATA,                               ///< metadata
+            SANITIZED,                              ///< metadata.sanitized
+            PAYLOAD_TYPE,                           ///< metadata.payloadType
+            RECEIVED_DETAILS,                       ///< metadata.receivedMessageDetails
+            LOCATION,                               ///< metadata.receivedMessageDetails.locationData
+            TIM_LATITUDE,                           ///< metadata.receivedMessageDetails.locationData.latitude
+            TIM_LONGITUDE,                          ///< metadata.receivedMessageDetails.locationData.longitude
+            TIM_SPEED,                              ///< metadata.receivedMessageDetails.locationData.speed
+            PAYLOAD,                                ///< payload
+            DATA,                                   ///< payload.data
+            CORE_DATA,                              ///< payload.data.coreData
+            SPEED,                                  ///< payload.data.coreData.speed
+            POSITION,                               ///< payload.data.coreData.position
+            LATITUDE,                               ///< payload.data.coreData.position.latitude
+            LONGITUDE,                              ///< payload.data.coreData.position.longitude
+            ID,                                     ///< payload.data.coreData.id
+            SIZE,                                   ///< payload.data.coreData.size
+            LENGTH,                                 ///< payload.data.coreData.size.length
+            WIDTH,                                  ///< payload.data.coreData.size.width
+            kFieldCount,
+            kNone = kFieldCount
+        };
+
+        /**
+         * @brief What the message held for one field.
+         */
+        struct Value {
+            bool present;                           ///< The member was found.
+            rapidjson::Type type;                   ///< The type of its value.
+            bool is_double;                         ///< The value is a number rapidjson holds as a double.
+            double number;                          ///< The value when is_double.
+            std::string text;                       ///< The value when a string.
+        };
+
+        BSMStreamHandler();
+
+        BSMStreamHandler( const BSMStreamHandler& other );
+        BSMStreamHandler& operator=( const BSMStreamHandler& other );
+
+        /**
+         * @brief The field a member is, given the field of its object.
+         *
+         * @param parent the field of the object; kNone for an object BSMHandler does not look into.
+         * @param key the member name.
+         * @param length the length of the member name.
+         * @param root the object is the message itself.
+         * @return the field, or kNone for the members BSMHandler does not look at.
+         */
+        static Field child_field( Field parent, const char* key, rapidjson::SizeType length, bool root );
+
+        /**
+         * @brief Set the general redaction paths, e.g., those of a RedactionPropertiesManager.
+         *
+         * @param paths the dot separated member paths, applied in this order by redact.
+         */
+        void set_redaction_paths( const std::vector<std::string>& paths );
+
+        /**
+         * @brief Parse a message, recording its fields and writing its output.
+         *
+         * @param json the message.
+         * @param redact_size write 0 for size.length and size.width of a BSM.
+         * @param outline keep the outline the general redaction paths need.
+         * @return true if the message is a JSON object; false if it does not parse or is not an object.
+         */
+        bool parse( const std::string& json, bool redact_size, bool outline );
+
+        /**
+         * @return true if the last message must be processed by the DOM path; see above.
+         */
+        bool needs_dom() const;
+
+        /**
+         * @param field the field.
+         * @return what the last message held for the field.
+         */
+        const Value& get( Field field ) const;
+
+        /**
+         * @brief Apply the general redaction paths to the outline of the last message; trie.isRedacted then reports
+         * each path as for a DOM.
+         *
+         * @param trie the paths given to set_redaction_paths, compiled.
+         */
+        void redact( RedactionTrie& trie );
+
+        /**
+         * @brief Write a member of payload.data from the outline of the last message, e.g., to store coreData in the
+         * BSM after general redaction.
+         *
+         * @param name the member name.
+         * @param id the coreData.id to write.
+         * @param json set to the member's value as JSON.
+         * @return true if payload.data has the member; false otherwise.
+         */
+        bool write_data_member( const char* name, const std::string& id, std::string& json ) const;
+
+        /**
+         * @brief Write the last message.
+         *
+         * @param id the coreData.id to write.
+         * @param json set to the message as JSON.
+         */
+        void finish( const std::string& id, std::string& json ) const;
+
+        // SAX events of rapidjson::Reader.
+        bool Null();
+        bool Bool( bool b );
+        bool Int( int i );
+        bool Uint( unsigned u );
+        bool Int64( int64_t i );
+        bool Uint64( uint64_t u );
+        bool Double( double d );
+        bool RawNumber( const char* str, rapidjson::SizeType length, bool copy );
+        bool String( const char* str, rapidjson::SizeType length, bool copy );
+        bool StartObject();
+        bool Key( const char* str, rapidjson::SizeType length, bool copy );
+        bool EndObject( rapidjson::SizeType count );
+        bool StartArray();
+        bool EndArray( rapidjson::SizeType count );
+
+    private:
+        using Writer = rapidjson::Writer<rapidjson::StringBuffer>;
+
+        struct Node;
+        struct Outline;
+
+        /**
+         * @brief A member of an outlined object, or an element of an outlined array.
+         */
+        struct Member {
+            std::string name;                       ///< The member name; empty for an array element.
+            rapidjson::Type type;                   ///< The type of the value.
+            std::string text;                       ///< The value as JSON, unless it is outlined.
+            Node* child;                            ///< The outline of the value, or null.
+        };
+
+        /**
+         * @brief The position of a redaction path in the outline: path component index of path.
+         */
+        struct Cursor {
+            uint32_t path;
+            uint32_t index;
+        };
+
+        /**
+         * @brief The members of an outlined object or elements of an outlined array. A member that is cleared or
+         * removed keeps its place and the memory of its strings, which the member added there next reuses; as a node
+         * is reused from message to message, a message shaped like the ones before it allocates nothing.
+         */
+        class MemberList {
+            public:
+                std::size_t size() const { return size_; }
+                Member& operator[]( std::size_t index ) { return slots_[index]; }
+                Member& back() { return slots_[size_ - 1]; }
+                Member* begin() { return slots_.data(); }
+                Member* end() { return slots_.data() + size_; }
+                const Member* begin() const { return slots_.data(); }
+                const Member* end() const { return slots_.data() + size_; }
+
+                Member& add( const char* name, std::size_t length );
+                void remove( std::size_t index );
+                void clear() { size_ = 0; }
+
+            private:
+                std::vector<Member> slots_;         ///< The members, then the places of cleared ones.
+                std::size_t size_ = 0;              ///< The members in use.
+        };
+
+        /**
+         * @brief An outlined object or array.
+         */
+        struct Node {
+            bool array;                             ///< An array rather than an object.
+            MemberList members;                     ///< The members or elements in order.
+            std::vector<Cursor> cursors;            ///< The redaction paths that can reach this node.
+        };
+
+        /**
+         * @brief An object or array being parsed.
+         */
+        struct Frame {
+            Field role;                             ///< The field this object is, or kNone.
+            Field pending;                          ///< The field of the value after the last key, or kNone.
+            Node* node;                             ///< The outline of this object, or null when it is written.
+            Writer* writer;                         ///< Where this object is written when it is not outlined.
+            bool captured;                          ///< This object is written to capture_ for its parent's outline.
+        };
+
+        std::vector<std::vector<std::string>> paths_;   ///< The general redaction paths split at the dots.
+        std::vector<Value> values_;                 ///< The fields of the last message.
+        bool redact_size_;                          ///< Write 0 for a BSM's size.length and size.width.
+        bool outline_;                              ///< Keep the outline of the last message.
+        bool object_;                               ///< The last message is an object.
+        bool needs_dom_;                            ///< The last message must take the DOM path.
+        int skip_;                                  ///< The depth within a value that is being replaced.
+        std::vector<Frame> frames_;                 ///< The objects and arrays open in the parse.
+        std::vector<std::unique_ptr<Node>> nodes_;  ///< The outline nodes, reused from message to message.
+        std::size_t node_count_;                    ///< The nodes of nodes_ in use.
+        Node* root_;                                ///< The outline of the last message, or null.
+        rapidjson::Reader reader_;                  ///< The SAX parser.
+        mutable rapidjson::StringBuffer out_;       ///< The output when nothing is outlined.
+        mutable Writer writer_;                     ///< Writes out_.
+        rapidjson::StringBuffer capture_;           ///< A scalar or a container that is not outlined.
+        Writer capture_writer_;                     ///< Writes capture_.
+        mutable rapidjson::StringBuffer member_;    ///< An outlined data member written for the BSM.
+        mutable Writer member_writer_;              ///< Writes member_.
+        mutable rapidjson::StringBuffer id_;        ///< The escaped id spliced into the output.
+        mutable Writer id_writer_;                  ///< Writes id_.
+
+        Node* make_node( bool array );
+        Member& next_member( Node& node );
+        bool replace( Field field, rapidjson::Type type, Writer*& writer );
+        Writer* start_value( Field& field, Member*& member );
+
+        template <typename Write>
+        bool scalar( rapidjson::Type type, Write write );
+
+        bool start( bool array );
+        bool end( bool array );
+
+        void write( const Node& node, Writer& writer ) const;
+        void splice( const std::string& id, std::string& json ) const;
+};
+
+#endif
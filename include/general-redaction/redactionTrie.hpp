@@ -0,0 +1,333 @@
+#ifndef CVDP_REDACTION_TRIE_H
+#define CVDP_REDACTION_TRIE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "rapidjson/document.h"
+
+/**
+ * @brief The general redaction paths compiled into a trie, applied to a document, or to the outline BSMStreamHandler
+ * keeps of a streamed message, in one walk.
+ *
+ * Each distinct member name below a member is stored once, as a node, along with what a path does when it reaches
+ * that member: the leaf values that are set rather than removed (angle, transmission, traction, ...), the objects
+ * that are always removed (weatherProbe, status, speedProfile) and the wheelBrakes bitstring. Nothing is parsed
+ * or compared as a string while redacting.
+ *
+ * The result is exactly that of RapidjsonRedactor::redactMemberByPath called for each path in order. A removal moves
+ * the last member of an object into its place, and a removal can leave an object holding only booleans, so paths
+ * are still applied in their order; consecutive paths through the same member walk it once, and an array is walked
+ * once for all the paths that try its elements.
+ */
+class RedactionTrie {
+    public:
+        /**
+         * @brief Construct an empty trie, which redacts nothing.
+         */
+        RedactionTrie();
+
+        /**
+         * @brief Compile the redaction paths, e.g., those of a RedactionPropertiesManager.
+         *
+         * @param fields The dot separated member paths, applied in this order
+         */
+        explicit RedactionTrie(const std::vector<std::string>& fields);
+
+        /**
+         * @brief Applies every path to a value
+         *
+         * @param value The rapidjson::Value to redact from
+         */
+        void redact(rapidjson::Value& value);
+
+        /**
+         * @brief Applies every path to another tree of JSON values, e.g., the outline of a streamed message
+         *
+         * The Tree gives access to its Value type: isObject, isArray, isNumber, isString and isBool; elementCount and
+         * element of an array; memberCount, member, findMember and removeMember of an object, where removing a member
+         * moves the last member into its place as rapidjson does; and setNumber, setString and setBool.
+         *
+         * @param tree The access to the tree
+         * @param value The value to redact from
+         */
+        template <typename Tree>
+        void redact(const Tree& tree, typename Tree::Value& value);
+
+        /**
+         * @brief Returns the number of paths.
+         */
+        std::size_t getPathCount() const;
+
+        /**
+         * @brief Returns a path as it was given.
+         *
+         * @param index The index of the path
+         */
+        const std::string& getPath(std::size_t index) const;
+
+        /**
+         * @brief Checks whether a path redacted a member in the last call to redact.
+         *
+         * @param index The index of the path
+         * @return true if it did; false when redactMemberByPath would have returned false
+         */
+        bool isRedacted(std::size_t index) const;
+
+    private:
+        /**
+         * @brief What a path does to the leaf it ends at.
+         */
+        enum class Leaf : uint8_t { REMOVE, SET_127, SET_UPPER_UNAVAILABLE, SET_UNAVAILABLE };
+
+        /**
+         * @brief What a path does to an object or array it reaches.
+         */
+        enum class Container : uint8_t { DESCEND, REMOVE_OBJECT, WHEEL_BRAKES };
+
+        /**
+         * @brief The wheelBrakes member a path ends at.
+         */
+        enum class Bit : uint8_t { NONE, UNAVAILABLE, LEFT_FRONT, RIGHT_FRONT, LEFT_REAR, RIGHT_REAR };
+
+        struct Node {
+            std::string name;
+            Leaf leaf;
+            Container container;
+            std::vector<uint32_t> children;
+        };
+
+        struct Step {
+            uint32_t node;              // the member to look up
+            bool target;                // the member name is the last one of the path
+        };
+
+        struct Path {
+            std::string text;
+            std::vector<Step> steps;
+            Bit bit;
+        };
+
+        struct Cursor {
+            uint32_t path;
+            uint32_t step;
+        };
+
+        std::vector<Node> nodes;
+        std::vector<Path> paths;
+        std::vector<char> redacted;
+        std::vector<Cursor> cursors;    // the paths being applied, as a stack of ranges
+
+        struct RapidjsonTree;
+
+        uint32_t addNode(uint32_t parent, const std::string& name);
+
+        /**
+         * @brief Applies the paths of cursors [begin, end) to a value, in order.
+         *
+         * @param watch stop once a removal leaves the value an object of booleans, which its parent treats as a bitstring
+         * @return the number of paths applied
+         */
+        template <typename Tree>
+        std::size_t apply(const Tree& tree, typename Tree::Value& value, std::size_t begin, std::size_t end, bool watch);
+
+        template <typename Tree>
+        static bool isBitstring(const Tree& tree, typename Tree::Value& value);
+
+        template <typename Tree>
+        static bool clearBit(const Tree& tree, typename Tree::Value& wheelBrakes, Bit bit);
+};
+
+template <typename Tree>
+void RedactionTrie::redact(const Tree& tree, typename Tree::Value& value) {
+    cursors.clear();
+    for (uint32_t path = 0; path < paths.size(); ++path) {
+        redacted[path] = false;
+        cursors.push_back(Cursor{ path, 0 });
+    }
+
+    apply(tree, value, 0, cursors.size(), false);
+}
+
+/**
+ * @brief Apply paths to a value the way redactMemberByPath applies each one.
+ *
+ * An array passes each path to its elements until one redacts. An object looks up the next member of each path; a
+ * leaf that the path ends at is set or removed, a bitstring is cleared (wheelBrakes) or removed, and any other
+ * object or array is walked by the run of consecutive paths that reach it, which then continue with their next
+ * member. A path whose last member is an object or array looks that name up again inside it.
+ */
+template <typename Tree>
+std::size_t RedactionTrie::apply(const Tree& tree, typename Tree::Value& value, std::size_t begin, std::size_t end, bool watch) {
+    if (tree.isArray(value)) {
+        std::size_t pending = cursors.size();
+        for (std::size_t i = begin; i < end; ++i) {
+            Cursor cursor = cursors[i];
+            cursors.push_back(cursor);
+        }
+
+        for (std::size_t e = 0; e < tree.elementCount(value); ++e) {
+            if (cursors.size() == pending) {
+                break;
+            }
+
+            typename Tree::Value& element = tree.element(value, e);
+            if (!tree.isObject(element) && !tree.isArray(element)) {
+                continue;
+            }
+
+            apply(tree, element, pending, cursors.size(), false);
+
+            // the paths that did not redact try the next element.
+            std::size_t kept = pending;
+            for (std::size_t i = pending; i < cursors.size(); ++i) {
+                if (!redacted[cursors[i].path]) {
+                    cursors[kept++] = cursors[i];
+                }
+            }
+            cursors.resize(kept);
+        }
+
+        cursors.resize(pending);
+        return end - begin;
+    }
+
+    if (!tree.isObject(value)) {
+        return end - begin;
+    }
+
+    std::size_t i = begin;
+    while (i < end) {
+        const Cursor cursor = cursors[i];
+        const Path& path = paths[cursor.path];
+        const Step& step = path.steps[cursor.step];
+        const Node& node = nodes[step.node];
+
+        std::size_t member = tree.findMember(value, node.name.data(), node.name.size());
+        if (member == tree.memberCount(value)) {
+            ++i;
+            continue;
+        }
+
+        typename Tree::Value& child = tree.member(value, member);
+        bool removed = false;
+
+        if (tree.isObject(child) || tree.isArray(child)) {
+            if (isBitstring(tree, child)) {
+                if (node.container == Container::WHEEL_BRAKES) {
+                    redacted[cursor.path] = clearBit(tree, child, path.bit);
+                }
+                else {
+                    tree.removeMember(value, member);
+                    redacted[cursor.path] = true;
+                    removed = true;
+                }
+                ++i;
+            }
+            else if (tree.isObject(child) && node.container == Container::REMOVE_OBJECT) {
+                tree.removeMember(value, member);
+                redacted[cursor.path] = true;
+                removed = true;
+                ++i;
+            }
+            else {
+                std::size_t run = cursors.size();
+                for (std::size_t j = i; j < end; ++j) {
+                    Cursor next = cursors[j];
+                    const Path& nextPath = paths[next.path];
+                    if (nextPath.steps[next.step].node != step.node) {
+                        break;
+                    }
+
+                    if (next.step + 1 < nextPath.steps.size()) {
+                        ++next.step;
+                    }
+                    cursors.push_back(next);
+                }
+
+                i += apply(tree, child, run, cursors.size(), tree.isObject(child));
+                cursors.resize(run);
+            }
+        }
+        else {
+            if (step.target) {
+                switch (node.leaf) {
+                    case Leaf::SET_127:
+                        if (tree.isNumber(child)) {
+                            tree.setNumber(child, 127);
+                            redacted[cursor.path] = true;
+                        }
+                        break;
+                    case Leaf::SET_UPPER_UNAVAILABLE:
+                        if (tree.isString(child)) {
+                            tree.setString(child, "UNAVAILABLE");
+                            redacted[cursor.path] = true;
+                        }
+                        break;
+                    case Leaf::SET_UNAVAILABLE:
+                        if (tree.isString(child)) {
+                            tree.setString(child, "unavailable");
+                            redacted[cursor.path] = true;
+                        }
+                        break;
+                    case Leaf::REMOVE:
+                        break;
+                }
+
+                if (!redacted[cursor.path]) {
+                    tree.removeMember(value, member);
+                    redacted[cursor.path] = true;
+                    removed = true;
+                }
+            }
+            ++i;
+        }
+
+        if (removed && watch && isBitstring(tree, value)) {
+            return i - begin;
+        }
+    }
+
+    return end - begin;
+}
+
+template <typename Tree>
+bool RedactionTrie::isBitstring(const Tree& tree, typename Tree::Value& value) {
+    if (!tree.isObject(value)) {
+        return false;
+    }
+    for (std::size_t i = 0; i < tree.memberCount(value); ++i) {
+        if (!tree.isBool(tree.member(value, i))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Clear a member of a wheelBrakes bitstring. As in redactMemberByPath, unavailable is set but not reported as
+ * redacted, and a member the bitstring does not have is left out.
+ */
+template <typename Tree>
+bool RedactionTrie::clearBit(const Tree& tree, typename Tree::Value& wheelBrakes, Bit bit) {
+    const char* name;
+    bool value = false;
+    switch (bit) {
+        case Bit::UNAVAILABLE: name = "unavailable"; value = true; break;
+        case Bit::LEFT_FRONT: name = "leftFront"; break;
+        case Bit::RIGHT_FRONT: name = "rightFront"; break;
+        case Bit::LEFT_REAR: name = "leftRear"; break;
+        case Bit::RIGHT_REAR: name = "rightRear"; break;
+        default: return false;
+    }
+
+    std::size_t member = tree.findMember(wheelBrakes, name, std::strlen(name));
+    if (member != tree.memberCount(wheelBrakes)) {
+        tree.setBool(tree.member(wheelBrakes, member), value);
+    }
+
+    return bit != Bit::UNAVAILABLE;
+}
+
+#endif
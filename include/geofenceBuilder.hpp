@@ -0,0 +1,175 @@
+/** 
+ * @file 
+ * @version
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory.
+ */
+
+#ifndef CVDP_GEOFENCE_BUILDER_H
+#define CVDP_GEOFENCE_BUILDER_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cvlib.hpp"
+#include "ppmLogger.hpp"
+
+using ConfigMap = std::unordered_map<std::string,std::string>;            ///< An alias to a string key - value configuration for the privacy parameters.
+
+/**
+ * @brief A GeofenceBuilder turns a map file into the GeofenceIndex used by the geofence filter, following the
+ * privacy.filter.geofence.* configuration.
+ *
+ * A map file is either a CSV shape file (see shapes::CSVInputFactory), which is parsed into a Quad tree and indexed,
+ * or a compiled geofence written by ppm_geofence_compile, which is mapped into memory as a FrozenQuad without parsing.
+ * When privacy.filter.geofence.shared names a file (e.g., in /dev/shm or on a hugetlbfs mount), a CSV map is compiled
+ * there once and every PPM on the host maps that one copy. When privacy.filter.geofence.delta names a delta file, its
+ * removals and additions are applied to a CSV map after it is parsed (see Quad::edit). When
+ * privacy.filter.geofence.merge.tolerance is set, consecutive edges of a way are merged into longer corridors as the
+ * map is parsed (see CorridorMerger). The builder has no Kafka dependency so the offline compiler can share it with
+ * the PPM.
+ */
+class GeofenceBuilder {
+    public:
+        static constexpr double kDefaultBoxExtension = 10.0;    ///< Meters edge boxes are extended when privacy.filter.geofence.extension is not set.
+        static const std::string kDefaultGeofenceIndex;         ///< The index used when privacy.filter.geofence.index is not set.
+
+        /**
+         * @brief Construct a builder from the privacy configuration.
+         *
+         * @param conf the user-specified configuration; the geofence bounds, extension, quadtree, index and raster
+         * settings are read.
+         * @param logger the logger for warnings; may be null.
+         */
+        GeofenceBuilder( const ConfigMap& conf, std::shared_ptr<PpmLogger> logger );
+
+        /**
+         * @brief Parse a CSV map file and insert its shapes, with their edge corridors, into a new Quad tree covering
+         * the configured bounds. The tree is built in parallel (see Quad::bulk_insert).
+         *
+         * @param mapfile the CSV map file.
+         * @return The root of the tree.
+         * @throws std::exception when the map file cannot be read or parsed.
+         */
+        Quad::Ptr build_quad( const std::string& mapfile ) const;
+
+        /**
+         * @brief Parse a CSV map file into the entities build_quad inserts, in insertion order: circles, edges and
+         * grids, with the corridor of each edge. Edges are merged first when a merge tolerance is configured and no
+         * delta file is (see CorridorMerger); circles and grids get empty corridors.
+         *
+         * @param mapfile the CSV map file.
+         * @param entities appended with the entities.
+         * @param corridors appended with the corridor of each entity.
+         * @throws std::exception when the map file cannot be read or parsed.
+         */
+        void parse_shapes( const std::string& mapfile, geo::Entity::PtrList& entities, std::vector<geo::Corridor>& corridors ) const;
+
+        /**
+         * @brief Build the configured GeofenceIndex over a Quad tree; edges without a corridor are given one first.
+         *
+         * @param quad_ptr the root of the tree.
+         * @return The index; null when quad_ptr is null.
+         */
+        GeofenceIndex::CPtr build_index( Quad::Ptr quad_ptr ) const;
+
+        /**
+         * @brief Load a map file as a GeofenceIndex: compiled geofences are mapped, CSV maps are parsed and indexed,
+         * or attached through the shared geofence when one is configured (see attach_shared).
+         *
+         * A compiled or shared geofence is always a FrozenQuad; the index and raster settings do not apply to it. When a
+         * delta file is configured, a CSV map is parsed and edited with it, and never shared.
+         *
+         * @param mapfile the compiled geofence or CSV map file.
+         * @param base when not null and a delta file is configured, set to the tree parsed from the CSV map before the
+         * delta was applied, so a changed delta can be applied again without parsing the map (see apply_delta).
+         * @return The index.
+         * @throws std::exception when the map file cannot be loaded.
+         */
+        GeofenceIndex::CPtr load( const std::string& mapfile, Quad::Ptr* base = nullptr ) const;
+
+        /**
+         * @brief Apply the configured delta file to a tree, copying only the quads it changes (see Quad::edit). Added
+         * edges are given their corridors.
+         *
+         * @param base the root of the tree; not modified.
+         * @return The root of the edited tree; base itself when no delta file is configured or the file does not exist.
+         * @throws std::exception when the delta file cannot be parsed.
+         */
+        Quad::Ptr apply_delta( const Quad::Ptr& base ) const;
+
+        /**
+         * @brief Parse a CSV map file and write it as a compiled geofence.
+         *
+         * @param mapfile the CSV map file.
+         * @param outfile the compiled geofence file to write.
+         * @return The compiled tree.
+         * @throws std::exception when the map file cannot be parsed or the output cannot be written.
+         */
+        FrozenQuad::CPtr compile( const std::string& mapfile, const std::string& outfile ) const;
+
+        /**
+         * @brief Map the shared geofence for a CSV map file, compiling it first when it is missing, damaged, older
+         * than the map file or built with other region, extension, quadtree, merge or geometry settings.
+         *
+         * A lock file next to the shared geofence lets one process compile it while the others wait.
+         *
+         * @param mapfile the CSV map file.
+         * @return The tree mapped from the shared geofence.
+         * @throws std::exception when the map file cannot be parsed or the shared geofence cannot be written or mapped.
+         */
+        FrozenQuad::CPtr attach_shared( const std::string& mapfile ) const;
+
+        const geo::Point& get_sw() const;                   ///< @return the southwest corner of the geofence region.
+        const geo::Point& get_ne() const;                   ///< @return the northeast corner of the geofence region.
+        double get_extension() const;                       ///< @return the edge box extension in meters.
+        const std::string& get_index_type() const;          ///< @return the configured index name.
+        const std::string& get_delta_path() const;          ///< @return the delta file; empty when not configured.
+        FrozenQuad::Geometry get_geometry() const;          ///< @return the configured FrozenQuad geometry.
+        const Quad::Parameters& get_quad_parameters() const;    ///< @return the configured quadtree parameters.
+        double get_merge_tolerance() const;                 ///< @return the edge merge tolerance in meters; 0 when edges are not merged.
+        double get_merge_length() const;                    ///< @return the longest merged edge in meters; 0 when edges are not merged.
+
+    private:
+        geo::Point sw_;                                     ///< The southwest corner of the geofence region.
+        geo::Point ne_;                                     ///< The northeast corner of the geofence region.
+        double extension_;                                  ///< Meters edge boxes are extended.
+        Quad::Parameters quad_parameters_;                  ///< The leaf capacity, minimum size and fuzzy margin of the quadtree.
+        std::string index_type_;                            ///< The configured index: quad, frozen, grid or rtree.
+        double cell_degrees_;                               ///< The GridIndex cell side.
+        uint32_t fanout_;                                   ///< The HilbertRTree children per node.
+        bool raster_;                                       ///< Whether a RasterIndex is put in front of the index.
+        double raster_cell_degrees_;                        ///< The RasterIndex cell side.
+        unsigned build_threads_;                            ///< Threads used to load the shapes and build the Quad tree; 0 for one per hardware thread.
+        double merge_tolerance_;                            ///< The configured CorridorMerger tolerance; 0 to not merge.
+        double merge_length_;                               ///< The configured CorridorMerger maximum length.
+        bool planar_;                                       ///< Whether the FrozenQuad geometry is projected onto a plane.
+        bool fixed_;                                        ///< Whether the FrozenQuad geometry is rounded to 1e-7 degree integers.
+        std::string shared_path_;                           ///< The shared compiled geofence; empty when not shared.
+        std::string delta_path_;                            ///< The delta file applied to CSV maps; empty when not configured.
+        std::shared_ptr<PpmLogger> logger_;                 ///< The logger for warnings; may be null.
+
+        /**
+         * @brief Map the shared geofence if it is current for the map file and configuration; null otherwise.
+         */
+        FrozenQuad::CPtr current_shared( const std::string& mapfile ) const;
+};
+
+#endif
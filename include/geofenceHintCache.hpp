@@ -0,0 +1,114 @@
+/** 
+ * @file 
+ * @version
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory.
+ */
+
+#ifndef CVDP_GEOFENCE_HINT_CACHE_H
+#define CVDP_GEOFENCE_HINT_CACHE_H
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "cvlib.hpp"
+
+/**
+ * @brief A GeofenceHintCache keeps one GeofenceIndex::Hint per vehicle so consecutive geofence lookups for the same
+ * vehicle start from the leaf and entity of its previous BSM.
+ *
+ * Vehicles broadcast at 10 Hz and move a few meters between messages, so most lookups land in the hinted leaf. The
+ * table is bounded: the least recently seen vehicle is evicted when it is full, and a hint that has not been used
+ * for the time-to-live is dropped. Hints never change an answer, only how fast it is found.
+ */
+class GeofenceHintCache {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        static constexpr std::size_t kDefaultCapacity = 4096;          ///< Vehicles tracked when privacy.filter.geofence.hints is not set.
+        static constexpr uint32_t kDefaultTimeToLive = 5000;           ///< Milliseconds when privacy.filter.geofence.hints.ttl is not set.
+
+        /**
+         * @brief Counters describing how useful the hints are.
+         */
+        struct Stats {
+            uint64_t lookups;                       ///< Geofence lookups made through the cache.
+            uint64_t vehicle_hits;                  ///< Lookups for a vehicle with a live hint.
+            uint64_t leaf_hits;                     ///< Lookups answered from the hinted leaf without a descent.
+            uint64_t entity_hits;                   ///< Lookups answered by the hinted entity alone.
+            uint64_t evictions;                     ///< Vehicles evicted because the table was full.
+            uint64_t expirations;                   ///< Hints dropped because they outlived the time-to-live.
+
+            Stats() : lookups{ 0 }, vehicle_hits{ 0 }, leaf_hits{ 0 }, entity_hits{ 0 }, evictions{ 0 }, expirations{ 0 } {}
+        };
+
+        /**
+         * @brief Construct a cache.
+         *
+         * @param capacity the maximum number of vehicles tracked; 0 disables the hints.
+         * @param ttl_ms the number of milliseconds an unused hint is kept.
+         */
+        explicit GeofenceHintCache( std::size_t capacity = kDefaultCapacity, uint32_t ttl_ms = kDefaultTimeToLive );
+
+        /**
+         * @brief Predicate indicating whether a vehicle's position is within the geofence, using and updating the
+         * vehicle's hint.
+         *
+         * @param index the geofence index to query.
+         * @param id the vehicle identifier, e.g., the BSM coreData.id before redaction.
+         * @param pt the vehicle's position.
+         * @param now the time of the lookup; used for the time-to-live.
+         * @return true if the position is within the geofence; false otherwise.
+         */
+        bool is_within_entity( const GeofenceIndex& index, const std::string& id, const geo::Point& pt,
+                               Clock::time_point now = Clock::now() );
+
+        /**
+         * @brief Forget every hint, e.g., when the geofence index is replaced. The counters are kept.
+         */
+        void clear();
+
+        std::size_t size() const;                           ///< @return the number of vehicles tracked.
+        std::size_t get_capacity() const;                   ///< @return the maximum number of vehicles tracked.
+        uint32_t get_time_to_live() const;                  ///< @return the hint time-to-live in milliseconds.
+        const Stats& get_stats() const;                     ///< @return the hit and eviction counters.
+
+    private:
+        /**
+         * @brief One tracked vehicle; the list is kept in most recently used order.
+         */
+        struct Entry {
+            std::string id;                         ///< The vehicle identifier.
+            GeofenceIndex::Hint hint;               ///< The vehicle's hint.
+            Clock::time_point last_used;            ///< When the hint was last used.
+        };
+
+        using EntryList = std::list<Entry>;
+
+        std::size_t capacity_;                                          ///< The maximum number of vehicles tracked.
+        Clock::duration ttl_;                                           ///< How long an unused hint is kept.
+        uint32_t ttl_ms_;                                               ///< The time-to-live in milliseconds.
+        EntryList entries_;                                             ///< The tracked vehicles; most recently used first.
+        std::unordered_map<std::string, EntryList::iterator> lookup_;   ///< Vehicle identifier to its entry.
+        Stats stats_;                                                   ///< The counters.
+};
+
+#endif
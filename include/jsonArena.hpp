@@ -0,0 +1,146 @@
+/**
+ * @file
+ * @version
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory.
+ */
+
+
+#ifndef CVDP_JSON_ARENA_H
+#define CVDP_JSON_ARENA_H
+
+#include <cstdint>
+#include <memory>
+
+#include "rapidjson/document.h"
+#include "rapidjson/writer.h"
+#include "rapidjson/stringbuffer.h"
+
+/**
+ * @brief A JsonArena holds the memory BSMHandler uses to parse, change and write one message as a DOM, and is reset
+ * between messages.
+ *
+ * A rapidjson::MemoryPoolAllocator never frees what it hands out, so a document that is reused for message after
+ * message grows without bound. Instead each message gets a fresh document whose values and parse stack come from two
+ * pools owned by the arena. Each pool starts with a fixed chunk of its own and takes overflow chunks from the heap
+ * when a message needs more; reset frees the overflow and empties the first chunk, so a message only ever keeps the
+ * memory it needs and a steady stream of messages allocates nothing. The output buffer and writer are kept too, at
+ * the size of the largest message written.
+ *
+ * The arena counts the heap allocations it makes: the overflow chunks of both pools, counted as the capacity the pool
+ * gained over the chunk capacity, which is exact unless a single allocation is larger than a chunk, and each growth of
+ * the output buffer. The count covers the arena alone, not the rest of the heap a message uses, e.g., the strings of
+ * the BSM or the log. Only the DOM path uses the arena: a message BSMStreamHandler processes allocates from its own
+ * buffers, which are neither here nor counted.
+ */
+class JsonArena {
+    public:
+        using Allocator = rapidjson::MemoryPoolAllocator<>;
+        using Document = rapidjson::GenericDocument<rapidjson::UTF8<>, Allocator, Allocator>;
+        using Writer = rapidjson::Writer<rapidjson::StringBuffer>;
+
+        constexpr static std::size_t kDefaultCapacity = 64 * 1024;     ///< Bytes of the first chunk of the value pool.
+        constexpr static std::size_t kStackCapacity = 16 * 1024;       ///< Bytes of the first chunk of the stack pool.
+        constexpr static std::size_t kMinCapacity = 1024;              ///< Fewest bytes of the first chunk of the value pool.
+        constexpr static std::size_t kDocumentStackCapacity = 1024;    ///< Initial bytes of a document's parse stack.
+
+        /**
+         * @brief Resets an arena when it goes out of scope, i.e., after the document of a message is destroyed.
+         */
+        class Scope {
+            public:
+                explicit Scope( JsonArena& arena );
+                ~Scope();
+
+                Scope( const Scope& ) = delete;
+                Scope& operator=( const Scope& ) = delete;
+
+            private:
+                JsonArena& arena_;
+        };
+
+        /**
+         * @brief Construct an arena.
+         *
+         * @param capacity the bytes of the first chunk of the value pool, at least kMinCapacity; also the size of its
+         * overflow chunks.
+         */
+        explicit JsonArena( std::size_t capacity = kDefaultCapacity );
+
+        JsonArena( const JsonArena& other );
+        JsonArena& operator=( const JsonArena& other );
+
+        /**
+         * @return the pool for the values of a document, e.g., to pass to Document's constructor.
+         */
+        Allocator& get_allocator();
+
+        /**
+         * @return the pool for the parse stack of a document.
+         */
+        Allocator& get_stack_allocator();
+
+        /**
+         * @brief Start writing a message, emptying the output buffer.
+         *
+         * @return the writer of the output buffer.
+         */
+        Writer& start_output();
+
+        /**
+         * @return the output buffer.
+         */
+        const rapidjson::StringBuffer& get_output() const;
+
+        /**
+         * @brief Free the overflow of both pools and empty their first chunks. No value of a document made from the
+         * pools may be used afterwards.
+         */
+        void reset();
+
+        /**
+         * @return the bytes of the first chunk of the value pool.
+         */
+        std::size_t get_capacity() const;
+
+        /**
+         * @return the heap allocations of the arena since construction, as counted by reset; no other heap use is counted.
+         */
+        uint64_t get_heap_allocations() const;
+
+        /**
+         * @return the number of resets since construction, i.e., the messages processed.
+         */
+        uint64_t get_resets() const;
+
+    private:
+        std::size_t capacity_;                      ///< Bytes of the first chunk of the value pool.
+        std::unique_ptr<char[]> chunk_;             ///< The first chunk of the value pool.
+        std::unique_ptr<char[]> stack_chunk_;       ///< The first chunk of the stack pool.
+        std::unique_ptr<Allocator> values_;         ///< The value pool.
+        std::unique_ptr<Allocator> stack_;          ///< The stack pool.
+        rapidjson::StringBuffer output_;            ///< The output of the last message.
+        Writer writer_;                             ///< Writes output_.
+        std::size_t output_capacity_;               ///< The capacity of output_ at the last reset.
+        uint64_t heap_allocations_;                 ///< Heap allocations since construction.
+        uint64_t resets_;                           ///< Resets since construction.
+
+        static uint64_t overflow( const Allocator& pool, std::size_t chunk );
+};
+
+#endif
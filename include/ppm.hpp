@@ -49,9 +49,12 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <csignal>
+
 #include "librdkafka/rdkafkacpp.h"
 #include "tool.hpp"
 #include "bsmHandler.hpp"
+#include "privacyReloader.hpp"
 #include "cvlib.hpp"
 #include "spdlog/spdlog.h"
 #include "ppmLogger.hpp"
@@ -63,6 +66,7 @@ class PPM : public tool::Tool {
         std::shared_ptr<PpmLogger> logger;
 
         static void sigterm (int sig);
+        static void sighup (int sig);
 
         PPM( const std::string& name, const std::string& description );
         ~PPM();
@@ -73,7 +77,7 @@ class PPM : public tool::Tool {
         bool launch_consumer();
         bool launch_producer();
         bool msg_consume(RdKafka::Message* message, void* opaque, BSMHandler& handler);
-        Quad::Ptr BuildGeofence( const std::string& mapfile );
+        GeofenceIndex::CPtr BuildGeofence( const std::string& mapfile );
         int operator()(void);
 
         /**
@@ -95,6 +99,7 @@ class PPM : public tool::Tool {
 
         static bool bootstrap;                                          ///> flag indicating we need to bootstrap the consumer and producer
         static bool bsms_available;                                     ///> flag to find consumer/produce bsms; set via signals so static.
+        static volatile sig_atomic_t reload_requested;                 ///> flag asking for a privacy reload; set by SIGHUP.
 
         bool exit_eof;                                                  ///> flag to cause the application to exit on stream eof.
         int eof_cnt;                                                    ///> counts the number of eofs needed for exit_eof to work; each partition must end.
@@ -107,6 +112,7 @@ class PPM : public tool::Tool {
         int64_t bsm_recv_bytes;                                         ///> Counter for the number of BSM bytes received.
         int64_t bsm_send_bytes;                                         ///> Counter for the nubmer of BSM bytes published.
         int64_t bsm_filt_bytes;                                         ///> Counter for the nubmer of BSM bytes filtered/suppressed.
+        long reload_count;                                              ///> Counter for the number of privacy snapshots swapped in.
 
         std::string mode;
         std::string debug;
@@ -122,7 +128,9 @@ class PPM : public tool::Tool {
         RdKafka::Conf *conf;
         RdKafka::Conf *tconf;
 
-        Quad::Ptr qptr;
+        std::string mapfile;                                            ///> The map file of the geofence.
+        GeofenceIndex::CPtr geofence_index;                             ///> The geofence shared by every handler.
+        Quad::Ptr geofence_base;                                        ///> The tree the geofence delta is applied to; null without a delta file.
 
         std::shared_ptr<RdKafka::KafkaConsumer> consumer;
         int consumer_timeout;
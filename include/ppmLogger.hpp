@@ -25,6 +25,11 @@ class PpmLogger {
         void critical(const std::string& message);
         void warn(const std::string& message);
 
+        /**
+         * @return true if an info message is written anywhere, i.e., it is worth building.
+         */
+        bool is_info_enabled() const;
+
         void flush();
 
     private:
@@ -0,0 +1,224 @@
+/**
+ * @file
+ * @version
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory.
+ */
+
+#ifndef CVDP_PRIVACY_RELOADER_H
+#define CVDP_PRIVACY_RELOADER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "privacySnapshot.hpp"
+#include "ppmLogger.hpp"
+
+/**
+ * @brief A PrivacyReloader rebuilds the PrivacySnapshot when the configuration file, the map file, the geofence delta
+ * file or the general redaction fields file changes, or when asked to (e.g., on SIGHUP), without stopping the PPM.
+ *
+ * The new snapshot is built on the reloader's thread and published with an atomic pointer swap; the consumer picks it
+ * up between messages by comparing get_generation with the generation it applied last, so it never waits for a build.
+ * Snapshots in use stay alive until the last handler lets go of them. A build that fails is logged and the current
+ * snapshot is kept. The geofence index is reused when neither the map file nor the privacy.filter.geofence settings
+ * changed, since it is by far the slowest part to build; when only the delta file changed, it is applied to the tree
+ * the previous snapshot parsed from the map file instead of parsing the map again.
+ *
+ * Only the snapshot settings are reloaded; the Kafka settings and the privacy.filter.* and privacy.redaction.* ON/OFF
+ * switches keep their start up values.
+ */
+class PrivacyReloader {
+    public:
+        static constexpr uint32_t kDefaultInterval = 0;         ///< Milliseconds between file checks when privacy.reload.interval is not set; 0 only reloads on request.
+
+        /**
+         * @brief What identifies a version of a watched file.
+         */
+        struct FileStamp {
+            bool exists;                            ///< Whether the file could be found.
+            int64_t mtime_ns;                       ///< Last modification time, in nanoseconds.
+            int64_t size;                           ///< Size in bytes.
+            uint64_t inode;                         ///< Inode; changes when a new file is renamed into place.
+
+            FileStamp() : exists{ false }, mtime_ns{ 0 }, size{ 0 }, inode{ 0 } {}
+
+            bool operator==( const FileStamp& other ) const;
+            bool operator!=( const FileStamp& other ) const;
+        };
+
+        /**
+         * @brief Counters describing the reloads.
+         */
+        struct Stats {
+            uint64_t requests;                      ///< Reloads asked for with request.
+            uint64_t reloads;                       ///< Snapshots built and published.
+            uint64_t failures;                      ///< Builds that failed; the snapshot was kept.
+
+            Stats() : requests{ 0 }, reloads{ 0 }, failures{ 0 } {}
+        };
+
+        /**
+         * @brief Construct a reloader; the thread is not started.
+         *
+         * @param config_file the PPM configuration file to re-read.
+         * @param mapfile_override the map file given on the command line, which takes precedence over
+         * privacy.filter.geofence.mapfile; empty when not given.
+         * @param initial the snapshot the PPM started with; it must not be null.
+         * @param logger the logger for reload messages; may be null.
+         */
+        PrivacyReloader( const std::string& config_file, const std::string& mapfile_override, PrivacySnapshot::CPtr initial,
+                         std::shared_ptr<PpmLogger> logger );
+
+        /**
+         * @brief Stop the thread, if running.
+         */
+        ~PrivacyReloader();
+
+        PrivacyReloader( const PrivacyReloader& ) = delete;
+        PrivacyReloader& operator=( const PrivacyReloader& ) = delete;
+
+        /**
+         * @brief Start the reloader thread. It checks the watched files every privacy.reload.interval milliseconds of
+         * the initial configuration and wakes up for every request.
+         */
+        void start();
+
+        /**
+         * @brief Stop the reloader thread and wait for it; a build in progress is finished first.
+         */
+        void stop();
+
+        /**
+         * @brief Ask the thread for a reload, whether or not any file changed. Not async-signal-safe; a signal handler
+         * should set a flag that the caller turns into a request.
+         */
+        void request();
+
+        /**
+         * @brief Build a new snapshot from the current files and publish it, on the calling thread.
+         *
+         * @return true if a snapshot was published; false if the build failed and the current one was kept.
+         */
+        bool reload();
+
+        /**
+         * @brief Predicate indicating whether any watched file changed since the last build.
+         *
+         * @return true if the configuration, map, delta or general redaction fields file changed; false otherwise.
+         */
+        bool changed() const;
+
+        /**
+         * @brief Return the snapshot most recently published.
+         *
+         * @return The current snapshot.
+         */
+        PrivacySnapshot::CPtr current() const;
+
+        /**
+         * @brief Return the generation of the snapshot most recently published; cheap enough to call for every
+         * message.
+         *
+         * @return The generation of the current snapshot.
+         */
+        uint64_t get_generation() const;
+
+        /**
+         * @brief Return the reload counters.
+         *
+         * @return A copy of the counters.
+         */
+        Stats get_stats() const;
+
+        /**
+         * @brief Return the stamp of a file.
+         *
+         * @param path the file.
+         * @return The stamp; exists is false if the file cannot be found.
+         */
+        static FileStamp stamp( const std::string& path );
+
+        /**
+         * @brief Read a PPM configuration file into key-value pairs, as PPM::configure does.
+         *
+         * @param path the configuration file.
+         * @return The settings in the file.
+         * @throws std::runtime_error when the file cannot be read.
+         */
+        static ConfigMap read_configuration( const std::string& path );
+
+    private:
+        std::string config_file_;                           ///< The configuration file.
+        std::string mapfile_override_;                      ///< The command line map file; empty if not given.
+        std::string fields_file_;                           ///< The general redaction fields file; empty if not set.
+        uint32_t interval_ms_;                              ///< Milliseconds between file checks; 0 to only reload on request.
+        std::shared_ptr<PpmLogger> logger_;                 ///< The logger; may be null.
+
+        PrivacySnapshot::CPtr current_;                     ///< The published snapshot; accessed with atomic_load and atomic_store.
+        std::atomic<uint64_t> generation_;                  ///< The generation of current_.
+
+        mutable std::mutex build_mutex_;                    ///< Serializes builds and guards the members below.
+        std::vector<std::string> watched_;                  ///< The files checked for changes.
+        std::vector<FileStamp> stamps_;                     ///< The stamps of the watched files at the last build.
+        std::string geofence_key_;                          ///< The geofence settings and map stamp the current index was built with.
+        FileStamp delta_stamp_;                             ///< The stamp of the delta file the current index was built with.
+
+        mutable std::mutex stats_mutex_;                    ///< Guards the counters; never held during a build.
+        Stats stats_;                                       ///< The counters.
+
+        std::mutex mutex_;                                  ///< Guards the thread flags.
+        std::condition_variable wake_;                      ///< Wakes the thread for requests and stop.
+        bool requested_;                                    ///< A reload was requested.
+        bool stopping_;                                     ///< The thread should exit.
+        std::thread worker_;                                ///< The reloader thread.
+
+        /**
+         * @brief The reloader thread: wait for a request or the next check, then reload if needed.
+         */
+        void run();
+
+        /**
+         * @brief Return the map file for a configuration: the override if given, else privacy.filter.geofence.mapfile.
+         */
+        std::string mapfile_for( const ConfigMap& conf ) const;
+
+        /**
+         * @brief Return the geofence delta file for a configuration; empty when not configured.
+         */
+        std::string delta_for( const ConfigMap& conf ) const;
+
+        /**
+         * @brief Return what the geofence index of a configuration depends on, except for the contents of the delta
+         * file: its privacy.filter.geofence settings, its map file and the map file's stamp.
+         */
+        std::string geofence_key_for( const ConfigMap& conf ) const;
+
+        /**
+         * @brief Set the watched files for a configuration and record their stamps. Called with build_mutex_ held.
+         */
+        void watch( const ConfigMap& conf );
+};
+
+#endif
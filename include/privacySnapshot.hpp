@@ -0,0 +1,81 @@
+/**
+ * @file
+ * @version
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory.
+ */
+
+#ifndef CVDP_PRIVACY_SNAPSHOT_H
+#define CVDP_PRIVACY_SNAPSHOT_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "cvlib.hpp"
+#include "geofenceBuilder.hpp"
+#include "velocityFilter.hpp"
+#include "idRedactor.hpp"
+#include "general-redaction/redactionPropertiesManager.hpp"
+
+/**
+ * @brief A PrivacySnapshot holds everything a BSMHandler needs from the privacy configuration that can change while
+ * the PPM runs: the geofence index, the velocity filter, the id redactor and the general redaction fields.
+ *
+ * A snapshot is built once and never modified, so a new one can be built in the background while messages are
+ * processed with the current one, and then swapped in between messages (see PrivacyReloader and BSMHandler::apply).
+ */
+class PrivacySnapshot {
+    public:
+        using CPtr = std::shared_ptr<const PrivacySnapshot>;
+
+        /**
+         * @brief Construct a snapshot of a configuration.
+         *
+         * @param conf the privacy configuration; the velocity filter and id redactor are built from it.
+         * @param mapfile the map file the geofence index was loaded from.
+         * @param index the geofence index; may be null.
+         * @param base the tree parsed from the map file before the geofence delta was applied; null when no delta file
+         * is configured.
+         * @param rpm the general redaction fields, as loaded from fieldsToRedact.txt.
+         * @param generation the number of this snapshot; 0 for the one the PPM starts with.
+         */
+        PrivacySnapshot( const ConfigMap& conf, const std::string& mapfile, GeofenceIndex::CPtr index, Quad::Ptr base,
+                         const RedactionPropertiesManager& rpm, uint64_t generation = 0 );
+
+        const ConfigMap& get_configuration() const;                         ///< @return the privacy configuration.
+        const std::string& get_mapfile() const;                             ///< @return the map file of the geofence.
+        const GeofenceIndex::CPtr& get_geofence_index() const;              ///< @return the geofence index; may be null.
+        const Quad::Ptr& get_geofence_base() const;                         ///< @return the tree the geofence delta is applied to; may be null.
+        const VelocityFilter& get_velocity_filter() const;                  ///< @return the velocity filter.
+        const IdRedactor& get_id_redactor() const;                          ///< @return the id redactor; handlers copy it.
+        const RedactionPropertiesManager& get_redaction_properties() const; ///< @return the general redaction fields.
+        uint64_t get_generation() const;                                    ///< @return the number of this snapshot.
+
+    private:
+        ConfigMap conf_;                                    ///< The privacy configuration.
+        std::string mapfile_;                               ///< The map file of the geofence.
+        GeofenceIndex::CPtr geofence_index_;                ///< The geofence index.
+        Quad::Ptr geofence_base_;                           ///< The tree the geofence delta is applied to.
+        VelocityFilter velocity_filter_;                    ///< The velocity filter.
+        IdRedactor id_redactor_;                            ///< The id redactor.
+        RedactionPropertiesManager rpm_;                    ///< The general redaction fields.
+        uint64_t generation_;                               ///< The number of this snapshot.
+};
+
+#endif
@@ -18,6 +18,7 @@ void BSM::reset() {
     id_ = "";
     oid_ = "";
     partII_ = "";
+    coreData_ = "";
 }
 
 std::string BSM::logString() {
@@ -29,6 +29,7 @@
 #include <sstream>
 #include <random>
 #include <limits>
+#include <cstring>
 
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
@@ -48,15 +49,25 @@ BSMHandler::ResultStringMap BSMHandler::result_string_map{
         };
 
 BSMHandler::BSMHandler(Quad::Ptr quad_ptr, const ConfigMap& conf, std::shared_ptr<PpmLogger> logger ):
+    arena_{ JsonArena::kDefaultCapacity },
     activated_{0},
+    finalized_{ false },
     result_{ ResultStatus::SUCCESS },
     bsm_{},
     quad_ptr_{quad_ptr},
-    finalized_{ false },
+    geofence_index_{},
+    hints_{},
     json_{},
+    input_{},
+    member_{},
     vf_{ conf },
     idr_{ conf },
-    box_extension_{ 10.0 },
+    box_extension_{ kDefaultBoxExtension },
+    stream_{},
+    stream_parse_{ true },
+    prefilter_{},
+    prefilter_on_{ true },
+    geofence_{ Geofence::UNCHECKED },
     logger_{ logger }
 {
     if (logger_ == nullptr) {
@@ -91,66 +102,411 @@ BSMHandler::BSMHandler(Quad::Ptr quad_ptr, const ConfigMap& conf, std::shared_pt
         activate<BSMHandler::kGeneralRedactFlag>();
     }
 
+    search = conf.find("privacy.parse.streaming");
+    if ( search != conf.end() && search->second!="ON" ) {
+        stream_parse_ = false;
+    }
+
+    search = conf.find("privacy.parse.prefilter");
+    if ( search != conf.end() && search->second!="ON" ) {
+        prefilter_on_ = false;
+    }
+
+    stream_.set_redaction_paths( rpm.getFields() );
+    redactionTrie = RedactionTrie{ rpm.getFields() };
+
+    search = conf.find("privacy.parse.arena");
+    if ( search != conf.end() ) {
+        arena_ = JsonArena{ std::stoul( search->second ) };
+    }
+
     search = conf.find("privacy.filter.geofence.extension");
     if ( search != conf.end() ) {
         box_extension_ = std::stod( search->second );
     }
+
+    std::size_t hint_capacity = GeofenceHintCache::kDefaultCapacity;
+    search = conf.find("privacy.filter.geofence.hints");
+    if ( search != conf.end() ) {
+        hint_capacity = std::stoul( search->second );
+    }
+
+    uint32_t hint_ttl = GeofenceHintCache::kDefaultTimeToLive;
+    search = conf.find("privacy.filter.geofence.hints.ttl");
+    if ( search != conf.end() ) {
+        hint_ttl = static_cast<uint32_t>( std::stoul( search->second ) );
+    }
+
+    hints_ = GeofenceHintCache{ hint_capacity, hint_ttl };
+
+    if (quad_ptr_) {
+        geofence_index_ = GeofenceBuilder{ conf, logger_ }.build_index( quad_ptr_ );
+    }
+}
+
+void BSMHandler::set_geofence_index( GeofenceIndex::CPtr index ) {
+    geofence_index_ = index;
+    hints_.clear();
+}
+
+void BSMHandler::apply( const PrivacySnapshot& snapshot ) {
+    if (snapshot.get_geofence_index() != geofence_index_) {
+        set_geofence_index( snapshot.get_geofence_index() );
+    }
+
+    vf_ = snapshot.get_velocity_filter();
+    idr_ = snapshot.get_id_redactor();
+    rpm = snapshot.get_redaction_properties();
+    stream_.set_redaction_paths( rpm.getFields() );
+    redactionTrie = RedactionTrie{ rpm.getFields() };
+}
+
+void BSMHandler::set_stream_parse( bool streaming ) {
+    stream_parse_ = streaming;
+}
+
+bool BSMHandler::is_stream_parse() const {
+    return stream_parse_;
+}
+
+void BSMHandler::set_prefilter( bool on ) {
+    prefilter_on_ = on;
+}
+
+bool BSMHandler::is_prefilter() const {
+    return prefilter_on_;
 }
 
 bool BSMHandler::isWithinEntity(BSM &bsm) const {
-    geo::Circle::CPtr circle_ptr = nullptr;
-    geo::EdgeCPtr edge_ptr = nullptr;
-    geo::Grid::CPtr grid_ptr = nullptr;
-    geo::AreaPtr area_ptr = nullptr;
+    return geofence_index_ && geofence_index_->is_within_entity(bsm);
+}
 
-    geo::Entity::PtrList entity_set = quad_ptr_->retrieve_elements(bsm); 
+bool BSMHandler::isWithinEntity(BSM &bsm, const std::string& vehicle_id) {
+    return geofence_index_ && hints_.is_within_entity(*geofence_index_, vehicle_id, bsm);
+}
 
-    for (auto& entity_ptr : entity_set) {
+bool BSMHandler::process( const std::string& bsm_json ) {
+    finalized_ = false;
+    result_ = ResultStatus::SUCCESS;
+    geofence_ = Geofence::UNCHECKED;
 
-        edge_ptr = std::static_pointer_cast<const geo::Edge>(entity_ptr); 
+    // nothing of the previous message may remain, even when the scan decides this one.
+    bsm_.reset();
 
-        if (entity_ptr->get_type() == "edge") {
-            edge_ptr = std::static_pointer_cast<const geo::Edge>(entity_ptr); 
-            area_ptr = edge_ptr->to_area(box_extension_);
+    if (prefilter_on_ && prefilter( bsm_json )) {
+        return false;
+    }
 
-            if (area_ptr->contains(bsm)) {
-                return true;
-            }
+    if (stream_parse_) {
+        if (!stream_.parse( bsm_json, is_active<kSizeRedactFlag>(), is_active<kGeneralRedactFlag>() )) {
+            result_ = ResultStatus::PARSE;
 
-        }  else if (entity_ptr->get_type() == "circle") {
-            circle_ptr = std::static_pointer_cast<const geo::Circle>(entity_ptr);
+            return false;
+        }
 
-            if (circle_ptr->contains(bsm)) {
-                return true;
-            }
+        if (!stream_.needs_dom()) {
+            return process_stream();
+        }
+    }
 
-        } else  if (entity_ptr->get_type() == "grid") {
-            grid_ptr = std::static_pointer_cast<const geo::Grid>(entity_ptr); 
+    return process_dom( bsm_json );
+}
 
-            if (grid_ptr->contains(bsm)) {
-                return true;
-            }
+bool BSMHandler::process( const char* bsm_json, std::size_t length ) {
+    // the one copy of the message; the DOM path then parses it in place.
+    input_.assign( bsm_json, length );
+    return process( input_ );
+}
+
+bool BSMHandler::prefilter( const std::string& bsm_json ) {
+    using Field = BSMStreamHandler::Field;
+
+    bool velocity = is_active<kVelocityFilterFlag>();
+    bool geofence = is_active<kGeofenceFilterFlag>();
+
+    if ((!velocity && !geofence) || !prefilter_.scan( bsm_json )) {
+        return false;
+    }
+
+    // only a message that passes every check of process is decided here; the rest get the full processing.
+    auto present = [this]( Field field ) { return prefilter_.get( field ).present; };
+    auto type = [this]( Field field ) { return prefilter_.get( field ).type; };
+    auto is_double = [this]( Field field ) { return prefilter_.get( field ).is_double; };
+    auto number = [this]( Field field ) { return prefilter_.get( field ).number; };
+
+    if (!present( Field::METADATA ) || !present( Field::SANITIZED ) || !present( Field::PAYLOAD_TYPE )) {
+        return false;
+    }
+
+    if ((type( Field::SANITIZED ) != rapidjson::kTrueType && type( Field::SANITIZED ) != rapidjson::kFalseType) ||
+        type( Field::PAYLOAD_TYPE ) != rapidjson::kStringType) {
+        return false;
+    }
+
+    const std::string& payload_type_str = prefilter_.get( Field::PAYLOAD_TYPE ).text;
 
+    if (payload_type_str == "us.dot.its.jpo.ode.model.OdeBsmPayload") {
+        if (!present( Field::PAYLOAD ) || !present( Field::DATA ) || !present( Field::CORE_DATA ) ||
+            !present( Field::POSITION ) || !present( Field::ID ) || type( Field::ID ) != rapidjson::kStringType ||
+            !is_double( Field::SPEED ) || !is_double( Field::LATITUDE ) || !is_double( Field::LONGITUDE )) {
+            return false;
+        }
+
+        double speed = number( Field::SPEED );
+        bool speed_suppressed = velocity && vf_.suppress(speed);
+
+        if (!speed_suppressed && !geofence) {
+            return false;
+        }
+
+        bsm_.set_velocity(speed);
+        bsm_.set_latitude( number( Field::LATITUDE ) );
+        bsm_.set_longitude( number( Field::LONGITUDE ) );
+
+        std::string id = prefilter_.get( Field::ID ).text;
+
+        bool outside = geofence && !isWithinEntity(bsm_, id);
+        if (!speed_suppressed && !outside) {
+            // retained; process reuses the answer, so the vehicle's hint is consulted once.
+            geofence_ = Geofence::INSIDE;
+            return false;
+        }
+
+        // as process: a position outside the geofence overrides the speed, and the id is still redacted.
+        result_ = outside ? ResultStatus::GEOPOSITION : ResultStatus::SPEED;
+
+        if (is_active<kIdRedactFlag>()) {
+            bsm_.set_original_id(id);
+            idr_(id);
+        }
+
+        bsm_.set_id(id);
+
+        return true;
+    }
+
+    if (payload_type_str == "us.dot.its.jpo.ode.model.OdeTimPayload") {
+        if (!present( Field::RECEIVED_DETAILS ) || !present( Field::LOCATION ) || !is_double( Field::TIM_LATITUDE ) ||
+            !is_double( Field::TIM_LONGITUDE ) || !is_double( Field::TIM_SPEED )) {
+            return false;
+        }
+
+        double speed = number( Field::TIM_SPEED );
+
+        bsm_.set_latitude( number( Field::TIM_LATITUDE ) );
+        bsm_.set_longitude( number( Field::TIM_LONGITUDE ) );
+        bsm_.set_velocity(speed);
+
+        bool outside = geofence && !isWithinEntity(bsm_);
+        bool speed_suppressed = velocity && vf_.suppress(speed);
+
+        if (!outside && !speed_suppressed) {
+            if (geofence) geofence_ = Geofence::INSIDE;
+            return false;
         }
+
+        // as process: the speed overrides a position outside the geofence.
+        result_ = speed_suppressed ? ResultStatus::SPEED : ResultStatus::GEOPOSITION;
+
+        return true;
     }
+
     return false;
 }
 
-bool BSMHandler::process( const std::string& bsm_json ) {
+bool BSMHandler::within_geofence( const std::string* vehicle_id ) {
+    if (geofence_ == Geofence::INSIDE) {
+        return true;
+    }
+
+    return vehicle_id ? isWithinEntity(bsm_, *vehicle_id) : isWithinEntity(bsm_);
+}
+
+bool BSMHandler::process_stream() {
+    using Field = BSMStreamHandler::Field;
+
+    // the checks of process_dom, in the same order, on the fields the stream handler recorded.
+    auto missing = [this]( Field field ) { return !stream_.get( field ).present; };
+    auto is_double = [this]( Field field ) { return stream_.get( field ).is_double; };
+    auto number = [this]( Field field ) { return stream_.get( field ).number; };
+
+    if (missing( Field::METADATA )) {
+        result_ = ResultStatus::MISSING;
+
+        return false;
+    }
+
+    if (missing( Field::SANITIZED )) {
+        result_ = ResultStatus::MISSING;
+
+        return false;
+    }
+
+    rapidjson::Type sanitized_type = stream_.get( Field::SANITIZED ).type;
+    if (sanitized_type != rapidjson::kTrueType && sanitized_type != rapidjson::kFalseType) {
+        result_ = ResultStatus::OTHER;
+
+        return false;
+    }
+
+    if (missing( Field::PAYLOAD_TYPE )) {
+        result_ = ResultStatus::MISSING;
+
+        return false;
+    }
+
+    if (stream_.get( Field::PAYLOAD_TYPE ).type != rapidjson::kStringType) {
+        result_ = ResultStatus::OTHER;
+
+        return false;
+    }
+
+    const char* payload_type_str = stream_.get( Field::PAYLOAD_TYPE ).text.c_str();
+
+    // the id written out; the original unless it is redacted.
+    std::string output_id = stream_.get( Field::ID ).text;
+
+    if (std::strcmp(payload_type_str, "us.dot.its.jpo.ode.model.OdeBsmPayload") == 0) {
+        if (missing( Field::PAYLOAD ) || missing( Field::DATA ) || missing( Field::CORE_DATA ) || missing( Field::SPEED )) {
+            result_ = ResultStatus::MISSING;
+
+            return false;
+        }
+
+        if (!is_double( Field::SPEED )) {
+            result_ = ResultStatus::OTHER;
+
+            return false;
+        }
+
+        double speed = number( Field::SPEED );
+        bsm_.set_velocity(speed);
+
+        if (is_active<kVelocityFilterFlag>() && vf_.suppress(speed)) {
+            result_ = ResultStatus::SPEED;
+        }
+
+        if (missing( Field::POSITION ) || missing( Field::LATITUDE ) || missing( Field::LONGITUDE )) {
+            result_ = ResultStatus::MISSING;
+
+            return false;
+        }
+
+        if (!is_double( Field::LATITUDE ) || !is_double( Field::LONGITUDE )) {
+            result_ = ResultStatus::OTHER;
+
+            return false;
+        }
+
+        bsm_.set_latitude( number( Field::LATITUDE ) );
+        bsm_.set_longitude( number( Field::LONGITUDE ) );
+
+        if (missing( Field::ID )) {
+            result_ = ResultStatus::MISSING;
+
+            return false;
+        }
+
+        if (stream_.get( Field::ID ).type != rapidjson::kStringType) {
+            result_ = ResultStatus::OTHER;
+
+            return false;
+        }
+
+        std::string id = stream_.get( Field::ID ).text.c_str();
+
+        // the geofence hints follow each vehicle by its id before redaction.
+        if (is_active<kGeofenceFilterFlag>() && !within_geofence(&id)) {
+            result_ = ResultStatus::GEOPOSITION;
+        }
+
+        if (is_active<kIdRedactFlag>()) {
+            bsm_.set_original_id(id);
+            idr_(id);
+            output_id = id;
+        }
+
+        bsm_.set_id(id);
+
+        // the size was redacted as it was written.
+        if (is_active<kGeneralRedactFlag>()) {
+            stream_.redact( redactionTrie );
+            log_unredacted_paths();
+
+            if (stream_.write_data_member( "coreData", output_id, member_ )) {
+                bsm_.set_coreData(member_);
+            }
+
+            if (stream_.write_data_member( "partII", output_id, member_ )) {
+                bsm_.set_partII(member_);
+            }
+        }
+    }
+    else if (std::strcmp(payload_type_str, "us.dot.its.jpo.ode.model.OdeTimPayload") == 0) {
+        if (missing( Field::RECEIVED_DETAILS ) || missing( Field::LOCATION )) {
+            result_ = ResultStatus::MISSING;
+
+            return false;
+        }
+
+        if (missing( Field::TIM_LATITUDE ) || missing( Field::TIM_LONGITUDE ) || missing( Field::TIM_SPEED )) {
+            result_ = ResultStatus::MISSING;
+
+            return false;
+        }
+
+        if (!is_double( Field::TIM_LATITUDE ) || !is_double( Field::TIM_LONGITUDE ) || !is_double( Field::TIM_SPEED )) {
+            result_ = ResultStatus::OTHER;
+
+            return false;
+        }
+
+        double speed = number( Field::TIM_SPEED );
+
+        bsm_.set_latitude( number( Field::TIM_LATITUDE ) );
+        bsm_.set_longitude( number( Field::TIM_LONGITUDE ) );
+        bsm_.set_velocity(speed);
+
+        if (is_active<kGeofenceFilterFlag>() && !within_geofence(nullptr)) {
+            result_ = ResultStatus::GEOPOSITION;
+        }
+
+        if (is_active<kVelocityFilterFlag>() && vf_.suppress(speed)) {
+            result_ = ResultStatus::SPEED;
+        }
+    }
+    else {
+        result_ = ResultStatus::MISSING;
+
+        return false;
+    }
+
+    stream_.finish( output_id, json_ );
+    finalized_ = true;
+
+    return result_ == ResultStatus::SUCCESS;
+}
+
+bool BSMHandler::process_dom( const std::string& bsm_json ) {
     double speed = 0.0;
     double latitude = 0.0;
     double longitude = 0.0;
     std::string id;
     
     // JMC: Attempt to fix memory leak; build and destroy JSON object each time to ensure memory is reclaimed.
-    rapidjson::Document document;
+    // The document's memory comes from the arena, which the scope resets once the document is destroyed.
+    JsonArena::Scope scope{ arena_ };
+    JsonArena::Document document{ &arena_.get_allocator(), JsonArena::kDocumentStackCapacity, &arena_.get_stack_allocator() };
+
+    // the DOM is parsed in place, so its strings point into input_ rather than being copied into the arena; the
+    // caller's string is copied there first unless it is input_ already.
+    if (&bsm_json != &input_) {
+        input_.assign( bsm_json );
+    }
 
-    finalized_ = false;
-    result_ = ResultStatus::SUCCESS;
-    
     // create the DOM
     // check for errors
-    if (document.Parse(bsm_json.c_str()).HasParseError()) {
+    if (document.ParseInsitu(&input_[0]).HasParseError()) {
         result_ = ResultStatus::PARSE;
 
         return false;
@@ -198,9 +554,9 @@ bool BSMHandler::process( const std::string& bsm_json ) {
         return false;
     }
 
-    std::string payload_type_str = metadata["payloadType"].GetString();
+    const char* payload_type_str = metadata["payloadType"].GetString();
 
-    if (payload_type_str == "us.dot.its.jpo.ode.model.OdeBsmPayload") {
+    if (std::strcmp(payload_type_str, "us.dot.its.jpo.ode.model.OdeBsmPayload") == 0) {
         if (!document.HasMember("payload")) {
             result_ = ResultStatus::MISSING;
 
@@ -271,10 +627,6 @@ bool BSMHandler::process( const std::string& bsm_json ) {
         bsm_.set_latitude(latitude); 
         bsm_.set_longitude(longitude); 
 
-        if (is_active<kGeofenceFilterFlag>() && !isWithinEntity(bsm_)) {
-            result_ = ResultStatus::GEOPOSITION;
-        }
-
         if (!core_data.HasMember("id")) {
             result_ = ResultStatus::MISSING;
 
@@ -289,6 +641,11 @@ bool BSMHandler::process( const std::string& bsm_json ) {
 
         id = core_data["id"].GetString();
 
+        // the geofence hints follow each vehicle by its id before redaction.
+        if (is_active<kGeofenceFilterFlag>() && !within_geofence(&id)) {
+            result_ = ResultStatus::GEOPOSITION;
+        }
+
         if (is_active<kIdRedactFlag>()) {
             bsm_.set_original_id(id);
             idr_(id);
@@ -318,7 +675,7 @@ bool BSMHandler::process( const std::string& bsm_json ) {
 
         handleGeneralRedaction(document); // uses fieldsToRedact.txt
     }
-    else if (payload_type_str == "us.dot.its.jpo.ode.model.OdeTimPayload") {
+    else if (std::strcmp(payload_type_str, "us.dot.its.jpo.ode.model.OdeTimPayload") == 0) {
         if (!metadata.HasMember("receivedMessageDetails")) {
             result_ = ResultStatus::MISSING;
 
@@ -355,7 +712,7 @@ bool BSMHandler::process( const std::string& bsm_json ) {
         bsm_.set_longitude(longitude); 
         bsm_.set_velocity(speed); 
 
-        if (is_active<kGeofenceFilterFlag>() && !isWithinEntity(bsm_)) {
+        if (is_active<kGeofenceFilterFlag>() && !within_geofence(nullptr)) {
             result_ = ResultStatus::GEOPOSITION;
         }
 
@@ -372,10 +729,8 @@ bool BSMHandler::process( const std::string& bsm_json ) {
     // JMC: Moving this here to finalize the json string instead of in get_json()
     // JMC: Go ahead and write out the BSM in redacted form using the document that we built in
     // JMC: this method.
-    rapidjson::StringBuffer buffer;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-    document.Accept(writer);
-    json_ = buffer.GetString();
+    document.Accept(arena_.start_output());
+    json_.assign(arena_.get_output().GetString(), arena_.get_output().GetSize());
 
     // TODO: if we keep this model, this variable serves no purpose.
     finalized_ = true;
@@ -383,24 +738,34 @@ bool BSMHandler::process( const std::string& bsm_json ) {
     return result_ == ResultStatus::SUCCESS;
 }
 
-void BSMHandler::handleGeneralRedaction(rapidjson::Document& document) {
+void BSMHandler::handleGeneralRedaction(rapidjson::Value& document) {
     if (is_active<kGeneralRedactFlag>()) {
-        for (std::string memberPath : rpm.getFields()) {
-            bool memberRedacted = rapidjsonRedactor.redactMemberByPath(document, memberPath.c_str());
-            if (!memberRedacted) {
-                logger_->info("Member not found while handling general redaction! Path: '" + memberPath + "'");
-            }
-        }
+        redactionTrie.redact(document);
+        log_unredacted_paths();
 
-        // attempt to store the redacted coreData and partII in the BSM object
+        // attempt to store the redacted coreData and partII in the BSM object; they are written with the arena's
+        // writer, which the whole document is written with afterwards.
         if (document["payload"]["data"].HasMember("coreData")) {
-            std::string coreDataString = rapidjsonRedactor.stringifyValue(document["payload"]["data"]["coreData"]);
-            bsm_.set_coreData(coreDataString);
+            document["payload"]["data"]["coreData"].Accept(arena_.start_output());
+            member_.assign(arena_.get_output().GetString(), arena_.get_output().GetSize());
+            bsm_.set_coreData(member_);
         }
 
         if (document["payload"]["data"].HasMember("partII")) {
-            std::string partIIString = rapidjsonRedactor.stringifyValue(document["payload"]["data"]["partII"]);
-            bsm_.set_partII(partIIString);
+            document["payload"]["data"]["partII"].Accept(arena_.start_output());
+            member_.assign(arena_.get_output().GetString(), arena_.get_output().GetSize());
+            bsm_.set_partII(member_);
+        }
+    }
+}
+
+void BSMHandler::log_unredacted_paths() {
+    // the message is only built for a logger that writes it.
+    if (!logger_->is_info_enabled()) return;
+
+    for (std::size_t i = 0; i < redactionTrie.getPathCount(); ++i) {
+        if (!redactionTrie.isRedacted(i)) {
+            logger_->info("Member not found while handling general redaction! Path: '" + redactionTrie.getPath(i) + "'");
         }
     }
 }
@@ -450,6 +815,21 @@ const double BSMHandler::get_box_extension() const
     return box_extension_;
 }
 
+const GeofenceHintCache& BSMHandler::get_hint_cache() const
+{
+    return hints_;
+}
+
+const JsonArena& BSMHandler::get_arena() const
+{
+    return arena_;
+}
+
+const GeofenceIndex::CPtr& BSMHandler::get_geofence_index() const
+{
+    return geofence_index_;
+}
+
 const VelocityFilter& BSMHandler::get_velocity_filter() const {
     return vf_;
 }
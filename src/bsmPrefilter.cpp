@@ -0,0 +1,333 @@
+/**
+ * @file
+ * @version
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory.
+ */
+
+#include <cstring>
+
+#include "bsmPrefilter.hpp"
+
+namespace {
+
+/**
+ * @brief Catches the number rapidjson parses from a token.
+ */
+struct NumberHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, NumberHandler> {
+    bool is_double = false;
+    double number = 0.0;
+
+    bool Double( double d ) {
+        is_double = true;
+        number = d;
+        return true;
+    }
+};
+
+bool is_digit( char c ) {
+    return c >= '0' && c <= '9';
+}
+
+int hex_value( char c ) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+}
+
+constexpr std::size_t BSMPrefilter::kMaxNumber;
+constexpr int BSMPrefilter::kMaxDepth;
+
+BSMPrefilter::BSMPrefilter() :
+    values_( BSMStreamHandler::kFieldCount ),
+    p_{ nullptr },
+    end_{ nullptr }
+{}
+
+bool BSMPrefilter::scan( const std::string& json ) {
+    for (auto& value : values_) {
+        value.present = false;
+        value.type = rapidjson::kNullType;
+        value.is_double = false;
+        value.number = 0.0;
+        value.text.clear();
+    }
+
+    // rapidjson stops at a NUL.
+    if (std::memchr( json.data(), '\0', json.size() )) return false;
+
+    p_ = json.data();
+    end_ = p_ + json.size();
+
+    skip_whitespace();
+    if (p_ == end_ || *p_ != '{') return false;
+
+    ++p_;
+    if (!scan_object( BSMStreamHandler::kNone, true, 1 )) return false;
+
+    skip_whitespace();
+    return p_ == end_;
+}
+
+const BSMPrefilter::Value& BSMPrefilter::get( Field field ) const {
+    return values_[field];
+}
+
+void BSMPrefilter::skip_whitespace() {
+    while (p_ != end_ && (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t')) ++p_;
+}
+
+void BSMPrefilter::note( Field field, rapidjson::Type type ) {
+    if (field == BSMStreamHandler::kNone) return;
+
+    values_[field].present = true;
+    values_[field].type = type;
+}
+
+bool BSMPrefilter::scan_value( Field field, int depth ) {
+    if (p_ == end_) return false;
+
+    switch (*p_) {
+        case '{':
+            ++p_;
+            note( field, rapidjson::kObjectType );
+            return scan_object( field, false, depth + 1 );
+
+        case '[':
+            ++p_;
+            note( field, rapidjson::kArrayType );
+            return scan_array( depth + 1 );
+
+        case '"': {
+            const char* begin;
+            const char* end;
+            bool escaped;
+            if (!scan_string( begin, end, escaped )) return false;
+
+            note( field, rapidjson::kStringType );
+            if (field == BSMStreamHandler::PAYLOAD_TYPE || field == BSMStreamHandler::ID) {
+                if (escaped) return false;
+                values_[field].text.assign( begin, end );
+            }
+
+            return true;
+        }
+
+        case 't':
+            note( field, rapidjson::kTrueType );
+            return scan_literal( "true" );
+
+        case 'f':
+            note( field, rapidjson::kFalseType );
+            return scan_literal( "false" );
+
+        case 'n':
+            note( field, rapidjson::kNullType );
+            return scan_literal( "null" );
+
+        default:
+            note( field, rapidjson::kNumberType );
+            return scan_number( field );
+    }
+}
+
+bool BSMPrefilter::scan_object( Field role, bool root, int depth ) {
+    if (depth > kMaxDepth) return false;
+
+    skip_whitespace();
+    if (p_ != end_ && *p_ == '}') {
+        ++p_;
+        return true;
+    }
+
+    // only the members of the objects BSMHandler looks into are tracked.
+    bool tracked = root || role != BSMStreamHandler::kNone;
+
+    while (true) {
+        if (p_ == end_ || *p_ != '"') return false;
+
+        const char* begin;
+        const char* end;
+        bool escaped;
+        if (!scan_string( begin, end, escaped )) return false;
+
+        Field field = BSMStreamHandler::kNone;
+        if (tracked) {
+            // rapidjson compares names after unescaping them.
+            if (escaped) return false;
+
+            field = BSMStreamHandler::child_field( role, begin, static_cast<rapidjson::SizeType>( end - begin ), root );
+            if (field != BSMStreamHandler::kNone && values_[field].present) {
+                field = BSMStreamHandler::kNone;
+            }
+        }
+
+        skip_whitespace();
+        if (p_ == end_ || *p_ != ':') return false;
+        ++p_;
+        skip_whitespace();
+
+        // a field names an object only when its value is one.
+        if (!scan_value( field, depth )) return false;
+
+        skip_whitespace();
+        if (p_ == end_) return false;
+
+        if (*p_ == ',') {
+            ++p_;
+            skip_whitespace();
+        } else if (*p_ == '}') {
+            ++p_;
+            return true;
+        } else {
+            return false;
+        }
+    }
+}
+
+bool BSMPrefilter::scan_array( int depth ) {
+    if (depth > kMaxDepth) return false;
+
+    skip_whitespace();
+    if (p_ != end_ && *p_ == ']') {
+        ++p_;
+        return true;
+    }
+
+    while (true) {
+        if (!scan_value( BSMStreamHandler::kNone, depth )) return false;
+
+        skip_whitespace();
+        if (p_ == end_) return false;
+
+        if (*p_ == ',') {
+            ++p_;
+            skip_whitespace();
+        } else if (*p_ == ']') {
+            ++p_;
+            return true;
+        } else {
+            return false;
+        }
+    }
+}
+
+bool BSMPrefilter::scan_string( const char*& begin, const char*& end, bool& escaped ) {
+    ++p_;
+    begin = p_;
+    escaped = false;
+
+    while (p_ != end_) {
+        unsigned char c = static_cast<unsigned char>( *p_ );
+
+        if (c == '"') {
+            end = p_++;
+            return true;
+        }
+
+        if (c < 0x20) return false;
+
+        if (c == '\\') {
+            escaped = true;
+            if (++p_ == end_) return false;
+
+            switch (*p_) {
+                case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+                    break;
+
+                case 'u': {
+                    if (end_ - p_ < 5) return false;
+
+                    int code = 0;
+                    for (int i = 1; i <= 4; ++i) {
+                        int h = hex_value( p_[i] );
+                        if (h < 0) return false;
+                        code = code * 16 + h;
+                    }
+
+                    // surrogate pairs are left to rapidjson.
+                    if (code >= 0xD800 && code <= 0xDFFF) return false;
+
+                    p_ += 4;
+                    break;
+                }
+
+                default:
+                    return false;
+            }
+        }
+
+        ++p_;
+    }
+
+    return false;
+}
+
+bool BSMPrefilter::scan_number( Field field ) {
+    const char* begin = p_;
+
+    if (p_ != end_ && *p_ == '-') ++p_;
+    if (p_ == end_ || !is_digit( *p_ )) return false;
+
+    if (*p_ == '0') {
+        ++p_;
+    } else {
+        while (p_ != end_ && is_digit( *p_ )) ++p_;
+    }
+
+    if (p_ != end_ && *p_ == '.') {
+        ++p_;
+        if (p_ == end_ || !is_digit( *p_ )) return false;
+        while (p_ != end_ && is_digit( *p_ )) ++p_;
+    }
+
+    if (p_ != end_ && (*p_ == 'e' || *p_ == 'E')) {
+        ++p_;
+        if (p_ != end_ && (*p_ == '+' || *p_ == '-')) ++p_;
+
+        const char* exponent = p_;
+        while (p_ != end_ && is_digit( *p_ )) ++p_;
+        if (p_ == exponent || p_ - exponent > 2) return false;
+    }
+
+    if (static_cast<std::size_t>( p_ - begin ) > kMaxNumber) return false;
+
+    if (field == BSMStreamHandler::kNone) return true;
+
+    // rapidjson converts the token, so the value is the one the full parse gives.
+    std::string token{ begin, p_ };
+    rapidjson::StringStream stream{ token.c_str() };
+    NumberHandler handler;
+    rapidjson::Reader reader;
+    if (reader.Parse( stream, handler ).IsError()) return false;
+
+    values_[field].is_double = handler.is_double;
+    values_[field].number = handler.number;
+    return true;
+}
+
+bool BSMPrefilter::scan_literal( const char* literal ) {
+    std::size_t length = std::strlen( literal );
+    if (static_cast<std::size_t>( end_ - p_ ) < length || std::memcmp( p_, literal, length ) != 0) return false;
+
+    p_ += length;
+    return true;
+}
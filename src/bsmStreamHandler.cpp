@@ -0,0 +1,612 @@
+/**
+ * @file
+ * @version
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "bsmStreamHandler.hpp"
+
+namespace {
+
+const char kIdPlaceholder[] = "\x01";
+const char kBsmPayloadType[] = "us.dot.its.jpo.ode.model.OdeBsmPayload";
+
+bool equals( const char* str, rapidjson::SizeType length, const char* name ) {
+    return std::strlen( name ) == length && std::memcmp( str, name, length ) == 0;
+}
+
+}
+
+BSMStreamHandler::BSMStreamHandler() :
+    paths_{},
+    values_( kFieldCount ),
+    redact_size_{ false },
+    outline_{ false },
+    object_{ false },
+    needs_dom_{ false },
+    skip_{ 0 },
+    frames_{},
+    nodes_{},
+    node_count_{ 0 },
+    root_{ nullptr },
+    reader_{},
+    out_{},
+    writer_{ out_ },
+    capture_{},
+    capture_writer_{ capture_ },
+    member_{},
+    member_writer_{ member_ },
+    id_{},
+    id_writer_{ id_ }
+{}
+
+BSMStreamHandler::BSMStreamHandler( const BSMStreamHandler& other ) :
+    BSMStreamHandler{}
+{
+    paths_ = other.paths_;
+}
+
+BSMStreamHandler& BSMStreamHandler::operator=( const BSMStreamHandler& other ) {
+    // the rest is the state of one parse.
+    paths_ = other.paths_;
+    return *this;
+}
+
+BSMStreamHandler::Field BSMStreamHandler::child_field( Field parent, const char* key, rapidjson::SizeType length,
+                                                      bool root ) {
+    using F = BSMStreamHandler;
+
+    if (root) {
+        if (equals( key, length, "metadata" )) return F::METADATA;
+        if (equals( key, length, "payload" )) return F::PAYLOAD;
+        return F::kNone;
+    }
+
+    switch (parent) {
+        case F::METADATA:
+            if (equals( key, length, "sanitized" )) return F::SANITIZED;
+            if (equals( key, length, "payloadType" )) return F::PAYLOAD_TYPE;
+            if (equals( key, length, "receivedMessageDetails" )) return F::RECEIVED_DETAILS;
+            break;
+        case F::RECEIVED_DETAILS:
+            if (equals( key, length, "locationData" )) return F::LOCATION;
+            break;
+        case F::LOCATION:
+            if (equals( key, length, "latitude" )) return F::TIM_LATITUDE;
+            if (equals( key, length, "longitude" )) return F::TIM_LONGITUDE;
+            if (equals( key, length, "speed" )) return F::TIM_SPEED;
+            break;
+        case F::PAYLOAD:
+            if (equals( key, length, "data" )) return F::DATA;
+            break;
+        case F::DATA:
+            if (equals( key, length, "coreData" )) return F::CORE_DATA;
+            break;
+        case F::CORE_DATA:
+            if (equals( key, length, "speed" )) return F::SPEED;
+            if (equals( key, length, "position" )) return F::POSITION;
+            if (equals( key, length, "id" )) return F::ID;
+            if (equals( key, length, "size" )) return F::SIZE;
+            break;
+        case F::POSITION:
+            if (equals( key, length, "latitude" )) return F::LATITUDE;
+            if (equals( key, length, "longitude" )) return F::LONGITUDE;
+            break;
+        case F::SIZE:
+            if (equals( key, length, "length" )) return F::LENGTH;
+            if (equals( key, length, "width" )) return F::WIDTH;
+            break;
+        default:
+            break;
+    }
+
+    return F::kNone;
+}
+
+void BSMStreamHandler::set_redaction_paths( const std::vector<std::string>& paths ) {
+    paths_.clear();
+
+    // RapidjsonRedactor splits at every dot and keeps empty components.
+    for (auto& path : paths) {
+        std::vector<std::string> components;
+        std::size_t begin = 0;
+        for (std::size_t dot = path.find( '.' ); dot != std::string::npos; dot = path.find( '.', begin )) {
+            components.push_back( path.substr( begin, dot - begin ) );
+            begin = dot + 1;
+        }
+
+        components.push_back( path.substr( begin ) );
+        paths_.push_back( std::move( components ) );
+    }
+}
+
+bool BSMStreamHandler::parse( const std::string& json, bool redact_size, bool outline ) {
+    for (auto& value : values_) {
+        value.present = false;
+        value.type = rapidjson::kNullType;
+        value.is_double = false;
+        value.number = 0.0;
+        value.text.clear();
+    }
+
+    redact_size_ = redact_size;
+    outline_ = outline;
+    object_ = false;
+    needs_dom_ = false;
+    skip_ = 0;
+    frames_.clear();
+    node_count_ = 0;
+    root_ = nullptr;
+    out_.Clear();
+    writer_.Reset( out_ );
+
+    rapidjson::StringStream stream{ json.c_str() };
+    if (reader_.Parse( stream, *this ).IsError()) {
+        return false;
+    }
+
+    return object_;
+}
+
+bool BSMStreamHandler::needs_dom() const {
+    return needs_dom_;
+}
+
+const BSMStreamHandler::Value& BSMStreamHandler::get( Field field ) const {
+    return values_[field];
+}
+
+BSMStreamHandler::Node* BSMStreamHandler::make_node( bool array ) {
+    if (node_count_ == nodes_.size()) {
+        nodes_.emplace_back( new Node{} );
+    }
+
+    Node* node = nodes_[node_count_++].get();
+    node->array = array;
+    node->members.clear();
+    node->cursors.clear();
+    return node;
+}
+
+BSMStreamHandler::Member& BSMStreamHandler::next_member( Node& node ) {
+    // an object's member is added by its key; an array's element by its value.
+    if (node.array) {
+        node.members.add( "", 0 );
+    }
+
+    return node.members.back();
+}
+
+BSMStreamHandler::Member& BSMStreamHandler::MemberList::add( const char* name, std::size_t length ) {
+    if (size_ == slots_.size()) {
+        slots_.push_back( Member{ std::string{}, rapidjson::kNullType, std::string{}, nullptr } );
+    }
+
+    Member& member = slots_[size_++];
+    member.name.assign( name, length );
+    member.type = rapidjson::kNullType;
+    member.text.clear();
+    member.child = nullptr;
+    return member;
+}
+
+void BSMStreamHandler::MemberList::remove( std::size_t index ) {
+    // as rapidjson's RemoveMember, the last member takes the place of the removed one, which keeps its memory.
+    if (index != size_ - 1) {
+        std::swap( slots_[index], slots_[size_ - 1] );
+    }
+
+    --size_;
+}
+
+bool BSMStreamHandler::replace( Field field, rapidjson::Type type, Writer*& writer ) {
+    switch (field) {
+        case SANITIZED:
+            if (type != rapidjson::kFalseType && type != rapidjson::kTrueType) return false;
+            writer->Bool( true );
+            return true;
+
+        case ID:
+            if (type != rapidjson::kStringType) return false;
+            writer->RawValue( kIdPlaceholder, 1, rapidjson::kStringType );
+            return true;
+
+        case LENGTH:
+        case WIDTH:
+            if (!redact_size_) return false;
+
+            if (!values_[PAYLOAD_TYPE].present) {
+                // whether this is a BSM is not known yet.
+                needs_dom_ = true;
+                return false;
+            }
+
+            if (values_[PAYLOAD_TYPE].type != rapidjson::kStringType ||
+                std::strcmp( values_[PAYLOAD_TYPE].text.c_str(), kBsmPayloadType ) != 0) {
+                return false;
+            }
+
+            writer->Int( 0 );
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+BSMStreamHandler::Writer* BSMStreamHandler::start_value( Field& field, Member*& member ) {
+    Frame& top = frames_.back();
+    field = top.pending;
+    top.pending = kNone;
+
+    if (top.node) {
+        // the value of an outlined member is written on its own and kept as text.
+        member = &next_member( *top.node );
+        capture_.Clear();
+        capture_writer_.Reset( capture_ );
+        return &capture_writer_;
+    }
+
+    member = nullptr;
+    return top.writer;
+}
+
+template <typename Write>
+bool BSMStreamHandler::scalar( rapidjson::Type type, Write write ) {
+    if (skip_ > 0 || frames_.empty()) return true;
+
+    Field field;
+    Member* member;
+    Writer* writer = start_value( field, member );
+
+    if (field != kNone) {
+        values_[field].present = true;
+        values_[field].type = type;
+    }
+
+    if (replace( field, type, writer )) {
+        if (field == SANITIZED) type = rapidjson::kTrueType;
+        if (field == LENGTH || field == WIDTH) type = rapidjson::kNumberType;
+    } else {
+        write( *writer );
+    }
+
+    if (member) {
+        member->type = type;
+        member->text.assign( capture_.GetString(), capture_.GetSize() );
+    }
+
+    return true;
+}
+
+bool BSMStreamHandler::Null() {
+    return scalar( rapidjson::kNullType, []( Writer& w ) { w.Null(); } );
+}
+
+bool BSMStreamHandler::Bool( bool b ) {
+    return scalar( b ? rapidjson::kTrueType : rapidjson::kFalseType, [b]( Writer& w ) { w.Bool( b ); } );
+}
+
+bool BSMStreamHandler::Int( int i ) {
+    return scalar( rapidjson::kNumberType, [i]( Writer& w ) { w.Int( i ); } );
+}
+
+bool BSMStreamHandler::Uint( unsigned u ) {
+    return scalar( rapidjson::kNumberType, [u]( Writer& w ) { w.Uint( u ); } );
+}
+
+bool BSMStreamHandler::Int64( int64_t i ) {
+    return scalar( rapidjson::kNumberType, [i]( Writer& w ) { w.Int64( i ); } );
+}
+
+bool BSMStreamHandler::Uint64( uint64_t u ) {
+    return scalar( rapidjson::kNumberType, [u]( Writer& w ) { w.Uint64( u ); } );
+}
+
+bool BSMStreamHandler::Double( double d ) {
+    if (skip_ == 0 && !frames_.empty() && frames_.back().pending != kNone) {
+        values_[frames_.back().pending].is_double = true;
+        values_[frames_.back().pending].number = d;
+    }
+
+    return scalar( rapidjson::kNumberType, [d]( Writer& w ) { w.Double( d ); } );
+}
+
+bool BSMStreamHandler::RawNumber( const char* str, rapidjson::SizeType length, bool /*copy*/ ) {
+    // only called with kParseNumbersAsStringsFlag, which the DOM path does not use.
+    return scalar( rapidjson::kNumberType, [str, length]( Writer& w ) { w.RawValue( str, length, rapidjson::kNumberType ); } );
+}
+
+bool BSMStreamHandler::String( const char* str, rapidjson::SizeType length, bool /*copy*/ ) {
+    if (skip_ == 0 && !frames_.empty() && frames_.back().pending != kNone) {
+        values_[frames_.back().pending].text.assign( str, length );
+    }
+
+    return scalar( rapidjson::kStringType, [str, length]( Writer& w ) { w.String( str, length ); } );
+}
+
+bool BSMStreamHandler::StartObject() {
+    return start( false );
+}
+
+bool BSMStreamHandler::StartArray() {
+    return start( true );
+}
+
+bool BSMStreamHandler::EndObject( rapidjson::SizeType /*count*/ ) {
+    return end( false );
+}
+
+bool BSMStreamHandler::EndArray( rapidjson::SizeType /*count*/ ) {
+    return end( true );
+}
+
+bool BSMStreamHandler::start( bool array ) {
+    if (skip_ > 0) {
+        ++skip_;
+        return true;
+    }
+
+    rapidjson::Type type = array ? rapidjson::kArrayType : rapidjson::kObjectType;
+
+    if (frames_.empty()) {
+        object_ = !array;
+
+        Node* node = nullptr;
+        if (outline_ && object_) {
+            node = make_node( false );
+            for (uint32_t p = 0; p < paths_.size(); ++p) {
+                node->cursors.push_back( Cursor{ p, 0 } );
+            }
+
+            root_ = node;
+        } else {
+            array ? writer_.StartArray() : writer_.StartObject();
+        }
+
+        frames_.push_back( Frame{ kNone, kNone, node, &writer_, false } );
+        return true;
+    }
+
+    Node* parent = frames_.back().node;
+    Field field;
+    Member* member;
+    Writer* writer = start_value( field, member );
+
+    if (field != kNone) {
+        values_[field].present = true;
+        values_[field].type = type;
+    }
+
+    if (replace( field, type, writer )) {
+        // the whole container is replaced by a scalar.
+        skip_ = 1;
+
+        if (member) {
+            member->type = rapidjson::kNumberType;
+            member->text.assign( capture_.GetString(), capture_.GetSize() );
+        }
+
+        return true;
+    }
+
+    Field role = array ? kNone : field;
+
+    if (member) {
+        member->type = type;
+
+        Node* node = make_node( array );
+        if (parent->array) {
+            node->cursors = parent->cursors;
+        } else {
+            for (auto& cursor : parent->cursors) {
+                auto& path = paths_[cursor.path];
+                if (path[cursor.index] == member->name) {
+                    uint32_t last = static_cast<uint32_t>( path.size() - 1 );
+                    node->cursors.push_back( Cursor{ cursor.path, std::min( cursor.index + 1, last ) } );
+                }
+            }
+        }
+
+        // payload and data are outlined so coreData and partII can be written after general redaction.
+        if (!node->cursors.empty() || role == PAYLOAD || role == DATA) {
+            member->child = node;
+            frames_.push_back( Frame{ role, kNone, node, nullptr, false } );
+            return true;
+        }
+
+        --node_count_;
+        member->child = nullptr;
+        array ? writer->StartArray() : writer->StartObject();
+        frames_.push_back( Frame{ role, kNone, nullptr, writer, true } );
+        return true;
+    }
+
+    array ? writer->StartArray() : writer->StartObject();
+    frames_.push_back( Frame{ role, kNone, nullptr, writer, false } );
+    return true;
+}
+
+bool BSMStreamHandler::Key( const char* str, rapidjson::SizeType length, bool /*copy*/ ) {
+    if (skip_ > 0) return true;
+
+    Frame& top = frames_.back();
+
+    Field field = child_field( top.role, str, length, frames_.size() == 1 && object_ );
+    top.pending = field != kNone && !values_[field].present ? field : kNone;
+
+    if (top.node) {
+        top.node->members.add( str, length );
+    } else {
+        top.writer->Key( str, length );
+    }
+
+    return true;
+}
+
+bool BSMStreamHandler::end( bool array ) {
+    if (skip_ > 0) {
+        --skip_;
+        return true;
+    }
+
+    Frame frame = frames_.back();
+    frames_.pop_back();
+
+    if (frame.node) return true;
+
+    array ? frame.writer->EndArray() : frame.writer->EndObject();
+
+    if (frame.captured) {
+        Member& member = frames_.back().node->members.back();
+        member.text.assign( capture_.GetString(), capture_.GetSize() );
+    }
+
+    return true;
+}
+
+/**
+ * @brief The access RedactionTrie needs to the outline. A value is a member; only an outlined object or array is one
+ * the paths can reach, and a value that is set is written as its JSON text.
+ */
+struct BSMStreamHandler::Outline {
+    using Value = Member;
+
+    bool isObject( const Value& value ) const { return value.child && !value.child->array; }
+    bool isArray( const Value& value ) const { return value.child && value.child->array; }
+    bool isNumber( const Value& value ) const { return value.type == rapidjson::kNumberType; }
+    bool isString( const Value& value ) const { return value.type == rapidjson::kStringType; }
+    bool isBool( const Value& value ) const { return value.type == rapidjson::kTrueType || value.type == rapidjson::kFalseType; }
+
+    std::size_t elementCount( const Value& array ) const { return array.child->members.size(); }
+    Value& element( Value& array, std::size_t index ) const { return array.child->members[index]; }
+
+    std::size_t memberCount( const Value& object ) const { return object.child->members.size(); }
+    Value& member( Value& object, std::size_t index ) const { return object.child->members[index]; }
+
+    std::size_t findMember( const Value& object, const char* name, std::size_t length ) const {
+        auto& members = object.child->members;
+        auto m = std::find_if( members.begin(), members.end(), [name, length]( const Member& m ) {
+            return m.name.size() == length && std::memcmp( m.name.data(), name, length ) == 0;
+        } );
+        return m - members.begin();
+    }
+
+    void removeMember( Value& object, std::size_t index ) const {
+        object.child->members.remove( index );
+    }
+
+    void setNumber( Value& value, int number ) const {
+        set( value, rapidjson::kNumberType, std::to_string( number ) );
+    }
+
+    void setString( Value& value, const char* text ) const {
+        set( value, rapidjson::kStringType, '"' + std::string{ text } + '"' );
+    }
+
+    void setBool( Value& value, bool b ) const {
+        set( value, b ? rapidjson::kTrueType : rapidjson::kFalseType, b ? "true" : "false" );
+    }
+
+    void set( Value& value, rapidjson::Type type, const std::string& text ) const {
+        value.type = type;
+        value.text = text;
+        value.child = nullptr;
+    }
+};
+
+void BSMStreamHandler::redact( RedactionTrie& trie ) {
+    // a message that is not outlined has nothing to redact; every path reports it.
+    Member root{ std::string{}, rapidjson::kObjectType, std::string{}, root_ };
+    trie.redact( Outline{}, root );
+}
+
+void BSMStreamHandler::write( const Node& node, Writer& writer ) const {
+    node.array ? writer.StartArray() : writer.StartObject();
+
+    for (auto& member : node.members) {
+        if (!node.array) {
+            writer.Key( member.name.data(), static_cast<rapidjson::SizeType>( member.name.size() ) );
+        }
+
+        if (member.child) {
+            write( *member.child, writer );
+        } else {
+            writer.RawValue( member.text.data(), member.text.size(), member.type );
+        }
+    }
+
+    node.array ? writer.EndArray() : writer.EndObject();
+}
+
+bool BSMStreamHandler::write_data_member( const char* name, const std::string& id, std::string& json ) const {
+    auto find = []( const Node* node, const char* name ) -> const Member* {
+        if (!node || node->array) return nullptr;
+
+        for (auto& member : node->members) {
+            if (member.name == name) return &member;
+        }
+
+        return nullptr;
+    };
+
+    const Member* payload = find( root_, "payload" );
+    const Member* data = payload ? find( payload->child, "data" ) : nullptr;
+    const Member* member = data ? find( data->child, name ) : nullptr;
+
+    if (!member) return false;
+
+    if (member->child) {
+        member_.Clear();
+        member_writer_.Reset( member_ );
+        write( *member->child, member_writer_ );
+        json.assign( member_.GetString(), member_.GetSize() );
+    } else {
+        json = member->text;
+    }
+
+    splice( id, json );
+    return true;
+}
+
+void BSMStreamHandler::finish( const std::string& id, std::string& json ) const {
+    if (root_) {
+        out_.Clear();
+        writer_.Reset( out_ );
+        write( *root_, writer_ );
+    }
+
+    json.assign( out_.GetString(), out_.GetSize() );
+    splice( id, json );
+}
+
+void BSMStreamHandler::splice( const std::string& id, std::string& json ) const {
+    std::size_t at = json.find( kIdPlaceholder[0] );
+    if (at == std::string::npos) return;
+
+    id_.Clear();
+    id_writer_.Reset( id_ );
+    id_writer_.String( id.data(), static_cast<rapidjson::SizeType>( id.size() ) );
+
+    json.replace( at, 1, id_.GetString(), id_.GetSize() );
+}
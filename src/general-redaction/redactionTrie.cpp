@@ -0,0 +1,120 @@
+#include "redactionTrie.hpp"
+
+/**
+ * @brief The access RedactionTrie::apply needs to a rapidjson::Value.
+ */
+struct RedactionTrie::RapidjsonTree {
+    using Value = rapidjson::Value;
+
+    bool isObject(const Value& value) const { return value.IsObject(); }
+    bool isArray(const Value& value) const { return value.IsArray(); }
+    bool isNumber(const Value& value) const { return value.IsNumber(); }
+    bool isString(const Value& value) const { return value.IsString(); }
+    bool isBool(const Value& value) const { return value.IsBool(); }
+
+    std::size_t elementCount(const Value& array) const { return array.Size(); }
+    Value& element(Value& array, std::size_t index) const { return array[static_cast<rapidjson::SizeType>(index)]; }
+
+    std::size_t memberCount(const Value& object) const { return object.MemberCount(); }
+    Value& member(Value& object, std::size_t index) const { return (object.MemberBegin() + index)->value; }
+
+    std::size_t findMember(const Value& object, const char* name, std::size_t length) const {
+        return object.FindMember(rapidjson::StringRef(name, static_cast<rapidjson::SizeType>(length))) - object.MemberBegin();
+    }
+
+    void removeMember(Value& object, std::size_t index) const { object.RemoveMember(object.MemberBegin() + index); }
+
+    void setNumber(Value& value, int number) const { value = number; }
+    void setString(Value& value, const char* text) const { value.SetString(rapidjson::StringRef(text)); }
+    void setBool(Value& value, bool b) const { value = b; }
+};
+
+/**
+ * @brief Construct an empty trie, which redacts nothing.
+ */
+RedactionTrie::RedactionTrie() : nodes(1), paths(), redacted(), cursors() {
+    nodes[0].leaf = Leaf::REMOVE;
+    nodes[0].container = Container::DESCEND;
+}
+
+/**
+ * @brief Split each path at its dots, as getTopLevelFromPath and removeTopLevelFromPath do, and add its members to
+ * the trie.
+ */
+RedactionTrie::RedactionTrie(const std::vector<std::string>& fields) : RedactionTrie() {
+    for (const std::string& field : fields) {
+        Path path;
+        path.text = field;
+
+        std::vector<std::string> names;
+        std::size_t start = 0;
+        std::size_t dot;
+        while ((dot = field.find('.', start)) != std::string::npos) {
+            names.push_back(field.substr(start, dot - start));
+            start = dot + 1;
+        }
+        names.push_back(field.substr(start));
+
+        const std::string& target = names.back();
+        uint32_t node = 0;
+        for (const std::string& name : names) {
+            node = addNode(node, name);
+            path.steps.push_back(Step{ node, name == target });
+        }
+
+        if (target == "unavailable") path.bit = Bit::UNAVAILABLE;
+        else if (target == "leftFront") path.bit = Bit::LEFT_FRONT;
+        else if (target == "rightFront") path.bit = Bit::RIGHT_FRONT;
+        else if (target == "leftRear") path.bit = Bit::LEFT_REAR;
+        else if (target == "rightRear") path.bit = Bit::RIGHT_REAR;
+        else path.bit = Bit::NONE;
+
+        paths.push_back(path);
+    }
+
+    redacted.resize(paths.size());
+}
+
+void RedactionTrie::redact(rapidjson::Value& value) {
+    redact(RapidjsonTree{}, value);
+}
+
+std::size_t RedactionTrie::getPathCount() const {
+    return paths.size();
+}
+
+const std::string& RedactionTrie::getPath(std::size_t index) const {
+    return paths[index].text;
+}
+
+bool RedactionTrie::isRedacted(std::size_t index) const {
+    return redacted[index];
+}
+
+/**
+ * @brief Find or add the child of a node, resolving what a path does when it reaches the member.
+ */
+uint32_t RedactionTrie::addNode(uint32_t parent, const std::string& name) {
+    for (uint32_t child : nodes[parent].children) {
+        if (nodes[child].name == name) {
+            return child;
+        }
+    }
+
+    Node node;
+    node.name = name;
+
+    if (name == "angle") node.leaf = Leaf::SET_127;
+    else if (name == "transmission") node.leaf = Leaf::SET_UPPER_UNAVAILABLE;
+    else if (name == "traction" || name == "abs" || name == "scs" || name == "brakeBoost" || name == "auxBrakes") node.leaf = Leaf::SET_UNAVAILABLE;
+    else node.leaf = Leaf::REMOVE;
+
+    if (name == "wheelBrakes") node.container = Container::WHEEL_BRAKES;
+    else if (name == "weatherProbe" || name == "status" || name == "speedProfile") node.container = Container::REMOVE_OBJECT;
+    else node.container = Container::DESCEND;
+
+    uint32_t index = static_cast<uint32_t>(nodes.size());
+    nodes.push_back(node);
+    nodes[parent].children.push_back(index);
+    return index;
+}
@@ -0,0 +1,280 @@
+/** 
+ * @file 
+ * @version
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "tool.hpp"
+#include "geofenceBuilder.hpp"
+
+/**
+ * @brief The work and time one index spends on the benchmark points.
+ */
+struct BenchResult {
+    std::string name;               ///< The index.
+    std::size_t bytes;              ///< Memory used by the index.
+    uint32_t corridors;             ///< Corridors stored, counting copies.
+    uint64_t nodes;                 ///< Node bounds checked over all points.
+    uint64_t candidates;            ///< Entities in the leaves entered over all points.
+    uint64_t inside;                ///< Points within the geofence.
+    double seconds;                 ///< Time to answer all the points.
+};
+
+/**
+ * @brief The offline geofence benchmark: builds the quadtree (in its frozen form) and the Hilbert R-tree for a CSV map
+ * and compares their memory, node visits, candidate entities and query time on the same points.
+ */
+class GeofenceBench : public tool::Tool {
+    public:
+        GeofenceBench( const std::string& name, const std::string& description ) :
+            tool::Tool{ name, description, false }
+        {}
+
+        int operator()( void ) override
+        {
+            ConfigMap pconf;
+
+            if ( optIsSet('c') ) {
+                std::ifstream ifs{ optString('c') };
+                if (!ifs) {
+                    std::cerr << "cannot open configuration file: " << optString('c') << std::endl;
+                    return EXIT_FAILURE;
+                }
+
+                std::string line;
+                while (std::getline( ifs, line )) {
+                    line = string_utilities::strip( line );
+                    if ( !line.empty() && line[0] != '#' ) {
+                        StrVector pieces = string_utilities::split( line, '=' );
+                        if (pieces.size() == 2) {
+                            pconf[ string_utilities::strip( pieces[0] ) ] = string_utilities::strip( pieces[1] );
+                        }
+                    }
+                }
+            }
+
+            std::string mapfile;
+            if ( optIsSet('m') ) {
+                mapfile = optString('m');
+            } else {
+                auto search = pconf.find("privacy.filter.geofence.mapfile");
+                if ( search == pconf.end() ) {
+                    std::cerr << "no map file specified." << std::endl;
+                    return EXIT_FAILURE;
+                }
+                mapfile = search->second;
+            }
+
+            std::size_t count = 1000000;
+            uint32_t fanout = HilbertRTree::kDefaultFanout;
+
+            try {
+                if ( optIsSet('n') ) count = std::stoul( optString('n') );
+                if ( optIsSet('f') ) fanout = static_cast<uint32_t>( std::stoul( optString('f') ) );
+
+                GeofenceBuilder builder{ pconf, nullptr };
+                Quad::Ptr qptr = builder.build_quad( mapfile );
+                Quad::make_corridors( qptr, builder.get_extension() );
+
+                FrozenQuad frozen{ *qptr };
+                HilbertRTree rtree{ *qptr, fanout };
+
+                std::vector<geo::Point> points = make_points( frozen, builder.get_sw(), builder.get_ne(), count );
+
+                std::vector<BenchResult> results{ run_quad( frozen, points ), run_rtree( rtree, points ) };
+
+                std::cout << mapfile << ": " << points.size() << " points, half near the road segments; R-tree fanout "
+                    << fanout << ", " << rtree.height() << " levels." << std::endl;
+                std::cout << std::left << std::setw( 8 ) << "index" << std::right
+                    << std::setw( 12 ) << "bytes" << std::setw( 12 ) << "corridors"
+                    << std::setw( 14 ) << "nodes/query" << std::setw( 18 ) << "candidates/query"
+                    << std::setw( 10 ) << "ns/query" << std::setw( 10 ) << "inside" << std::endl;
+
+                for (auto& result : results) {
+                    double n = static_cast<double>( points.size() );
+                    std::cout << std::left << std::setw( 8 ) << result.name << std::right << std::fixed
+                        << std::setw( 12 ) << result.bytes << std::setw( 12 ) << result.corridors
+                        << std::setprecision( 2 ) << std::setw( 14 ) << result.nodes / n
+                        << std::setw( 18 ) << result.candidates / n
+                        << std::setprecision( 1 ) << std::setw( 10 ) << result.seconds * 1e9 / n
+                        << std::setw( 10 ) << result.inside << std::endl;
+                }
+
+                // the quadtree only checks the edges inserted into the point's leaf, so it can miss a corridor that
+                // reaches into a neighboring leaf; the R-tree checks every corridor whose box holds the point.
+                std::size_t quad_misses = 0;
+                std::size_t rtree_misses = 0;
+                mismatches( frozen, rtree, points, quad_misses, rtree_misses );
+
+                if (quad_misses > 0) {
+                    std::cout << "the quadtree misses " << quad_misses << " points in corridors that reach past their leaves." << std::endl;
+                }
+
+                if (rtree_misses > 0) {
+                    std::cerr << "the R-tree disagrees with a scan of every corridor on " << rtree_misses << " points." << std::endl;
+                    return EXIT_FAILURE;
+                }
+
+            } catch ( std::exception& e ) {
+                std::cerr << "benchmark failed: " << e.what() << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            return EXIT_SUCCESS;
+        }
+
+    private:
+        /**
+         * @brief Make the benchmark points: half uniform over the region, half in the bounding box of a random corridor.
+         */
+        static std::vector<geo::Point> make_points( const FrozenQuad& frozen, const geo::Point& sw, const geo::Point& ne, std::size_t count )
+        {
+            std::vector<geo::Point> points;
+            points.reserve( count );
+
+            std::mt19937_64 generator{ 2017 };
+            std::uniform_real_distribution<double> unit{ 0.0, 1.0 };
+            const FrozenQuad::CorridorArrays& corridors = frozen.get_corridors();
+
+            for (std::size_t i = 0; i < count; ++i) {
+                if (i % 2 == 0 || frozen.corridor_count() == 0) {
+                    points.emplace_back( sw.lat + unit( generator ) * (ne.lat - sw.lat), sw.lon + unit( generator ) * (ne.lon - sw.lon) );
+                } else {
+                    uint32_t c = static_cast<uint32_t>( unit( generator ) * frozen.corridor_count() ) % frozen.corridor_count();
+                    points.emplace_back( corridors.min_lat[c] + unit( generator ) * (corridors.max_lat[c] - corridors.min_lat[c]),
+                                         corridors.min_lon[c] + unit( generator ) * (corridors.max_lon[c] - corridors.min_lon[c]) );
+                }
+            }
+
+            return points;
+        }
+
+        /**
+         * @brief Time the frozen quadtree, then count its work with a second pass that retraces each descent.
+         */
+        static BenchResult run_quad( const FrozenQuad& frozen, const std::vector<geo::Point>& points )
+        {
+            BenchResult result{ "quad", frozen.bytes(), frozen.corridor_count(), 0, 0, 0, 0.0 };
+
+            auto start = std::chrono::steady_clock::now();
+            for (auto& pt : points) {
+                if (frozen.is_within_entity( pt )) ++result.inside;
+            }
+            result.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+            const FrozenQuad::Node* nodes = frozen.get_nodes();
+            for (auto& pt : points) {
+                // the root, then each child checked on the way down (see FrozenQuad::retrieve_leaf).
+                const FrozenQuad::Node* node = nodes;
+                ++result.nodes;
+                if (!node->contains( pt )) continue;
+
+                while (node && node->child_count > 0) {
+                    const FrozenQuad::Node* next = nullptr;
+                    for (uint32_t i = 0; i < node->child_count && !next; ++i) {
+                        ++result.nodes;
+                        if (nodes[node->first_child + i].contains( pt )) next = nodes + node->first_child + i;
+                    }
+                    node = next;
+                }
+
+                if (node) {
+                    result.candidates += (node->corridor_end - node->corridor_begin) + (node->circle_end - node->circle_begin) +
+                                         (node->grid_end - node->grid_begin);
+                }
+            }
+
+            return result;
+        }
+
+        /**
+         * @brief Time the R-tree, then count its work with HilbertRTree::search.
+         */
+        static BenchResult run_rtree( const HilbertRTree& rtree, const std::vector<geo::Point>& points )
+        {
+            BenchResult result{ "rtree", rtree.bytes(), rtree.corridor_count(), 0, 0, 0, 0.0 };
+
+            auto start = std::chrono::steady_clock::now();
+            for (auto& pt : points) {
+                if (rtree.is_within_entity( pt )) ++result.inside;
+            }
+            result.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+            HilbertRTree::SearchCost cost;
+            for (auto& pt : points) {
+                rtree.search( pt, cost );
+            }
+            result.nodes = cost.nodes;
+            result.candidates = cost.candidates;
+
+            return result;
+        }
+
+        /**
+         * @brief Count the points the two indexes answer differently, settling each with a scan of every corridor:
+         * quad_misses counts the quadtree's wrong answers and rtree_misses the R-tree's.
+         */
+        static void mismatches( const FrozenQuad& frozen, const HilbertRTree& rtree, const std::vector<geo::Point>& points,
+                                std::size_t& quad_misses, std::size_t& rtree_misses )
+        {
+            FrozenQuad::CorridorScan scan = CorridorKernel::get( CorridorKernel::best() );
+
+            for (auto& pt : points) {
+                bool in_quad = frozen.is_within_entity( pt );
+                bool in_rtree = rtree.is_within_entity( pt );
+                if (in_quad == in_rtree) continue;
+
+                // outside the region neither index answers true, so a corridor scan settles it.
+                bool within = scan( frozen.get_corridors(), 0, frozen.corridor_count(), pt.lat, pt.lon );
+                if (in_quad != within) ++quad_misses;
+                if (in_rtree != within) ++rtree_misses;
+            }
+        }
+};
+
+int main( int argc, char* argv[] )
+{
+    GeofenceBench bench{ "ppm_geofence_bench", "Compare the geofence quadtree and R-tree on a PPM map file." };
+
+    bench.addOption( 'c', "config", "PPM configuration file; supplies the geofence bounds and edge extension.", true );
+    bench.addOption( 'm', "mapfile", "CSV map data file to index.", true );
+    bench.addOption( 'n', "points", "Number of query points (default 1000000).", true );
+    bench.addOption( 'f', "fanout", "R-tree children per node (default 16).", true );
+    bench.addOption( 'h', "help", "print out some help" );
+
+    if (!bench.parseArgs(argc, argv)) {
+        bench.usage();
+        exit( EXIT_FAILURE );
+    }
+
+    if (bench.optIsSet('h')) {
+        bench.help();
+        exit( EXIT_SUCCESS );
+    }
+
+    exit( bench.run() );
+}
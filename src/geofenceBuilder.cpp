@@ -0,0 +1,516 @@
+/** 
+ * @file 
+ * @version
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory.
+ */
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "geofenceBuilder.hpp"
+
+constexpr double GeofenceBuilder::kDefaultBoxExtension;
+const std::string GeofenceBuilder::kDefaultGeofenceIndex{ "frozen" };
+
+GeofenceBuilder::GeofenceBuilder( const ConfigMap& conf, std::shared_ptr<PpmLogger> logger ) :
+    sw_{},
+    ne_{},
+    extension_{ kDefaultBoxExtension },
+    quad_parameters_{},
+    index_type_{ kDefaultGeofenceIndex },
+    cell_degrees_{ GridIndex::kDefaultCellDegrees },
+    fanout_{ HilbertRTree::kDefaultFanout },
+    raster_{ false },
+    raster_cell_degrees_{ RasterIndex::kDefaultCellDegrees },
+    build_threads_{ 0 },
+    merge_tolerance_{ 0.0 },
+    merge_length_{ CorridorMerger::kDefaultMaxLength },
+    planar_{ false },
+    fixed_{ false },
+    shared_path_{},
+    delta_path_{},
+    logger_{ logger }
+{
+    auto search = conf.find("privacy.filter.geofence.sw.lat");
+    if ( search != conf.end() ) {
+        sw_.lat = std::stod( search->second );
+    }
+
+    search = conf.find("privacy.filter.geofence.sw.lon");
+    if ( search != conf.end() ) {
+        sw_.lon = std::stod( search->second );
+    }
+
+    search = conf.find("privacy.filter.geofence.ne.lat");
+    if ( search != conf.end() ) {
+        ne_.lat = std::stod( search->second );
+    }
+
+    search = conf.find("privacy.filter.geofence.ne.lon");
+    if ( search != conf.end() ) {
+        ne_.lon = std::stod( search->second );
+    }
+
+    search = conf.find("privacy.filter.geofence.extension");
+    if ( search != conf.end() ) {
+        extension_ = std::stod( search->second );
+    }
+
+    search = conf.find("privacy.filter.geofence.quad.elements");
+    if ( search != conf.end() ) {
+        quad_parameters_.max_elements = static_cast<uint32_t>( std::stoul( search->second ) );
+    }
+
+    search = conf.find("privacy.filter.geofence.quad.degrees");
+    if ( search != conf.end() ) {
+        quad_parameters_.min_degrees = std::stod( search->second );
+    }
+
+    search = conf.find("privacy.filter.geofence.quad.reduction");
+    if ( search != conf.end() ) {
+        quad_parameters_.reduction_factor = std::stod( search->second );
+    }
+
+    search = conf.find("privacy.filter.geofence.index");
+    if ( search != conf.end() ) {
+        index_type_ = search->second;
+    }
+
+    search = conf.find("privacy.filter.geofence.index.cell");
+    if ( search != conf.end() ) {
+        cell_degrees_ = std::stod( search->second );
+    }
+
+    search = conf.find("privacy.filter.geofence.index.fanout");
+    if ( search != conf.end() ) {
+        fanout_ = static_cast<uint32_t>( std::stoul( search->second ) );
+    }
+
+    search = conf.find("privacy.filter.geofence.raster");
+    if ( search != conf.end() && search->second=="ON" ) {
+        raster_ = true;
+    }
+
+    search = conf.find("privacy.filter.geofence.raster.cell");
+    if ( search != conf.end() ) {
+        raster_cell_degrees_ = std::stod( search->second );
+    }
+
+    search = conf.find("privacy.filter.geofence.planar");
+    if ( search != conf.end() && search->second=="ON" ) {
+        planar_ = true;
+    }
+
+    search = conf.find("privacy.filter.geofence.fixed");
+    if ( search != conf.end() && search->second=="ON" ) {
+        fixed_ = true;
+    }
+
+    if ( planar_ && fixed_ && logger_ ) {
+        logger_->warn("planar and fixed-point geofence geometry are exclusive; using fixed point.");
+    }
+
+    search = conf.find("privacy.filter.geofence.build.threads");
+    if ( search != conf.end() ) {
+        build_threads_ = static_cast<unsigned>( std::stoul( search->second ) );
+    }
+
+    search = conf.find("privacy.filter.geofence.shared");
+    if ( search != conf.end() ) {
+        shared_path_ = search->second;
+    }
+
+    search = conf.find("privacy.filter.geofence.delta");
+    if ( search != conf.end() ) {
+        delta_path_ = search->second;
+    }
+
+    search = conf.find("privacy.filter.geofence.merge.tolerance");
+    if ( search != conf.end() ) {
+        merge_tolerance_ = std::stod( search->second );
+    }
+
+    search = conf.find("privacy.filter.geofence.merge.length");
+    if ( search != conf.end() ) {
+        merge_length_ = std::stod( search->second );
+    }
+
+    if ( merge_tolerance_ > 0.0 && !delta_path_.empty() && logger_ ) {
+        logger_->warn("a delta file removes edges by identifier; edges are not merged when one is configured.");
+    }
+}
+
+Quad::Ptr GeofenceBuilder::build_quad( const std::string& mapfile ) const  // throws
+{
+    if (logger_) logger_->trace("Starting BuildGeofence.");
+
+    Quad::Ptr qptr = std::make_shared<Quad>(sw_, ne_, quad_parameters_);
+
+    // Add all the shapes to the quad; edge areas are computed once here rather than for every BSM.
+    geo::Entity::PtrList entities;
+    std::vector<geo::Corridor> corridors;
+    parse_shapes( mapfile, entities, corridors );
+
+    // the same tree as inserting the shapes one at a time, in the order above.
+    Quad::bulk_insert( qptr, entities, corridors, build_threads_ );
+
+    if (logger_) logger_->trace("Completed BuildGeofence.");
+    return qptr;
+}
+
+void GeofenceBuilder::parse_shapes( const std::string& mapfile, geo::Entity::PtrList& entities,
+                                    std::vector<geo::Corridor>& corridors ) const  // throws
+{
+    // Read the file and parse the shapes; the edges come as a graph, so their vertices do not hold them in cycles.
+    shapes::CSVInputFactory shape_factory( mapfile );
+    std::vector<geo::EdgeCPtr> map_edges;
+    std::vector<std::string> map_ways;
+    shape_factory.load_graph( build_threads_ ).make_edges( map_edges, map_ways );
+
+    for (auto& circle_ptr : shape_factory.get_circles()) {
+        entities.push_back( circle_ptr );
+        corridors.emplace_back();
+    }
+
+    if (get_merge_tolerance() > 0.0) {
+        std::vector<geo::EdgeCPtr> edges;
+        std::vector<geo::Corridor> edge_corridors;
+        CorridorMerger::Stats stats;
+
+        CorridorMerger merger{ extension_, merge_tolerance_, merge_length_ };
+        merger.merge( map_edges, map_ways, edges, edge_corridors, &stats );
+
+        entities.insert( entities.end(), edges.begin(), edges.end() );
+        corridors.insert( corridors.end(), edge_corridors.begin(), edge_corridors.end() );
+
+        if (logger_) {
+            logger_->info("merged " + std::to_string( stats.edges ) + " map edges in " + std::to_string( stats.chains ) +
+                          " chains into " + std::to_string( stats.corridors ) + " corridors");
+        }
+    } else {
+        for (auto& edge_ptr : map_edges) {
+            entities.push_back( edge_ptr );
+            corridors.emplace_back( *edge_ptr->to_area(extension_) );
+        }
+    }
+
+    for (auto& grid_ptr : shape_factory.get_grids()) {
+        entities.push_back( grid_ptr );
+        corridors.emplace_back();
+    }
+}
+
+GeofenceIndex::CPtr GeofenceBuilder::build_index( Quad::Ptr quad_ptr ) const
+{
+    if (!quad_ptr) return nullptr;
+
+    // no-op for trees built with precomputed corridors (see build_quad).
+    Quad::make_corridors( quad_ptr, extension_ );
+
+    GeofenceIndex::CPtr index;
+
+    if (index_type_ == "quad" || index_type_ == "grid" || index_type_ == "rtree") {
+        if ((planar_ || fixed_) && logger_) {
+            logger_->warn("planar and fixed-point geofence geometry need the frozen index; the " + index_type_ + " index stays spherical.");
+        }
+    }
+
+    if (index_type_ == "quad") {
+        index = quad_ptr;
+    } else if (index_type_ == "grid") {
+        index = std::make_shared<const GridIndex>( *quad_ptr, cell_degrees_ );
+    } else if (index_type_ == "rtree") {
+        auto rtree = std::make_shared<const HilbertRTree>( *quad_ptr, fanout_ );
+        if (logger_) {
+            logger_->info("geofence R-tree " + std::to_string( rtree->node_count() ) + " nodes, " +
+                          std::to_string( rtree->height() ) + " levels, " + std::to_string( rtree->corridor_count() ) +
+                          " corridors, " + std::to_string( rtree->bytes() ) + " bytes");
+        }
+        index = rtree;
+    } else {
+        if (index_type_ != kDefaultGeofenceIndex && logger_) {
+            logger_->warn("unknown geofence index: " + index_type_ + "; using " + kDefaultGeofenceIndex);
+        }
+        index = std::make_shared<const FrozenQuad>( *quad_ptr, get_geometry() );
+    }
+
+    if (raster_) {
+        auto raster_index = std::make_shared<const RasterIndex>( *quad_ptr, index, raster_cell_degrees_ );
+        if (logger_) {
+            logger_->info("geofence raster " + std::to_string( raster_index->get_rows() ) + "x" +
+                          std::to_string( raster_index->get_cols() ) + " cells, " +
+                          std::to_string( raster_index->count( RasterIndex::CellState::INSIDE ) ) + " inside, " +
+                          std::to_string( raster_index->count( RasterIndex::CellState::BOUNDARY ) ) + " boundary, " +
+                          std::to_string( raster_index->bytes() ) + " bytes");
+        }
+        index = raster_index;
+    }
+
+    return index;
+}
+
+GeofenceIndex::CPtr GeofenceBuilder::load( const std::string& mapfile, Quad::Ptr* base ) const  // throws
+{
+    if (!FrozenQuad::is_compiled( mapfile )) {
+        if (!delta_path_.empty()) {
+            if (!shared_path_.empty() && logger_) {
+                logger_->warn("an edited geofence is not shared; privacy.filter.geofence.shared is ignored.");
+            }
+
+            Quad::Ptr qptr = build_quad( mapfile );
+            if (base) *base = qptr;
+            return build_index( apply_delta( qptr ) );
+        }
+
+        if (!shared_path_.empty()) return attach_shared( mapfile );
+        return build_index( build_quad( mapfile ) );
+    }
+
+    FrozenQuad::FileHeader header = FrozenQuad::read_header( mapfile );
+
+    if (logger_) {
+        if (!delta_path_.empty()) {
+            logger_->warn("a compiled geofence cannot be edited; privacy.filter.geofence.delta is ignored.");
+        }
+
+        if (header.extension != extension_) {
+            logger_->warn("compiled geofence uses extension " + std::to_string( header.extension ) + " not the configured " +
+                          std::to_string( extension_ ) + "; recompile the map to change it.");
+        }
+
+        if (header.geometry() != get_geometry()) {
+            logger_->warn("compiled geofence geometry is not the configured one; recompile the map to change it.");
+        }
+
+        if (header.parameters() != quad_parameters_) {
+            logger_->warn("compiled geofence quadtree parameters are not the configured ones; recompile the map to change them.");
+        }
+
+        if (header.merge_tolerance != get_merge_tolerance() || header.merge_length != get_merge_length()) {
+            logger_->warn("compiled geofence edges were merged with other settings; recompile the map to change them.");
+        }
+
+        if (index_type_ != kDefaultGeofenceIndex || raster_) {
+            logger_->warn("compiled geofence is always a frozen index; the index and raster settings are ignored.");
+        }
+    }
+
+    FrozenQuad::CPtr frozen = FrozenQuad::load( mapfile );
+
+    if (logger_) {
+        logger_->info("mapped compiled geofence: " + std::to_string( frozen->node_count() ) + " nodes, " +
+                      std::to_string( frozen->corridor_count() ) + " corridors, " + std::to_string( frozen->bytes() ) + " bytes");
+    }
+
+    return frozen;
+}
+
+Quad::Ptr GeofenceBuilder::apply_delta( const Quad::Ptr& base ) const  // throws
+{
+    struct stat delta_status;
+    if (delta_path_.empty() || ::stat( delta_path_.c_str(), &delta_status ) != 0) return base;
+
+    shapes::CSVInputFactory shape_factory( delta_path_ );
+    std::vector<geo::EdgeCPtr> delta_edges;
+    std::vector<std::string> delta_ways;
+    shape_factory.load_graph( build_threads_ ).make_edges( delta_edges, delta_ways );
+
+    Quad::Delta delta;
+    delta.removed_edges = shape_factory.get_removed_edges();
+    delta.removed_circles = shape_factory.get_removed_circles();
+
+    // the same order as build_quad.
+    for (auto& circle_ptr : shape_factory.get_circles()) {
+        delta.added.push_back( circle_ptr );
+        delta.corridors.emplace_back();
+    }
+
+    for (auto& edge_ptr : delta_edges) {
+        delta.added.push_back( edge_ptr );
+        delta.corridors.emplace_back( *edge_ptr->to_area(extension_) );
+    }
+
+    for (auto& grid_ptr : shape_factory.get_grids()) {
+        delta.added.push_back( grid_ptr );
+        delta.corridors.emplace_back();
+    }
+
+    Quad::EditStats stats;
+    Quad::Ptr edited = Quad::edit( base, delta, &stats );
+
+    if (logger_) {
+        logger_->info("geofence delta " + delta_path_ + ": " + std::to_string( stats.removed ) + " removed, " +
+                      std::to_string( stats.added ) + " added, " + std::to_string( stats.copied ) + " quads copied, " +
+                      std::to_string( stats.merged ) + " merged");
+    }
+
+    return edited;
+}
+
+FrozenQuad::CPtr GeofenceBuilder::compile( const std::string& mapfile, const std::string& outfile ) const  // throws
+{
+    // read before building, so a map edited during the build does not match the file.
+    FrozenQuad::Source source = FrozenQuad::Source::of( mapfile );
+
+    Quad::Ptr qptr = build_quad( mapfile );
+    Quad::make_corridors( qptr, extension_ );
+
+    FrozenQuad::CPtr frozen = std::make_shared<const FrozenQuad>( *qptr, get_geometry() );
+    frozen->save( outfile, extension_, get_merge_tolerance(), get_merge_length(), source );
+    return frozen;
+}
+
+FrozenQuad::CPtr GeofenceBuilder::attach_shared( const std::string& mapfile ) const  // throws
+{
+    if ((index_type_ != kDefaultGeofenceIndex || raster_) && logger_) {
+        logger_->warn("a shared geofence is always a frozen index; the index and raster settings are ignored.");
+    }
+
+    // replicas starting together take turns: the first compiles and publishes the map, the others wait and map it.
+    std::string lockfile = shared_path_ + ".lock";
+    int fd = ::open( lockfile.c_str(), O_RDWR | O_CREAT, 0644 );
+    if (fd < 0) {
+        throw std::runtime_error{ "cannot open shared geofence lock: " + lockfile };
+    }
+
+    if (::flock( fd, LOCK_EX ) != 0) {
+        ::close( fd );
+        throw std::runtime_error{ "cannot lock shared geofence: " + lockfile };
+    }
+
+    FrozenQuad::CPtr frozen;
+
+    try {
+        frozen = current_shared( mapfile );
+
+        if (frozen) {
+            if (logger_) logger_->info("attached shared geofence: " + shared_path_);
+        } else {
+            compile( mapfile, shared_path_ );
+            frozen = FrozenQuad::load( shared_path_ );
+            if (logger_) logger_->info("published shared geofence: " + shared_path_);
+        }
+    } catch (...) {
+        ::close( fd );
+        throw;
+    }
+
+    // closing the descriptor releases the lock.
+    ::close( fd );
+
+    if (logger_) {
+        logger_->info("shared geofence: " + std::to_string( frozen->node_count() ) + " nodes, " +
+                      std::to_string( frozen->corridor_count() ) + " corridors, " + std::to_string( frozen->bytes() ) + " bytes");
+    }
+
+    return frozen;
+}
+
+FrozenQuad::CPtr GeofenceBuilder::current_shared( const std::string& mapfile ) const
+{
+    struct stat shared_status;
+    if (::stat( shared_path_.c_str(), &shared_status ) != 0) return nullptr;
+
+    FrozenQuad::CPtr frozen;
+
+    try {
+        frozen = FrozenQuad::load( shared_path_ );
+    } catch (std::runtime_error& e) {
+        if (logger_) logger_->warn("cannot use the shared geofence, rebuilding it: " + std::string{ e.what() });
+        return nullptr;
+    }
+
+    // the file records the extension, geometry, quadtree parameters and merge settings; the region is the bounds of the root.
+    FrozenQuad::FileHeader header = FrozenQuad::read_header( shared_path_ );
+    const FrozenQuad::Node& root = frozen->get_nodes()[0];
+
+    if (header.extension != extension_ || header.geometry() != get_geometry() || header.parameters() != quad_parameters_ ||
+        header.merge_tolerance != get_merge_tolerance() || header.merge_length != get_merge_length() ||
+        root.sw_lat != sw_.lat || root.sw_lon != sw_.lon || root.ne_lat != ne_.lat || root.ne_lon != ne_.lon) {
+        if (logger_) logger_->info("shared geofence was built with other settings; rebuilding it.");
+        return nullptr;
+    }
+
+    // the contents decide, not the modification time: copies of a map match, and an edit within the same second does not.
+    FrozenQuad::Source source;
+
+    try {
+        source = FrozenQuad::Source::of( mapfile );
+    } catch (std::runtime_error& e) {
+        if (logger_) logger_->warn("cannot compare the shared geofence to the map file, rebuilding it: " + std::string{ e.what() });
+        return nullptr;
+    }
+
+    if (!header.source().same_contents( source )) {
+        if (logger_) logger_->info("shared geofence was compiled from another map file; rebuilding it.");
+        return nullptr;
+    }
+
+    return frozen;
+}
+
+const geo::Point& GeofenceBuilder::get_sw() const
+{
+    return sw_;
+}
+
+const geo::Point& GeofenceBuilder::get_ne() const
+{
+    return ne_;
+}
+
+double GeofenceBuilder::get_extension() const
+{
+    return extension_;
+}
+
+FrozenQuad::Geometry GeofenceBuilder::get_geometry() const
+{
+    if (fixed_) return FrozenQuad::Geometry::FIXED;
+
+    return planar_ ? FrozenQuad::Geometry::PLANAR : FrozenQuad::Geometry::SPHERICAL;
+}
+
+const Quad::Parameters& GeofenceBuilder::get_quad_parameters() const
+{
+    return quad_parameters_;
+}
+
+double GeofenceBuilder::get_merge_tolerance() const
+{
+    // a delta file names the edges it removes; merged edges would hide them.
+    return delta_path_.empty() && merge_tolerance_ > 0.0 ? merge_tolerance_ : 0.0;
+}
+
+double GeofenceBuilder::get_merge_length() const
+{
+    return get_merge_tolerance() > 0.0 ? merge_length_ : 0.0;
+}
+
+const std::string& GeofenceBuilder::get_index_type() const
+{
+    return index_type_;
+}
+
+const std::string& GeofenceBuilder::get_delta_path() const
+{
+    return delta_path_;
+}
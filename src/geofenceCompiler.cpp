@@ -0,0 +1,116 @@
+/** 
+ * @file 
+ * @version
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory.
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#include "tool.hpp"
+#include "geofenceBuilder.hpp"
+
+/**
+ * @brief The offline geofence compiler: parses a CSV map file with the PPM's privacy.filter.geofence.* configuration
+ * and writes the compiled geofence the PPM maps at start up (see GeofenceBuilder::load).
+ */
+class GeofenceCompiler : public tool::Tool {
+    public:
+        GeofenceCompiler( const std::string& name, const std::string& description ) :
+            tool::Tool{ name, description, false }
+        {}
+
+        int operator()( void ) override
+        {
+            ConfigMap pconf;
+
+            if ( optIsSet('c') ) {
+                std::ifstream ifs{ optString('c') };
+                if (!ifs) {
+                    std::cerr << "cannot open configuration file: " << optString('c') << std::endl;
+                    return EXIT_FAILURE;
+                }
+
+                std::string line;
+                while (std::getline( ifs, line )) {
+                    line = string_utilities::strip( line );
+                    if ( !line.empty() && line[0] != '#' ) {
+                        StrVector pieces = string_utilities::split( line, '=' );
+                        if (pieces.size() == 2) {
+                            pconf[ string_utilities::strip( pieces[0] ) ] = string_utilities::strip( pieces[1] );
+                        }
+                    }
+                }
+            }
+
+            std::string mapfile;
+            if ( optIsSet('m') ) {
+                mapfile = optString('m');
+            } else {
+                auto search = pconf.find("privacy.filter.geofence.mapfile");
+                if ( search == pconf.end() ) {
+                    std::cerr << "no map file specified." << std::endl;
+                    return EXIT_FAILURE;
+                }
+                mapfile = search->second;
+            }
+
+            if ( !optIsSet('o') ) {
+                std::cerr << "no output file specified." << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            try {
+                GeofenceBuilder builder{ pconf, nullptr };
+                FrozenQuad::CPtr fq = builder.compile( mapfile, optString('o') );
+                std::cout << "compiled " << mapfile << " to " << optString('o') << ": " << fq->node_count()
+                    << " nodes, " << fq->corridor_count() << " corridors, " << fq->circle_count() << " circles, "
+                    << fq->grid_count() << " grids, " << fq->bytes() << " bytes." << std::endl;
+
+            } catch ( std::exception& e ) {
+                std::cerr << "compile failed: " << e.what() << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            return EXIT_SUCCESS;
+        }
+};
+
+int main( int argc, char* argv[] )
+{
+    GeofenceCompiler compiler{ "ppm_geofence_compile", "Compile a PPM map file into a binary geofence." };
+
+    compiler.addOption( 'c', "config", "PPM configuration file; supplies the geofence bounds and edge extension.", true );
+    compiler.addOption( 'm', "mapfile", "CSV map data file to compile.", true );
+    compiler.addOption( 'o', "output", "Compiled geofence file to write.", true );
+    compiler.addOption( 'h', "help", "print out some help" );
+
+    if (!compiler.parseArgs(argc, argv)) {
+        compiler.usage();
+        exit( EXIT_FAILURE );
+    }
+
+    if (compiler.optIsSet('h')) {
+        compiler.help();
+        exit( EXIT_SUCCESS );
+    }
+
+    exit( compiler.run() );
+}
@@ -0,0 +1,101 @@
+/** 
+ * @file 
+ * @version
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory.
+ */
+
+#include "geofenceHintCache.hpp"
+
+constexpr std::size_t GeofenceHintCache::kDefaultCapacity;
+constexpr uint32_t GeofenceHintCache::kDefaultTimeToLive;
+
+GeofenceHintCache::GeofenceHintCache( std::size_t capacity, uint32_t ttl_ms ) :
+    capacity_{ capacity },
+    ttl_{ std::chrono::duration_cast<Clock::duration>( std::chrono::milliseconds{ ttl_ms } ) },
+    ttl_ms_{ ttl_ms },
+    entries_{},
+    lookup_{},
+    stats_{}
+{
+}
+
+bool GeofenceHintCache::is_within_entity( const GeofenceIndex& index, const std::string& id, const geo::Point& pt,
+                                          Clock::time_point now )
+{
+    if (capacity_ == 0) return index.is_within_entity( pt );
+
+    ++stats_.lookups;
+
+    // drop the hints of vehicles that have gone quiet; the least recently used are at the back.
+    while (!entries_.empty() && now - entries_.back().last_used > ttl_) {
+        lookup_.erase( entries_.back().id );
+        entries_.pop_back();
+        ++stats_.expirations;
+    }
+
+    auto search = lookup_.find( id );
+    if (search != lookup_.end()) {
+        ++stats_.vehicle_hits;
+        entries_.splice( entries_.begin(), entries_, search->second );
+    } else {
+        if (entries_.size() >= capacity_) {
+            lookup_.erase( entries_.back().id );
+            entries_.pop_back();
+            ++stats_.evictions;
+        }
+
+        entries_.push_front( Entry{ id, GeofenceIndex::Hint{}, now } );
+        lookup_.emplace( id, entries_.begin() );
+    }
+
+    Entry& entry = entries_.front();
+    entry.last_used = now;
+
+    bool within = index.is_within_entity( pt, entry.hint );
+    if (entry.hint.leaf_hit) ++stats_.leaf_hits;
+    if (entry.hint.entity_hit) ++stats_.entity_hits;
+
+    return within;
+}
+
+void GeofenceHintCache::clear()
+{
+    entries_.clear();
+    lookup_.clear();
+}
+
+std::size_t GeofenceHintCache::size() const
+{
+    return entries_.size();
+}
+
+std::size_t GeofenceHintCache::get_capacity() const
+{
+    return capacity_;
+}
+
+uint32_t GeofenceHintCache::get_time_to_live() const
+{
+    return ttl_ms_;
+}
+
+const GeofenceHintCache::Stats& GeofenceHintCache::get_stats() const
+{
+    return stats_;
+}
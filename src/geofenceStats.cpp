@@ -0,0 +1,444 @@
+/**
+ * @file
+ * @version
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+#include "tool.hpp"
+#include "geofenceBuilder.hpp"
+
+/**
+ * @brief The shape of one quadtree.
+ */
+struct TreeStats {
+    std::size_t nodes;                              ///< Quads, internal and leaf.
+    std::size_t leaves;                             ///< Leaf quads.
+    std::size_t references;                         ///< Entities held over all leaves, counting copies.
+    std::size_t entities;                           ///< Distinct entities.
+    std::size_t max_occupancy;                      ///< Entities in the fullest leaf.
+    std::size_t bytes;                              ///< Memory used by the quads and their lists (not the entities).
+    std::map<int, std::size_t> depths;              ///< Leaves per level.
+    std::map<std::size_t, std::size_t> occupancy;   ///< Leaves per occupancy bucket: 0, 1, 2-3, 4-7, ... keyed by the bucket's first value.
+
+    /**
+     * @brief Return the number of leaves that hold each distinct entity, on average.
+     */
+    double duplication() const
+    {
+        return entities == 0 ? 0.0 : static_cast<double>( references ) / entities;
+    }
+};
+
+/**
+ * @brief One candidate setting replayed on the sample points.
+ */
+struct Replay {
+    Quad::Parameters parameters;    ///< The candidate.
+    TreeStats stats;                ///< The shape of its quadtree.
+    std::size_t frozen_bytes;       ///< Memory used by its frozen quadtree.
+    double candidates;              ///< Entities in the point's leaf, per point.
+    double seconds;                 ///< Best time for the frozen quadtree to answer all the points.
+    std::size_t misses;             ///< Points answered differently from a check of every corridor.
+};
+
+/**
+ * @brief The offline geofence statistics tool: reports the shape of the quadtree built for a CSV map with the
+ * configured parameters, then replays sample BSM positions against trees built with candidate parameters and suggests
+ * the fastest that misses no more points than the configured one.
+ */
+class GeofenceStats : public tool::Tool {
+    public:
+        GeofenceStats( const std::string& name, const std::string& description ) :
+            tool::Tool{ name, description, false }
+        {}
+
+        int operator()( void ) override
+        {
+            ConfigMap pconf;
+
+            if ( optIsSet('c') ) {
+                std::ifstream ifs{ optString('c') };
+                if (!ifs) {
+                    std::cerr << "cannot open configuration file: " << optString('c') << std::endl;
+                    return EXIT_FAILURE;
+                }
+
+                std::string line;
+                while (std::getline( ifs, line )) {
+                    line = string_utilities::strip( line );
+                    if ( !line.empty() && line[0] != '#' ) {
+                        StrVector pieces = string_utilities::split( line, '=' );
+                        if (pieces.size() == 2) {
+                            pconf[ string_utilities::strip( pieces[0] ) ] = string_utilities::strip( pieces[1] );
+                        }
+                    }
+                }
+            }
+
+            std::string mapfile;
+            if ( optIsSet('m') ) {
+                mapfile = optString('m');
+            } else {
+                auto search = pconf.find("privacy.filter.geofence.mapfile");
+                if ( search == pconf.end() ) {
+                    std::cerr << "no map file specified." << std::endl;
+                    return EXIT_FAILURE;
+                }
+                mapfile = search->second;
+            }
+
+            try {
+                std::size_t count = 200000;
+                if ( optIsSet('n') ) count = std::stoul( optString('n') );
+
+                std::vector<uint32_t> elements = optIsSet('e') ? parse_list<uint32_t>( optString('e') ) :
+                                                                 std::vector<uint32_t>{ 8, 16, 32, 64, 128 };
+                std::vector<double> degrees = optIsSet('d') ? parse_list<double>( optString('d') ) :
+                                                              std::vector<double>{ 0.001, 0.003, 0.01 };
+                std::vector<double> reductions = optIsSet('r') ? parse_list<double>( optString('r') ) :
+                                                                 std::vector<double>{ 5.0, 10.0, 20.0 };
+
+                GeofenceBuilder builder{ pconf, nullptr };
+
+                // parse once; every candidate tree is built from the same entities and corridors.
+                geo::Entity::PtrList entities;
+                std::vector<geo::Corridor> corridors;
+                builder.parse_shapes( mapfile, entities, corridors );
+
+                Quad::Ptr configured = build( builder, builder.get_quad_parameters(), entities, corridors );
+                report( mapfile, builder.get_quad_parameters(), tree_stats( configured ) );
+
+                std::vector<geo::Point> points = optIsSet('s') ? read_points( optString('s') ) :
+                                                                 make_points( builder.get_sw(), builder.get_ne(), corridors, count );
+                if (points.empty()) {
+                    std::cerr << "no sample positions." << std::endl;
+                    return EXIT_FAILURE;
+                }
+
+                // the R-tree checks every corridor whose box holds a point, so it settles what the quadtrees miss.
+                HilbertRTree reference{ *configured };
+                std::vector<bool> within;
+                within.reserve( points.size() );
+                for (auto& pt : points) {
+                    within.push_back( reference.is_within_entity( pt ) );
+                }
+
+                Replay current = replay( builder, builder.get_quad_parameters(), entities, corridors, points, within );
+
+                std::vector<Replay> replays;
+                for (uint32_t e : elements) {
+                    for (double d : degrees) {
+                        for (double r : reductions) {
+                            replays.push_back( replay( builder, Quad::Parameters{ e, d, r }, entities, corridors, points, within ) );
+                        }
+                    }
+                }
+
+                std::cout << std::endl << points.size() << (optIsSet('s') ? " sample positions" : " positions, half near the road segments")
+                    << "; " << std::count( within.begin(), within.end(), true ) << " within the geofence." << std::endl;
+                print_replays( current, replays, points.size() );
+
+                // the fastest candidate that is as accurate as the configured tree.
+                const Replay* best = &current;
+                for (auto& candidate : replays) {
+                    if (candidate.misses <= current.misses && candidate.seconds < best->seconds) best = &candidate;
+                }
+
+                if (best == &current) {
+                    std::cout << std::endl << "no candidate is faster than the configured parameters." << std::endl;
+                } else {
+                    std::cout << std::endl << "suggested (" << std::setprecision( 1 ) << std::fixed
+                        << current.seconds * 1e9 / points.size() << " -> " << best->seconds * 1e9 / points.size()
+                        << " ns/query):" << std::endl;
+                    std::cout << "privacy.filter.geofence.quad.elements=" << best->parameters.max_elements << std::endl;
+                    std::cout << std::defaultfloat << std::setprecision( 6 );
+                    std::cout << "privacy.filter.geofence.quad.degrees=" << best->parameters.min_degrees << std::endl;
+                    std::cout << "privacy.filter.geofence.quad.reduction=" << best->parameters.reduction_factor << std::endl;
+                }
+
+            } catch ( std::exception& e ) {
+                std::cerr << "statistics failed: " << e.what() << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            return EXIT_SUCCESS;
+        }
+
+    private:
+        /**
+         * @brief Parse a comma separated list of candidate values.
+         */
+        template <typename T>
+        static std::vector<T> parse_list( const std::string& list )
+        {
+            std::vector<T> values;
+            for (auto& piece : string_utilities::split( list, ',' )) {
+                values.push_back( static_cast<T>( std::stod( string_utilities::strip( piece ) ) ) );
+            }
+            return values;
+        }
+
+        /**
+         * @brief Read sample positions, one latitude,longitude pair per line; blank lines and lines starting with # are
+         * skipped.
+         */
+        static std::vector<geo::Point> read_points( const std::string& path )
+        {
+            std::ifstream ifs{ path };
+            if (!ifs) throw std::invalid_argument{ "cannot open sample file: " + path };
+
+            std::vector<geo::Point> points;
+            std::string line;
+            while (std::getline( ifs, line )) {
+                line = string_utilities::strip( line );
+                if ( line.empty() || line[0] == '#' ) continue;
+
+                StrVector pieces = string_utilities::split( line, ',' );
+                if (pieces.size() != 2) throw std::invalid_argument{ "bad sample position: " + line };
+                points.emplace_back( std::stod( pieces[0] ), std::stod( pieces[1] ) );
+            }
+
+            return points;
+        }
+
+        /**
+         * @brief Make sample positions like ppm_geofence_bench does: half uniform over the region, half in the bounding
+         * box of a random road segment corridor.
+         */
+        static std::vector<geo::Point> make_points( const geo::Point& sw, const geo::Point& ne,
+                                                    const std::vector<geo::Corridor>& corridors, std::size_t count )
+        {
+            // only the edges have corridors; the circles and grids have empty ones.
+            std::vector<const geo::Corridor*> boxes;
+            for (auto& corridor : corridors) {
+                if (corridor.max_lat > corridor.min_lat) boxes.push_back( &corridor );
+            }
+
+            std::vector<geo::Point> points;
+            points.reserve( count );
+
+            std::mt19937_64 generator{ 2017 };
+            std::uniform_real_distribution<double> unit{ 0.0, 1.0 };
+
+            for (std::size_t i = 0; i < count; ++i) {
+                if (i % 2 == 0 || boxes.empty()) {
+                    points.emplace_back( sw.lat + unit( generator ) * (ne.lat - sw.lat), sw.lon + unit( generator ) * (ne.lon - sw.lon) );
+                } else {
+                    const geo::Corridor& c = *boxes[ static_cast<std::size_t>( unit( generator ) * boxes.size() ) % boxes.size() ];
+                    points.emplace_back( c.min_lat + unit( generator ) * (c.max_lat - c.min_lat),
+                                         c.min_lon + unit( generator ) * (c.max_lon - c.min_lon) );
+                }
+            }
+
+            return points;
+        }
+
+        /**
+         * @brief Build the quadtree of the configured region with the given parameters.
+         */
+        static Quad::Ptr build( const GeofenceBuilder& builder, const Quad::Parameters& parameters,
+                                const geo::Entity::PtrList& entities, const std::vector<geo::Corridor>& corridors )
+        {
+            Quad::Ptr qptr = std::make_shared<Quad>( builder.get_sw(), builder.get_ne(), parameters );
+            Quad::bulk_insert( qptr, entities, corridors );
+            return qptr;
+        }
+
+        /**
+         * @brief Measure the shape of a quadtree.
+         */
+        static TreeStats tree_stats( Quad::Ptr& qptr )
+        {
+            TreeStats stats{};
+            stats.nodes = Quad::retrieve_all_bounds( qptr ).size();
+            stats.leaves = Quad::retrieve_all_bounds( qptr, true ).size();
+
+            std::unordered_set<const geo::Entity*> distinct;
+            Quad::PtrStack quadstack;
+            quadstack.push( qptr );
+
+            while (!quadstack.empty()) {
+                Quad::Ptr currquad = quadstack.top();
+                quadstack.pop();
+
+                const Quad::PtrList& children = currquad->get_children();
+                const geo::Entity::PtrList& elements = currquad->get_elements();
+
+                // the quad and the shared pointer control block it is allocated with.
+                stats.bytes += sizeof(Quad) + 2 * sizeof(long) + children.capacity() * sizeof(Quad::Ptr) +
+                               elements.capacity() * sizeof(geo::Entity::CPtr) +
+                               currquad->get_corridors().capacity() * sizeof(geo::Corridor);
+
+                for (auto& child : children) {
+                    quadstack.push( child );
+                }
+
+                if (currquad->haschildren()) continue;
+
+                ++stats.depths[ currquad->get_level() ];
+
+                std::size_t bucket = 0;
+                if (!elements.empty()) {
+                    for (bucket = 1; bucket * 2 <= elements.size(); bucket *= 2) {}
+                }
+                ++stats.occupancy[ bucket ];
+
+                stats.references += elements.size();
+                stats.max_occupancy = std::max( stats.max_occupancy, elements.size() );
+                for (auto& entity : elements) {
+                    distinct.insert( entity.get() );
+                }
+            }
+
+            stats.entities = distinct.size();
+            return stats;
+        }
+
+        /**
+         * @brief Print the shape of the configured quadtree.
+         */
+        static void report( const std::string& mapfile, const Quad::Parameters& parameters, const TreeStats& stats )
+        {
+            std::cout << mapfile << ": quadtree with " << parameters.max_elements << " elements per leaf, "
+                << parameters.min_degrees << " minimum degrees, reduction factor " << parameters.reduction_factor << std::endl;
+            std::cout << "  nodes      : " << stats.nodes << " (" << stats.leaves << " leaves)" << std::endl;
+            std::cout << "  entities   : " << stats.entities << " held " << stats.references << " times; duplication "
+                << std::fixed << std::setprecision( 2 ) << stats.duplication() << std::defaultfloat << std::endl;
+            std::cout << "  bytes      : " << stats.bytes << " in quads and leaf lists" << std::endl;
+
+            std::cout << "  depth      :";
+            for (auto& depth : stats.depths) {
+                std::cout << " " << depth.first << ":" << depth.second;
+            }
+            std::cout << std::endl;
+
+            std::cout << "  occupancy  :";
+            for (auto& bucket : stats.occupancy) {
+                if (bucket.first <= 1) {
+                    std::cout << " " << bucket.first << ":" << bucket.second;
+                } else {
+                    std::cout << " " << bucket.first << "-" << 2 * bucket.first - 1 << ":" << bucket.second;
+                }
+            }
+            std::cout << " (max " << stats.max_occupancy << ")" << std::endl;
+        }
+
+        /**
+         * @brief Build a candidate tree and its frozen form, and answer the points with it.
+         */
+        static Replay replay( const GeofenceBuilder& builder, const Quad::Parameters& parameters, const geo::Entity::PtrList& entities,
+                              const std::vector<geo::Corridor>& corridors, const std::vector<geo::Point>& points,
+                              const std::vector<bool>& within )
+        {
+            Quad::Ptr qptr = build( builder, parameters, entities, corridors );
+            FrozenQuad frozen{ *qptr, builder.get_geometry() };
+
+            Replay result{ parameters, tree_stats( qptr ), frozen.bytes(), 0.0, 0.0, 0 };
+
+            std::size_t candidates = 0;
+            std::size_t expected = 0;
+            for (std::size_t i = 0; i < points.size(); ++i) {
+                candidates += qptr->retrieve_leaf_view( points[i] ).size;
+                bool inside = frozen.is_within_entity( points[i] );
+                if (inside) ++expected;
+                if (inside != within[i]) ++result.misses;
+            }
+            result.candidates = static_cast<double>( candidates ) / points.size();
+
+            // the best of a few runs; the pass above warmed the caches.
+            for (int run = 0; run < 5; ++run) {
+                std::size_t inside = 0;
+                auto start = std::chrono::steady_clock::now();
+                for (auto& pt : points) {
+                    if (frozen.is_within_entity( pt )) ++inside;
+                }
+                double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+                if (run == 0 || seconds < result.seconds) result.seconds = seconds;
+
+                // using the count keeps the timed loop from being optimized away.
+                if (inside != expected) throw std::logic_error{ "frozen quadtree answers changed between runs" };
+            }
+
+            return result;
+        }
+
+        /**
+         * @brief Print the replay of every candidate, the configured parameters first.
+         */
+        static void print_replays( const Replay& current, const std::vector<Replay>& replays, std::size_t count )
+        {
+            std::cout << std::right << std::setw( 10 ) << "elements" << std::setw( 10 ) << "degrees" << std::setw( 11 ) << "reduction"
+                << std::setw( 9 ) << "leaves" << std::setw( 7 ) << "depth" << std::setw( 13 ) << "duplication"
+                << std::setw( 12 ) << "bytes" << std::setw( 18 ) << "candidates/query" << std::setw( 10 ) << "ns/query"
+                << std::setw( 8 ) << "misses" << std::endl;
+
+            auto print = [count]( const Replay& replay, const char* note ) {
+                std::cout << std::defaultfloat << std::setprecision( 6 ) << std::right << std::setw( 10 ) << replay.parameters.max_elements
+                    << std::setw( 10 ) << replay.parameters.min_degrees << std::setw( 11 ) << replay.parameters.reduction_factor
+                    << std::setw( 9 ) << replay.stats.leaves << std::setw( 7 ) << replay.stats.depths.rbegin()->first
+                    << std::fixed << std::setprecision( 2 ) << std::setw( 13 ) << replay.stats.duplication()
+                    << std::setw( 12 ) << replay.frozen_bytes << std::setw( 18 ) << replay.candidates
+                    << std::setprecision( 1 ) << std::setw( 10 ) << replay.seconds * 1e9 / count
+                    << std::setw( 8 ) << replay.misses << note << std::endl;
+            };
+
+            print( current, "  (configured)" );
+            for (auto& replay : replays) {
+                print( replay, "" );
+            }
+        }
+};
+
+int main( int argc, char* argv[] )
+{
+    GeofenceStats stats{ "ppm_geofence_stats", "Report the shape of a PPM map's geofence quadtree and suggest its parameters." };
+
+    stats.addOption( 'c', "config", "PPM configuration file; supplies the geofence bounds, extension, merge settings and quadtree parameters.", true );
+    stats.addOption( 'm', "mapfile", "CSV map data file to index.", true );
+    stats.addOption( 's', "samples", "File of sample BSM positions, one latitude,longitude pair per line.", true );
+    stats.addOption( 'n', "points", "Number of positions to generate when no sample file is given (default 200000).", true );
+    stats.addOption( 'e', "elements", "Candidate elements per leaf, comma separated (default 8,16,32,64,128).", true );
+    stats.addOption( 'd', "degrees", "Candidate minimum quad sizes in degrees, comma separated (default 0.001,0.003,0.01).", true );
+    stats.addOption( 'r', "reduction", "Candidate fuzzy margin reduction factors, comma separated (default 5,10,20).", true );
+    stats.addOption( 'h', "help", "print out some help" );
+
+    if (!stats.parseArgs(argc, argv)) {
+        stats.usage();
+        exit( EXIT_FAILURE );
+    }
+
+    if (stats.optIsSet('h')) {
+        stats.help();
+        exit( EXIT_SUCCESS );
+    }
+
+    exit( stats.run() );
+}
@@ -0,0 +1,117 @@
+/**
+ * @file
+ * @version
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory.
+ */
+
+
+#include <algorithm>
+
+#include "jsonArena.hpp"
+
+constexpr std::size_t JsonArena::kDefaultCapacity;
+constexpr std::size_t JsonArena::kStackCapacity;
+constexpr std::size_t JsonArena::kMinCapacity;
+constexpr std::size_t JsonArena::kDocumentStackCapacity;
+
+JsonArena::Scope::Scope( JsonArena& arena ) :
+    arena_( arena )
+{}
+
+JsonArena::Scope::~Scope() {
+    arena_.reset();
+}
+
+JsonArena::JsonArena( std::size_t capacity ) :
+    capacity_{ std::max( capacity, kMinCapacity ) },
+    chunk_{ new char[capacity_] },
+    stack_chunk_{ new char[kStackCapacity] },
+    values_{ new Allocator{ chunk_.get(), capacity_, capacity_ } },
+    stack_{ new Allocator{ stack_chunk_.get(), kStackCapacity, kStackCapacity } },
+    output_{},
+    writer_{ output_ },
+    output_capacity_{ 0 },
+    heap_allocations_{ 0 },
+    resets_{ 0 }
+{}
+
+JsonArena::JsonArena( const JsonArena& other ) :
+    JsonArena{ other.capacity_ }
+{}
+
+JsonArena& JsonArena::operator=( const JsonArena& other ) {
+    // the memory is not shared; only the capacity is taken.
+    if (this != &other && capacity_ != other.capacity_) {
+        values_.reset();
+        capacity_ = other.capacity_;
+        chunk_.reset( new char[capacity_] );
+        values_.reset( new Allocator{ chunk_.get(), capacity_, capacity_ } );
+    }
+
+    return *this;
+}
+
+JsonArena::Allocator& JsonArena::get_allocator() {
+    return *values_;
+}
+
+JsonArena::Allocator& JsonArena::get_stack_allocator() {
+    return *stack_;
+}
+
+JsonArena::Writer& JsonArena::start_output() {
+    output_.Clear();
+    writer_.Reset( output_ );
+    return writer_;
+}
+
+const rapidjson::StringBuffer& JsonArena::get_output() const {
+    return output_;
+}
+
+void JsonArena::reset() {
+    heap_allocations_ += overflow( *values_, capacity_ ) + overflow( *stack_, kStackCapacity );
+    values_->Clear();
+    stack_->Clear();
+
+    if (output_.stack_.GetCapacity() != output_capacity_) {
+        output_capacity_ = output_.stack_.GetCapacity();
+        ++heap_allocations_;
+    }
+
+    ++resets_;
+}
+
+std::size_t JsonArena::get_capacity() const {
+    return capacity_;
+}
+
+uint64_t JsonArena::get_heap_allocations() const {
+    return heap_allocations_;
+}
+
+uint64_t JsonArena::get_resets() const {
+    return resets_;
+}
+
+uint64_t JsonArena::overflow( const Allocator& pool, std::size_t chunk ) {
+    // the first chunk holds a little less than chunk bytes and every overflow chunk at least chunk bytes, so this is
+    // the number of overflow chunks when none was made for an allocation larger than chunk.
+    return pool.Capacity() / chunk;
+}
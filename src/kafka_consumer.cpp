@@ -123,10 +123,6 @@ static bool ode_topic_available( const std::string& topic, std::shared_ptr<RdKaf
  */
 RdKafka::ErrorCode msg_consume(RdKafka::Message* message, void* opaque, BSMHandler& handler) {
 
-    // payload is a void *
-    // len is a size_t
-    std::string payload(static_cast<const char*>(message->payload()), message->len());
-
     switch (message->err()) {
         case RdKafka::ERR__TIMED_OUT:
             break;
@@ -158,7 +154,8 @@ RdKafka::ErrorCode msg_consume(RdKafka::Message* message, void* opaque, BSMHandl
                 logger->info("Key: " + *message->key());
             }
 
-            if ( handler.process( payload ) ) {
+            // payload is a void * and len is a size_t; the handler makes its one copy.
+            if ( handler.process( static_cast<const char*>(message->payload()), message->len() ) ) {
                 return RdKafka::ERR_NO_ERROR;
             } else {
                 return RdKafka::ERR_INVALID_MSG;
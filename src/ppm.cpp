@@ -76,12 +76,17 @@
 
 bool PPM::bootstrap = true;
 bool PPM::bsms_available = true;
+volatile sig_atomic_t PPM::reload_requested = 0;
 
 void PPM::sigterm (int sig) {
     bsms_available = false;
     bootstrap = false;
 }
 
+void PPM::sighup (int sig) {
+    reload_requested = 1;
+}
+
 PPM::PPM( const std::string& name, const std::string& description ) :
     Tool{ name, description },
     exit_eof{true},
@@ -93,6 +98,7 @@ PPM::PPM( const std::string& name, const std::string& description ) :
     bsm_recv_bytes{0},
     bsm_send_bytes{0},
     bsm_filt_bytes{0},
+    reload_count{0},
     pconf{},
     brokers{"localhost"},
     partition{RdKafka::Topic::PARTITION_UA},
@@ -103,7 +109,9 @@ PPM::PPM( const std::string& name, const std::string& description ) :
     consumed_topic{},
     conf{nullptr},
     tconf{nullptr},
-    qptr{},
+    mapfile{},
+    geofence_index{},
+    geofence_base{},
     consumer{},
     consumer_timeout{500},
     producer{},
@@ -326,8 +334,6 @@ bool PPM::configure() {
     // All configuration file settings are overridden, if supplied, by CLI options.
 
     // fail first on mapfile.
-    std::string mapfile;
-
     if ( optIsSet('m') ) {
         // map file is specified on command line.
         mapfile = optString('m');
@@ -344,7 +350,7 @@ bool PPM::configure() {
 
     logger->info("ppm mapfile: " + mapfile);
 
-    qptr = BuildGeofence( mapfile );                // throws.
+    geofence_index = BuildGeofence( mapfile );      // throws.
 
     if ( optIsSet('b') ) {
         // broker specified.
@@ -471,10 +477,6 @@ bool PPM::msg_consume(RdKafka::Message* message, void* opaque, BSMHandler& handl
     static std::string tsname;
     static RdKafka::MessageTimestamp ts;
 
-    // payload is a void *
-    // len is a size_t
-    std::string payload(static_cast<const char*>(message->payload()), message->len());
-
     switch (message->err()) {
         case RdKafka::ERR__TIMED_OUT:
             logger->info("Waiting for more BSMs from the ODE producer.");
@@ -506,8 +508,8 @@ bool PPM::msg_consume(RdKafka::Message* message, void* opaque, BSMHandler& handl
                 logger->trace("Message key: " + *message->key() );
             }
 
-            // Process the BSM payload.
-            if ( handler.process( payload ) ) {
+            // Process the BSM payload; payload is a void * and len is a size_t. The handler makes its one copy.
+            if ( handler.process( static_cast<const char*>(message->payload()), message->len() ) ) {
                 // the complete BSM was parsed, so we have all the information.
                 logger->info("BSM [RETAINED]: " + handler.get_bsm().logString());
                 return true;
@@ -551,54 +553,16 @@ bool PPM::msg_consume(RdKafka::Message* message, void* opaque, BSMHandler& handl
     return false;
 }
 
-Quad::Ptr PPM::BuildGeofence( const std::string& mapfile )  // throws
+GeofenceIndex::CPtr PPM::BuildGeofence( const std::string& mapfile )  // throws
 {
-    geo::Point sw, ne;
-
     logger->trace("Starting BuildGeofence.");
 
-    auto search = pconf.find("privacy.filter.geofence.sw.lat");
-    if ( search != pconf.end() ) {
-        sw.lat = stod(search->second);
-    }
-
-    search = pconf.find("privacy.filter.geofence.sw.lon");
-    if ( search != pconf.end() ) {
-        sw.lon = stod(search->second);
-    }
-
-    search = pconf.find("privacy.filter.geofence.ne.lat");
-    if ( search != pconf.end() ) {
-        ne.lat = stod(search->second);
-    }
-
-    search = pconf.find("privacy.filter.geofence.ne.lon");
-    if ( search != pconf.end() ) {
-        ne.lon = stod(search->second);
-    }
-
-    Quad::Ptr qptr = std::make_shared<Quad>(sw, ne);
-
-    // Read the file and parse the shapes.
-    shapes::CSVInputFactory shape_factory( mapfile );
-    shape_factory.make_shapes();
-
-    // Add all the shapes to the quad.
-    // NOTE: we are only using Edges right now.
-    for (auto& circle_ptr : shape_factory.get_circles()) {
-        Quad::insert(qptr, std::dynamic_pointer_cast<const geo::Entity>(circle_ptr)); 
-    }
-
-    for (auto& edge_ptr : shape_factory.get_edges()) {
-        Quad::insert(qptr, std::dynamic_pointer_cast<const geo::Entity>(edge_ptr)); 
-    }
-
-    for (auto& grid_ptr : shape_factory.get_grids()) {
-        Quad::insert(qptr, std::dynamic_pointer_cast<const geo::Entity>(grid_ptr)); 
-    }
+    // a compiled geofence file is mapped as is; a CSV map is parsed and its index built here, once, rather than for
+    // every handler.
+    GeofenceIndex::CPtr index = GeofenceBuilder{ pconf, logger }.load( mapfile, &geofence_base );
 
     logger->trace("Completed BuildGeofence.");
-    return qptr;
+    return index;
 }
 
 bool PPM::launch_producer()
@@ -771,6 +735,9 @@ int PPM::operator()(void) {
 
     signal(SIGINT, sigterm);
     signal(SIGTERM, sigterm);
+#ifdef SIGHUP
+    signal(SIGHUP, sighup);
+#endif
 
     try {
 
@@ -784,6 +751,13 @@ int PPM::operator()(void) {
         return EXIT_FAILURE;
     }
 
+    // the map, velocity, id and general redaction settings are rebuilt in the background and swapped in between
+    // messages, on SIGHUP or when their files change.
+    PrivacySnapshot::CPtr snapshot = std::make_shared<const PrivacySnapshot>( pconf, mapfile, geofence_index, geofence_base,
+                                                                              RedactionPropertiesManager{} );
+    PrivacyReloader reloader{ optString('c'), optIsSet('m') ? optString('m') : "", snapshot, logger };
+    reloader.start();
+
     while (bootstrap) {
         // reset flag here, or else nothing works below
         bsms_available = true;
@@ -801,7 +775,9 @@ int PPM::operator()(void) {
         }
 
         // JMC: There was leak in here caused by RapidJSON.  It has been fixed.  The notes are in that class's code.
-        BSMHandler handler{qptr, pconf, logger};
+        BSMHandler handler{nullptr, pconf, logger};
+        uint64_t applied = reloader.get_generation();
+        handler.apply( *reloader.current() );
 
         std::vector<RdKafka::TopicPartition*> partitions;
         RdKafka::ErrorCode err = consumer->position(partitions);
@@ -816,6 +792,22 @@ int PPM::operator()(void) {
 
         // consume-produce loop.
         while (bsms_available) {
+            if (reload_requested) {
+                reload_requested = 0;
+                logger->info("PPM privacy reload requested.");
+                reloader.request();
+            }
+
+            // a new snapshot is only swapped in between messages.
+            if (reloader.get_generation() != applied) {
+                PrivacySnapshot::CPtr next = reloader.current();
+                handler.apply( *next );
+                applied = next->get_generation();
+                reload_count++;
+                logger->info("PPM swapped in privacy snapshot " + std::to_string(applied) + "; " +
+                             std::to_string(reload_count) + " reloads so far.");
+            }
+
             std::unique_ptr<RdKafka::Message> msg{ consumer->consume( consumer_timeout ) };
 
             if ( msg_consume(msg.get(), NULL, handler) ) {
@@ -835,12 +827,29 @@ int PPM::operator()(void) {
             // NOTE: good for troubleshooting, but bad for performance.
             logger->flush();
         }
+
+        const GeofenceHintCache::Stats& hint_stats = handler.get_hint_cache().get_stats();
+        logger->info("PPM geofence hints: " + std::to_string(hint_stats.lookups) + " lookups, " +
+                     std::to_string(hint_stats.vehicle_hits) + " vehicle hits, " +
+                     std::to_string(hint_stats.leaf_hits) + " leaf hits, " +
+                     std::to_string(hint_stats.entity_hits) + " entity hits, " +
+                     std::to_string(hint_stats.evictions) + " evictions, " +
+                     std::to_string(hint_stats.expirations) + " expirations");
+
+        const JsonArena& arena = handler.get_arena();
+        logger->info("PPM DOM arena: " + std::to_string(arena.get_resets()) + " documents, " +
+                     std::to_string(arena.get_heap_allocations()) + " overflow and output buffer allocations");
     }
 
+    reloader.stop();
+    PrivacyReloader::Stats reload_stats = reloader.get_stats();
+
     logger->info("PPM operations complete; shutting down...");
     logger->info("PPM consumed  : " + std::to_string(bsm_recv_count) + " BSMs and " + std::to_string(bsm_recv_bytes) + " bytes");
     logger->info("PPM published : " + std::to_string(bsm_send_count) + " BSMs and " + std::to_string(bsm_send_bytes) + " bytes");
     logger->info("PPM suppressed: " + std::to_string(bsm_filt_count) + " BSMs and " + std::to_string(bsm_filt_bytes) + " bytes");
+    logger->info("PPM reloads   : " + std::to_string(reload_count) + " swapped in, " + std::to_string(reload_stats.requests) +
+                 " requested, " + std::to_string(reload_stats.failures) + " failed");
     return EXIT_SUCCESS;
 }
 
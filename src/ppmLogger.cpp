@@ -65,6 +65,10 @@ void PpmLogger::warn(const std::string& message) {
     elogger->warn(message.c_str());
 }
 
+bool PpmLogger::is_info_enabled() const {
+    return (logToFileFlag || logToConsoleFlag) && ilogger->should_log( spdlog::level::info );
+}
+
 void PpmLogger::flush() {
     ilogger->flush();
     elogger->flush();
@@ -0,0 +1,337 @@
+/**
+ * @file
+ * @version
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <sys/stat.h>
+
+#include "privacyReloader.hpp"
+
+constexpr uint32_t PrivacyReloader::kDefaultInterval;
+
+bool PrivacyReloader::FileStamp::operator==( const FileStamp& other ) const
+{
+    return exists == other.exists && mtime_ns == other.mtime_ns && size == other.size && inode == other.inode;
+}
+
+bool PrivacyReloader::FileStamp::operator!=( const FileStamp& other ) const
+{
+    return !(*this == other);
+}
+
+PrivacyReloader::PrivacyReloader( const std::string& config_file, const std::string& mapfile_override,
+                                  PrivacySnapshot::CPtr initial, std::shared_ptr<PpmLogger> logger ) :
+    config_file_{ config_file },
+    mapfile_override_{ mapfile_override },
+    fields_file_{},
+    interval_ms_{ kDefaultInterval },
+    logger_{ logger },
+    current_{ initial },
+    generation_{ initial->get_generation() },
+    build_mutex_{},
+    watched_{},
+    stamps_{},
+    geofence_key_{},
+    delta_stamp_{},
+    stats_mutex_{},
+    stats_{},
+    mutex_{},
+    wake_{},
+    requested_{ false },
+    stopping_{ false },
+    worker_{}
+{
+    // the same variable RedactionPropertiesManager reads.
+    const char* fields_file = std::getenv( "REDACTION_PROPERTIES_PATH" );
+    if (fields_file) fields_file_ = fields_file;
+
+    const ConfigMap& conf = initial->get_configuration();
+
+    auto search = conf.find("privacy.reload.interval");
+    if ( search != conf.end() ) {
+        interval_ms_ = static_cast<uint32_t>( std::stoul( search->second ) );
+    }
+
+    std::lock_guard<std::mutex> lock{ build_mutex_ };
+    watch( conf );
+    geofence_key_ = geofence_key_for( conf );
+    delta_stamp_ = stamp( delta_for( conf ) );
+}
+
+PrivacyReloader::~PrivacyReloader()
+{
+    stop();
+}
+
+void PrivacyReloader::start()
+{
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    if (worker_.joinable()) return;
+
+    stopping_ = false;
+    worker_ = std::thread{ &PrivacyReloader::run, this };
+}
+
+void PrivacyReloader::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        stopping_ = true;
+    }
+
+    wake_.notify_all();
+    if (worker_.joinable()) worker_.join();
+}
+
+void PrivacyReloader::request()
+{
+    {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        requested_ = true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{ stats_mutex_ };
+        ++stats_.requests;
+    }
+
+    wake_.notify_all();
+}
+
+void PrivacyReloader::run()
+{
+    std::unique_lock<std::mutex> lock{ mutex_ };
+
+    while (!stopping_) {
+        auto woken = [this] () { return stopping_ || requested_; };
+
+        if (interval_ms_ > 0) {
+            wake_.wait_for( lock, std::chrono::milliseconds{ interval_ms_ }, woken );
+        } else {
+            wake_.wait( lock, woken );
+        }
+
+        if (stopping_) break;
+
+        bool requested = requested_;
+        requested_ = false;
+
+        // build without the lock so requests made meanwhile are not lost.
+        lock.unlock();
+        if (requested || changed()) reload();
+        lock.lock();
+    }
+}
+
+bool PrivacyReloader::reload()
+{
+    std::lock_guard<std::mutex> lock{ build_mutex_ };
+
+    PrivacySnapshot::CPtr previous = current();
+    uint64_t generation = previous->get_generation() + 1;
+
+    try {
+        ConfigMap conf;
+
+        try {
+            conf = read_configuration( config_file_ );
+        } catch (...) {
+            // keep watching the old files so a fixed configuration file is picked up.
+            watch( previous->get_configuration() );
+            throw;
+        }
+
+        // stamp the files before reading them: a change made during the build triggers another one.
+        watch( conf );
+
+        std::string mapfile = mapfile_for( conf );
+        std::string key = geofence_key_for( conf );
+        FileStamp delta_stamp = stamp( delta_for( conf ) );
+        GeofenceIndex::CPtr index = previous->get_geofence_index();
+        Quad::Ptr base = previous->get_geofence_base();
+        bool rebuilt = key != geofence_key_;
+        bool edited = !rebuilt && base && delta_stamp != delta_stamp_;
+
+        GeofenceBuilder builder{ conf, logger_ };
+
+        if (rebuilt) {
+            if (mapfile.empty()) throw std::runtime_error{ "no map file specified" };
+            base = nullptr;
+            index = builder.load( mapfile, &base );
+        } else if (edited) {
+            // only the changed quads are copied; the rest of the tree is shared with the previous snapshot.
+            index = builder.build_index( builder.apply_delta( base ) );
+        }
+
+        // re-reads the general redaction fields file.
+        RedactionPropertiesManager rpm;
+
+        PrivacySnapshot::CPtr snapshot = std::make_shared<const PrivacySnapshot>( conf, mapfile, index, base, rpm, generation );
+        geofence_key_ = key;
+        delta_stamp_ = delta_stamp;
+
+        std::atomic_store( &current_, snapshot );
+        generation_.store( generation, std::memory_order_release );
+
+        {
+            std::lock_guard<std::mutex> stats_lock{ stats_mutex_ };
+            ++stats_.reloads;
+        }
+
+        if (logger_) {
+            logger_->info("privacy snapshot " + std::to_string( generation ) + " built: geofence " +
+                          (rebuilt ? "reloaded from " + mapfile : edited ? "edited from " + builder.get_delta_path()
+                                                                         : std::string{ "unchanged" }) + ", " +
+                          std::to_string( snapshot->get_id_redactor().NumInclusions() ) + " id inclusions, " +
+                          std::to_string( rpm.getNumFields() ) + " redaction fields");
+        }
+
+        return true;
+
+    } catch (std::exception& e) {
+        {
+            std::lock_guard<std::mutex> stats_lock{ stats_mutex_ };
+            ++stats_.failures;
+        }
+        if (logger_) {
+            logger_->error("privacy reload failed; keeping snapshot " + std::to_string( previous->get_generation() ) +
+                           ": " + std::string{ e.what() });
+        }
+    }
+
+    return false;
+}
+
+bool PrivacyReloader::changed() const
+{
+    std::lock_guard<std::mutex> lock{ build_mutex_ };
+
+    for (std::size_t i = 0; i < watched_.size(); ++i) {
+        if (stamp( watched_[i] ) != stamps_[i]) return true;
+    }
+
+    return false;
+}
+
+PrivacySnapshot::CPtr PrivacyReloader::current() const
+{
+    return std::atomic_load( &current_ );
+}
+
+uint64_t PrivacyReloader::get_generation() const
+{
+    return generation_.load( std::memory_order_acquire );
+}
+
+PrivacyReloader::Stats PrivacyReloader::get_stats() const
+{
+    std::lock_guard<std::mutex> lock{ stats_mutex_ };
+    return stats_;
+}
+
+PrivacyReloader::FileStamp PrivacyReloader::stamp( const std::string& path )
+{
+    FileStamp file_stamp;
+    struct stat status;
+
+    if (path.empty() || ::stat( path.c_str(), &status ) != 0) return file_stamp;
+
+    file_stamp.exists = true;
+#ifdef __APPLE__
+    file_stamp.mtime_ns = static_cast<int64_t>( status.st_mtimespec.tv_sec ) * 1000000000 + status.st_mtimespec.tv_nsec;
+#else
+    file_stamp.mtime_ns = static_cast<int64_t>( status.st_mtim.tv_sec ) * 1000000000 + status.st_mtim.tv_nsec;
+#endif
+    file_stamp.size = static_cast<int64_t>( status.st_size );
+    file_stamp.inode = static_cast<uint64_t>( status.st_ino );
+    return file_stamp;
+}
+
+ConfigMap PrivacyReloader::read_configuration( const std::string& path )
+{
+    std::ifstream ifs{ path };
+    if (!ifs) {
+        throw std::runtime_error{ "cannot open configuration file: " + path };
+    }
+
+    ConfigMap conf;
+    std::string line;
+
+    while (std::getline( ifs, line )) {
+        line = string_utilities::strip( line );
+        if ( !line.empty() && line[0] != '#' ) {
+            StrVector pieces = string_utilities::split( line, '=' );
+            if (pieces.size() == 2) {
+                // the Kafka settings are kept too; nothing in a snapshot reads them.
+                conf[ string_utilities::strip( pieces[0] ) ] = string_utilities::strip( pieces[1] );
+            }
+        }
+    }
+
+    return conf;
+}
+
+std::string PrivacyReloader::mapfile_for( const ConfigMap& conf ) const
+{
+    if (!mapfile_override_.empty()) return mapfile_override_;
+
+    auto search = conf.find("privacy.filter.geofence.mapfile");
+    return search != conf.end() ? search->second : std::string{};
+}
+
+std::string PrivacyReloader::delta_for( const ConfigMap& conf ) const
+{
+    auto search = conf.find("privacy.filter.geofence.delta");
+    return search != conf.end() ? search->second : std::string{};
+}
+
+std::string PrivacyReloader::geofence_key_for( const ConfigMap& conf ) const
+{
+    std::map<std::string, std::string> settings;
+    for (auto& setting : conf) {
+        if (setting.first.compare( 0, 23, "privacy.filter.geofence" ) == 0) settings.insert( setting );
+    }
+
+    std::string mapfile = mapfile_for( conf );
+    FileStamp map_stamp = stamp( mapfile );
+
+    std::string key = mapfile + "\n" + std::to_string( map_stamp.mtime_ns ) + " " + std::to_string( map_stamp.size ) + " " +
+                      std::to_string( map_stamp.inode ) + "\n";
+    for (auto& setting : settings) {
+        key += setting.first + "=" + setting.second + "\n";
+    }
+
+    return key;
+}
+
+void PrivacyReloader::watch( const ConfigMap& conf )
+{
+    watched_ = { config_file_, mapfile_for( conf ), delta_for( conf ), fields_file_ };
+
+    stamps_.clear();
+    for (auto& path : watched_) {
+        stamps_.push_back( stamp( path ) );
+    }
+}
@@ -0,0 +1,76 @@
+/**
+ * @file
+ * @version
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory.
+ */
+
+#include "privacySnapshot.hpp"
+
+PrivacySnapshot::PrivacySnapshot( const ConfigMap& conf, const std::string& mapfile, GeofenceIndex::CPtr index,
+                                  Quad::Ptr base, const RedactionPropertiesManager& rpm, uint64_t generation ) :
+    conf_{ conf },
+    mapfile_{ mapfile },
+    geofence_index_{ index },
+    geofence_base_{ base },
+    velocity_filter_{ conf },
+    id_redactor_{ conf },
+    rpm_{ rpm },
+    generation_{ generation }
+{
+}
+
+const ConfigMap& PrivacySnapshot::get_configuration() const
+{
+    return conf_;
+}
+
+const std::string& PrivacySnapshot::get_mapfile() const
+{
+    return mapfile_;
+}
+
+const GeofenceIndex::CPtr& PrivacySnapshot::get_geofence_index() const
+{
+    return geofence_index_;
+}
+
+const Quad::Ptr& PrivacySnapshot::get_geofence_base() const
+{
+    return geofence_base_;
+}
+
+const VelocityFilter& PrivacySnapshot::get_velocity_filter() const
+{
+    return velocity_filter_;
+}
+
+const IdRedactor& PrivacySnapshot::get_id_redactor() const
+{
+    return id_redactor_;
+}
+
+const RedactionPropertiesManager& PrivacySnapshot::get_redaction_properties() const
+{
+    return rpm_;
+}
+
+uint64_t PrivacySnapshot::get_generation() const
+{
+    return generation_;
+}
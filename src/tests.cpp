@@ -1,6 +1,7 @@
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
 #include "redactionPropertiesManager.hpp"
+#include "redactionTrie.hpp"
 
 // NOTE: The test file OPERAND is a <test-spec> (see github.com/philsquared/Catch/blob/master/docs/command-line.md) 
 // <test-spec> is defined as below.
@@ -11,6 +12,13 @@
 // NOTE: If test specifier includes spaces, quote the specifier on the CL.
 // NOTE: specifiers in square brackets can be used to develop predicates: [one][two],[three].  All tests tagged with one AND two OR tagged with three.
 
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
 #include <memory>
 #include <bitset>
 #include <sstream>
@@ -18,17 +26,45 @@
 #include <fstream>
 #include <string>
 #include <vector>
+#include <map>
+#include <set>
 // #include <iterator>
 // #include <algorithm>
 #include <regex>
 #include <iomanip>
+#include <random>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <chrono>
+#include <thread>
 
 #include "cvlib.hpp"
 #include "bsmHandler.hpp"
 #include "bsm.hpp"
+#include "privacyReloader.hpp"
 
 static std::shared_ptr<PpmLogger> testLogger = std::make_shared<PpmLogger>("testInfo.log", "testError.log");
 
+/**
+ * @brief The calls to the global operator new in this process, i.e., the heap allocations of C++ objects; rapidjson's
+ * own buffers are allocated with malloc and are not counted.
+ */
+static std::atomic<uint64_t> heapAllocations{ 0 };
+
+void* operator new( std::size_t size ) {
+    ++heapAllocations;
+
+    void* p = std::malloc( size ? size : 1 );
+    if (!p) throw std::bad_alloc{};
+    return p;
+}
+
+void operator delete( void* p ) noexcept {
+    std::free( p );
+}
+
 /**
  * @brief Load the test case JSON data from case_file and return that data in case_data.
  *
@@ -57,6 +93,75 @@ bool loadTestCases( const std::string& case_file, StrVector& case_data ) {
     return( !case_data.empty() );
 }
 
+/**
+ * @brief Load the cases of every line-delimited message file in unit-test-data and data.
+ *
+ * @param case_data vector of strings that will be loaded with the cases.
+ * @return true if all are loaded, false if some failure occurs.
+ */
+bool loadAllTestCases( StrVector& case_data ) {
+    static const StrVector case_files{
+        "unit-test-data/error_cases.json",
+        "unit-test-data/test-case.all.good.json",
+        "unit-test-data/test-case.all.good.tims.json",
+        "unit-test-data/test-case.bad.id.json",
+        "unit-test-data/test-case.bad.speed.json",
+        "unit-test-data/test-case.bad.speed.tims.json",
+        "unit-test-data/test-case.inside.geofence.json",
+        "unit-test-data/test-case.inside.geofence.tims.json",
+        "unit-test-data/test-case.malformed.json",
+        "unit-test-data/test-case.outside.geofence.json",
+        "unit-test-data/test-case.outside.geofence.tims.json",
+        "unit-test-data/test-case.redaction.general.json",
+        "unit-test-data/test-case.redaction.general.nobitstrings.json",
+        "data/I_80_test.json",
+        "data/I_80_test.json.old",
+        "data/I_80_test_TIMS.json",
+        "data/bsm.new.json",
+        "data/archive/bsm.wy.test.json",
+        "data/archive/plymouth_test.json",
+        "data/archive/testing_data.json"
+    };
+
+    for (auto& case_file : case_files) {
+        if (!loadTestCases( case_file, case_data )) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Apply one privacy snapshot of conf to each handler, then activate FIRST if bit 0 of features is set and
+ * SECOND if bit 1 is set, deactivating them otherwise. Each handler copies the snapshot's id redactor, so all of them
+ * draw the same random ids afterwards.
+ *
+ * @param conf the configuration of the snapshot.
+ * @param handlers the handlers to compare; they share the geofence index of the first.
+ * @param features the two bits that select the flags.
+ */
+template <uint32_t FIRST, uint32_t SECOND>
+void applyTestSnapshot( const ConfigMap& conf, std::initializer_list<BSMHandler*> handlers, uint32_t features ) {
+    PrivacySnapshot snapshot{ conf, "", (*handlers.begin())->get_geofence_index(), nullptr, RedactionPropertiesManager{} };
+
+    for (BSMHandler* handler : handlers) {
+        handler->apply( snapshot );
+
+        if (features & 0x1) {
+            handler->activate<FIRST>();
+        } else {
+            handler->deactivate<FIRST>();
+        }
+
+        if (features & 0x2) {
+            handler->activate<SECOND>();
+        } else {
+            handler->deactivate<SECOND>();
+        }
+    }
+}
+
 
 bool buildBaseConfiguration( ConfigMap& conf ) {
     conf.clear();
@@ -118,6 +223,78 @@ Quad::Ptr buildTestQuadTree( void ) {
     return qptr;
 }
 
+/**
+ * @brief Build a quad tree of the I_80 map the way PPM::BuildGeofence does, precomputing the edge corridors.
+ *
+ * @param extension the number of meters to extend the edge areas.
+ * @return the root of the tree.
+ */
+Quad::Ptr buildI80QuadTree( double extension ) {
+    geo::Point sw{ 40.997, -111.041 };
+    geo::Point ne{ 42.085, -104.047 };
+
+    Quad::Ptr qptr = std::make_shared<Quad>(sw, ne);
+
+    shapes::CSVInputFactory shape_factory( "data/I_80.edges" );
+    shape_factory.make_shapes();
+
+    for (auto& edge_ptr : shape_factory.get_edges()) {
+        Quad::insert( qptr, edge_ptr, geo::Corridor{ *edge_ptr->to_area(extension) } );
+    }
+
+    return qptr;
+}
+
+/**
+ * @brief Sample points on and around the I_80 map: the vertices and midpoints of every seventh edge, each jittered by
+ * up to about 50 meters so that points fall inside, outside and on the edges of the corridors.
+ *
+ * @return the sample points.
+ */
+std::vector<geo::Point> sampleI80Points( void ) {
+    std::vector<geo::Point> points;
+    std::mt19937 generator{ 80 };
+    std::uniform_real_distribution<double> jitter{ -0.0005, 0.0005 };
+
+    shapes::CSVInputFactory shape_factory( "data/I_80.edges" );
+    shape_factory.make_shapes();
+
+    const std::vector<geo::EdgeCPtr>& edges = shape_factory.get_edges();
+    for (std::size_t i = 0; i < edges.size(); i += 7) {
+        const geo::Vertex& v1 = *edges[i]->v1;
+        const geo::Vertex& v2 = *edges[i]->v2;
+        points.emplace_back( v1.lat, v1.lon );
+        points.emplace_back( (v1.lat + v2.lat) / 2.0, (v1.lon + v2.lon) / 2.0 );
+        points.emplace_back( v1.lat + jitter(generator), v1.lon + jitter(generator) );
+        points.emplace_back( (v1.lat + v2.lat) / 2.0 + jitter(generator), (v1.lon + v2.lon) / 2.0 + jitter(generator) );
+    }
+
+    return points;
+}
+
+/**
+ * @brief The geofence check as originally done by the BSMHandler: retrieve the leaf entities and rebuild the area of
+ * every edge. Used as the reference for the compiled geofence structures.
+ *
+ * @param qptr the quad tree.
+ * @param pt the point to check.
+ * @param extension the number of meters to extend the edge areas.
+ * @return true if the point is within an entity of its leaf.
+ */
+bool referenceWithinEntity( const Quad::Ptr& qptr, const geo::Point& pt, double extension ) {
+    for (auto& entity_ptr : qptr->retrieve_elements(pt)) {
+        if (entity_ptr->get_type() == "edge") {
+            if (std::static_pointer_cast<const geo::Edge>(entity_ptr)->to_area(extension)->contains(pt)) return true;
+        } else if (entity_ptr->get_type() == "circle") {
+            if (std::static_pointer_cast<const geo::Circle>(entity_ptr)->contains(pt)) return true;
+        } else if (entity_ptr->get_type() == "grid") {
+            if (std::static_pointer_cast<const geo::Grid>(entity_ptr)->contains(pt)) return true;
+        }
+    }
+
+    return false;
+}
+
 bool validateSanitizedProperty( const std::string& json ) {
     static const std::regex re_sanitized{ "\"sanitized\"[ ]*:[ ]*true", std::regex::icase | std::regex::extended };
     return ( std::regex_search( json, re_sanitized ) );
@@ -422,6 +599,241 @@ TEST_CASE( "Parse Shape File Data", "[quad][shapefile]" ) {
     CHECK_NOTHROW(output_factory.write_shapes());
 }
 
+TEST_CASE("Fast Shape Loading", "[quad][shapefile][load]") {
+
+    // load_shapes must produce exactly what make_shapes does: the same shapes, in the same order, sharing the same
+    // vertices, with the same coordinates to the bit.
+    auto check_same = []( const shapes::CSVInputFactory& expected, const shapes::CSVInputFactory& loaded ) {
+        REQUIRE( loaded.get_circles().size() == expected.get_circles().size() );
+        for ( std::size_t i = 0; i < expected.get_circles().size(); ++i ) {
+            const geo::Circle& a = *expected.get_circles()[i];
+            const geo::Circle& b = *loaded.get_circles()[i];
+            CHECK( b.uid == a.uid );
+            CHECK( b.lat == a.lat );
+            CHECK( b.lon == a.lon );
+            CHECK( b.radius == a.radius );
+        }
+
+        REQUIRE( loaded.get_grids().size() == expected.get_grids().size() );
+        for ( std::size_t i = 0; i < expected.get_grids().size(); ++i ) {
+            const geo::Grid& a = *expected.get_grids()[i];
+            const geo::Grid& b = *loaded.get_grids()[i];
+            CHECK( b.row == a.row );
+            CHECK( b.col == a.col );
+            CHECK( b.sw.lat == a.sw.lat );
+            CHECK( b.sw.lon == a.sw.lon );
+            CHECK( b.ne.lat == a.ne.lat );
+            CHECK( b.ne.lon == a.ne.lon );
+        }
+
+        REQUIRE( loaded.get_edges().size() == expected.get_edges().size() );
+        CHECK( loaded.get_edge_ways() == expected.get_edge_ways() );
+
+        // vertices are deduplicated the same way: equal edges share a vertex exactly when the originals do.
+        std::map<const geo::Vertex*, const geo::Vertex*> vertices;
+        bool same = true;
+        for ( std::size_t i = 0; i < expected.get_edges().size(); ++i ) {
+            const geo::Edge& a = *expected.get_edges()[i];
+            const geo::Edge& b = *loaded.get_edges()[i];
+            same = same && b.get_uid() == a.get_uid() && b.get_way_type() == a.get_way_type();
+
+            const geo::Vertex* va[2] = { a.v1.get(), a.v2.get() };
+            const geo::Vertex* vb[2] = { b.v1.get(), b.v2.get() };
+            for ( int v = 0; v < 2; ++v ) {
+                auto mapped = vertices.emplace( va[v], vb[v] ).first->second;
+                same = same && mapped == vb[v] && vb[v]->uid == va[v]->uid && vb[v]->lat == va[v]->lat &&
+                       vb[v]->lon == va[v]->lon && vb[v]->degree() == va[v]->degree();
+            }
+        }
+        CHECK( same );
+
+        CHECK( loaded.get_removed_edges() == expected.get_removed_edges() );
+        CHECK( loaded.get_removed_circles() == expected.get_removed_circles() );
+    };
+
+    SECTION( "I_80" ) {
+        shapes::CSVInputFactory expected{ "data/I_80.edges" };
+        expected.make_shapes();
+        REQUIRE( expected.get_edges().size() == 20997 );
+
+        for ( unsigned threads : { 1u, 3u, 8u, 0u } ) {
+            shapes::CSVInputFactory loaded{ "data/I_80.edges" };
+            loaded.load_shapes( threads );
+            check_same( expected, loaded );
+        }
+    }
+
+    SECTION( "Circles and Grids" ) {
+        shapes::CSVInputFactory expected{ "unit-test-data/test-data/test.shapes" };
+        expected.make_shapes();
+        shapes::CSVInputFactory loaded{ "unit-test-data/test-data/test.shapes" };
+        loaded.load_shapes();
+        CHECK_FALSE( expected.get_circles().empty() );
+        CHECK_FALSE( expected.get_grids().empty() );
+        check_same( expected, loaded );
+    }
+
+    SECTION( "Bad Specifications" ) {
+        const std::string path{ "load.test.shapes" };
+        {
+            std::ofstream ofs{ path, std::ios::trunc };
+            ofs << "type,id,geography,attributes\n"
+                << "edge,1,10;41.0;-105.0:11;41.1;-105.1,way_type=Motorway:way_id=A\n"
+                << "edge,2,11;41.2;-105.2:12;41.3;-105.3, way_id = B :way_type=bogus\n"          // moved vertex warning.
+                << "edge,3,13;41.4;-105.4:14;95.0;-105.5\n"                                  // vertex 13 is still made.
+                << "edge,4,13;41.9;-105.9:15;41.5;-105.6,way_type=Service\n"                  // blacklisted.
+                << "edge,5,16;41.6;-105.7:16;41.6;-105.7\n"                                  // same vertex.
+                << "edge,6,17;41.7;x:18;41.8;-105.8\n"
+                << "edge,+7,18;4.18e1;-1058e-1:19; 41.9;-105.9:,way_id=C:way_id=D\n"          // left to std::stoull and std::stod.
+                << "circle,8,42.0:-83.0:10.0\n"
+                << "circle,9,42.0:-83.0\n"
+                << "grid,1_2,42.0:-84.0:42.1:-83.9\n"
+                << "grid,3,42.0:-84.0:42.1:-83.9\n"
+                << "\n"
+                << "polygon,10,1;2;3\n"
+                << "a,b\n"
+                << "remove,edge,1\n"
+                << "remove,circle,8\n"
+                << "remove,grid,3\n"
+                << "edge,11,14;41.95;-105.95:13;41.4;-105.4";                               // no final newline.
+        }
+
+        shapes::CSVInputFactory expected{ path };
+        expected.make_shapes();
+        shapes::CSVInputFactory loaded{ path };
+        loaded.load_shapes( 4 );
+
+        CHECK( expected.get_edges().size() == 4 );
+        CHECK( expected.get_edge_ways() == StrVector( { "A", "B", "D", "" } ) );
+        check_same( expected, loaded );
+        std::remove(path.c_str());
+
+        shapes::CSVInputFactory missing{ "unit-test-data/test-data/missing.shapes" };
+        CHECK_THROWS_AS( missing.load_shapes(), std::invalid_argument );
+        shapes::CSVInputFactory headless{ "unit-test-data/test-data/test.shapes.bad2" };
+        CHECK_THROWS_AS( headless.load_shapes(), std::invalid_argument );
+    }
+}
+
+TEST_CASE("Road Graph", "[quad][shapefile][graph]") {
+
+    SECTION( "I_80" ) {
+        shapes::CSVInputFactory expected{ "data/I_80.edges" };
+        expected.load_shapes();
+        shapes::CSVInputFactory loaded{ "data/I_80.edges" };
+        RoadGraph graph = loaded.load_graph( 3 );
+
+        CHECK( loaded.get_edges().empty() );
+        REQUIRE( graph.edge_count() == expected.get_edges().size() );
+
+        std::set<uint64_t> vertex_uids;
+        bool same = true;
+        for ( uint32_t e = 0; e < graph.edge_count(); ++e ) {
+            const geo::Edge& edge = *expected.get_edges()[e];
+            const RoadGraph::Link& link = graph.edge( e );
+            const geo::Vertex* vertices[2] = { edge.v1.get(), edge.v2.get() };
+            uint32_t ends[2] = { link.source, link.target };
+
+            same = same && link.uid == edge.get_uid() && link.way_type == edge.get_way_type() &&
+                   graph.way( e ) == expected.get_edge_ways()[e];
+
+            for ( int i = 0; i < 2; ++i ) {
+                const RoadGraph::Node& node = graph.vertex( ends[i] );
+                same = same && node.uid == vertices[i]->uid && node.lat == vertices[i]->lat && node.lon == vertices[i]->lon &&
+                       graph.find( node.uid ) == ends[i] && graph.opposite( e, ends[i] ) == ends[1 - i];
+
+                // the incident edges are those of the vertex, in edge order.
+                std::set<uint64_t> incident;
+                for ( auto& edge_ptr : vertices[i]->get_incident_edges() ) {
+                    incident.insert( edge_ptr->get_uid() );
+                }
+
+                RoadGraph::Range range = graph.incident( ends[i] );
+                same = same && graph.degree( ends[i] ) == vertices[i]->degree() && std::is_sorted( range.first, range.second );
+                for ( const uint32_t* p = range.first; p != range.second; ++p ) {
+                    same = same && incident.count( graph.edge( *p ).uid ) == 1;
+                }
+
+                vertex_uids.insert( node.uid );
+            }
+        }
+        CHECK( same );
+        CHECK( graph.vertex_count() == vertex_uids.size() );
+        CHECK( graph.find( 99999999 ) == RoadGraph::kNoVertex );
+
+        // a small fraction of the Vertex and Edge instances with their incident edge sets.
+        CHECK( graph.memory_bytes() < 64 * (graph.vertex_count() + graph.edge_count()) );
+
+        std::vector<geo::EdgeCPtr> edges;
+        StrVector ways;
+        graph.make_edges( edges, ways );
+        REQUIRE( edges.size() == expected.get_edges().size() );
+        CHECK( ways == expected.get_edge_ways() );
+
+        for ( std::size_t e = 0; e < edges.size(); ++e ) {
+            const geo::Edge& a = *expected.get_edges()[e];
+            const geo::Edge& b = *edges[e];
+            same = same && b.get_uid() == a.get_uid() && b.v1->uid == a.v1->uid && b.v2->lat == a.v2->lat &&
+                   b.v2->lon == a.v2->lon && b.v1->degree() == 0;
+        }
+        CHECK( same );
+
+        // consecutive edges share a vertex, and nothing holds it in a cycle.
+        CHECK( edges[0]->v2 == edges[1]->v1 );
+        std::weak_ptr<geo::Vertex> vertex = edges[0]->v2;
+        edges.clear();
+        CHECK( vertex.expired() );
+    }
+
+    SECTION( "Bad Specifications" ) {
+        const std::string path{ "graph.test.shapes" };
+        {
+            std::ofstream ofs{ path, std::ios::trunc };
+            ofs << "type,id,geography,attributes\n"
+                << "edge,1,10;41.0;-105.0:11;41.1;-105.1,way_type=motorway:way_id=A\n"
+                << "edge,2,11;41.2;-105.2:12;41.3;-105.3,way_id=B\n"
+                << "edge,3,13;41.4;-105.4:14;95.0;-105.5\n"
+                << "edge,5,16;41.6;-105.7:16;41.6;-105.7\n"
+                << "circle,8,42.0:-83.0:10.0\n"
+                << "edge,11,14;41.95;-105.95:11;41.4;-105.4,way_id=A\n";
+        }
+
+        shapes::CSVInputFactory loaded{ path };
+        RoadGraph graph = loaded.load_graph();
+        std::remove(path.c_str());
+
+        CHECK( loaded.get_circles().size() == 1 );
+        REQUIRE( graph.edge_count() == 3 );
+        CHECK( graph.vertex_count() == 6 );                    // 13 and 16 are made before their edges fail.
+        CHECK( graph.edge( 2 ).way == graph.edge( 0 ).way );
+        CHECK( graph.way( 1 ) == "B" );
+        CHECK( graph.way( 2 ) == "A" );
+
+        uint32_t shared = graph.find( 11 );
+        REQUIRE( shared != RoadGraph::kNoVertex );
+        CHECK( graph.vertex( shared ).lat == 41.1 );
+        CHECK( graph.degree( shared ) == 3 );
+        CHECK( graph.degree( graph.find( 13 ) ) == 0 );
+        CHECK( graph.find( 12 ) != RoadGraph::kNoVertex );
+        CHECK( graph.find( 15 ) == RoadGraph::kNoVertex );
+    }
+
+    SECTION( "Construction" ) {
+        RoadGraph empty;
+        CHECK( empty.vertex_count() == 0 );
+        CHECK( empty.edge_count() == 0 );
+        CHECK( empty.find( 1 ) == RoadGraph::kNoVertex );
+
+        std::vector<RoadGraph::Node> nodes{ { 1, 41.0, -105.0 }, { 2, 41.1, -105.1 } };
+        CHECK_NOTHROW( RoadGraph( nodes, { { 7, 0, 1, osm::Highway::MOTORWAY, 0 } }, { "" } ) );
+        CHECK_THROWS_AS( RoadGraph( nodes, { { 7, 0, 2, osm::Highway::MOTORWAY, 0 } }, { "" } ), std::invalid_argument );
+        CHECK_THROWS_AS( RoadGraph( nodes, { { 7, 1, 1, osm::Highway::MOTORWAY, 0 } }, { "" } ), std::invalid_argument );
+        CHECK_THROWS_AS( RoadGraph( nodes, { { 7, 0, 1, osm::Highway::MOTORWAY, 1 } }, { "" } ), std::invalid_argument );
+        CHECK_THROWS_AS( RoadGraph( nodes, {}, { "A" } ), std::invalid_argument );
+        CHECK_THROWS_AS( RoadGraph( { { 1, 41.0, -105.0 }, { 1, 41.1, -105.1 } }, {}, { "" } ), std::invalid_argument );
+    }
+}
+
 TEST_CASE("Entity", "[quad][entity]") {
     SECTION("Conversions") {
         CHECK(geo::to_degrees(0.0) == Approx(0.0));
@@ -668,6 +1080,36 @@ TEST_CASE("Entity", "[quad][entity]") {
         CHECK(phss_area->get_poly_string() == "-83.93236639,35.95255325,0 -83.9280134,35.94893125,0 -83.9281486,35.94882475,0 -83.93250161,35.95244675,0 -83.93236639,35.95255325,0");
     }
 
+    SECTION("Corridor") {
+        geo::Corridor empty;
+        CHECK(empty.empty());
+        CHECK_FALSE(empty.contains(inside));
+        CHECK_FALSE(empty.contains(midsum));
+
+        geo::Corridor phss_corridor{ *phss_area };
+        CHECK_FALSE(phss_corridor.empty());
+        CHECK(phss_corridor.contains(midsum));
+        CHECK(phss_corridor.contains(inside));
+        CHECK_FALSE(phss_corridor.contains(loc_a));
+        CHECK_FALSE(phss_corridor.contains(outside_1));
+        CHECK_FALSE(phss_corridor.contains(outside_2));
+        CHECK(geo::Corridor{ *phss_area_long }.contains(outside_2));
+
+        // the corridor must agree with the area everywhere, including right at its edges.
+        for (auto& area_ptr : { phss_area, phss_area_long, phss_area_wide_long }) {
+            geo::Corridor corridor{ *area_ptr };
+            for (int i = 0; i <= 200; ++i) {
+                for (int j = 0; j <= 200; ++j) {
+                    geo::Point pt{ 35.9487 + i * 0.00002, -83.9327 + j * 0.000025 };
+                    CHECK(corridor.contains(pt) == area_ptr->contains(pt));
+                }
+            }
+            for (auto& corner : area_ptr->get_corners()) {
+                CHECK(corridor.contains(corner) == area_ptr->contains(corner));
+            }
+        }
+    }
+
     geo::Circle c1(cage, 10.0);
     // contains itself
     geo::Circle c2(cage, 0.0);
@@ -794,6 +1236,12 @@ TEST_CASE("Entity", "[quad][entity]") {
         CHECK(phss->get_type() == "edge");
         CHECK(c1.get_type() == "circle");
         CHECK(g2_ptr->get_type() == "grid");
+        CHECK(b_inside.get_entity_type() == geo::EntityType::LOCATION);
+        CHECK(v_a->get_entity_type() == geo::EntityType::LOCATION);
+        CHECK(phss->get_entity_type() == geo::EntityType::EDGE);
+        CHECK(phss_area->get_entity_type() == geo::EntityType::AREA);
+        CHECK(c1.get_entity_type() == geo::EntityType::CIRCLE);
+        CHECK(g2_ptr->get_entity_type() == geo::EntityType::GRID);
         CHECK(b_inside.touches(b1));
         CHECK(phss->touches(b1));
         CHECK(g2_ptr->touches(b1));
@@ -935,166 +1383,1596 @@ TEST_CASE("Quad Tree", "[quad]") {
         CHECK(Quad::retrieve_all_bounds(quad_ptr, false, true).size() == 3);
         CHECK(Quad::retrieve_all_bounds(quad_ptr, true, true).size() == 2);
     }
+
+    SECTION("Corridors") {
+        geo::Corridor phss_corridor{ *phss->to_area(5.0) };
+        CHECK(Quad::insert(quad_ptr_2, phss, phss_corridor));
+        CHECK(Quad::insert(quad_ptr_2, ahw));
+        CHECK(Quad::insert(quad_ptr_2, ahe));
+
+        // force splits so the corridors are redistributed with their entities.
+        for (int i = 0; i < Quad::MAX_ELEMENTS + 1; ++i) {
+            geo::Location::Ptr test_loc_ptr = std::make_shared<geo::Location>(35.951959, -83.931815, i);
+            Quad::insert(quad_ptr_2, test_loc_ptr);
+        }
+        CHECK(Quad::retrieve_all_bounds(quad_ptr_2, true).size() > 1);
+
+        CHECK_FALSE(quad_ptr_2->retrieve_leaf(test_point_3));
+        const Quad* leaf = quad_ptr_2->retrieve_leaf(*v_a);
+        REQUIRE(leaf);
+        CHECK(leaf->get_elements() == quad_ptr_2->retrieve_elements(*v_a));
+        REQUIRE(leaf->get_corridors().size() == leaf->get_elements().size());
+
+        // only phss was inserted with a corridor; the others get theirs from make_corridors.
+        for (std::size_t i = 0; i < leaf->get_elements().size(); ++i) {
+            const geo::Entity* entity = leaf->get_elements()[i].get();
+            CHECK(leaf->get_corridors()[i].empty() == (entity != phss.get()));
+        }
+
+        Quad::LeafView view = quad_ptr_2->retrieve_leaf_view(*v_a);
+        CHECK(view.size == leaf->get_elements().size());
+        CHECK(view.elements == leaf->get_elements().data());
+        CHECK(view.corridors == leaf->get_corridors().data());
+        CHECK(quad_ptr_2->retrieve_leaf_view(test_point_3).empty());
+        CHECK_FALSE(quad_ptr_2->is_within_entity(test_point_3));
+
+        // edges without corridors contain nothing until they are computed.
+        geo::Point on_ahw{ (v_a->lat + v_c->lat) / 2.0, (v_a->lon + v_c->lon) / 2.0 };
+        CHECK_FALSE(quad_ptr_2->is_within_entity(on_ahw));
+
+        Quad::make_corridors(quad_ptr_2, 10.0);
+        CHECK(quad_ptr_2->is_within_entity(on_ahw));
+        geo::Corridor ahw_corridor{ *ahw->to_area(10.0) };
+        for (std::size_t i = 0; i < leaf->get_elements().size(); ++i) {
+            const geo::Entity* entity = leaf->get_elements()[i].get();
+            const geo::Corridor& corridor = leaf->get_corridors()[i];
+            CHECK(corridor.empty() == (entity->get_type() != "edge"));
+
+            if (entity == phss.get()) {
+                // corridors that were provided are not recomputed.
+                CHECK(corridor.max_lat == phss_corridor.max_lat);
+                CHECK(corridor.c[0] == phss_corridor.c[0]);
+            } else if (entity == ahw.get()) {
+                CHECK(corridor.min_lon == ahw_corridor.min_lon);
+                CHECK(corridor.a[1] == ahw_corridor.a[1]);
+            }
+        }
+    }
 }
 
-/** PPM tests below **/
+/**
+ * @brief Check that two quad trees have the same shape and the same leaves: bounds, elements and corridors, in order.
+ *
+ * @param lhs the root of one tree.
+ * @param rhs the root of the other tree.
+ * @return the number of leaves compared.
+ */
+std::size_t checkSameTree( const Quad& lhs, const Quad& rhs ) {
+    CHECK(lhs.sw.lat == rhs.sw.lat);
+    CHECK(lhs.sw.lon == rhs.sw.lon);
+    CHECK(lhs.ne.lat == rhs.ne.lat);
+    CHECK(lhs.ne.lon == rhs.ne.lon);
+    REQUIRE(lhs.get_children().size() == rhs.get_children().size());
+
+    std::size_t leaves = 0;
+    for (std::size_t c = 0; c < lhs.get_children().size(); ++c) {
+        leaves += checkSameTree(*lhs.get_children()[c], *rhs.get_children()[c]);
+    }
+    if (lhs.haschildren()) return leaves;
 
-TEST_CASE( "Redactor Checks", "[ppm][redactor]" ) {
+    REQUIRE(lhs.get_elements().size() == rhs.get_elements().size());
+    REQUIRE(lhs.get_corridors().size() == rhs.get_corridors().size());
+    for (std::size_t i = 0; i < lhs.get_elements().size(); ++i) {
+        CHECK(lhs.get_elements()[i] == rhs.get_elements()[i]);
+        CHECK(std::memcmp(&lhs.get_corridors()[i], &rhs.get_corridors()[i], sizeof(geo::Corridor)) == 0);
+    }
+    return 1;
+}
 
-    ConfigMap conf{ 
-        { "privacy.redaction.id.inclusions", "ON" },
-        { "privacy.redaction.id.included", "ID1,ID2" },
-        { "privacy.redaction.id.value", "FFFF" },
-    };
+TEST_CASE("Quad Bulk Insert", "[quad][bulk]") {
+    SECTION("I_80") {
+        geo::Point sw{ 40.997, -111.041 };
+        geo::Point ne{ 42.085, -104.047 };
 
-    std::string r;
-    IdRedactor idr{ conf };
+        shapes::CSVInputFactory shape_factory( "data/I_80.edges" );
+        shape_factory.make_shapes();
 
-    SECTION( "Inclusion State Checks" ) {
+        geo::Entity::PtrList entities;
+        std::vector<geo::Corridor> corridors;
+        for (auto& edge_ptr : shape_factory.get_edges()) {
+            entities.push_back(edge_ptr);
+            corridors.emplace_back(*edge_ptr->to_area(10.0));
+        }
 
-        // checks from setup above.
-        CHECK( idr.HasInclusions() );
-        CHECK( idr.NumInclusions() == 2 );
+        Quad::Ptr serial = std::make_shared<Quad>(sw, ne);
+        std::size_t inserted = 0;
+        for (std::size_t i = 0; i < entities.size(); ++i) {
+            if (Quad::insert(serial, entities[i], corridors[i])) ++inserted;
+        }
 
-        idr.ClearInclusions();
-        CHECK( idr.NumInclusions() == 0 );
+        for (unsigned threads : { 1u, 2u, 3u, 8u, 0u }) {
+            INFO("threads: " << threads);
+            Quad::Ptr bulk = std::make_shared<Quad>(sw, ne);
+            CHECK(Quad::bulk_insert(bulk, entities, corridors, threads) == inserted);
+            CHECK(checkSameTree(*serial, *bulk) == Quad::retrieve_all_bounds(serial, true).size());
+        }
 
-        idr.RedactAll();
-        CHECK_FALSE( idr.HasInclusions() );
-        CHECK( idr.NumInclusions() == -1 );
-        CHECK(idr.redaction_value() == "FFFF");
-        CHECK( idr.AddIdInclusion("ID3") );
+        // without corridors every leaf gets empty ones, like Quad::insert without a corridor.
+        Quad::Ptr plain = std::make_shared<Quad>(sw, ne);
+        for (auto& entity : entities) {
+            Quad::insert(plain, entity);
+        }
+        Quad::Ptr bulk = std::make_shared<Quad>(sw, ne);
+        Quad::bulk_insert(bulk, entities, std::vector<geo::Corridor>{}, 4);
+        checkSameTree(*plain, *bulk);
+
+        CHECK_THROWS_AS(Quad::bulk_insert(bulk, entities, corridors), std::invalid_argument);
+        Quad::Ptr empty = std::make_shared<Quad>(sw, ne);
+        corridors.pop_back();
+        CHECK_THROWS_AS(Quad::bulk_insert(empty, entities, corridors), std::invalid_argument);
     }
 
-    SECTION( "Inclusion Redaction" ) {
+    SECTION("Mixed Entities") {
+        // circles, edges and grids, some outside the root and a cluster too dense for the smallest quad.
+        geo::Point sw{ 35.946920, -83.938486 };
+        geo::Point ne{ 35.955526, -83.926738 };
+
+        std::mt19937 gen{ 8 };
+        std::uniform_real_distribution<double> lat{ 35.94, 35.96 };
+        std::uniform_real_distribution<double> lon{ -83.94, -83.92 };
+
+        geo::Entity::PtrList entities;
+        for (int i = 0; i < 400; ++i) {
+            switch (i % 4) {
+                case 0:
+                    entities.push_back(std::make_shared<geo::Circle>(lat(gen), lon(gen), 5.0 + i % 30));
+                    break;
+                case 1: {
+                    geo::Location corner{ lat(gen), lon(gen) };
+                    entities.push_back(std::make_shared<geo::Grid>(corner, geo::Location{ corner.lat + 0.0003, corner.lon + 0.0004 }, 0, i));
+                    break;
+                }
+                default: {
+                    auto a = std::make_shared<geo::Vertex>(lat(gen), lon(gen), 2 * i);
+                    auto b = std::make_shared<geo::Vertex>(a->lat + 0.0008, a->lon - 0.0011, 2 * i + 1);
+                    entities.push_back(std::make_shared<geo::Edge>(a, b, osm::Highway::SECONDARY, i));
+                    break;
+                }
+            }
+        }
+        for (int i = 0; i < 50; ++i) {
+            entities.push_back(std::make_shared<geo::Circle>(35.951250, -83.931861, 1.0 + i));
+        }
 
-        r = "ID1";
-        CHECK( idr(r) );
-        // should be random.
-        CHECK( r != "ID1" );
-    }
+        Quad::Ptr serial = std::make_shared<Quad>(sw, ne);
+        for (auto& entity : entities) {
+            Quad::insert(serial, entity);
+        }
+        Quad::make_corridors(serial, 5.2);
 
-    SECTION( "Exclusion No Redact" ) {
+        Quad::Ptr bulk = std::make_shared<Quad>(sw, ne);
+        Quad::bulk_insert(bulk, entities, std::vector<geo::Corridor>{}, 3);
+        Quad::make_corridors(bulk, 5.2);
 
-        r = "IDX";
-        CHECK_FALSE( idr(r) );
-        // no random redaction.
-        CHECK( r == "IDX" );
+        checkSameTree(*serial, *bulk);
+
+        // the dense cluster overflows a leaf that is too small to split.
+        CHECK(serial->haschildren());
+        CHECK(serial->retrieve_leaf(geo::Point{ 35.951250, -83.931861 })->get_elements().size() > static_cast<std::size_t>(Quad::MAX_ELEMENTS));
     }
+}
 
-    SECTION( "Add Id" ) {
+TEST_CASE("Quad Edit", "[quad][edit]") {
+    geo::Point sw{ 40.997, -111.041 };
+    geo::Point ne{ 42.085, -104.047 };
 
-        idr.AddIdInclusion( "ID3" );
-        CHECK( idr.HasInclusions() );
-        CHECK( idr.NumInclusions() == 3 );
+    shapes::CSVInputFactory shape_factory( "data/I_80.edges" );
+    shape_factory.make_shapes();
 
-        SECTION( "Inclusion Redaction" ) {
-            r = "ID3";
-            CHECK( idr(r) );
-            CHECK( r != "ID3" );
-        }
+    geo::Entity::PtrList entities;
+    std::vector<geo::Corridor> corridors;
+    for (auto& edge_ptr : shape_factory.get_edges()) {
+        entities.push_back(edge_ptr);
+        corridors.emplace_back(*edge_ptr->to_area(10.0));
     }
 
-    SECTION( "Remove Id" ) {
+    auto build = [&](std::size_t begin, std::size_t end, const std::unordered_set<uint64_t>& skip) {
+        Quad::Ptr qptr = std::make_shared<Quad>(sw, ne);
+        for (std::size_t i = begin; i < end; ++i) {
+            if (skip.count(shape_factory.get_edges()[i]->get_uid()) == 0) Quad::insert(qptr, entities[i], corridors[i]);
+        }
+        return qptr;
+    };
 
-        idr.RemoveIdInclusion( "ID1" );
-        CHECK( idr.HasInclusions() );
-        CHECK( idr.NumInclusions() == 1 );
+    Quad::Ptr full = build(0, entities.size(), {});
+    std::size_t nodes = Quad::retrieve_all_bounds(full).size();
+    std::size_t leaves = Quad::retrieve_all_bounds(full, true).size();
+
+    SECTION("Add") {
+        // adding entities to a tree gives the tree inserting them after the others would.
+        std::size_t split = entities.size() - 300;
+        Quad::Ptr partial = build(0, split, {});
+        std::size_t partial_leaves = Quad::retrieve_all_bounds(partial, true).size();
+
+        Quad::Delta delta;
+        delta.added.assign(entities.begin() + split, entities.end());
+        delta.corridors.assign(corridors.begin() + split, corridors.end());
+
+        Quad::EditStats stats;
+        Quad::Ptr edited = Quad::edit(partial, delta, &stats);
+        CHECK(stats.added == 300);
+        CHECK(stats.removed == 0);
+        CHECK(stats.copied > 0);
+        CHECK(stats.copied < nodes);
+        CHECK(checkSameTree(*full, *edited) == leaves);
+
+        // the original is untouched.
+        CHECK(Quad::retrieve_all_bounds(partial, true).size() == partial_leaves);
+        checkSameTree(*build(0, split, {}), *partial);
+    }
 
-        SECTION( "Inclusion Redaction" ) {
-            r = "ID2";
-            CHECK( idr(r) );
-            CHECK( r != "ID2" );
+    SECTION("Remove") {
+        std::unordered_set<uint64_t> ids;
+        for (std::size_t i = 1000; i < 1400; ++i) {
+            ids.insert(shape_factory.get_edges()[i]->get_uid());
         }
-        SECTION( "Exclusion No Redaction" ) {
-            r = "ID1";
-            CHECK_FALSE( idr(r) );
-            CHECK( r == "ID1" );
-        }
-    }
 
-    SECTION( "Reset to Redact All" ) {
+        Quad::EditStats stats;
+        Quad::Ptr edited = Quad::remove(full, geo::EntityType::EDGE, ids, &stats);
+        CHECK(stats.removed == ids.size());
+        CHECK(stats.added == 0);
+        CHECK(stats.copied < nodes);
+        CHECK(stats.merged > 0);
+        CHECK(Quad::retrieve_all_bounds(edited, true).size() < leaves);
+        CHECK(Quad::retrieve_all_bounds(full).size() == nodes);
+
+        // no removed edge is left, and every other quad is shared with the original tree.
+        std::size_t shared = 0;
+        for (std::size_t c = 0; c < edited->get_children().size(); ++c) {
+            if (edited->get_children()[c] == full->get_children()[c]) ++shared;
+        }
+        CHECK(shared > 0);
 
-        idr.RedactAll();
-        r = "IDX";
-        CHECK( idr(r) );
-        CHECK( r != "IDX" );
-    }
+        Quad::Ptr rebuilt = build(0, entities.size(), ids);
+        std::size_t inside = 0;
+        for (auto& pt : sampleI80Points()) {
+            for (auto& entity : edited->retrieve_elements(pt)) {
+                CHECK(ids.count(std::static_pointer_cast<const geo::Edge>(entity)->get_uid()) == 0);
+            }
+            CHECK(edited->is_within_entity(pt) == rebuilt->is_within_entity(pt));
+            if (full->is_within_entity(pt)) ++inside;
+        }
 
-    SECTION( "Clear Inclusions - Redact NOTHING" ) {
+        // adding them back answers as the original tree does.
+        Quad::Delta delta;
+        delta.added.assign(entities.begin() + 1000, entities.begin() + 1400);
+        delta.corridors.assign(corridors.begin() + 1000, corridors.begin() + 1400);
+        Quad::Ptr restored = Quad::edit(edited, delta, &stats);
+        CHECK(stats.added == 400);
+
+        std::size_t restored_inside = 0;
+        for (auto& pt : sampleI80Points()) {
+            CHECK(restored->is_within_entity(pt) == full->is_within_entity(pt));
+            if (restored->is_within_entity(pt)) ++restored_inside;
+        }
+        CHECK(restored_inside == inside);
 
-        idr.ClearInclusions();
-        r = "ID1";
-        CHECK_FALSE( idr(r) );
-        CHECK( r == "ID1" );
-        r = "ID2";
-        CHECK_FALSE( idr(r) );
-        CHECK( r == "ID2" );
+        // removing everything merges the tree back into an empty root.
+        std::unordered_set<uint64_t> all;
+        for (auto& edge_ptr : shape_factory.get_edges()) {
+            all.insert(edge_ptr->get_uid());
+        }
+        Quad::Ptr empty = Quad::remove(full, geo::EntityType::EDGE, all, &stats);
+        CHECK(stats.merged > 0);
+        CHECK_FALSE(empty->haschildren());
+        CHECK(empty->get_elements().empty());
+    }
 
+    SECTION("Circles and Errors") {
+        Quad::Ptr qptr = buildTestQuadTree();
+        geo::Point center{ 35.951250, -83.931861 };
+
+        Quad::Delta delta;
+        delta.added.push_back(std::make_shared<geo::Circle>(35.949, -83.937, 7, 20.0));
+        Quad::Ptr edited = Quad::edit(qptr, delta);
+        CHECK(edited->is_within_entity(geo::Point{ 35.949, -83.937 }));
+        CHECK_FALSE(qptr->is_within_entity(geo::Point{ 35.949, -83.937 }));
+
+        // the test tree's circle has uid 0.
+        CHECK(edited->is_within_entity(center));
+        Quad::EditStats stats;
+        Quad::Ptr removed = Quad::remove(edited, geo::EntityType::CIRCLE, { 0, 7 }, &stats);
+        CHECK(stats.removed == 2);
+        CHECK_FALSE(removed->is_within_entity(geo::Point{ 35.949, -83.937 }));
+        CHECK(removed->retrieve_leaf(center)->get_elements().size() < edited->retrieve_leaf(center)->get_elements().size());
+
+        // nothing to do returns the same tree.
+        CHECK(Quad::edit(qptr, Quad::Delta{}) == qptr);
+        CHECK(Quad::remove(qptr, geo::EntityType::EDGE, { 12345 }) == qptr);
+
+        CHECK_THROWS_AS(Quad::remove(qptr, geo::EntityType::GRID, { 0 }), std::invalid_argument);
+        delta.corridors.resize(2);
+        CHECK_THROWS_AS(Quad::edit(qptr, delta), std::invalid_argument);
     }
 }
 
-TEST_CASE( "Velocity Filter", "[ppm][velocity]" ) {
-
-    ConfigMap conf{ 
-        { "privacy.filter.velocity.min", "5" },
-        { "privacy.filter.velocity.max", "100" }
-    };
-    
-    // cover default constructor
-    VelocityFilter v_test;
+TEST_CASE("Quad Parameters", "[quad][parameters]") {
+    geo::Point sw{ 40.997, -111.041 };
+    geo::Point ne{ 42.085, -104.047 };
 
-    VelocityFilter vf{ conf };
+    CHECK(Quad::Parameters{} == Quad::Parameters(Quad::MAX_ELEMENTS, Quad::MIN_DEGREES, Quad::REDUCTION_FACTOR));
+    CHECK((Quad{ sw, ne }.get_parameters() == Quad::Parameters{}));
 
-    SECTION( "Using Configuration" ) {
-        CHECK( vf( 4.999 ) );
-        CHECK( vf( 100.001 ) );
-        CHECK_FALSE( vf( 10 ) );
+    CHECK_THROWS_AS(Quad(sw, ne, Quad::Parameters(0, 0.003, 10.0)), std::invalid_argument);
+    CHECK_THROWS_AS(Quad(sw, ne, Quad::Parameters(32, 0.0, 10.0)), std::invalid_argument);
+    CHECK_THROWS_AS(Quad(sw, ne, Quad::Parameters(32, 0.003, -1.0)), std::invalid_argument);
 
-        CHECK( vf.suppress( 4.999 ) );
-        CHECK( vf.suppress( 100.001 ) );
-        CHECK_FALSE( vf.suppress( 10 ) );
+    shapes::CSVInputFactory shape_factory( "data/I_80.edges" );
+    shape_factory.make_shapes();
 
-        CHECK( vf.retain( 5 ) );
-        CHECK( vf.retain( 100 ) );
-        CHECK( vf.retain( 10 ) );
-        CHECK_FALSE( vf.retain( 4.999 ) );
-        CHECK_FALSE( vf.retain( 100.001 ) );
+    geo::Entity::PtrList entities;
+    std::vector<geo::Corridor> corridors;
+    for (auto& edge_ptr : shape_factory.get_edges()) {
+        entities.push_back(edge_ptr);
+        corridors.emplace_back(*edge_ptr->to_area(10.0));
     }
 
-    SECTION( "Changing the filter's min and max" ) {
-        vf.set_min( 3.0 );
-        vf.set_max( 200.0 );
-        CHECK( vf( 2.999 ) );
-        CHECK( vf( 200.001 ) );
-        CHECK_FALSE( vf( 10 ) );
+    Quad::Parameters small{ 8, 0.01, 20.0 };
+    Quad::Ptr qptr = std::make_shared<Quad>(sw, ne, small);
+    Quad::bulk_insert(qptr, entities, corridors);
+
+    // every quad has the parameters of the root; leaves are split at 8 entities but not below 0.01 degrees.
+    Quad::PtrStack quadstack;
+    quadstack.push(qptr);
+    while (!quadstack.empty()) {
+        Quad::Ptr currquad = quadstack.top();
+        quadstack.pop();
+
+        CHECK(currquad->get_parameters() == small);
+        for (auto& child : currquad->get_children()) {
+            CHECK(child->get_level() == currquad->get_level() + 1);
+            quadstack.push(child);
+        }
 
-        CHECK( vf.suppress( 2.999 ) );
-        CHECK( vf.suppress( 200.001 ) );
-        CHECK_FALSE( vf.suppress( 10 ) );
+        if (!currquad->haschildren() && currquad->get_elements().size() > small.max_elements) {
+            CHECK((currquad->height() / 2.0 < small.min_degrees || currquad->width() / 2.0 < small.min_degrees));
+        }
 
-        CHECK( vf.retain( 3 ) );
-        CHECK( vf.retain( 200 ) );
-        CHECK( vf.retain( 10 ) );
-        CHECK_FALSE( vf.retain( 2.999 ) );
-        CHECK_FALSE( vf.retain( 200.001 ) );
     }
-}
 
-TEST_CASE( "BSM Checks", "[ppm][bsm]" ) {
+    // a wider fuzzy margin (a smaller reduction factor) stores each edge in more leaves.
+    Quad::Ptr wide = std::make_shared<Quad>(sw, ne, Quad::Parameters{ 8, 0.01, 5.0 });
+    Quad::bulk_insert(wide, entities, corridors);
+
+    auto references = [](Quad::Ptr& root) {
+        std::size_t count = 0;
+        Quad::PtrStack stack;
+        stack.push(root);
+        while (!stack.empty()) {
+            Quad::Ptr currquad = stack.top();
+            stack.pop();
+            for (auto& child : currquad->get_children()) {
+                stack.push(child);
+            }
+            count += currquad->get_elements().size();
+        }
+        return count;
+    };
+    CHECK(references(wide) > references(qptr));
 
-    BSM bsm;
+    // the frozen tree and its compiled file keep the parameters.
+    FrozenQuad frozen{ *qptr };
+    CHECK(frozen.get_parameters() == small);
 
-    SECTION( "Default Construction" ) {
-        CHECK( bsm.lat == 90.0 );
-        CHECK( bsm.lon == 180.0 );
-        CHECK( bsm.get_velocity() == -1.0 );
-        CHECK( bsm.get_secmark() == 0 );
-        CHECK( bsm.get_id() == "" );
-        CHECK( bsm.get_original_id() == "" );
-    }
+    const std::string path{ "parameters.test.geofence" };
+    frozen.save(path, 10.0);
+    CHECK(FrozenQuad::read_header(path).parameters() == small);
+    CHECK(FrozenQuad::load(path)->get_parameters() == small);
+    std::remove(path.c_str());
+}
 
-    SECTION( "Change and Reset" ) {
+TEST_CASE("Frozen Quad Tree", "[quad][frozen]") {
+    SECTION("Test Network") {
+        Quad::Ptr qptr = buildTestQuadTree();
+        Quad::make_corridors(qptr, 5.2);
+        FrozenQuad frozen{ *qptr };
+
+        // a single leaf holding six edges, a circle and a grid.
+        CHECK(frozen.node_count() == 1);
+        CHECK(frozen.corridor_count() == 6);
+        CHECK(frozen.circle_count() == 1);
+        CHECK(frozen.grid_count() == 1);
+        CHECK(frozen.bytes() % 64 == 0);
+        CHECK(reinterpret_cast<std::uintptr_t>(frozen.get_nodes()) % 64 == 0);
+        CHECK(reinterpret_cast<std::uintptr_t>(frozen.get_corridors().c[3]) % 64 == 0);
+
+        CHECK_FALSE(frozen.retrieve_leaf(geo::Point{ 35.964, -83.926 }));
+        CHECK_FALSE(frozen.is_within_entity(geo::Point{ 35.964, -83.926 }));
+
+        for (int i = 0; i <= 100; ++i) {
+            for (int j = 0; j <= 100; ++j) {
+                geo::Point pt{ 35.9469 + i * 0.000087, -83.9385 + j * 0.000118 };
+                bool within = referenceWithinEntity(qptr, pt, 5.2);
+                CHECK(frozen.is_within_entity(pt) == within);
+                CHECK(qptr->is_within_entity(pt) == within);
+            }
+        }
+    }
+
+    SECTION("I_80") {
+        Quad::Ptr qptr = buildI80QuadTree(10.0);
+        FrozenQuad frozen{ *qptr };
+
+        std::vector<geo::Bounds::Ptr> leaves = Quad::retrieve_all_bounds(qptr, true);
+        CHECK(frozen.node_count() == Quad::retrieve_all_bounds(qptr).size());
+        CHECK(frozen.circle_count() == 0);
+        CHECK(frozen.grid_count() == 0);
+
+        // children are contiguous and come after their parent; the leaf ranges cover every corridor exactly once.
+        const FrozenQuad::Node* nodes = frozen.get_nodes();
+        std::vector<std::pair<uint32_t, uint32_t>> ranges;
+        for (uint32_t i = 0; i < frozen.node_count(); ++i) {
+            if (nodes[i].child_count > 0) {
+                CHECK(nodes[i].first_child > i);
+                CHECK(nodes[i].first_child + nodes[i].child_count <= frozen.node_count());
+                CHECK(nodes[i].corridor_begin == nodes[i].corridor_end);
+            } else {
+                ranges.emplace_back(nodes[i].corridor_begin, nodes[i].corridor_end);
+            }
+        }
+        CHECK(ranges.size() == leaves.size());
+        std::sort(ranges.begin(), ranges.end());
+        uint32_t next_corridor = 0;
+        for (auto& range : ranges) {
+            CHECK(range.first == next_corridor);
+            next_corridor = range.second;
+        }
+        CHECK(next_corridor == frozen.corridor_count());
+
+        uint32_t inside = 0;
+        for (auto& pt : sampleI80Points()) {
+            const FrozenQuad::Node* leaf = frozen.retrieve_leaf(pt);
+            const Quad* quad_leaf = qptr->retrieve_leaf(pt);
+            REQUIRE((leaf == nullptr) == (quad_leaf == nullptr));
+            if (!leaf) {
+                // a few edges run past the geofence bounds.
+                CHECK_FALSE(frozen.is_within_entity(pt));
+                continue;
+            }
+            CHECK(leaf->sw_lat == quad_leaf->sw.lat);
+            CHECK(leaf->ne_lon == quad_leaf->ne.lon);
+            CHECK(leaf->corridor_end - leaf->corridor_begin == quad_leaf->get_elements().size());
+
+            bool within = frozen.is_within_entity(pt);
+            CHECK(within == referenceWithinEntity(qptr, pt, 10.0));
+            CHECK(within == qptr->is_within_entity(pt));
+            if (within) ++inside;
+        }
+
+        // the samples should exercise both answers.
+        CHECK(inside > 1000);
+        CHECK(inside < sampleI80Points().size());
+    }
+
+    SECTION("Corridor Kernels") {
+        Quad::Ptr qptr = buildI80QuadTree(10.0);
+        FrozenQuad frozen{ *qptr };
+        const FrozenQuad::CorridorArrays& corridors = frozen.get_corridors();
+
+        CHECK(CorridorKernel::supported(CorridorKernel::ISA::SCALAR));
+        CHECK(CorridorKernel::supported(CorridorKernel::best()));
+        CHECK(CorridorKernel::get(CorridorKernel::ISA::SCALAR) == &CorridorKernel::scan_scalar);
+        CHECK(std::string{ CorridorKernel::name(CorridorKernel::ISA::AVX2) } == "avx2");
+
+        std::vector<CorridorKernel::ISA> isas{ CorridorKernel::ISA::SCALAR, CorridorKernel::ISA::SSE2, CorridorKernel::ISA::AVX2 };
+        for (auto isa : isas) {
+            CorridorKernel::Scan scan = CorridorKernel::get(isa);
+            CHECK((scan != nullptr) == CorridorKernel::supported(isa));
+            if (!scan) continue;
+
+            INFO("isa: " << CorridorKernel::name(isa));
+            uint32_t hits = 0;
+            for (auto& pt : sampleI80Points()) {
+                const FrozenQuad::Node* leaf = frozen.retrieve_leaf(pt);
+                if (!leaf) continue;
+
+                // every suffix of the leaf's range so the vector loops and their tails are both exercised.
+                for (uint32_t begin = leaf->corridor_begin; begin <= leaf->corridor_end; ++begin) {
+                    bool expected = CorridorKernel::scan_scalar(corridors, begin, leaf->corridor_end, pt.lat, pt.lon);
+                    CHECK(scan(corridors, begin, leaf->corridor_end, pt.lat, pt.lon) == expected);
+                    if (expected) ++hits;
+                }
+
+                // and against the whole array, where the hit may be in any leaf.
+                bool anywhere = false;
+                for (uint32_t i = 0; i < frozen.corridor_count() && !anywhere; ++i) {
+                    anywhere = CorridorKernel::scan_scalar(corridors, i, i + 1, pt.lat, pt.lon);
+                }
+                CHECK(scan(corridors, 0, frozen.corridor_count(), pt.lat, pt.lon) == anywhere);
+            }
+            CHECK(hits > 1000);
+        }
+    }
+
+    SECTION("Compiled File") {
+        Quad::Ptr qptr = buildI80QuadTree(10.0);
+        FrozenQuad frozen{ *qptr };
+        const std::string path{ "frozen.test.geofence" };
+
+        frozen.save(path, 10.0);
+        CHECK(FrozenQuad::is_compiled(path));
+        CHECK_FALSE(FrozenQuad::is_compiled("data/I_80.edges"));
+        CHECK_FALSE(FrozenQuad::is_compiled("no.such.geofence"));
+        CHECK_THROWS_AS(FrozenQuad::load("no.such.geofence"), std::runtime_error);
+        CHECK_THROWS_AS(FrozenQuad::load("data/I_80.edges"), std::runtime_error);
+
+        FrozenQuad::FileHeader header = FrozenQuad::read_header(path);
+        CHECK(header.version == FrozenQuad::kFormatVersion);
+        CHECK(header.node_count == frozen.node_count());
+        CHECK(header.corridor_count == frozen.corridor_count());
+        CHECK(header.extension == 10.0);
+        CHECK(header.payload_bytes == frozen.bytes());
+
+        {
+            FrozenQuad::CPtr loaded = FrozenQuad::load(path);
+            CHECK(loaded->bytes() == frozen.bytes());
+            CHECK(reinterpret_cast<std::uintptr_t>(loaded->get_nodes()) % FrozenQuad::kAlignment == 0);
+            CHECK(std::memcmp(loaded->get_nodes(), frozen.get_nodes(), frozen.bytes()) == 0);
+
+            for (auto& pt : sampleI80Points()) {
+                CHECK(loaded->is_within_entity(pt) == frozen.is_within_entity(pt));
+            }
+        }
+
+        // the checksum catches a damaged payload; an unverified load trusts it.
+        std::string bytes;
+        {
+            std::ifstream ifs{ path, std::ios::binary };
+            bytes.assign(std::istreambuf_iterator<char>{ ifs }, std::istreambuf_iterator<char>{});
+        }
+        auto write = [&path](const std::string& contents) {
+            std::ofstream ofs{ path, std::ios::binary | std::ios::trunc };
+            ofs.write(contents.data(), contents.size());
+        };
+
+        std::string damaged{ bytes };
+        damaged[sizeof(FrozenQuad::FileHeader) + frozen.bytes() / 2] ^= 0x10;
+        write(damaged);
+        CHECK_THROWS_AS(FrozenQuad::load(path), std::runtime_error);
+        CHECK_NOTHROW(FrozenQuad::load(path, false));
+
+        // a node whose children lead back up the tree, or a leaf whose range runs past its array, is rejected even
+        // when the checksum is not verified.
+        const FrozenQuad::Node* nodes = frozen.get_nodes();
+        uint32_t parent = 0;
+        uint32_t leaf = 0;
+        REQUIRE(nodes[parent].child_count > 0);
+        while (nodes[leaf].child_count > 0 || nodes[leaf].corridor_begin == nodes[leaf].corridor_end) ++leaf;
+        REQUIRE(leaf < frozen.node_count());
+
+        auto corrupt = [&bytes](std::size_t node, std::size_t offset, uint32_t value) {
+            std::string contents{ bytes };
+            std::memcpy(&contents[sizeof(FrozenQuad::FileHeader) + node * sizeof(FrozenQuad::Node) + offset], &value, sizeof(value));
+            return contents;
+        };
+
+        write(corrupt(parent, offsetof(FrozenQuad::Node, first_child), 0));
+        CHECK_THROWS_AS(FrozenQuad::load(path, false), std::runtime_error);
+
+        write(corrupt(parent, offsetof(FrozenQuad::Node, first_child), frozen.node_count()));
+        CHECK_THROWS_AS(FrozenQuad::load(path, false), std::runtime_error);
+
+        write(corrupt(leaf, offsetof(FrozenQuad::Node, corridor_end), frozen.corridor_count() + 1));
+        CHECK_THROWS_AS(FrozenQuad::load(path, false), std::runtime_error);
+
+        write(corrupt(leaf, offsetof(FrozenQuad::Node, corridor_end), nodes[leaf].corridor_begin - 1));
+        CHECK_THROWS_AS(FrozenQuad::load(path, false), std::runtime_error);
+
+        write(bytes);
+        CHECK_NOTHROW(FrozenQuad::load(path, false));
+
+        // other format versions, truncated files and bad magic are rejected before the payload is used.
+        std::string version{ bytes };
+        version[offsetof(FrozenQuad::FileHeader, version)] += 1;
+        write(version);
+        CHECK_THROWS_AS(FrozenQuad::read_header(path), std::runtime_error);
+        CHECK_THROWS_AS(FrozenQuad::load(path, false), std::runtime_error);
+
+        write(bytes.substr(0, bytes.size() - 64));
+        CHECK_THROWS_AS(FrozenQuad::load(path, false), std::runtime_error);
+
+        write(bytes.substr(0, 32));
+        CHECK_THROWS_AS(FrozenQuad::load(path, false), std::runtime_error);
+
+        std::string magic{ bytes };
+        magic[0] = 'X';
+        write(magic);
+        CHECK_FALSE(FrozenQuad::is_compiled(path));
+        CHECK_THROWS_AS(FrozenQuad::load(path, false), std::runtime_error);
+
+        std::remove(path.c_str());
+    }
+}
+
+TEST_CASE("Planar Geometry", "[quad][frozen][planar]") {
+    Quad::Ptr qptr = buildI80QuadTree(10.0);
+
+    // circles of growing radius across the region, so the planar circle error is measurable.
+    std::vector<geo::Circle::Ptr> circles;
+    for (int i = 0; i < 8; ++i) {
+        circles.push_back(std::make_shared<geo::Circle>(41.05 + i * 0.13, -110.9 + i * 0.85, 25.0 * std::pow(3.0, i)));
+        Quad::insert(qptr, circles.back());
+    }
+
+    FrozenQuad spherical{ *qptr };
+    FrozenQuad planar{ *qptr, FrozenQuad::Geometry::PLANAR };
+    CHECK(spherical.get_geometry() == FrozenQuad::Geometry::SPHERICAL);
+    CHECK(planar.get_geometry() == FrozenQuad::Geometry::PLANAR);
+
+    const FrozenQuad::Projection& projection = planar.get_projection();
+    CHECK(projection.anchor_lat == Approx((40.997 + 42.085) / 2.0));
+    CHECK(projection.anchor_lon == Approx((-111.041 + -104.047) / 2.0));
+    CHECK(projection.north_scale == Approx(111319.49));
+    geo::Point origin = projection.project(geo::Point{ projection.anchor_lat, projection.anchor_lon });
+    CHECK(origin.lat == 0.0);
+    CHECK(origin.lon == 0.0);
+    geo::Point east = projection.project(geo::Point{ projection.anchor_lat, projection.anchor_lon + 0.01 });
+    CHECK(east.lon == Approx(geo::Location::distance(projection.anchor_lat, projection.anchor_lon, projection.anchor_lat, projection.anchor_lon + 0.01)));
+
+    SECTION("Corridors") {
+        // corridors keep their shape in the plane.
+        for (auto& pt : sampleI80Points()) {
+            CHECK(planar.is_within_entity(pt) == spherical.is_within_entity(pt));
+        }
+    }
+
+    SECTION("Circles") {
+        // rings just inside and outside each circle; the planar answer may only differ within the documented bound.
+        uint32_t checked = 0;
+        for (auto& circle : circles) {
+            for (int k = 0; k < 72; ++k) {
+                for (double ratio : { 0.98, 0.9995, 0.99999, 1.00001, 1.0005, 1.02 }) {
+                    geo::Location pt = geo::Location::project_position(circle->lat, circle->lon, k * 5.0, circle->radius * ratio);
+                    geo::Point point{ pt.lat, pt.lon };
+                    double d = geo::Location::distance(circle->lat, circle->lon, point.lat, point.lon);
+                    double bound = d * d * std::tan(std::fabs(circle->lat) * M_PI / 180.0) / (2.0 * geo::kEarthRadiusM) + 1e-6;
+
+                    bool expected = spherical.is_within_entity(point);
+                    if (std::fabs(d - circle->radius) > bound) {
+                        CHECK(planar.is_within_entity(point) == expected);
+                        ++checked;
+                    }
+
+                    // the planar distance itself, measured the way the leaf does.
+                    geo::Point q = projection.project(point);
+                    geo::Point c = projection.project(geo::Point{ circle->lat, circle->lon });
+                    double scale = std::cos(circle->lat * M_PI / 180.0) / std::cos(projection.anchor_lat * M_PI / 180.0);
+                    double planar_d = std::hypot((q.lon - c.lon) * scale, q.lat - c.lat);
+                    CHECK(std::fabs(planar_d - d) <= bound);
+                }
+            }
+        }
+        CHECK(checked > 2000);
+    }
+
+    SECTION("Compiled File") {
+        const std::string path{ "planar.test.geofence" };
+        planar.save(path, 10.0);
+        CHECK(FrozenQuad::read_header(path).flags == FrozenQuad::kPlanarFlag + 0);
+
+        FrozenQuad::CPtr loaded = FrozenQuad::load(path);
+        CHECK(loaded->get_geometry() == FrozenQuad::Geometry::PLANAR);
+        CHECK(loaded->get_projection().east_scale == projection.east_scale);
+        for (auto& pt : sampleI80Points()) {
+            CHECK(loaded->is_within_entity(pt) == planar.is_within_entity(pt));
+        }
+
+        spherical.save(path, 10.0);
+        CHECK(FrozenQuad::read_header(path).flags == 0);
+        std::remove(path.c_str());
+    }
+}
+
+/**
+ * @brief Predicate indicating whether a point is within a few fixed-point units of a boundary of a geofence: one of
+ * its eight neighbors 3e-7 degree away gets a different answer.
+ *
+ * @param within the geofence predicate.
+ * @param pt the point to check.
+ * @return true if rounding to fixed point could move the point across a boundary.
+ */
+template<typename Within>
+bool nearFixedBoundary( Within within, const geo::Point& pt ) {
+    bool inside = within( pt );
+
+    for (int dlat = -1; dlat <= 1; ++dlat) {
+        for (int dlon = -1; dlon <= 1; ++dlon) {
+            if (within( geo::Point{ pt.lat + dlat * 3e-7, pt.lon + dlon * 3e-7 } ) != inside) return true;
+        }
+    }
+
+    return false;
+}
+
+TEST_CASE("Fixed-Point Geometry", "[quad][frozen][fixed]") {
+    SECTION("Fixed Points") {
+        geo::FixedPoint fp = geo::FixedPoint::from_degrees(geo::Point{ 41.1234567, -104.7654321 });
+        CHECK(fp.lat == 411234567);
+        CHECK(fp.lon == -1047654321);
+        CHECK(geo::FixedPoint::to_units(180.0) == 1800000000);
+        CHECK(geo::FixedPoint::to_units(-90.0) == -900000000);
+
+        // decoding and rounding again gives back the same units.
+        std::mt19937 generator{ 12 };
+        std::uniform_int_distribution<int32_t> lat{ -900000000, 900000000 };
+        std::uniform_int_distribution<int32_t> lon{ -1800000000, 1800000000 };
+        for (int i = 0; i < 10000; ++i) {
+            geo::FixedPoint original{ lat(generator), lon(generator) };
+            geo::FixedPoint round_trip = geo::FixedPoint::from_degrees(original.to_degrees());
+            CHECK(round_trip.lat == original.lat);
+            CHECK(round_trip.lon == original.lon);
+        }
+    }
+
+    SECTION("Fixed Corridors") {
+        CHECK(geo::FixedCorridor{}.empty());
+        CHECK(geo::FixedCorridor{ geo::Corridor{} }.empty());
+        CHECK_FALSE(geo::FixedCorridor{}.contains(geo::FixedPoint{}));
+
+        // the box differences must fit in 32 bits.
+        geo::Area wide{ geo::Point{ 0.0, -120.0 }, geo::Point{ 1.0, -120.0 }, geo::Point{ 1.0, 120.0 }, geo::Point{ 0.0, 120.0 } };
+        CHECK_THROWS_AS(geo::FixedCorridor{ geo::Corridor{ wide } }, std::out_of_range);
+
+        shapes::CSVInputFactory shape_factory( "data/I_80.edges" );
+        shape_factory.make_shapes();
+
+        std::mt19937 generator{ 7 };
+        std::uniform_real_distribution<double> unit{ -0.1, 1.1 };
+        uint32_t inside = 0;
+        uint32_t near = 0;
+
+        const std::vector<geo::EdgeCPtr>& edges = shape_factory.get_edges();
+        for (std::size_t e = 0; e < edges.size(); e += 5) {
+            geo::AreaPtr area = edges[e]->to_area(10.0);
+            geo::Corridor corridor{ *area };
+            geo::FixedCorridor fixed{ corridor };
+            REQUIRE_FALSE(fixed.empty());
+
+            // the corners come back from the edge lines.
+            const std::vector<geo::Point>& corners = area->get_corners();
+            for (int k = 0; k < 4; ++k) {
+                CHECK(std::abs(fixed.lat[k] - geo::FixedPoint::to_units(corners[k].lat)) <= 1);
+                CHECK(std::abs(fixed.lon[k] - geo::FixedPoint::to_units(corners[k].lon)) <= 1);
+            }
+
+            // points across the box, and points a few units either side of each edge midpoint.
+            std::vector<geo::Point> points;
+            for (int i = 0; i < 40; ++i) {
+                points.emplace_back( corridor.min_lat + unit(generator) * (corridor.max_lat - corridor.min_lat),
+                                     corridor.min_lon + unit(generator) * (corridor.max_lon - corridor.min_lon) );
+            }
+            for (int k = 0; k < 4; ++k) {
+                const geo::Point& a = corners[k];
+                const geo::Point& b = corners[(k + 1) % 4];
+                double length = std::hypot(b.lat - a.lat, b.lon - a.lon);
+                for (int step = -4; step <= 4; ++step) {
+                    double offset = step * 0.5e-7 / length;
+                    points.emplace_back( (a.lat + b.lat) / 2.0 - (b.lon - a.lon) * offset, (a.lon + b.lon) / 2.0 + (b.lat - a.lat) * offset );
+                }
+            }
+
+            for (auto& pt : points) {
+                bool expected = area->contains(pt);
+                if (fixed.contains(geo::FixedPoint::from_degrees(pt)) != expected) {
+                    CHECK(nearFixedBoundary([&area] (const geo::Point& q) { return area->contains(q); }, pt));
+                    ++near;
+                }
+                if (expected) ++inside;
+            }
+        }
+
+        CHECK(inside > 1000);
+        CHECK(near > 0);
+    }
+
+    Quad::Ptr qptr = buildI80QuadTree(10.0);
+    for (int i = 0; i < 8; ++i) {
+        Quad::insert(qptr, std::make_shared<geo::Circle>(41.05 + i * 0.13, -110.9 + i * 0.85, 25.0 * std::pow(3.0, i)));
+    }
+    Quad::insert(qptr, std::make_shared<geo::Grid>(geo::Point{ 41.30000004, -107.20000006 }, geo::Point{ 41.3100001, -107.1900001 }, 1, 1));
+
+    FrozenQuad spherical{ *qptr };
+    FrozenQuad fixed{ *qptr, FrozenQuad::Geometry::FIXED };
+    CHECK(fixed.get_geometry() == FrozenQuad::Geometry::FIXED);
+    CHECK(fixed.corridor_count() == spherical.corridor_count());
+    CHECK(fixed.bytes() < spherical.bytes());
+    CHECK(fixed.get_corridors().a[0] == nullptr);
+    CHECK(spherical.get_fixed_corridors().lat[0] == nullptr);
+    CHECK(reinterpret_cast<std::uintptr_t>(fixed.get_fixed_corridors().lon[3]) % 64 == 0);
+
+    // sample points plus a walk across the circles and the grid.
+    std::vector<geo::Point> points = sampleI80Points();
+    for (int i = 0; i < 8; ++i) {
+        for (int k = 0; k < 200; ++k) {
+            points.emplace_back( 41.05 + i * 0.13 + (k - 100) * 0.00005 * i, -110.9 + i * 0.85 + (k - 100) * 0.00003 * i );
+        }
+    }
+    for (int k = 0; k < 400; ++k) {
+        points.emplace_back( 41.2999 + k * 0.0000301, -107.2001 + k * 0.0000299 );
+    }
+
+    SECTION("Frozen Answers") {
+        uint32_t inside = 0;
+        for (auto& pt : points) {
+            bool expected = spherical.is_within_entity(pt);
+            if (fixed.is_within_entity(pt) != expected) {
+                CHECK(nearFixedBoundary([&spherical] (const geo::Point& q) { return spherical.is_within_entity(q); }, pt));
+            }
+            if (expected) ++inside;
+        }
+        CHECK(inside > 1000);
+
+        // the same position always gets the same answer, however it was written in degrees.
+        for (auto& pt : sampleI80Points()) {
+            geo::Point rounded = geo::FixedPoint::from_degrees(pt).to_degrees();
+            CHECK(fixed.is_within_entity(rounded) == fixed.is_within_entity(pt));
+        }
+
+        GeofenceIndex::Bitmap batch;
+        fixed.within_entities(points.data(), points.size(), batch);
+        GeofenceIndex::Hint hint;
+        for (std::size_t i = 0; i < points.size(); ++i) {
+            bool expected = fixed.is_within_entity(points[i]);
+            CHECK(batch[i] == expected);
+            CHECK(fixed.is_within_entity(points[i], hint) == expected);
+        }
+    }
+
+    SECTION("Fixed Corridor Kernels") {
+        const FrozenQuad::FixedCorridorArrays& corridors = fixed.get_fixed_corridors();
+
+        CHECK(CorridorKernel::get_fixed(CorridorKernel::ISA::SCALAR) == &CorridorKernel::scan_fixed_scalar);
+        CHECK(CorridorKernel::get_fixed(CorridorKernel::ISA::SSE2) == (CorridorKernel::supported(CorridorKernel::ISA::SSE2) ?
+                                                                       &CorridorKernel::scan_fixed_scalar : nullptr));
+
+        std::vector<CorridorKernel::ISA> isas{ CorridorKernel::ISA::SCALAR, CorridorKernel::ISA::SSE2, CorridorKernel::ISA::AVX2 };
+        for (auto isa : isas) {
+            CorridorKernel::FixedScan scan = CorridorKernel::get_fixed(isa);
+            CHECK((scan != nullptr) == CorridorKernel::supported(isa));
+            if (!scan) continue;
+
+            INFO("isa: " << CorridorKernel::name(isa));
+            uint32_t hits = 0;
+            for (auto& pt : points) {
+                const FrozenQuad::Node* leaf = fixed.retrieve_leaf(pt);
+                if (!leaf) continue;
+                geo::FixedPoint fp = geo::FixedPoint::from_degrees(pt);
+
+                // every suffix of the leaf's range so the vector loops and their tails are both exercised.
+                for (uint32_t begin = leaf->corridor_begin; begin <= leaf->corridor_end; ++begin) {
+                    bool expected = CorridorKernel::scan_fixed_scalar(corridors, begin, leaf->corridor_end, fp.lat, fp.lon);
+                    CHECK(scan(corridors, begin, leaf->corridor_end, fp.lat, fp.lon) == expected);
+                    if (expected) ++hits;
+                }
+
+                bool anywhere = false;
+                for (uint32_t i = 0; i < fixed.corridor_count() && !anywhere; ++i) {
+                    anywhere = CorridorKernel::scan_fixed_scalar(corridors, i, i + 1, fp.lat, fp.lon);
+                }
+                CHECK(scan(corridors, 0, fixed.corridor_count(), fp.lat, fp.lon) == anywhere);
+            }
+            CHECK(hits > 1000);
+        }
+    }
+
+    SECTION("Compiled File") {
+        const std::string path{ "fixed.test.geofence" };
+        fixed.save(path, 10.0);
+        FrozenQuad::FileHeader header = FrozenQuad::read_header(path);
+        CHECK(header.flags == FrozenQuad::kFixedFlag + 0);
+        CHECK(header.geometry() == FrozenQuad::Geometry::FIXED);
+
+        FrozenQuad::CPtr loaded = FrozenQuad::load(path);
+        CHECK(loaded->get_geometry() == FrozenQuad::Geometry::FIXED);
+        CHECK(loaded->bytes() == fixed.bytes());
+        for (auto& pt : points) {
+            CHECK(loaded->is_within_entity(pt) == fixed.is_within_entity(pt));
+        }
+
+        std::remove(path.c_str());
+    }
+}
+
+TEST_CASE("Geofence Hints", "[quad][hint]") {
+    Quad::Ptr qptr = buildI80QuadTree(10.0);
+    auto frozen = std::make_shared<FrozenQuad>(*qptr);
+    GridIndex grid{ *qptr, 0.002 };
+    RasterIndex raster{ *qptr, frozen, 0.0002 };
+
+    // one vehicle driving the map, weaving across the corridor edges.
+    std::vector<geo::Point> drive;
+    shapes::CSVInputFactory shape_factory( "data/I_80.edges" );
+    shape_factory.make_shapes();
+    const std::vector<geo::EdgeCPtr>& edges = shape_factory.get_edges();
+    for (std::size_t i = 0; i < edges.size(); i += 3) {
+        const geo::Vertex& v1 = *edges[i]->v1;
+        const geo::Vertex& v2 = *edges[i]->v2;
+        for (int step = 0; step < 10; ++step) {
+            double t = step / 10.0;
+            double weave = 0.00015 * std::sin(i + step);
+            drive.emplace_back(v1.lat + t * (v2.lat - v1.lat) + weave, v1.lon + t * (v2.lon - v1.lon) - weave);
+        }
+    }
+
+    const std::vector<std::pair<std::string, const GeofenceIndex*>> indexes{
+        { "quad", qptr.get() }, { "frozen", frozen.get() }, { "grid", &grid }, { "raster", &raster } };
+
+    for (auto& named : indexes) {
+        INFO("index: " << named.first);
+        const GeofenceIndex& index = *named.second;
+        GeofenceIndex::Hint hint;
+        uint32_t leaf_hits = 0;
+        uint32_t entity_hits = 0;
+        uint32_t inside = 0;
+
+        for (auto& pt : drive) {
+            bool within = index.is_within_entity(pt);
+            CHECK(index.is_within_entity(pt, hint) == within);
+            CHECK((hint.leaf_hit || !hint.entity_hit));
+            if (hint.leaf_hit) ++leaf_hits;
+            if (hint.entity_hit) ++entity_hits;
+            if (within) ++inside;
+        }
+
+        CHECK(inside > drive.size() / 4);
+        CHECK(inside < drive.size());
+        if (named.first == "quad" || named.first == "frozen") {
+            // most steps stay in the leaf and many in the corridor of the previous step.
+            CHECK(leaf_hits > drive.size() / 2);
+            CHECK(entity_hits > drive.size() / 4);
+        } else if (named.first == "grid") {
+            CHECK(leaf_hits == 0);
+        }
+    }
+
+    SECTION("Foreign Hints") {
+        // a hint filled in by one index is ignored by the others.
+        GeofenceIndex::Hint hint;
+        for (std::size_t i = 0; i < drive.size(); ++i) {
+            const GeofenceIndex& index = i % 2 ? static_cast<const GeofenceIndex&>(*frozen) : *qptr;
+            CHECK(index.is_within_entity(drive[i], hint) == index.is_within_entity(drive[i]));
+            CHECK_FALSE(hint.leaf_hit);
+        }
+
+        // points outside the tree leave the hint empty.
+        GeofenceIndex::Hint outside;
+        CHECK_FALSE(frozen->is_within_entity(geo::Point{ 45.0, -100.0 }, outside));
+        CHECK(outside.index == nullptr);
+        CHECK_FALSE(qptr->is_within_entity(geo::Point{ 45.0, -100.0 }, outside));
+        CHECK(outside.index == nullptr);
+    }
+}
+
+TEST_CASE("Geofence Batch Queries", "[quad][batch]") {
+    SECTION("Morton Order") {
+        CHECK(GeofenceIndex::morton_code(0, 0) == 0);
+        CHECK(GeofenceIndex::morton_code(1, 0) == 1);
+        CHECK(GeofenceIndex::morton_code(0, 1) == 2);
+        CHECK(GeofenceIndex::morton_code(3, 3) == 15);
+        CHECK(GeofenceIndex::morton_code(UINT32_MAX, 0) == 0x5555555555555555ULL);
+        CHECK(GeofenceIndex::morton_code(UINT32_MAX, UINT32_MAX) == UINT64_MAX);
+
+        CHECK(GeofenceIndex::morton_order(nullptr, 0).empty());
+
+        // the four corners of the batch in Z order; the duplicate keeps its place after the first copy.
+        std::vector<geo::Point> points{ { 1.0, 1.0 }, { 0.0, 0.0 }, { 1.0, 0.0 }, { 0.0, 1.0 }, { 0.0, 0.0 } };
+        std::vector<uint32_t> expected{ 1, 4, 3, 2, 0 };
+        CHECK(GeofenceIndex::morton_order(points.data(), points.size()) == expected);
+    }
+
+    SECTION("Test Network") {
+        Quad::Ptr qptr = buildTestQuadTree();
+        Quad::make_corridors(qptr, 5.2);
+        FrozenQuad frozen{ *qptr };
+
+        std::vector<geo::Point> points;
+        for (int i = 0; i <= 60; ++i) {
+            for (int j = 0; j <= 60; ++j) {
+                points.emplace_back(35.9465 + i * 0.00015, -83.939 + j * 0.0002);
+            }
+        }
+        points.emplace_back(std::nan(""), -83.93);
+
+        for (const GeofenceIndex* index : { static_cast<const GeofenceIndex*>(qptr.get()), static_cast<const GeofenceIndex*>(&frozen) }) {
+            GeofenceIndex::Bitmap within;
+            index->within_entities(points.data(), points.size(), within);
+            REQUIRE(within.size() == points.size());
+            for (std::size_t i = 0; i < points.size(); ++i) {
+                CHECK(within[i] == index->is_within_entity(points[i]));
+            }
+        }
+    }
+
+    SECTION("I_80") {
+        Quad::Ptr qptr = buildI80QuadTree(10.0);
+        auto frozen = std::make_shared<FrozenQuad>(*qptr);
+        GridIndex grid{ *qptr, 0.002 };
+        RasterIndex raster{ *qptr, frozen, 0.0005 };
+
+        std::vector<geo::Point> points = sampleI80Points();
+        points.emplace_back(45.0, -100.0);
+        points.emplace_back(40.0, -110.0);
+
+        const std::vector<std::pair<std::string, const GeofenceIndex*>> indexes{
+            { "quad", qptr.get() }, { "frozen", frozen.get() }, { "grid", &grid }, { "raster", &raster } };
+
+        for (auto& named : indexes) {
+            INFO("index: " << named.first);
+            GeofenceIndex::Bitmap within;
+            named.second->within_entities(points.data(), points.size(), within);
+            REQUIRE(within.size() == points.size());
+
+            uint32_t inside = 0;
+            for (std::size_t i = 0; i < points.size(); ++i) {
+                CHECK(within[i] == named.second->is_within_entity(points[i]));
+                if (within[i]) ++inside;
+            }
+            CHECK(inside > 1000);
+
+            // a batch of one and an empty batch.
+            named.second->within_entities(points.data(), 1, within);
+            CHECK(within.size() == 1);
+            named.second->within_entities(points.data(), 0, within);
+            CHECK(within.empty());
+        }
+    }
+}
+
+TEST_CASE("Corridor Merging", "[quad][merge]") {
+    CHECK_THROWS_AS(CorridorMerger(-1.0, 1.0), std::invalid_argument);
+    CHECK_THROWS_AS(CorridorMerger(10.0, -1.0), std::invalid_argument);
+    CHECK_THROWS_AS(CorridorMerger(10.0, 1.0, 0.0), std::invalid_argument);
+
+    SECTION("Chains") {
+        // a straight way A of four edges, forking at its third vertex, and a way B sharing the first vertices.
+        std::vector<geo::Vertex::Ptr> v;
+        for (int i = 0; i < 5; ++i) {
+            v.push_back(std::make_shared<geo::Vertex>(41.0, -105.0 + 0.0003 * i, i));
+        }
+        auto branch = std::make_shared<geo::Vertex>(41.0003, -105.0003, 5);
+
+        std::vector<geo::EdgeCPtr> edges{
+            std::make_shared<geo::Edge>(v[0], v[1], osm::Highway::SECONDARY, 10),
+            std::make_shared<geo::Edge>(v[1], v[2], osm::Highway::SECONDARY, 11),
+            std::make_shared<geo::Edge>(v[2], v[3], osm::Highway::SECONDARY, 12),
+            std::make_shared<geo::Edge>(v[3], v[4], osm::Highway::SECONDARY, 13),
+            std::make_shared<geo::Edge>(v[2], branch, osm::Highway::SECONDARY, 14),
+            std::make_shared<geo::Edge>(v[0], v[1], osm::Highway::SECONDARY, 20),
+            std::make_shared<geo::Edge>(v[1], v[2], osm::Highway::SECONDARY, 21),
+            std::make_shared<geo::Edge>(v[1], v[2], osm::Highway::SECONDARY, 30),
+            std::make_shared<geo::Edge>(v[2], v[3], osm::Highway::SECONDARY, 31)
+        };
+        std::vector<std::string> ways{ "A", "A", "A", "A", "A", "B", "B", "", "" };
+
+        CorridorMerger merger{ 5.0, 0.5 };
+        std::vector<geo::EdgeCPtr> merged;
+        std::vector<geo::Corridor> corridors;
+        CorridorMerger::Stats stats;
+
+        CHECK_THROWS_AS(merger.merge(edges, std::vector<std::string>{ "A" }, merged, corridors), std::invalid_argument);
+
+        merger.merge(edges, ways, merged, corridors, &stats);
+        REQUIRE(merged.size() == corridors.size());
+        CHECK(stats.edges == edges.size());
+        CHECK(stats.corridors == merged.size());
+
+        // A stops at the fork: 10-11, 12-13 and 14; B is one run; the edges without a way are kept.
+        std::map<uint64_t, std::pair<uint64_t, uint64_t>> ends;
+        for (auto& edge : merged) {
+            ends[edge->get_uid()] = std::make_pair(edge->v1->uid, edge->v2->uid);
+        }
+        CHECK(merged.size() == 6);
+        CHECK(ends[10] == std::make_pair(uint64_t{ 0 }, uint64_t{ 2 }));
+        CHECK(ends[12] == std::make_pair(uint64_t{ 2 }, uint64_t{ 4 }));
+        CHECK(ends[14] == std::make_pair(uint64_t{ 2 }, uint64_t{ 5 }));
+        CHECK(ends[20] == std::make_pair(uint64_t{ 0 }, uint64_t{ 2 }));
+        CHECK(ends.count(30) == 1);
+        CHECK(ends.count(31) == 1);
+
+        // every corridor holds the corners of the original corridors it replaced (those that do not round outside).
+        for (auto& edge : edges) {
+            geo::AreaPtr area = edge->to_area(5.0);
+            geo::Corridor original{ *area };
+            for (auto& corner : area->get_corners()) {
+                if (!original.contains(corner)) continue;
+                bool covered = false;
+                for (auto& corridor : corridors) {
+                    covered = covered || corridor.contains(corner);
+                }
+                CHECK(covered);
+            }
+        }
+
+        // a tolerance too small for the bend of the branch keeps the edges of a way that turns.
+        std::vector<geo::EdgeCPtr> turn{ edges[0], std::make_shared<geo::Edge>(v[1], branch, osm::Highway::SECONDARY, 40) };
+        merger.merge(turn, std::vector<std::string>{ "C", "C" }, merged, corridors);
+        CHECK(merged.size() == 2);
+        CHECK(merged[0] == turn[0]);
+        CHECK(merged[1] == turn[1]);
+    }
+
+    SECTION("I_80") {
+        geo::Point sw{ 40.997, -111.041 };
+        geo::Point ne{ 42.085, -104.047 };
+
+        shapes::CSVInputFactory shape_factory( "data/I_80.edges" );
+        shape_factory.make_shapes();
+        const std::vector<geo::EdgeCPtr>& edges = shape_factory.get_edges();
+        REQUIRE(shape_factory.get_edge_ways().size() == edges.size());
+        CHECK(shape_factory.get_edge_ways().front() == "80E");
+
+        geo::Entity::PtrList originals{ edges.begin(), edges.end() };
+        std::vector<geo::Corridor> original_corridors;
+        for (auto& edge : edges) {
+            original_corridors.emplace_back(*edge->to_area(10.0));
+        }
+
+        CorridorMerger merger{ 10.0, 1.0 };
+        std::vector<geo::EdgeCPtr> merged;
+        std::vector<geo::Corridor> corridors;
+        CorridorMerger::Stats stats;
+        merger.merge(edges, shape_factory.get_edge_ways(), merged, corridors, &stats);
+
+        // the interstate is two long ways, so most of its edges merge.
+        CHECK(stats.corridors * 3 < stats.edges);
+
+        Quad::Ptr before = std::make_shared<Quad>(sw, ne);
+        Quad::bulk_insert(before, originals, original_corridors);
+        Quad::Ptr after = std::make_shared<Quad>(sw, ne);
+        Quad::bulk_insert(after, geo::Entity::PtrList{ merged.begin(), merged.end() }, corridors);
+
+        HilbertRTree exact_before{ *before };
+        HilbertRTree exact_after{ *after };
+
+        // corners exactly on an original corridor's boundary may round either way; the merged corridors are padded.
+        std::size_t corners = 0;
+        for (auto& edge : edges) {
+            geo::AreaPtr area = edge->to_area(10.0);
+            for (auto& corner : area->get_corners()) {
+                if (!exact_before.is_within_entity(corner)) continue;
+                ++corners;
+                CHECK(exact_after.is_within_entity(corner));
+            }
+        }
+        CHECK(corners > 3 * edges.size() / 2);
+
+        // nothing that was in the geofence leaves it, and little joins it.
+        std::size_t inside = 0;
+        std::size_t added = 0;
+        for (auto& pt : sampleI80Points()) {
+            bool was = exact_before.is_within_entity(pt);
+            bool is = exact_after.is_within_entity(pt);
+            if (was) {
+                ++inside;
+                CHECK(is);
+            } else if (is) {
+                ++added;
+            }
+        }
+        CHECK(inside > 1000);
+        CHECK(added * 50 < inside);
+
+        CHECK(exact_after.corridor_count() * 3 < exact_before.corridor_count());
+    }
+}
+
+TEST_CASE("Grid Index", "[quad][grid]") {
+    SECTION("Test Network") {
+        Quad::Ptr qptr = buildTestQuadTree();
+        Quad::make_corridors(qptr, 5.2);
+
+        CHECK_THROWS_AS(GridIndex(*qptr, 0.0), std::invalid_argument);
+        CHECK_THROWS_AS(GridIndex(*qptr, 1e-12), std::invalid_argument);
+
+        for (double cell : { 0.0001, 0.0007, GridIndex::kDefaultCellDegrees }) {
+            INFO("cell: " << cell);
+            GridIndex grid{ *qptr, cell };
+            const GeofenceIndex& index = grid;
+
+            CHECK(grid.get_cell_degrees() == cell);
+            CHECK(grid.cell_count() > 0);
+            CHECK(grid.corridor_count() >= 6);
+            CHECK(grid.circle_count() >= 1);
+            CHECK(grid.grid_count() >= 1);
+
+            CHECK_FALSE(grid.retrieve_cell(geo::Point{ 35.964, -83.926 }));
+            CHECK_FALSE(index.is_within_entity(geo::Point{ 35.964, -83.926 }));
+
+            for (int i = 0; i <= 100; ++i) {
+                for (int j = 0; j <= 100; ++j) {
+                    geo::Point pt{ 35.9469 + i * 0.000087, -83.9385 + j * 0.000118 };
+                    CHECK(index.is_within_entity(pt) == referenceWithinEntity(qptr, pt, 5.2));
+                }
+            }
+        }
+
+        // one cell covering the whole region holds every entity once.
+        GridIndex coarse{ *qptr, 1.0 };
+        CHECK(coarse.cell_count() == 1);
+        CHECK(coarse.corridor_count() == 6);
+        CHECK(coarse.circle_count() == 1);
+        CHECK(coarse.grid_count() == 1);
+    }
+
+    SECTION("I_80") {
+        Quad::Ptr qptr = buildI80QuadTree(10.0);
+        FrozenQuad frozen{ *qptr };
+
+        for (double cell : { 0.002, GridIndex::kDefaultCellDegrees, 0.05 }) {
+            INFO("cell: " << cell);
+            GridIndex grid{ *qptr, cell };
+
+            uint32_t inside = 0;
+            for (auto& pt : sampleI80Points()) {
+                bool within = grid.is_within_entity(pt);
+                CHECK(within == frozen.is_within_entity(pt));
+                CHECK(within == referenceWithinEntity(qptr, pt, 10.0));
+                if (within) ++inside;
+            }
+            CHECK(inside > 1000);
+        }
+    }
+}
+
+TEST_CASE("Hilbert R-Tree", "[quad][rtree]") {
+    SECTION("Hilbert Curve") {
+        // the cells of the 16 x 16 block at the origin are the first 256 steps of the curve, each next to the last.
+        std::vector<std::pair<uint32_t, uint32_t>> cells(256, std::make_pair(UINT32_MAX, UINT32_MAX));
+        for (uint32_t x = 0; x < 16; ++x) {
+            for (uint32_t y = 0; y < 16; ++y) {
+                uint32_t d = HilbertRTree::hilbert_index(x, y);
+                REQUIRE(d < 256);
+                CHECK(cells[d].first == UINT32_MAX);
+                cells[d] = std::make_pair(x, y);
+            }
+        }
+        for (uint32_t d = 1; d < 256; ++d) {
+            int64_t dx = static_cast<int64_t>(cells[d].first) - cells[d - 1].first;
+            int64_t dy = static_cast<int64_t>(cells[d].second) - cells[d - 1].second;
+            CHECK(std::abs(dx) + std::abs(dy) == 1);
+        }
+
+        CHECK(HilbertRTree::hilbert_index(0, 0) == 0);
+        CHECK(HilbertRTree::hilbert_index(65535, 0) == UINT32_MAX);
+    }
+
+    SECTION("Test Network") {
+        Quad::Ptr qptr = buildTestQuadTree();
+        Quad::make_corridors(qptr, 5.2);
+
+        CHECK_THROWS_AS(HilbertRTree(*qptr, 1), std::invalid_argument);
+        CHECK_THROWS_AS(HilbertRTree(*qptr, HilbertRTree::kMaxFanout + 1), std::invalid_argument);
+
+        for (uint32_t fanout : { 2u, 3u, HilbertRTree::kDefaultFanout }) {
+            INFO("fanout: " << fanout);
+            HilbertRTree rtree{ *qptr, fanout };
+            const GeofenceIndex& index = rtree;
+
+            // every entity once.
+            CHECK(rtree.get_fanout() == fanout);
+            CHECK(rtree.corridor_count() == 6);
+            CHECK(rtree.circle_count() == 1);
+            CHECK(rtree.grid_count() == 1);
+            CHECK(rtree.leaf_count() == (8 + fanout - 1) / fanout);
+
+            CHECK_FALSE(index.is_within_entity(geo::Point{ 35.964, -83.926 }));
+
+            for (int i = 0; i <= 100; ++i) {
+                for (int j = 0; j <= 100; ++j) {
+                    geo::Point pt{ 35.9469 + i * 0.000087, -83.9385 + j * 0.000118 };
+                    bool within = index.is_within_entity(pt);
+                    CHECK(within == referenceWithinEntity(qptr, pt, 5.2));
+
+                    HilbertRTree::SearchCost cost;
+                    CHECK(rtree.search(pt, cost) == within);
+                    CHECK(cost.nodes >= 1);
+                    CHECK(cost.nodes <= rtree.node_count());
+                }
+            }
+        }
+
+        // a map without entities is a single leaf that holds nothing.
+        Quad empty{ geo::Point{ 35.946920, -83.938486 }, geo::Point{ 35.955526, -83.926738 } };
+        HilbertRTree none{ empty };
+        CHECK(none.node_count() == 1);
+        CHECK(none.height() == 1);
+        CHECK_FALSE(none.is_within_entity(geo::Point{ 35.95, -83.93 }));
+    }
+
+    SECTION("I_80") {
+        Quad::Ptr qptr = buildI80QuadTree(10.0);
+        FrozenQuad frozen{ *qptr };
+
+        for (uint32_t fanout : { 4u, HilbertRTree::kDefaultFanout, 64u }) {
+            INFO("fanout: " << fanout);
+            HilbertRTree rtree{ *qptr, fanout };
+
+            // the quadtree copies long edges into every leaf they cross; the R-tree stores each once.
+            CHECK(rtree.corridor_count() < frozen.corridor_count());
+            CHECK(rtree.bytes() < frozen.bytes());
+
+            // packed: every node full except the last of each level, and every box holds its children's boxes.
+            const HilbertRTree::Node* nodes = rtree.get_nodes();
+            uint32_t leaves = 0;
+            for (uint32_t n = 0; n < rtree.node_count(); ++n) {
+                const HilbertRTree::Node& node = nodes[n];
+                if (node.child_count == 0) {
+                    ++leaves;
+                    uint32_t entities = (node.corridor_end - node.corridor_begin) + (node.circle_end - node.circle_begin) +
+                                        (node.grid_end - node.grid_begin);
+                    CHECK(entities <= fanout);
+                    continue;
+                }
+                CHECK(node.child_count <= fanout);
+                CHECK(node.first_child > n);
+                for (uint32_t c = node.first_child; c < node.first_child + node.child_count; ++c) {
+                    CHECK(node.min_lat <= nodes[c].min_lat);
+                    CHECK(node.min_lon <= nodes[c].min_lon);
+                    CHECK(nodes[c].max_lat <= node.max_lat);
+                    CHECK(nodes[c].max_lon <= node.max_lon);
+                }
+            }
+            CHECK(leaves == rtree.leaf_count());
+            CHECK(rtree.leaf_count() == (rtree.corridor_count() + fanout - 1) / fanout);
+            CHECK(nodes[rtree.node_count() - rtree.leaf_count()].child_count == 0);
+
+            uint32_t inside = 0;
+            HilbertRTree::SearchCost cost;
+            for (auto& pt : sampleI80Points()) {
+                bool within = rtree.is_within_entity(pt);
+                CHECK(within == frozen.is_within_entity(pt));
+                CHECK(within == referenceWithinEntity(qptr, pt, 10.0));
+                CHECK(rtree.search(pt, cost) == within);
+                if (within) ++inside;
+            }
+            CHECK(inside > 1000);
+            CHECK(cost.candidates > 0);
+        }
+    }
+}
+
+TEST_CASE("Raster Index", "[quad][raster]") {
+    SECTION("Test Network") {
+        Quad::Ptr qptr = buildTestQuadTree();
+        Quad::make_corridors(qptr, 5.2);
+        GeofenceIndex::CPtr frozen = std::make_shared<const FrozenQuad>(*qptr);
+
+        CHECK_THROWS_AS(RasterIndex(*qptr, frozen, -1.0), std::invalid_argument);
+        CHECK_THROWS_AS(RasterIndex(*qptr, frozen, 1e-9), std::invalid_argument);
+
+        // cells about 2 meters on a side so the 10 meter wide corridors hold inside cells.
+        RasterIndex raster{ *qptr, frozen, 0.00002 };
+        CHECK(raster.get_exact_index() == frozen);
+        CHECK(raster.count(RasterIndex::CellState::INSIDE) > 0);
+        CHECK(raster.count(RasterIndex::CellState::BOUNDARY) > 0);
+        CHECK(raster.count(RasterIndex::CellState::OUTSIDE) > raster.count(RasterIndex::CellState::BOUNDARY));
+        CHECK(raster.count(RasterIndex::CellState::INSIDE) + raster.count(RasterIndex::CellState::BOUNDARY) +
+              raster.count(RasterIndex::CellState::OUTSIDE) == uint64_t{ raster.get_rows() } * raster.get_cols());
+        CHECK(raster.bytes() * 4 >= uint64_t{ raster.get_rows() } * raster.get_cols());
+
+        // without an exact index only the raster answers; boundary cells report false.
+        RasterIndex raster_only{ *qptr, nullptr, 0.00002 };
+        CHECK(raster_only.retrieve_state(geo::Point{ 35.964, -83.926 }) == RasterIndex::CellState::BOUNDARY);
+
+        std::vector<GeofenceIndex::CPtr> exact_indexes{ frozen, qptr, std::make_shared<const GridIndex>(*qptr, 0.0007) };
+
+        uint32_t decided = 0;
+        for (int i = 0; i <= 200; ++i) {
+            for (int j = 0; j <= 200; ++j) {
+                geo::Point pt{ 35.9469 + i * 0.0000435, -83.9385 + j * 0.000059 };
+                bool within = referenceWithinEntity(qptr, pt, 5.2);
+                CHECK(raster.is_within_entity(pt) == within);
+
+                RasterIndex::CellState state = raster.retrieve_state(pt);
+                if (state != RasterIndex::CellState::BOUNDARY) {
+                    ++decided;
+                    CHECK(within == (state == RasterIndex::CellState::INSIDE));
+                    CHECK(raster_only.is_within_entity(pt) == within);
+                }
+            }
+        }
+        CHECK(decided > 30000);
+
+        for (auto& exact : exact_indexes) {
+            RasterIndex coarse{ *qptr, exact, 0.0003 };
+            for (int i = 0; i <= 100; ++i) {
+                for (int j = 0; j <= 100; ++j) {
+                    geo::Point pt{ 35.9469 + i * 0.000087, -83.9385 + j * 0.000118 };
+                    CHECK(coarse.is_within_entity(pt) == exact->is_within_entity(pt));
+                }
+            }
+        }
+    }
+
+    SECTION("I_80") {
+        Quad::Ptr qptr = buildI80QuadTree(10.0);
+        GeofenceIndex::CPtr frozen = std::make_shared<const FrozenQuad>(*qptr);
+
+        for (double cell : { 0.002, RasterIndex::kDefaultCellDegrees }) {
+            INFO("cell: " << cell);
+            RasterIndex raster{ *qptr, frozen, cell };
+
+            // most of the Wyoming box is far from I-80.
+            CHECK(raster.count(RasterIndex::CellState::OUTSIDE) > 10 * raster.count(RasterIndex::CellState::BOUNDARY));
+
+            for (auto& pt : sampleI80Points()) {
+                CHECK(raster.is_within_entity(pt) == frozen->is_within_entity(pt));
+            }
+        }
+
+        RasterIndex raster{ *qptr, frozen };
+        CHECK(raster.bytes() < 8 * 1024 * 1024);
+    }
+}
+
+/** PPM tests below **/
+
+TEST_CASE( "Redactor Checks", "[ppm][redactor]" ) {
+
+    ConfigMap conf{ 
+        { "privacy.redaction.id.inclusions", "ON" },
+        { "privacy.redaction.id.included", "ID1,ID2" },
+        { "privacy.redaction.id.value", "FFFF" },
+    };
+
+    std::string r;
+    IdRedactor idr{ conf };
+
+    SECTION( "Inclusion State Checks" ) {
+
+        // checks from setup above.
+        CHECK( idr.HasInclusions() );
+        CHECK( idr.NumInclusions() == 2 );
+
+        idr.ClearInclusions();
+        CHECK( idr.NumInclusions() == 0 );
+
+        idr.RedactAll();
+        CHECK_FALSE( idr.HasInclusions() );
+        CHECK( idr.NumInclusions() == -1 );
+        CHECK(idr.redaction_value() == "FFFF");
+        CHECK( idr.AddIdInclusion("ID3") );
+    }
+
+    SECTION( "Inclusion Redaction" ) {
+
+        r = "ID1";
+        CHECK( idr(r) );
+        // should be random.
+        CHECK( r != "ID1" );
+    }
+
+    SECTION( "Exclusion No Redact" ) {
+
+        r = "IDX";
+        CHECK_FALSE( idr(r) );
+        // no random redaction.
+        CHECK( r == "IDX" );
+    }
+
+    SECTION( "Add Id" ) {
+
+        idr.AddIdInclusion( "ID3" );
+        CHECK( idr.HasInclusions() );
+        CHECK( idr.NumInclusions() == 3 );
+
+        SECTION( "Inclusion Redaction" ) {
+            r = "ID3";
+            CHECK( idr(r) );
+            CHECK( r != "ID3" );
+        }
+    }
+
+    SECTION( "Remove Id" ) {
+
+        idr.RemoveIdInclusion( "ID1" );
+        CHECK( idr.HasInclusions() );
+        CHECK( idr.NumInclusions() == 1 );
+
+        SECTION( "Inclusion Redaction" ) {
+            r = "ID2";
+            CHECK( idr(r) );
+            CHECK( r != "ID2" );
+        }
+        SECTION( "Exclusion No Redaction" ) {
+            r = "ID1";
+            CHECK_FALSE( idr(r) );
+            CHECK( r == "ID1" );
+        }
+    }
+
+    SECTION( "Reset to Redact All" ) {
+
+        idr.RedactAll();
+        r = "IDX";
+        CHECK( idr(r) );
+        CHECK( r != "IDX" );
+    }
+
+    SECTION( "Clear Inclusions - Redact NOTHING" ) {
+
+        idr.ClearInclusions();
+        r = "ID1";
+        CHECK_FALSE( idr(r) );
+        CHECK( r == "ID1" );
+        r = "ID2";
+        CHECK_FALSE( idr(r) );
+        CHECK( r == "ID2" );
+
+    }
+}
+
+TEST_CASE( "Velocity Filter", "[ppm][velocity]" ) {
+
+    ConfigMap conf{ 
+        { "privacy.filter.velocity.min", "5" },
+        { "privacy.filter.velocity.max", "100" }
+    };
+    
+    // cover default constructor
+    VelocityFilter v_test;
+
+    VelocityFilter vf{ conf };
+
+    SECTION( "Using Configuration" ) {
+        CHECK( vf( 4.999 ) );
+        CHECK( vf( 100.001 ) );
+        CHECK_FALSE( vf( 10 ) );
+
+        CHECK( vf.suppress( 4.999 ) );
+        CHECK( vf.suppress( 100.001 ) );
+        CHECK_FALSE( vf.suppress( 10 ) );
+
+        CHECK( vf.retain( 5 ) );
+        CHECK( vf.retain( 100 ) );
+        CHECK( vf.retain( 10 ) );
+        CHECK_FALSE( vf.retain( 4.999 ) );
+        CHECK_FALSE( vf.retain( 100.001 ) );
+    }
+
+    SECTION( "Changing the filter's min and max" ) {
+        vf.set_min( 3.0 );
+        vf.set_max( 200.0 );
+        CHECK( vf( 2.999 ) );
+        CHECK( vf( 200.001 ) );
+        CHECK_FALSE( vf( 10 ) );
+
+        CHECK( vf.suppress( 2.999 ) );
+        CHECK( vf.suppress( 200.001 ) );
+        CHECK_FALSE( vf.suppress( 10 ) );
+
+        CHECK( vf.retain( 3 ) );
+        CHECK( vf.retain( 200 ) );
+        CHECK( vf.retain( 10 ) );
+        CHECK_FALSE( vf.retain( 2.999 ) );
+        CHECK_FALSE( vf.retain( 200.001 ) );
+    }
+}
+
+TEST_CASE( "BSM Checks", "[ppm][bsm]" ) {
+
+    BSM bsm;
+
+    SECTION( "Default Construction" ) {
+        CHECK( bsm.lat == 90.0 );
+        CHECK( bsm.lon == 180.0 );
+        CHECK( bsm.get_velocity() == -1.0 );
+        CHECK( bsm.get_secmark() == 0 );
+        CHECK( bsm.get_id() == "" );
+        CHECK( bsm.get_original_id() == "" );
+    }
+
+    SECTION( "Change and Reset" ) {
 
         bsm.set_latitude( 22.0 );
         CHECK( bsm.lat == 22.0 );
@@ -1118,6 +2996,8 @@ TEST_CASE( "BSM Checks", "[ppm][bsm]" ) {
             CHECK( bsm.get_id() == "" );
             CHECK( bsm.get_secmark() == 0 );
             CHECK( bsm.get_original_id() == "");
+            CHECK( bsm.get_partII() == "" );
+            CHECK( bsm.get_coreData() == "" );
         }
     }
 }
@@ -1429,6 +3309,583 @@ TEST_CASE( "BSMHandler JSON Geofence Only Filtering", "[ppm][filtering][geofence
     }
 }
 
+TEST_CASE( "Geofence Hint Cache", "[ppm][filtering][geofenceonly][hint]" ) {
+    Quad::Ptr qptr = buildTestQuadTree();
+    Quad::make_corridors( qptr, 5.2 );
+    FrozenQuad frozen{ *qptr };
+
+    geo::Point inside{ 35.951090, -83.930716 };
+    geo::Point outside{ 35.964, -83.926 };
+    GeofenceHintCache::Clock::time_point start{};
+
+    SECTION( "Hits" ) {
+        GeofenceHintCache cache{ 2, 1000 };
+        CHECK( cache.get_capacity() == 2 );
+        CHECK( cache.get_time_to_live() == 1000 );
+
+        CHECK( cache.is_within_entity( frozen, "A", inside, start ) );
+        CHECK( cache.is_within_entity( frozen, "A", inside, start + std::chrono::milliseconds{ 100 } ) );
+        CHECK_FALSE( cache.is_within_entity( frozen, "A", outside, start + std::chrono::milliseconds{ 200 } ) );
+
+        const GeofenceHintCache::Stats& stats = cache.get_stats();
+        CHECK( stats.lookups == 3 );
+        CHECK( stats.vehicle_hits == 2 );
+        CHECK( stats.leaf_hits == 1 );
+        CHECK( stats.entity_hits == 1 );
+        CHECK( cache.size() == 1 );
+    }
+
+    SECTION( "Eviction" ) {
+        GeofenceHintCache cache{ 2, 1000 };
+        cache.is_within_entity( frozen, "A", inside, start );
+        cache.is_within_entity( frozen, "B", inside, start );
+        cache.is_within_entity( frozen, "A", inside, start );
+        cache.is_within_entity( frozen, "C", inside, start );      // evicts B, the least recently used.
+        CHECK( cache.size() == 2 );
+        CHECK( cache.get_stats().evictions == 1 );
+
+        cache.is_within_entity( frozen, "A", inside, start );
+        CHECK( cache.get_stats().vehicle_hits == 2 );
+        cache.is_within_entity( frozen, "B", inside, start );
+        CHECK( cache.get_stats().vehicle_hits == 2 );
+        CHECK( cache.get_stats().evictions == 2 );
+    }
+
+    SECTION( "Expiration" ) {
+        GeofenceHintCache cache{ 16, 1000 };
+        cache.is_within_entity( frozen, "A", inside, start );
+        cache.is_within_entity( frozen, "B", inside, start + std::chrono::milliseconds{ 900 } );
+        cache.is_within_entity( frozen, "B", inside, start + std::chrono::milliseconds{ 1500 } );
+        CHECK( cache.get_stats().expirations == 1 );
+        CHECK( cache.size() == 1 );
+
+        cache.is_within_entity( frozen, "A", inside, start + std::chrono::milliseconds{ 1600 } );
+        CHECK( cache.get_stats().vehicle_hits == 1 );
+
+        cache.clear();
+        CHECK( cache.size() == 0 );
+        CHECK( cache.get_stats().lookups == 4 );
+    }
+
+    SECTION( "Disabled" ) {
+        GeofenceHintCache cache{ 0, 1000 };
+        CHECK( cache.is_within_entity( frozen, "A", inside, start ) );
+        CHECK_FALSE( cache.is_within_entity( frozen, "A", outside, start ) );
+        CHECK( cache.size() == 0 );
+        CHECK( cache.get_stats().lookups == 0 );
+    }
+
+    SECTION( "Handler" ) {
+        ConfigMap pconf;
+        REQUIRE( buildBaseConfiguration( pconf ) );
+        pconf["privacy.filter.geofence.hints"] = "8";
+        pconf["privacy.filter.geofence.hints.ttl"] = "60000";
+
+        BSMHandler handler{ buildTestQuadTree(), pconf, testLogger };
+        handler.deactivate<BSMHandler::kVelocityFilterFlag>();
+        CHECK( handler.get_hint_cache().get_capacity() == 8 );
+        CHECK( handler.get_hint_cache().get_time_to_live() == 60000 );
+
+        std::vector<std::string> json_inside;
+        std::vector<std::string> json_outside;
+        REQUIRE ( loadTestCases( "unit-test-data/test-case.inside.geofence.json", json_inside ) );
+        REQUIRE ( loadTestCases( "unit-test-data/test-case.outside.geofence.json", json_outside ) );
+
+        // twice, so the second pass runs with the hints of the first.
+        for ( int pass = 0; pass < 2; ++pass ) {
+            for ( auto& test_case : json_inside ) {
+                CHECK( handler.process( test_case ) );
+            }
+            for ( auto& test_case : json_outside ) {
+                CHECK_FALSE( handler.process( test_case ) );
+                CHECK( handler.get_result_string() == "geoposition" );
+            }
+        }
+
+        const GeofenceHintCache::Stats& stats = handler.get_hint_cache().get_stats();
+        CHECK( stats.lookups == 2 * ( json_inside.size() + json_outside.size() ) );
+        CHECK( stats.vehicle_hits > 0 );
+        CHECK( handler.get_hint_cache().size() > 0 );
+
+        handler.set_geofence_index( handler.get_geofence_index() );
+        CHECK( handler.get_hint_cache().size() == 0 );
+    }
+}
+
+TEST_CASE( "BSMHandler Geofence Index Selection", "[ppm][filtering][geofenceonly][index]" ) {
+
+    ConfigMap pconf;
+    REQUIRE( buildBaseConfiguration( pconf ) );
+
+    SECTION( "Default" ) {
+        BSMHandler handler{ buildTestQuadTree(), pconf, testLogger };
+        CHECK( std::dynamic_pointer_cast<const FrozenQuad>( handler.get_geofence_index() ) );
+    }
+
+    SECTION( "Unknown" ) {
+        pconf["privacy.filter.geofence.index"] = "kdtree";
+        BSMHandler handler{ buildTestQuadTree(), pconf, testLogger };
+        CHECK( std::dynamic_pointer_cast<const FrozenQuad>( handler.get_geofence_index() ) );
+    }
+
+    SECTION( "Raster" ) {
+        pconf["privacy.filter.geofence.index"] = "grid";
+        pconf["privacy.filter.geofence.raster"] = "ON";
+        pconf["privacy.filter.geofence.raster.cell"] = "0.0001";
+        BSMHandler handler{ buildTestQuadTree(), pconf, testLogger };
+
+        auto raster = std::dynamic_pointer_cast<const RasterIndex>( handler.get_geofence_index() );
+        REQUIRE( raster );
+        CHECK( raster->get_cell_degrees() == 0.0001 );
+        CHECK( std::dynamic_pointer_cast<const GridIndex>( raster->get_exact_index() ) );
+
+        BSM bsm;
+        bsm.set_latitude(35.951090);
+        bsm.set_longitude(-83.930716);
+        CHECK( handler.isWithinEntity( bsm ) );
+        bsm.set_latitude(35.964);
+        bsm.set_longitude(-83.926);
+        CHECK_FALSE( handler.isWithinEntity( bsm ) );
+    }
+
+    SECTION( "Planar" ) {
+        pconf["privacy.filter.geofence.planar"] = "ON";
+        BSMHandler handler{ buildTestQuadTree(), pconf, testLogger };
+
+        auto frozen = std::dynamic_pointer_cast<const FrozenQuad>( handler.get_geofence_index() );
+        REQUIRE( frozen );
+        CHECK( frozen->get_geometry() == FrozenQuad::Geometry::PLANAR );
+
+        BSM bsm;
+        bsm.set_latitude(35.951090);
+        bsm.set_longitude(-83.930716);
+        CHECK( handler.isWithinEntity( bsm ) );
+        bsm.set_latitude(35.964);
+        bsm.set_longitude(-83.926);
+        CHECK_FALSE( handler.isWithinEntity( bsm ) );
+    }
+
+    SECTION( "Fixed Point" ) {
+        pconf["privacy.filter.geofence.fixed"] = "ON";
+        pconf["privacy.filter.geofence.planar"] = "ON";
+        BSMHandler handler{ buildTestQuadTree(), pconf, testLogger };
+
+        auto frozen = std::dynamic_pointer_cast<const FrozenQuad>( handler.get_geofence_index() );
+        REQUIRE( frozen );
+        CHECK( frozen->get_geometry() == FrozenQuad::Geometry::FIXED );
+
+        BSM bsm;
+        bsm.set_latitude(35.951090);
+        bsm.set_longitude(-83.930716);
+        CHECK( handler.isWithinEntity( bsm ) );
+        bsm.set_latitude(35.964);
+        bsm.set_longitude(-83.926);
+        CHECK_FALSE( handler.isWithinEntity( bsm ) );
+    }
+
+    SECTION( "No Map" ) {
+        BSMHandler handler{ nullptr, pconf, testLogger };
+        CHECK_FALSE( handler.get_geofence_index() );
+    }
+
+    SECTION( "Compiled Map" ) {
+        pconf["privacy.filter.geofence.sw.lat"] = "40.997";
+        pconf["privacy.filter.geofence.sw.lon"] = "-111.041";
+        pconf["privacy.filter.geofence.ne.lat"] = "42.085";
+        pconf["privacy.filter.geofence.ne.lon"] = "-104.047";
+        pconf["privacy.filter.geofence.extension"] = "10.0";
+        const std::string path{ "builder.test.geofence" };
+
+        GeofenceBuilder builder{ pconf, testLogger };
+        FrozenQuad::CPtr compiled = builder.compile( "data/I_80.edges", path );
+        GeofenceIndex::CPtr parsed = builder.load( "data/I_80.edges" );
+        GeofenceIndex::CPtr loaded = builder.load( path );
+        REQUIRE( std::dynamic_pointer_cast<const FrozenQuad>( loaded ) );
+        CHECK( FrozenQuad::read_header( path ).extension == 10.0 );
+
+        BSMHandler handler{ nullptr, pconf, testLogger };
+        handler.set_geofence_index( loaded );
+        CHECK( handler.get_geofence_index() == loaded );
+
+        for ( auto& pt : sampleI80Points() ) {
+            bool within = parsed->is_within_entity( pt );
+            CHECK( loaded->is_within_entity( pt ) == within );
+            CHECK( compiled->is_within_entity( pt ) == within );
+        }
+
+        // the compiled file keeps its own extension; a different configured one only warns.
+        pconf["privacy.filter.geofence.extension"] = "20.0";
+        CHECK( GeofenceBuilder( pconf, testLogger ).load( path ) );
+
+        std::remove( path.c_str() );
+    }
+
+    SECTION( "Shared Map" ) {
+        pconf["privacy.filter.geofence.sw.lat"] = "40.997";
+        pconf["privacy.filter.geofence.sw.lon"] = "-111.041";
+        pconf["privacy.filter.geofence.ne.lat"] = "42.085";
+        pconf["privacy.filter.geofence.ne.lon"] = "-104.047";
+        pconf["privacy.filter.geofence.extension"] = "10.0";
+        const std::string path{ "shared.test.geofence" };
+        const std::string lockfile{ path + ".lock" };
+        std::remove( path.c_str() );
+
+        GeofenceIndex::CPtr parsed = GeofenceBuilder{ pconf, testLogger }.load( "data/I_80.edges" );
+        pconf["privacy.filter.geofence.shared"] = path;
+
+        // the first load publishes the shared geofence; the next one maps the same file without rewriting it.
+        GeofenceBuilder builder{ pconf, testLogger };
+        GeofenceIndex::CPtr first = builder.load( "data/I_80.edges" );
+        REQUIRE( std::dynamic_pointer_cast<const FrozenQuad>( first ) );
+        REQUIRE( FrozenQuad::is_compiled( path ) );
+
+        struct stat published;
+        REQUIRE( ::stat( path.c_str(), &published ) == 0 );
+
+        FrozenQuad::CPtr second = builder.attach_shared( "data/I_80.edges" );
+        struct stat attached;
+        REQUIRE( ::stat( path.c_str(), &attached ) == 0 );
+        CHECK( attached.st_ino == published.st_ino );
+        CHECK( second->bytes() == std::dynamic_pointer_cast<const FrozenQuad>( first )->bytes() );
+
+        for ( auto& pt : sampleI80Points() ) {
+            bool within = parsed->is_within_entity( pt );
+            CHECK( first->is_within_entity( pt ) == within );
+            CHECK( second->is_within_entity( pt ) == within );
+        }
+
+        // other settings replace the file; the trees already mapped keep the old one.
+        pconf["privacy.filter.geofence.extension"] = "20.0";
+        FrozenQuad::CPtr wider = GeofenceBuilder( pconf, testLogger ).attach_shared( "data/I_80.edges" );
+        CHECK( FrozenQuad::read_header( path ).extension == 20.0 );
+        CHECK( wider->corridor_count() > 0 );
+        for ( auto& pt : sampleI80Points() ) {
+            CHECK( second->is_within_entity( pt ) == parsed->is_within_entity( pt ) );
+        }
+
+        // the header identifies the map; a copy of it is the same map, whatever its modification time.
+        const std::string mapcopy{ "shared.test.edges" };
+        FrozenQuad::FileHeader header = FrozenQuad::read_header( path );
+        CHECK( header.source().same_contents( FrozenQuad::Source::of( "data/I_80.edges" ) ) );
+        CHECK( header.source().mtime_ns == FrozenQuad::Source::of( "data/I_80.edges" ).mtime_ns );
+        {
+            std::ifstream ifs{ "data/I_80.edges", std::ios::binary };
+            std::ofstream ofs{ mapcopy, std::ios::binary | std::ios::trunc };
+            ofs << ifs.rdbuf();
+        }
+        REQUIRE( ::stat( path.c_str(), &published ) == 0 );
+        GeofenceBuilder( pconf, testLogger ).attach_shared( mapcopy );
+        REQUIRE( ::stat( path.c_str(), &attached ) == 0 );
+        CHECK( attached.st_ino == published.st_ino );
+
+        // an edited map is rebuilt even when it is older than the shared file.
+        {
+            std::ofstream ofs{ mapcopy, std::ios::binary | std::ios::app };
+            ofs << "edge,20998,20998;41.18090044;-104.0533298:20999;41.1810;-104.0530,way_type=user_defined:way_id=80W\n";
+        }
+        struct timespec older[2] = { published.st_mtim, published.st_mtim };
+        older[0].tv_sec -= 60;
+        older[1].tv_sec -= 60;
+        REQUIRE( ::utimensat( AT_FDCWD, mapcopy.c_str(), older, 0 ) == 0 );
+        FrozenQuad::CPtr edited = GeofenceBuilder( pconf, testLogger ).attach_shared( mapcopy );
+        CHECK( FrozenQuad::read_header( path ).source().same_contents( FrozenQuad::Source::of( mapcopy ) ) );
+        CHECK( edited->corridor_count() > wider->corridor_count() );
+        std::remove( mapcopy.c_str() );
+
+        // a damaged file is rebuilt.
+        {
+            std::ofstream ofs{ path, std::ios::binary | std::ios::trunc };
+            ofs << "CVDPGEOF damaged";
+        }
+        CHECK( GeofenceBuilder( pconf, testLogger ).load( "data/I_80.edges" ) );
+        CHECK_NOTHROW( FrozenQuad::load( path ) );
+
+        std::remove( path.c_str() );
+        std::remove( lockfile.c_str() );
+    }
+
+    SECTION( "Each Index" ) {
+        pconf["privacy.filter.geofence.index.cell"] = "0.0005";
+        pconf["privacy.filter.geofence.index.fanout"] = "4";
+
+        std::vector<std::string> json_inside;
+        std::vector<std::string> json_outside;
+        REQUIRE ( loadTestCases( "unit-test-data/test-case.inside.geofence.json", json_inside ) );
+        REQUIRE ( loadTestCases( "unit-test-data/test-case.outside.geofence.json", json_outside ) );
+
+        for ( auto& index_type : { "quad", "frozen", "grid", "rtree" } ) {
+            INFO( "index: " << index_type );
+            pconf["privacy.filter.geofence.index"] = index_type;
+            Quad::Ptr qptr = buildTestQuadTree();
+            BSMHandler handler{ qptr, pconf, testLogger };
+
+            handler.deactivate<BSMHandler::kVelocityFilterFlag>();
+            handler.deactivate<BSMHandler::kIdRedactFlag>();
+            handler.deactivate<BSMHandler::kGeneralRedactFlag>();
+
+            const GeofenceIndex::CPtr& index = handler.get_geofence_index();
+            REQUIRE( index );
+            if ( std::string{ index_type } == "quad" ) {
+                CHECK( index.get() == qptr.get() );
+            } else if ( std::string{ index_type } == "grid" ) {
+                auto grid = std::dynamic_pointer_cast<const GridIndex>( index );
+                REQUIRE( grid );
+                CHECK( grid->get_cell_degrees() == 0.0005 );
+            } else if ( std::string{ index_type } == "rtree" ) {
+                auto rtree = std::dynamic_pointer_cast<const HilbertRTree>( index );
+                REQUIRE( rtree );
+                CHECK( rtree->get_fanout() == 4 );
+            } else {
+                CHECK( std::dynamic_pointer_cast<const FrozenQuad>( index ) );
+            }
+
+            BSM bsm;
+            bsm.set_latitude(35.951090);
+            bsm.set_longitude(-83.930716);
+            CHECK( handler.isWithinEntity( bsm ) );
+            bsm.set_latitude(35.964);
+            bsm.set_longitude(-83.926);
+            CHECK_FALSE( handler.isWithinEntity( bsm ) );
+
+            for ( auto& test_case : json_inside ) {
+                CHECK( handler.process( test_case ) );
+                CHECK( handler.get_result_string() == "success" );
+            }
+
+            for ( auto& test_case : json_outside ) {
+                CHECK_FALSE( handler.process( test_case ) );
+                CHECK( handler.get_result_string() == "geoposition" );
+            }
+        }
+    }
+}
+
+TEST_CASE( "Privacy Reload", "[ppm][reload]" ) {
+
+    ConfigMap pconf;
+    REQUIRE( buildBaseConfiguration( pconf ) );
+
+    SECTION( "Handler Apply" ) {
+        GeofenceIndex::CPtr index = GeofenceBuilder{ pconf, testLogger }.build_index( buildTestQuadTree() );
+        BSMHandler handler{ nullptr, pconf, testLogger };
+        handler.apply( PrivacySnapshot{ pconf, "", index, nullptr, RedactionPropertiesManager{} } );
+        CHECK( handler.get_geofence_index() == index );
+        CHECK( handler.get_id_redactor().NumInclusions() == 2 );
+
+        VelocityFilter before{ handler.get_velocity_filter() };
+        CHECK( before.suppress( 40.0 ) );
+
+        BSM bsm;
+        bsm.set_latitude(35.951090);
+        bsm.set_longitude(-83.930716);
+        CHECK( handler.isWithinEntity( bsm, "B1" ) );
+        CHECK( handler.get_hint_cache().size() == 1 );
+
+        // the same index keeps the hints; the other settings are replaced.
+        pconf["privacy.filter.velocity.max"] = "50.0";
+        pconf["privacy.redaction.id.included"] = "B1,B2,B3";
+        handler.apply( PrivacySnapshot{ pconf, "", index, nullptr, RedactionPropertiesManager{}, 1 } );
+        CHECK( handler.get_geofence_index() == index );
+        CHECK( handler.get_hint_cache().size() == 1 );
+        CHECK( handler.get_id_redactor().NumInclusions() == 3 );
+
+        VelocityFilter after{ handler.get_velocity_filter() };
+        CHECK_FALSE( after.suppress( 40.0 ) );
+
+        // a new index drops them.
+        handler.apply( PrivacySnapshot{ pconf, "", GeofenceBuilder{ pconf, testLogger }.build_index( buildTestQuadTree() ),
+                                        nullptr, RedactionPropertiesManager{}, 2 } );
+        CHECK( handler.get_geofence_index() != index );
+        CHECK( handler.get_hint_cache().size() == 0 );
+        CHECK( handler.isWithinEntity( bsm ) );
+    }
+
+    SECTION( "Reloader" ) {
+        pconf["privacy.filter.geofence.sw.lat"] = "40.997";
+        pconf["privacy.filter.geofence.sw.lon"] = "-111.041";
+        pconf["privacy.filter.geofence.ne.lat"] = "42.085";
+        pconf["privacy.filter.geofence.ne.lon"] = "-104.047";
+        pconf["privacy.filter.geofence.extension"] = "10.0";
+        pconf["privacy.filter.geofence.mapfile"] = "data/I_80.edges";
+        const std::string path{ "reload.test.properties" };
+
+        auto write = [&path]( const ConfigMap& conf ) {
+            std::ofstream ofs{ path, std::ios::trunc };
+            ofs << "# reload test" << std::endl;
+            for ( auto& setting : conf ) {
+                ofs << setting.first << " = " << setting.second << std::endl;
+            }
+        };
+
+        write( pconf );
+        CHECK( PrivacyReloader::read_configuration( path ) == pconf );
+        CHECK_THROWS_AS( PrivacyReloader::read_configuration( "no.such.properties" ), std::runtime_error );
+        CHECK_FALSE( PrivacyReloader::stamp( "no.such.properties" ).exists );
+
+        GeofenceIndex::CPtr index = GeofenceBuilder{ pconf, testLogger }.load( "data/I_80.edges" );
+        auto initial = std::make_shared<const PrivacySnapshot>( pconf, "data/I_80.edges", index, nullptr,
+                                                                 RedactionPropertiesManager{} );
+
+        PrivacyReloader reloader{ path, "", initial, testLogger };
+        CHECK( reloader.current() == initial );
+        CHECK( reloader.get_generation() == 0 );
+        CHECK_FALSE( reloader.changed() );
+
+        // a velocity change keeps the geofence index.
+        pconf["privacy.filter.velocity.max"] = "50.0";
+        write( pconf );
+        CHECK( reloader.changed() );
+        REQUIRE( reloader.reload() );
+        CHECK_FALSE( reloader.changed() );
+        CHECK( reloader.get_generation() == 1 );
+        CHECK( reloader.current()->get_generation() == 1 );
+        CHECK( reloader.current()->get_geofence_index() == index );
+        VelocityFilter faster{ reloader.current()->get_velocity_filter() };
+        CHECK_FALSE( faster.suppress( 40.0 ) );
+
+        // a geofence change rebuilds it; the old snapshot stays usable.
+        pconf["privacy.filter.geofence.extension"] = "20.0";
+        write( pconf );
+        REQUIRE( reloader.reload() );
+        CHECK( reloader.get_generation() == 2 );
+        GeofenceIndex::CPtr wider = reloader.current()->get_geofence_index();
+        REQUIRE( wider );
+        CHECK( wider != index );
+        for ( auto& pt : sampleI80Points() ) {
+            if ( index->is_within_entity( pt ) ) CHECK( wider->is_within_entity( pt ) );
+        }
+
+        // failed builds keep the current snapshot.
+        pconf["privacy.filter.geofence.mapfile"] = "no.such.edges";
+        write( pconf );
+        CHECK_FALSE( reloader.reload() );
+        CHECK_FALSE( reloader.changed() );
+        CHECK( reloader.get_generation() == 2 );
+        CHECK( reloader.current()->get_geofence_index() == wider );
+
+        std::remove( path.c_str() );
+        CHECK_FALSE( reloader.reload() );
+        CHECK( reloader.get_stats().reloads == 2 );
+        CHECK( reloader.get_stats().failures == 2 );
+
+        // the thread reloads on request, and on file changes when an interval is set.
+        pconf["privacy.filter.geofence.mapfile"] = "data/I_80.edges";
+        pconf["privacy.reload.interval"] = "10";
+        write( pconf );
+
+        auto wait_for = []( const PrivacyReloader& r, uint64_t generation ) {
+            for ( int i = 0; i < 3000 && r.get_generation() < generation; ++i ) {
+                std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+            }
+            return r.get_generation() >= generation;
+        };
+
+        reloader.start();
+        reloader.request();
+        CHECK( wait_for( reloader, 3 ) );
+        CHECK( reloader.get_stats().requests == 1 );
+        reloader.stop();
+
+        PrivacyReloader watcher{ path, "", reloader.current(), testLogger };
+        watcher.start();
+        pconf["privacy.filter.velocity.max"] = "60.0";
+        write( pconf );
+        CHECK( wait_for( watcher, 4 ) );
+        watcher.stop();
+        VelocityFilter fastest{ watcher.current()->get_velocity_filter() };
+        CHECK_FALSE( fastest.suppress( 55.0 ) );
+
+        std::remove( path.c_str() );
+    }
+
+    SECTION( "Geofence Delta" ) {
+        pconf["privacy.filter.geofence.sw.lat"] = "40.997";
+        pconf["privacy.filter.geofence.sw.lon"] = "-111.041";
+        pconf["privacy.filter.geofence.ne.lat"] = "42.085";
+        pconf["privacy.filter.geofence.ne.lon"] = "-104.047";
+        pconf["privacy.filter.geofence.extension"] = "10.0";
+        pconf["privacy.filter.geofence.mapfile"] = "data/I_80.edges";
+        pconf["privacy.filter.geofence.delta"] = "reload.test.delta";
+        const std::string path{ "reload.test.properties" };
+        const std::string delta{ "reload.test.delta" };
+        std::remove( delta.c_str() );
+
+        {
+            std::ofstream ofs{ path, std::ios::trunc };
+            for ( auto& setting : pconf ) {
+                ofs << setting.first << " = " << setting.second << std::endl;
+            }
+        }
+
+        // a work zone on the middle of an edge: every edge whose corridor holds it is removed.
+        shapes::CSVInputFactory shape_factory( "data/I_80.edges" );
+        shape_factory.make_shapes();
+        const geo::Edge& work_edge = *shape_factory.get_edges()[500];
+        geo::Point work_zone{ (work_edge.v1->lat + work_edge.v2->lat) / 2.0, (work_edge.v1->lon + work_edge.v2->lon) / 2.0 };
+
+        std::vector<uint64_t> closed;
+        for ( auto& edge_ptr : shape_factory.get_edges() ) {
+            if ( edge_ptr->to_area( 10.0 )->contains( work_zone ) ) closed.push_back( edge_ptr->get_uid() );
+        }
+        REQUIRE_FALSE( closed.empty() );
+
+        // without a delta file the map is used as is, and the parsed tree is kept.
+        Quad::Ptr base;
+        GeofenceIndex::CPtr index = GeofenceBuilder{ pconf, testLogger }.load( "data/I_80.edges", &base );
+        REQUIRE( base );
+        CHECK( index->is_within_entity( work_zone ) );
+
+        auto initial = std::make_shared<const PrivacySnapshot>( pconf, "data/I_80.edges", index, base,
+                                                                 RedactionPropertiesManager{} );
+        PrivacyReloader reloader{ path, "", initial, testLogger };
+        CHECK_FALSE( reloader.changed() );
+
+        {
+            std::ofstream ofs{ delta, std::ios::trunc };
+            ofs << "type,id,geography,attributes" << std::endl;
+            for ( uint64_t uid : closed ) {
+                ofs << "remove,edge," << uid << std::endl;
+            }
+        }
+
+        CHECK( reloader.changed() );
+        REQUIRE( reloader.reload() );
+        GeofenceIndex::CPtr edited = reloader.current()->get_geofence_index();
+        CHECK( edited != index );
+        CHECK( reloader.current()->get_geofence_base() == base );
+        CHECK_FALSE( edited->is_within_entity( work_zone ) );
+
+        // the delta always applies to the map file, so adding a circle keeps the removals.
+        {
+            std::ofstream ofs{ delta, std::ios::app };
+            ofs << "circle,90000," << work_zone.lat << ":" << work_zone.lon << ":30" << std::endl;
+            ofs << "remove,grid,0" << std::endl;
+        }
+
+        REQUIRE( reloader.reload() );
+        CHECK( reloader.current()->get_geofence_index()->is_within_entity( work_zone ) );
+        CHECK( reloader.current()->get_geofence_base() == base );
+
+        Quad::Ptr edited_quad = GeofenceBuilder{ pconf, testLogger }.apply_delta( base );
+        REQUIRE( edited_quad != base );
+        for ( auto& entity : edited_quad->retrieve_elements( work_zone ) ) {
+            if ( entity->get_entity_type() == geo::EntityType::EDGE ) {
+                uint64_t uid = std::static_pointer_cast<const geo::Edge>( entity )->get_uid();
+                CHECK( std::find( closed.begin(), closed.end(), uid ) == closed.end() );
+            }
+        }
+
+        // removing the delta file restores the map.
+        std::remove( delta.c_str() );
+        CHECK( reloader.changed() );
+        REQUIRE( reloader.reload() );
+        CHECK( reloader.current()->get_geofence_index()->is_within_entity( work_zone ) );
+        CHECK( (GeofenceBuilder{ pconf, testLogger }.apply_delta( base ) == base) );
+
+        std::remove( path.c_str() );
+    }
+}
+
 TEST_CASE( "BSMHandler JSON Error Checking", "[ppm][filtering][error]" ) {
     ConfigMap pconf;
 
@@ -1672,6 +4129,75 @@ TEST_CASE( "RapidjsonRedactor Redact Member By Path (Without Bitstrings)", "[ppm
     }
 }
 
+TEST_CASE( "RedactionTrie Matches Redact Member By Path", "[ppm][redaction][redactiontrie]" ) {
+    RapidjsonRedactor rapidjsonRedactor;
+
+    std::vector<std::vector<std::string>> path_sets;
+
+    // the configured paths.
+    RedactionPropertiesManager rpm;
+    path_sets.push_back( rpm.getFields() );
+
+    // paths whose order matters: a removal moves the last member into its place, and may leave a bitstring.
+    path_sets.push_back( {
+        "payload.data.partII.value.weatherReport.airTemp",
+        "payload.data.coreData.brakes.wheelBrakes.unavailable",
+        "payload.data.partII.value.weatherReport.friction",
+        "payload.data.coreData.brakes.wheelBrakes.leftFront",
+        "payload.data.partII.value.weatherReport.airPressure",
+        "payload.data.partII.value.weatherReport.airPressure",
+        "payload.data.coreData.size",
+        "payload.data.coreData.speed.value",
+        "payload.data.coreData.speed",
+        "payload.data.coreData.brakes.wheelBrakes.spare",
+        "payload.data.coreData.accuracy",
+        "payload.data.coreData.angle",
+        "payload.data.coreData.transmission",
+        "payload.data.partII.id",
+        "payload.data.partII.value.events",
+        "payload.data.partII",
+        "payload",
+        "metadata..x",
+        ""
+    } );
+
+    std::vector<std::string> cases;
+    REQUIRE( loadTestCases( "unit-test-data/test-case.redaction.general.json", cases ) );
+    REQUIRE( loadTestCases( "unit-test-data/test-case.redaction.general.nobitstrings.json", cases ) );
+    REQUIRE( loadTestCases( "unit-test-data/test-case.all.good.json", cases ) );
+    REQUIRE( loadTestCases( "data/bsm.new.json", cases ) );
+
+    cases.push_back( R"({"metadata":{"":{"x":1}},"payload":{"data":{"coreData":{"speed":{"value":1},"size":{"width":1},"accuracy":{"a":true},"angle":"x","transmission":3,"speed":2,"brakes":{"wheelBrakes":{"leftFront":true,"rightFront":true,"unavailable":false,"leftRear":true,"rightRear":false}}},"partII":[{"id":0,"value":{"weatherReport":{"airTemp":1,"friction":2}}},{"id":1,"value":{"weatherReport":{"airTemp":3,"airPressure":4,"x":true},"events":{"e":[1]}}},[{"id":2}]]},"payload":{}}})" );
+    cases.push_back( R"({"payload":{"data":{"coreData":{"size":1,"size":{"length":2},"speed":{"speed":{"value":3}}},"partII":[{"value":[{"weatherReport":{"airPressure":1}},{"weatherReport":{"airTemp":1,"airPressure":2}}]}]}}})" );
+    cases.push_back( R"({"payload":{"data":{"coreData":{"accuracy":{},"brakes":{"wheelBrakes":{"unavailable":true,"leftFront":false,"rightFront":false,"leftRear":false,"rightRear":false}}},"partII":{"id":3,"value":{"weatherReport":{"friction":1,"airTemp":{"a":false}}}}}}})" );
+
+    for (auto& paths : path_sets) {
+        RedactionTrie trie{ paths };
+        REQUIRE( trie.getPathCount() == paths.size() );
+
+        for (auto& test_case : cases) {
+            INFO( test_case );
+
+            rapidjson::Document expected = rapidjsonRedactor.getDocumentFromString( test_case );
+            rapidjson::Document actual = rapidjsonRedactor.getDocumentFromString( test_case );
+
+            std::vector<bool> expected_redacted;
+            for (auto& path : paths) {
+                expected_redacted.push_back( rapidjsonRedactor.redactMemberByPath( expected, path ) );
+            }
+
+            trie.redact( actual );
+
+            CHECK( rapidjsonRedactor.stringifyValue( actual ) == rapidjsonRedactor.stringifyValue( expected ) );
+            for (std::size_t i = 0; i < paths.size(); ++i) {
+                INFO( paths[i] );
+                CHECK( trie.isRedacted( i ) == expected_redacted[i] );
+                CHECK( trie.getPath( i ) == paths[i] );
+            }
+        }
+    }
+}
+
 TEST_CASE( "BSMHandler JSON General Redaction Only", "[ppm][redaction][generalonly]" ) {
     // create redaction properties manager
     RedactionPropertiesManager rpm;
@@ -1823,4 +4349,357 @@ TEST_CASE( "BSMHandler JSON General Redaction w/ All Flags", "[ppm][redaction][g
         CHECK( numMembersPresentAfterRedaction == 0 );
     }
 
-}
\ No newline at end of file
+}
+
+TEST_CASE( "BSMHandler Streaming Matches DOM", "[ppm][filtering][streaming]" ) {
+    std::unordered_map<std::string,std::string> pconf;
+    REQUIRE( buildBaseConfiguration( pconf ) );
+
+    // redact every id, so both handlers draw random ids.
+    pconf["privacy.redaction.id.inclusions"] = "OFF";
+
+    Quad::Ptr quad_ptr = buildTestQuadTree();
+    BSMHandler stream_handler{ quad_ptr, pconf, testLogger };
+    BSMHandler dom_handler{ quad_ptr, pconf, testLogger };
+    dom_handler.set_stream_parse( false );
+
+    // produce the output of suppressed messages too.
+    stream_handler.set_prefilter( false );
+    dom_handler.set_prefilter( false );
+
+    REQUIRE( stream_handler.is_stream_parse() );
+    REQUIRE_FALSE( dom_handler.is_stream_parse() );
+
+    pconf["privacy.parse.streaming"] = "OFF";
+    CHECK_FALSE( BSMHandler( nullptr, pconf, testLogger ).is_stream_parse() );
+
+    std::vector<std::string> cases;
+    REQUIRE( loadAllTestCases( cases ) );
+
+    // messages that exercise member order, duplicate members and replaced containers.
+    cases.push_back( R"({"payload":{"data":{"coreData":{"id":"B1","size":{"width":1,"length":2},"speed":5.5,"position":{"latitude":35.952500,"longitude":-83.932434}}}},"metadata":{"sanitized":false,"payloadType":"us.dot.its.jpo.ode.model.OdeBsmPayload"}})" );
+    cases.push_back( R"({"metadata":{"payloadType":"us.dot.its.jpo.ode.model.OdeBsmPayload","sanitized":false,"sanitized":7},"metadata":{},"payload":{"data":{"coreData":{"speed":5.5,"speed":"x","id":"\"q\u0001\"","size":{"length":{"a":[1,{"b":2}]},"width":[true]},"position":{"longitude":-83.932434,"latitude":35.952500}},"partII":[{"id":1,"value":{"angle":12.5,"events":{"a":true,"b":false}}}]}}})" );
+    cases.push_back( R"({"metadata":{"payloadType":"us.dot.its.jpo.ode.model.OdeBsmPayload","sanitized":true},"payload":{"data":{"coreData":{"speed":5.5,"id":7,"position":{"latitude":35.952500,"longitude":-83.932434}}}}})" );
+    cases.push_back( R"([{"metadata":{}}])" );
+
+    for (uint32_t features = 0; features < 4; ++features) {
+        applyTestSnapshot<BSMHandler::kGeneralRedactFlag, BSMHandler::kSizeRedactFlag>(
+                pconf, { &stream_handler, &dom_handler }, features );
+
+        for (auto& test_case : cases) {
+            INFO( "features " << features << ": " << test_case );
+
+            bool stream_retained = stream_handler.process( test_case );
+            bool dom_retained = dom_handler.process( test_case );
+
+            CHECK( stream_retained == dom_retained );
+            CHECK( stream_handler.get_result() == dom_handler.get_result() );
+            CHECK( stream_handler.get_json() == dom_handler.get_json() );
+
+            BSM& stream_bsm = stream_handler.get_bsm();
+            BSM& dom_bsm = dom_handler.get_bsm();
+            CHECK( stream_bsm.get_velocity() == dom_bsm.get_velocity() );
+            CHECK( stream_bsm.lat == dom_bsm.lat );
+            CHECK( stream_bsm.lon == dom_bsm.lon );
+            CHECK( stream_bsm.get_id() == dom_bsm.get_id() );
+            CHECK( stream_bsm.get_original_id() == dom_bsm.get_original_id() );
+            CHECK( stream_bsm.get_coreData() == dom_bsm.get_coreData() );
+            CHECK( stream_bsm.get_partII() == dom_bsm.get_partII() );
+        }
+    }
+}
+
+TEST_CASE( "BSMHandler Prefilter Matches Full Processing", "[ppm][filtering][prefilter]" ) {
+    std::unordered_map<std::string,std::string> pconf;
+    REQUIRE( buildBaseConfiguration( pconf ) );
+    pconf["privacy.redaction.id.inclusions"] = "OFF";
+
+    Quad::Ptr quad_ptr = buildTestQuadTree();
+    BSMHandler prefiltered{ quad_ptr, pconf, testLogger };
+    BSMHandler full{ quad_ptr, pconf, testLogger };
+    full.set_prefilter( false );
+
+    REQUIRE( prefiltered.is_prefilter() );
+    REQUIRE_FALSE( full.is_prefilter() );
+
+    pconf["privacy.parse.prefilter"] = "OFF";
+    CHECK_FALSE( BSMHandler( nullptr, pconf, testLogger ).is_prefilter() );
+
+    std::vector<std::string> cases;
+    REQUIRE( loadAllTestCases( cases ) );
+
+    // slow vehicles (1.0 m/s) in messages the scan must leave to the full processing, or decide exactly.
+    const std::string head = R"({"metadata":{"sanitized":false,"payloadType":"us.dot.its.jpo.ode.model.OdeBsmPayload"},"payload":{"data":{"coreData":{)";
+    const std::string position = R"("position":{"latitude":35.952500,"longitude":-83.932434})";
+    cases.push_back( head + R"("speed":1.0,"id":"B1",)" + position + "}}}}" );
+    cases.push_back( head + R"("speed":1.0,"id":"B1",)" + position + "}}}} x" );
+    cases.push_back( head + R"("speed":1.0,"id":"B1",)" + position + "}}}" );
+    cases.push_back( head + R"("speed":1.0,"id":"B1" )" + position + "}}}}" );
+    cases.push_back( head + R"("speed":1.0,"id":"B1",)" + position + "}}}}" );
+    cases.push_back( head + R"("speed":1.0,"speed":1.0,"id":"B1",)" + position + "}}}}" );
+    cases.push_back( head + R"("speed":1.0,"speed":20.0,"id":"B1",)" + position + ",\"note\":\"\\ud83d\\ude97\"}}}}" );
+    cases.push_back( head + R"("speed":1e0,"id":"B1",)" + position + ",\"big\":1e400}}}}" );
+    cases.push_back( head + R"("speed":1,"id":"B1",)" + position + "}}}}" );
+    cases.push_back( head + R"("speed":1.0,"id":"B1",)" + R"("position":{"latitude":35.952500})" + "}}}}" );
+    cases.push_back( head + R"("speed":1.0,"id":7,)" + position + "}}}}" );
+    cases.push_back( head + R"("speed":1.0,"id":"B1",)" + position + ",\"tab\":\"a\tb\"}}}}" );
+    cases.push_back( std::string{ head + R"("speed":1.0,"id":"B1",)" + position + "}}}}" }.append( 1, '\0' ).append( "x" ) );
+    cases.push_back( R"({"payload":{"data":{"coreData":{"speed":1.0,"id":"B1",)" + position + R"(}}},"metadata":{"sanitized":true,"payloadType":"us.dot.its.jpo.ode.model.OdeBsmPayload"}})" );
+
+    for (uint32_t filters = 0; filters < 4; ++filters) {
+        applyTestSnapshot<BSMHandler::kVelocityFilterFlag, BSMHandler::kGeofenceFilterFlag>(
+                pconf, { &prefiltered, &full }, filters );
+
+        for (auto& test_case : cases) {
+            INFO( "filters " << filters << ": " << test_case );
+
+            std::string previous_json = prefiltered.get_json();
+
+            bool prefiltered_retained = prefiltered.process( test_case );
+            bool full_retained = full.process( test_case );
+
+            CHECK( prefiltered_retained == full_retained );
+            CHECK( prefiltered.get_result() == full.get_result() );
+
+            // the output of a retained message is always produced; a suppressed one may be skipped.
+            if (full_retained) {
+                CHECK( prefiltered.get_json() == full.get_json() );
+            } else {
+                CHECK( (prefiltered.get_json() == full.get_json() || prefiltered.get_json() == previous_json) );
+            }
+
+            BSM& prefiltered_bsm = prefiltered.get_bsm();
+            BSM& full_bsm = full.get_bsm();
+            CHECK( prefiltered_bsm.get_velocity() == full_bsm.get_velocity() );
+            CHECK( prefiltered_bsm.lat == full_bsm.lat );
+            CHECK( prefiltered_bsm.lon == full_bsm.lon );
+            CHECK( prefiltered_bsm.get_id() == full_bsm.get_id() );
+            CHECK( prefiltered_bsm.get_original_id() == full_bsm.get_original_id() );
+
+            // every geofence check is made once, through the same hints.
+            CHECK( prefiltered.get_hint_cache().get_stats().lookups == full.get_hint_cache().get_stats().lookups );
+        }
+    }
+
+    // a slow vehicle is suppressed from the scan alone: its output is never produced.
+    prefiltered.activate<BSMHandler::kVelocityFilterFlag>();
+    std::string previous_json = prefiltered.get_json();
+    CHECK_FALSE( prefiltered.process( head + R"("speed":1.0,"id":"B1",)" + position + "}}}}" ) );
+    CHECK( prefiltered.get_result_string() == "speed" );
+    CHECK( prefiltered.get_json() == previous_json );
+}
+
+TEST_CASE( "BSMHandler Prefilter Leaves No Previous BSM", "[ppm][filtering][prefilter]" ) {
+    std::unordered_map<std::string,std::string> pconf;
+    REQUIRE( buildBaseConfiguration( pconf ) );
+
+    BSMHandler handler{ buildTestQuadTree(), pconf, testLogger };
+    REQUIRE( handler.is_prefilter() );
+    handler.activate<BSMHandler::kVelocityFilterFlag>();
+    handler.activate<BSMHandler::kGeneralRedactFlag>();
+    handler.deactivate<BSMHandler::kGeofenceFilterFlag>();
+    handler.deactivate<BSMHandler::kIdRedactFlag>();
+
+    const std::string head = R"({"metadata":{"sanitized":false,"payloadType":"us.dot.its.jpo.ode.model.OdeBsmPayload"},"payload":{"data":{"coreData":{)";
+    const std::string position = R"("position":{"latitude":35.952500,"longitude":-83.932434})";
+
+    REQUIRE( handler.process( head + R"("speed":20.0,"id":"A1",)" + position + R"(},"partII":[{"id":0}]}}})" ) );
+    REQUIRE_FALSE( handler.get_bsm().get_coreData().empty() );
+    REQUIRE_FALSE( handler.get_bsm().get_partII().empty() );
+
+    // the slow vehicle is suppressed from the scan; the BSM holds its fields alone.
+    CHECK_FALSE( handler.process( head + R"("speed":1.0,"id":"B1",)" + position + "}}}}" ) );
+    CHECK( handler.get_result_string() == "speed" );
+
+    BSM& bsm = handler.get_bsm();
+    CHECK( bsm.get_id() == "B1" );
+    CHECK( bsm.get_original_id() == "" );
+    CHECK( bsm.get_velocity() == 1.0 );
+    CHECK( bsm.get_coreData() == "" );
+    CHECK( bsm.get_partII() == "" );
+}
+
+TEST_CASE( "BSMHandler DOM Arena Reuse", "[ppm][filtering][arena]" ) {
+    std::unordered_map<std::string,std::string> pconf;
+    REQUIRE( buildBaseConfiguration( pconf ) );
+
+    Quad::Ptr quad_ptr = buildTestQuadTree();
+
+    // each general redaction path a message lacks is logged, which allocates the log line.
+    auto quietLogger = std::make_shared<PpmLogger>("testInfo.log", "testError.log");
+    quietLogger->set_info_level( spdlog::level::err );
+
+    // the arena is the memory of the DOM path only; a message the streaming pass decides never touches it. This is
+    // the default handler: streaming, with the prefilter.
+    BSMHandler streaming{ quad_ptr, pconf, quietLogger };
+    REQUIRE( streaming.is_stream_parse() );
+    REQUIRE( streaming.is_prefilter() );
+    streaming.activate<BSMHandler::kGeneralRedactFlag>();
+    CHECK( streaming.process( R"({"metadata":{"sanitized":false,"payloadType":"us.dot.its.jpo.ode.model.OdeBsmPayload"},"payload":{"data":{"coreData":{"speed":20.0,"id":"A1","position":{"latitude":35.952500,"longitude":-83.932434}}}}})" ) );
+    CHECK( streaming.get_arena().get_resets() == 0 );
+
+    // every message below takes the DOM path.
+    BSMHandler handler{ quad_ptr, pconf, quietLogger };
+    handler.set_stream_parse( false );
+    handler.set_prefilter( false );
+    handler.activate<BSMHandler::kGeneralRedactFlag>();
+    handler.activate<BSMHandler::kSizeRedactFlag>();
+
+    CHECK( handler.get_arena().get_capacity() == JsonArena::kDefaultCapacity );
+
+    // a first chunk too small for any message: every document overflows.
+    pconf["privacy.parse.arena"] = "1";
+    BSMHandler small{ quad_ptr, pconf, quietLogger };
+    small.set_stream_parse( false );
+    small.set_prefilter( false );
+    small.activate<BSMHandler::kGeneralRedactFlag>();
+    small.activate<BSMHandler::kSizeRedactFlag>();
+
+    CHECK( small.get_arena().get_capacity() == JsonArena::kMinCapacity );
+
+    std::vector<std::string> cases;
+    REQUIRE( loadAllTestCases( cases ) );
+
+    // the heap allocations of C++ objects in passes over the cases.
+    auto heap = [&cases]( BSMHandler& h, int passes ) -> uint64_t {
+        uint64_t before = heapAllocations;
+        for (int pass = 0; pass < passes; ++pass) {
+            for (auto& test_case : cases) {
+                h.process( test_case );
+            }
+        }
+        return heapAllocations - before;
+    };
+
+    // the first passes size the output buffers, the geofence hints and the strings the handlers reuse; a reused
+    // string only grows, so they stop allocating after a few passes.
+    heap( small, 1 );
+    for (BSMHandler* h : { &handler, &streaming }) {
+        int warmup = 1;
+        while (heap( *h, 1 ) != 0 && warmup < 10) {
+            ++warmup;
+        }
+
+        REQUIRE( warmup < 10 );
+    }
+
+    uint64_t allocations = handler.get_arena().get_heap_allocations();
+    uint64_t small_allocations = small.get_arena().get_heap_allocations();
+    uint64_t resets = handler.get_arena().get_resets();
+
+    // the arena counts only its own chunks and output buffer; operator new counts the rest of the handler's heap use.
+    const int passes = 100;
+    CHECK( heap( handler, passes ) == 0 );
+    CHECK( heap( streaming, passes ) == 0 );
+
+    CHECK( handler.get_arena().get_resets() - resets == passes * cases.size() );
+    CHECK( handler.get_arena().get_heap_allocations() == allocations );
+
+    // the overflow gives the same results and output, at the cost of heap allocations.
+    applyTestSnapshot<BSMHandler::kGeneralRedactFlag, BSMHandler::kSizeRedactFlag>(
+            pconf, { &handler, &small }, 0x3 );
+
+    for (auto& test_case : cases) {
+        INFO( test_case );
+
+        CHECK( handler.process( test_case ) == small.process( test_case ) );
+        CHECK( handler.get_result() == small.get_result() );
+        CHECK( handler.get_bsm().get_velocity() == small.get_bsm().get_velocity() );
+        CHECK( handler.get_bsm().get_coreData() == small.get_bsm().get_coreData() );
+        CHECK( handler.get_json() == small.get_json() );
+    }
+
+    CHECK( small.get_arena().get_heap_allocations() > small_allocations );
+    CHECK( handler.get_arena().get_heap_allocations() == allocations );
+}
+
+TEST_CASE( "BSMHandler Process From A Buffer", "[ppm][filtering][insitu]" ) {
+    std::unordered_map<std::string,std::string> pconf;
+    REQUIRE( buildBaseConfiguration( pconf ) );
+    pconf["privacy.redaction.id.inclusions"] = "OFF";
+
+    Quad::Ptr quad_ptr = buildTestQuadTree();
+    BSMHandler from_string{ quad_ptr, pconf, testLogger };
+    BSMHandler from_buffer{ quad_ptr, pconf, testLogger };
+
+    std::vector<std::string> cases;
+    REQUIRE( loadAllTestCases( cases ) );
+
+    cases.push_back( R"({"metadata":{"payloadType":"us.dot.its.jpo.ode.model.OdeBsmPayload","sanitized":false},"payload":{"data":{"coreData":{"speed":5.5,"id":"\"q\u0000\"","size":{"length":2,"width":1},"position":{"latitude":35.952500,"longitude":-83.932434}},"partII":[{"id":"\u00e9"}]}}})" );
+    cases.push_back( std::string{ R"({"metadata":{})" }.append( 1, '\0' ).append( "}" ) );
+    cases.push_back( "" );
+
+    for (uint32_t mode = 0; mode < 4; ++mode) {
+        applyTestSnapshot<BSMHandler::kGeneralRedactFlag, BSMHandler::kSizeRedactFlag>(
+                pconf, { &from_string, &from_buffer }, 0x3 );
+
+        for (BSMHandler* handler : { &from_string, &from_buffer }) {
+            handler->set_stream_parse( mode & 0x1 );
+            handler->set_prefilter( mode & 0x2 );
+        }
+
+        for (auto& test_case : cases) {
+            INFO( "mode " << mode << ": " << test_case );
+
+            // the buffer runs on past the message, as a Kafka payload is not NUL terminated.
+            std::string buffer = test_case + "]]} trailing bytes";
+            std::string original = test_case;
+
+            CHECK( from_string.process( test_case ) == from_buffer.process( buffer.data(), test_case.size() ) );
+            CHECK( test_case == original );
+            CHECK( from_string.get_result() == from_buffer.get_result() );
+            CHECK( from_string.get_json() == from_buffer.get_json() );
+            CHECK( from_string.get_bsm().get_velocity() == from_buffer.get_bsm().get_velocity() );
+            CHECK( from_string.get_bsm().get_id() == from_buffer.get_bsm().get_id() );
+            CHECK( from_string.get_bsm().get_coreData() == from_buffer.get_bsm().get_coreData() );
+            CHECK( from_string.get_bsm().get_partII() == from_buffer.get_bsm().get_partII() );
+        }
+    }
+}
+
+TEST_CASE( "BSMHandler Arena Soak", "[.][ppm][filtering][arena][soak]" ) {
+    std::unordered_map<std::string,std::string> pconf;
+    REQUIRE( buildBaseConfiguration( pconf ) );
+
+    Quad::Ptr quad_ptr = buildTestQuadTree();
+
+    // the default handler streams messages; the other takes each one through the DOM and its arena.
+    BSMHandler streaming{ quad_ptr, pconf, testLogger };
+    BSMHandler dom{ quad_ptr, pconf, testLogger };
+    dom.set_stream_parse( false );
+    dom.set_prefilter( false );
+
+    REQUIRE( streaming.is_stream_parse() );
+
+    std::vector<std::string> cases;
+    REQUIRE( loadTestCases( "data/I_80_test.json", cases ) );
+    REQUIRE( loadTestCases( "unit-test-data/test-case.all.good.tims.json", cases ) );
+
+    struct rusage usage;
+    const uint64_t messages = 1000000;
+
+    for (BSMHandler* handler : { &streaming, &dom }) {
+        INFO( (handler == &streaming ? "streaming" : "DOM") );
+
+        uint64_t processed = 0;
+
+        // warm up, then the peak resident set must not grow over a million messages.
+        while (processed < messages / 10) {
+            handler->process( cases[ processed++ % cases.size() ] );
+        }
+
+        REQUIRE( getrusage( RUSAGE_SELF, &usage ) == 0 );
+        long warm_rss = usage.ru_maxrss;
+        uint64_t allocations = handler->get_arena().get_heap_allocations();
+
+        while (processed < messages) {
+            handler->process( cases[ processed++ % cases.size() ] );
+        }
+
+        REQUIRE( getrusage( RUSAGE_SELF, &usage ) == 0 );
+
+        // ru_maxrss is in kilobytes.
+        CHECK( usage.ru_maxrss - warm_rss < 1024 );
+        CHECK( handler->get_arena().get_heap_allocations() == allocations );
+    }
+}